@@ -0,0 +1,139 @@
+
+#include <algorithm>
+#include "bench_utils.hpp"
+
+namespace black_scholes
+{
+namespace bench
+{
+static std::shared_ptr<RuntimeOperator> MakeConvOperator(const std::string& type, uint32_t batch_size,
+                                                         uint32_t in_channels, uint32_t out_channels,
+                                                         uint32_t kernel_size, uint32_t stride, uint32_t groups,
+                                                         uint32_t input_size, uint32_t output_size)
+{
+    const int32_t padding = type == "nn.Conv2d" ? int32_t(kernel_size / 2) : 0;
+    auto op = MakeOperator(
+        type, {{int32_t(batch_size), int32_t(in_channels), int32_t(input_size), int32_t(input_size)}},
+        {int32_t(batch_size), int32_t(out_channels), int32_t(output_size), int32_t(output_size)});
+    op->params["in_channels"] = std::make_shared<RuntimeParameterInt>(in_channels);
+    op->params["out_channels"] = std::make_shared<RuntimeParameterInt>(out_channels);
+    op->params["kernel_size"] =
+        std::make_shared<RuntimeParameterIntArray>(std::vector<int32_t>{int32_t(kernel_size), int32_t(kernel_size)});
+    op->params["stride"] =
+        std::make_shared<RuntimeParameterIntArray>(std::vector<int32_t>{int32_t(stride), int32_t(stride)});
+    op->params["padding"] = std::make_shared<RuntimeParameterIntArray>(std::vector<int32_t>{padding, padding});
+    op->params["dilation"] = std::make_shared<RuntimeParameterIntArray>(std::vector<int32_t>{1, 1});
+    op->params["groups"] = std::make_shared<RuntimeParameterInt>(groups);
+    op->params["bias"] = std::make_shared<RuntimeParameterBool>(true);
+    op->params["padding_mode"] = std::make_shared<RuntimeParameterString>("zeros");
+    op->params["output_padding"] = std::make_shared<RuntimeParameterIntArray>(std::vector<int32_t>{0, 0});
+
+    if (type == "nn.Conv2d")
+    {
+        op->attribute["weight"] = RandomAttribute(
+            {int32_t(out_channels), int32_t(in_channels / groups), int32_t(kernel_size), int32_t(kernel_size)});
+    }
+    else
+    {
+        op->attribute["weight"] = RandomAttribute(
+            {int32_t(in_channels), int32_t(out_channels / groups), int32_t(kernel_size), int32_t(kernel_size)});
+    }
+    op->attribute["bias"] = RandomAttribute({int32_t(out_channels)});
+    return op;
+}
+
+// args: in channels, out channels, kernel, stride, groups, input size, batch
+static void BM_Conv2d(benchmark::State& state)
+{
+    const uint32_t in_channels = state.range(0);
+    const uint32_t out_channels = state.range(1);
+    const uint32_t kernel_size = state.range(2);
+    const uint32_t stride = state.range(3);
+    const uint32_t groups = state.range(4);
+    const uint32_t input_size = state.range(5);
+    const uint32_t batch_size = state.range(6);
+    const uint32_t output_size = (input_size + 2 * (kernel_size / 2) - kernel_size) / stride + 1;
+
+    auto op = MakeConvOperator("nn.Conv2d", batch_size, in_channels, out_channels, kernel_size, stride, groups,
+                               input_size, output_size);
+    std::vector<sftensor> inputs = RandomTensors(batch_size, in_channels, input_size, input_size);
+    std::vector<sftensor> outputs = OutputTensors(batch_size, out_channels, output_size, output_size);
+    RunLayer(state, op, inputs, outputs);
+}
+
+static void ConvKernelSweep(benchmark::internal::Benchmark* bench)
+{
+    for (int64_t kernel_size : {1, 3, 5, 7})
+    {
+        for (int64_t stride : {1, 2})
+        {
+            bench->Args({64, 64, kernel_size, stride, 1, 56, 1});
+        }
+    }
+}
+
+static void ConvChannelSweep(benchmark::internal::Benchmark* bench)
+{
+    bench->Args({3, 32, 3, 2, 1, 224, 1});
+    for (int64_t channels : {16, 32, 64, 128, 256, 512})
+    {
+        const int64_t size = std::max(int64_t(7), 3584 / channels);
+        bench->Args({channels, channels, 3, 1, 1, size, 1});
+        bench->Args({channels, channels * 2, 1, 1, 1, size, 1});
+    }
+}
+
+static void ConvGroupSweep(benchmark::internal::Benchmark* bench)
+{
+    for (int64_t groups : {1, 2, 4, 8, 32, 128})
+    {
+        bench->Args({128, 128, 3, 1, groups, 28, 1});
+    }
+    // depthwise with stride 2, MobileNet style
+    bench->Args({64, 64, 3, 2, 64, 112, 1});
+}
+
+static void ConvBatchSweep(benchmark::internal::Benchmark* bench)
+{
+    for (int64_t batch_size : {1, 2, 4, 8})
+    {
+        bench->Args({64, 64, 3, 1, 1, 56, batch_size});
+    }
+}
+
+static const std::vector<std::string> kConvArgNames{"in", "out", "k", "s", "g", "hw", "n"};
+
+BENCHMARK(BM_Conv2d)->Name("Conv2d/kernel")->ArgNames(kConvArgNames)->Apply(ConvKernelSweep)->UseRealTime();
+BENCHMARK(BM_Conv2d)->Name("Conv2d/channel")->ArgNames(kConvArgNames)->Apply(ConvChannelSweep)->UseRealTime();
+BENCHMARK(BM_Conv2d)->Name("Conv2d/group")->ArgNames(kConvArgNames)->Apply(ConvGroupSweep)->UseRealTime();
+BENCHMARK(BM_Conv2d)->Name("Conv2d/batch")->ArgNames(kConvArgNames)->Apply(ConvBatchSweep)->UseRealTime();
+
+// args: in channels, out channels, kernel, stride, groups, input size, batch
+static void BM_ConvTranspose2d(benchmark::State& state)
+{
+    const uint32_t in_channels = state.range(0);
+    const uint32_t out_channels = state.range(1);
+    const uint32_t kernel_size = state.range(2);
+    const uint32_t stride = state.range(3);
+    const uint32_t groups = state.range(4);
+    const uint32_t input_size = state.range(5);
+    const uint32_t batch_size = state.range(6);
+    const uint32_t output_size = (input_size - 1) * stride + kernel_size;
+
+    auto op = MakeConvOperator("nn.ConvTranspose2d", batch_size, in_channels, out_channels, kernel_size, stride, groups,
+                               input_size, output_size);
+    std::vector<sftensor> inputs = RandomTensors(batch_size, in_channels, input_size, input_size);
+    std::vector<sftensor> outputs = OutputTensors(batch_size, out_channels, output_size, output_size);
+    RunLayer(state, op, inputs, outputs);
+}
+
+BENCHMARK(BM_ConvTranspose2d)
+    ->ArgNames(kConvArgNames)
+    ->Args({64, 32, 2, 2, 1, 28, 1})
+    ->Args({64, 32, 4, 2, 1, 28, 1})
+    ->Args({128, 64, 3, 2, 1, 14, 1})
+    ->Args({32, 16, 3, 1, 1, 56, 1})
+    ->Args({64, 64, 4, 2, 8, 28, 1})
+    ->UseRealTime();
+}  // namespace bench
+}  // namespace black_scholes
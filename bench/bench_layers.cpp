@@ -0,0 +1,189 @@
+
+#include "../src/layer/details/activation.hpp"
+#include "bench_utils.hpp"
+
+namespace black_scholes
+{
+namespace bench
+{
+// args: channels, size, batch
+static void BM_BatchNorm2d(benchmark::State& state)
+{
+    const int32_t channels = state.range(0);
+    const int32_t size = state.range(1);
+    const int32_t batch_size = state.range(2);
+
+    auto op = MakeOperator("nn.BatchNorm2d", {{batch_size, channels, size, size}}, {batch_size, channels, size, size});
+    op->params["num_features"] = std::make_shared<RuntimeParameterInt>(channels);
+    op->params["eps"] = std::make_shared<RuntimeParameterFloat>(1e-5f);
+    op->attribute["running_mean"] = RandomAttribute({channels});
+    op->attribute["running_var"] = RandomAttribute({channels}, 0.5f, 2.f);
+    op->attribute["weight"] = RandomAttribute({channels});
+    op->attribute["bias"] = RandomAttribute({channels});
+
+    std::vector<sftensor> inputs = RandomTensors(batch_size, channels, size, size);
+    std::vector<sftensor> outputs = OutputTensors(batch_size, channels, size, size);
+    RunLayer(state, op, inputs, outputs);
+}
+
+BENCHMARK(BM_BatchNorm2d)
+    ->ArgNames({"c", "hw", "n"})
+    ->Args({64, 112, 1})
+    ->Args({256, 56, 1})
+    ->Args({1024, 14, 1})
+    ->Args({64, 112, 4})
+    ->UseRealTime();
+
+// args: activation type, channels, size
+static void BM_Activation(benchmark::State& state)
+{
+    const auto activation_type = activation::ActivationType(state.range(0));
+    const uint32_t channels = state.range(1);
+    const uint32_t size = state.range(2);
+    state.SetLabel(activation::ActivationTypeToString(activation_type));
+
+    activation::ActivationLayer layer(activation_type, activation::ActivationTypeToString(activation_type));
+    std::vector<sftensor> inputs = RandomTensors(1, channels, size, size);
+    std::vector<sftensor> outputs = OutputTensors(1, channels, size, size);
+    for (auto _ : state)
+    {
+        if (layer.Forward(inputs, outputs) != StatusCode::kSuccess)
+        {
+            state.SkipWithError("layer forward failed");
+            break;
+        }
+        benchmark::ClobberMemory();
+    }
+    utils::LayerCost cost;
+    cost.bytes = 2. * channels * size * size * sizeof(float);
+    ReportCost(state, cost);
+}
+
+static void ActivationSweep(benchmark::internal::Benchmark* bench)
+{
+    for (auto activation_type :
+         {activation::ActivationType::kActivationRelu, activation::ActivationType::kActivationRelu6,
+          activation::ActivationType::kActivationSigmoid, activation::ActivationType::kActivationSilu,
+          activation::ActivationType::kActivationHardSwish, activation::ActivationType::kActivationHardSigmoid})
+    {
+        bench->Args({int64_t(activation_type), 64, 112});
+        bench->Args({int64_t(activation_type), 256, 28});
+    }
+}
+
+BENCHMARK(BM_Activation)->ArgNames({"type", "c", "hw"})->Apply(ActivationSweep)->UseRealTime();
+
+// nn.SiLU through the layer registry, the path the runtime takes
+static void BM_SiLU(benchmark::State& state)
+{
+    const int32_t channels = state.range(0);
+    const int32_t size = state.range(1);
+    auto op = MakeOperator("nn.SiLU", {{1, channels, size, size}}, {1, channels, size, size});
+    std::vector<sftensor> inputs = RandomTensors(1, channels, size, size);
+    std::vector<sftensor> outputs = OutputTensors(1, channels, size, size);
+    RunLayer(state, op, inputs, outputs);
+}
+
+BENCHMARK(BM_SiLU)->ArgNames({"c", "hw"})->Args({64, 112})->Args({256, 28})->UseRealTime();
+
+// args: channels, input size, output size
+static void BM_AdaptiveAvgPool2d(benchmark::State& state)
+{
+    const int32_t channels = state.range(0);
+    const int32_t input_size = state.range(1);
+    const int32_t output_size = state.range(2);
+    auto op = MakeOperator("nn.AdaptiveAvgPool2d", {{1, channels, input_size, input_size}},
+                           {1, channels, output_size, output_size});
+    op->params["output_size"] =
+        std::make_shared<RuntimeParameterIntArray>(std::vector<int32_t>{output_size, output_size});
+    std::vector<sftensor> inputs = RandomTensors(1, channels, input_size, input_size);
+    std::vector<sftensor> outputs = OutputTensors(1, channels, output_size, output_size);
+    RunLayer(state, op, inputs, outputs);
+}
+
+BENCHMARK(BM_AdaptiveAvgPool2d)
+    ->ArgNames({"c", "in", "out"})
+    ->Args({2048, 7, 1})
+    ->Args({512, 14, 7})
+    ->Args({64, 112, 1})
+    ->UseRealTime();
+
+// args: input count, channels per input, size, batch
+static void BM_Cat(benchmark::State& state)
+{
+    const int32_t input_count = state.range(0);
+    const int32_t channels = state.range(1);
+    const int32_t size = state.range(2);
+    const int32_t batch_size = state.range(3);
+
+    std::vector<std::vector<int32_t>> input_shapes(input_count, {batch_size, channels, size, size});
+    auto op = MakeOperator("torch.cat", input_shapes, {batch_size, channels * input_count, size, size});
+    op->params["dim"] = std::make_shared<RuntimeParameterInt>(1);
+
+    // the inputs of all operands are laid out operand after operand
+    std::vector<sftensor> inputs;
+    for (int32_t i = 0; i < input_count; ++i)
+    {
+        std::vector<sftensor> operand_inputs = RandomTensors(batch_size, channels, size, size);
+        inputs.insert(inputs.end(), operand_inputs.begin(), operand_inputs.end());
+    }
+    std::vector<sftensor> outputs = OutputTensors(batch_size, channels * input_count, size, size);
+    RunLayer(state, op, inputs, outputs);
+}
+
+BENCHMARK(BM_Cat)
+    ->ArgNames({"inputs", "c", "hw", "n"})
+    ->Args({2, 128, 40, 1})
+    ->Args({4, 64, 80, 1})
+    ->Args({2, 256, 20, 4})
+    ->UseRealTime();
+
+// args: channels, size
+static void BM_Flatten(benchmark::State& state)
+{
+    const int32_t channels = state.range(0);
+    const int32_t size = state.range(1);
+    auto op = MakeOperator("torch.flatten", {{1, channels, size, size}}, {1, channels * size * size});
+    op->params["start_dim"] = std::make_shared<RuntimeParameterInt>(1);
+    op->params["end_dim"] = std::make_shared<RuntimeParameterInt>(-1);
+    std::vector<sftensor> inputs = RandomTensors(1, channels, size, size);
+    std::vector<sftensor> outputs(1);
+    RunLayer(state, op, inputs, outputs);
+
+    // flatten has no cost function, it copies its input once
+    utils::LayerCost cost;
+    cost.bytes = 2. * channels * size * size * sizeof(float);
+    ReportCost(state, cost);
+}
+
+BENCHMARK(BM_Flatten)->ArgNames({"c", "hw"})->Args({512, 7})->Args({64, 56})->UseRealTime();
+
+// args: expression index, channels, size
+static void BM_Expression(benchmark::State& state)
+{
+    static const std::vector<std::pair<std::string, int32_t>> kExpressions{
+        {"add(@0,@1)", 2}, {"mul(@0,@1)", 2}, {"add(mul(@0,@1),@2)", 3}};
+    const auto& [statement, input_count] = kExpressions.at(state.range(0));
+    const int32_t channels = state.range(1);
+    const int32_t size = state.range(2);
+    state.SetLabel(statement);
+
+    std::vector<std::vector<int32_t>> input_shapes(input_count, {1, channels, size, size});
+    auto op = MakeOperator("pnnx.Expression", input_shapes, {1, channels, size, size});
+    op->params["expr"] = std::make_shared<RuntimeParameterString>(statement);
+    std::vector<sftensor> inputs;
+    for (int32_t i = 0; i < input_count; ++i)
+    {
+        std::vector<sftensor> operand_inputs = RandomTensors(1, channels, size, size);
+        inputs.insert(inputs.end(), operand_inputs.begin(), operand_inputs.end());
+    }
+    std::vector<sftensor> outputs(1);
+    RunLayer(state, op, inputs, outputs);
+}
+
+BENCHMARK(BM_Expression)
+    ->ArgNames({"expr", "c", "hw"})
+    ->ArgsProduct({{0, 1, 2}, {64}, {56, 112}})
+    ->UseRealTime();
+}  // namespace bench
+}  // namespace black_scholes
@@ -0,0 +1,194 @@
+
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include "bench_utils.hpp"
+#include "runtime/runtime_ir.hpp"
+#include "synthetic_models.hpp"
+
+namespace black_scholes
+{
+namespace bench
+{
+constexpr uint32_t kModelInputSize = 224;
+
+struct ModelFiles
+{
+    std::string param_path;
+    std::string bin_path;
+};
+
+/// generates each (model, batch) pair once per process into the temp directory
+static const ModelFiles& EnsureModelFiles(SyntheticModel model, uint32_t batch_size)
+{
+    static std::mutex files_mutex;
+    static std::map<std::pair<int32_t, uint32_t>, ModelFiles> model_files;
+    std::lock_guard<std::mutex> lock(files_mutex);
+    const auto key = std::make_pair(int32_t(model), batch_size);
+    auto files_iter = model_files.find(key);
+    if (files_iter != model_files.end())
+    {
+        return files_iter->second;
+    }
+
+    const char* temp_dir = std::getenv("TMPDIR");
+    const std::string prefix = std::string(temp_dir != nullptr ? temp_dir : "/tmp") + "/block_scholes_" +
+                               SyntheticModelName(model) + "_b" + std::to_string(batch_size);
+    ModelFiles files{prefix + ".pnnx.param", prefix + ".pnnx.bin"};
+    CHECK(SaveSyntheticModel(model, batch_size, kModelInputSize, files.param_path, files.bin_path));
+    return model_files.emplace(key, files).first->second;
+}
+
+static void SetModelInputs(RuntimeGraph& graph, uint32_t batch_size)
+{
+    graph.set_inputs(kSyntheticInputName, RandomTensors(batch_size, 3, kModelInputSize, kModelInputSize));
+}
+
+/**
+ * @brief Resets the peak resident set size of the process to its current size
+ *
+ * ru_maxrss only grows over the process, writing 5 to clear_refs restarts
+ * VmHWM so every benchmark reports its own peak.
+ */
+static void ResetPeakRss()
+{
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+    LOG_IF(WARNING, !clear_refs.flush()) << "Can not reset the peak RSS, it is the peak of the whole process";
+}
+
+/// VmHWM of the process in kB, 0 when it is not available
+static double PeakRssKb()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 6, "VmHWM:") == 0)
+        {
+            std::istringstream value(line.substr(6));
+            double peak_kb = 0.;
+            value >> peak_kb;
+            return peak_kb;
+        }
+    }
+    return 0.;
+}
+
+/// the peak since the last ResetPeakRss
+static void ReportPeakRss(benchmark::State& state)
+{
+    state.counters["peak_rss_MB"] = PeakRssKb() / 1024.;
+}
+
+// args: model
+static void BM_ModelBuild(benchmark::State& state)
+{
+    const auto model = SyntheticModel(state.range(0));
+    const ModelFiles& files = EnsureModelFiles(model, 1);
+    state.SetLabel(SyntheticModelName(model));
+    ResetPeakRss();
+    for (auto _ : state)
+    {
+        RuntimeGraph graph(files.param_path, files.bin_path);
+        graph.Build();
+        benchmark::DoNotOptimize(graph.graph_state());
+    }
+    ReportPeakRss(state);
+}
+
+// args: model
+static void BM_ModelFirstInference(benchmark::State& state)
+{
+    const auto model = SyntheticModel(state.range(0));
+    const ModelFiles& files = EnsureModelFiles(model, 1);
+    state.SetLabel(SyntheticModelName(model));
+    ResetPeakRss();
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto graph = std::make_unique<RuntimeGraph>(files.param_path, files.bin_path);
+        graph->Build();
+        SetModelInputs(*graph, 1);
+        state.ResumeTiming();
+
+        graph->Forward();
+
+        state.PauseTiming();
+        graph.reset();
+        state.ResumeTiming();
+    }
+    ReportPeakRss(state);
+}
+
+// args: model, batch
+static void BM_ModelSteadyState(benchmark::State& state)
+{
+    const auto model = SyntheticModel(state.range(0));
+    const uint32_t batch_size = state.range(1);
+    const ModelFiles& files = EnsureModelFiles(model, batch_size);
+    state.SetLabel(SyntheticModelName(model));
+    ResetPeakRss();
+
+    RuntimeGraph graph(files.param_path, files.bin_path);
+    graph.Build();
+    SetModelInputs(graph, batch_size);
+    for (uint32_t warmup = 0; warmup < 3; ++warmup)
+    {
+        graph.Forward();
+    }
+    graph.ResetLatencyHistograms();
+
+    for (auto _ : state)
+    {
+        graph.Forward();
+    }
+
+    // throughput versus batch
+    state.SetItemsProcessed(int64_t(state.iterations()) * batch_size);
+    const std::vector<utils::LatencySnapshot> snapshots = graph.latency_snapshot();
+    if (!snapshots.empty() && snapshots.front().name == "forward")
+    {
+        const utils::LatencySnapshot& forward = snapshots.front();
+        state.counters["p50_ms"] = double(forward.p50_ns) * 1e-6;
+        state.counters["p90_ms"] = double(forward.p90_ns) * 1e-6;
+        state.counters["p99_ms"] = double(forward.p99_ns) * 1e-6;
+    }
+    ReportPeakRss(state);
+}
+
+static void ModelSweep(benchmark::internal::Benchmark* bench)
+{
+    for (auto model : {SyntheticModel::kResNet, SyntheticModel::kYoloNeck, SyntheticModel::kMobileNet})
+    {
+        bench->Args({int64_t(model)});
+    }
+}
+
+static void ModelBatchSweep(benchmark::internal::Benchmark* bench)
+{
+    for (auto model : {SyntheticModel::kResNet, SyntheticModel::kYoloNeck, SyntheticModel::kMobileNet})
+    {
+        for (int64_t batch_size : {1, 2, 4, 8})
+        {
+            bench->Args({int64_t(model), batch_size});
+        }
+    }
+}
+
+BENCHMARK(BM_ModelBuild)->ArgNames({"model"})->Apply(ModelSweep)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_ModelFirstInference)
+    ->ArgNames({"model"})
+    ->Apply(ModelSweep)
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(5)
+    ->UseRealTime();
+BENCHMARK(BM_ModelSteadyState)
+    ->ArgNames({"model", "n"})
+    ->Apply(ModelBatchSweep)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+}  // namespace bench
+}  // namespace black_scholes
@@ -0,0 +1,153 @@
+
+#ifndef DL_BENCH_BENCH_UTILS_HPP_
+#define DL_BENCH_BENCH_UTILS_HPP_
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "data/tensor.hpp"
+#include "layer/abstract/layer_cost.hpp"
+#include "layer/abstract/layer_factory.hpp"
+#include "runtime/runtime_op.hpp"
+
+namespace black_scholes
+{
+namespace bench
+{
+/**
+ * @brief Creates a float32 attribute filled with uniform random values
+ *
+ * @param shape Shape of the attribute
+ * @param low Lower bound of the values
+ * @param high Upper bound of the values
+ * @return The attribute
+ */
+inline std::shared_ptr<RuntimeAttribute> RandomAttribute(const std::vector<int32_t>& shape, float low = -1.f,
+                                                         float high = 1.f)
+{
+    size_t size = 1;
+    for (int32_t dim : shape)
+    {
+        size *= size_t(dim);
+    }
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> distribution(low, high);
+    std::vector<float> values(size);
+    for (float& value : values)
+    {
+        value = distribution(generator);
+    }
+    std::vector<char> weight_data(size * sizeof(float));
+    std::memcpy(weight_data.data(), values.data(), weight_data.size());
+    return std::make_shared<RuntimeAttribute>(shape, RuntimeDataType::kTypeFloat32, std::move(weight_data));
+}
+
+/**
+ * @brief Creates an operator with the shapes the cost model reads
+ *
+ * @param type Layer type, e.g. "nn.Conv2d"
+ * @param input_shapes Shape of every input operand, batch first
+ * @param output_shape Shape of the output operand, batch first
+ * @return The operator, parameters and attributes are filled by the caller
+ */
+inline std::shared_ptr<RuntimeOperator> MakeOperator(const std::string& type,
+                                                     const std::vector<std::vector<int32_t>>& input_shapes,
+                                                     const std::vector<int32_t>& output_shape)
+{
+    auto op = std::make_shared<RuntimeOperator>();
+    op->name = type;
+    op->type = type;
+    for (uint32_t i = 0; i < input_shapes.size(); ++i)
+    {
+        op->input_operands_seq.push_back(std::make_shared<RuntimeOperand>(
+            "input" + std::to_string(i), input_shapes.at(i), std::vector<sftensor>{}, RuntimeDataType::kTypeFloat32));
+    }
+    op->output_operands = std::make_shared<RuntimeOperand>("output", output_shape, std::vector<sftensor>{},
+                                                           RuntimeDataType::kTypeFloat32);
+    return op;
+}
+
+/**
+ * @brief Creates batch random tensors of shape (channels, rows, cols)
+ *
+ * @param batch_size Number of tensors
+ * @param channels Number of channels
+ * @param rows Number of rows
+ * @param cols Number of cols
+ * @return The tensors
+ */
+inline std::vector<sftensor> RandomTensors(uint32_t batch_size, uint32_t channels, uint32_t rows, uint32_t cols)
+{
+    std::vector<sftensor> tensors(batch_size);
+    for (uint32_t i = 0; i < batch_size; ++i)
+    {
+        tensors.at(i) = std::make_shared<Tensor<float>>(channels, rows, cols);
+        tensors.at(i)->Rand();
+    }
+    return tensors;
+}
+
+/**
+ * @brief Creates batch empty output tensors of shape (channels, rows, cols)
+ *
+ * @param batch_size Number of tensors
+ * @param channels Number of channels
+ * @param rows Number of rows
+ * @param cols Number of cols
+ * @return The tensors
+ */
+inline std::vector<sftensor> OutputTensors(uint32_t batch_size, uint32_t channels, uint32_t rows, uint32_t cols)
+{
+    std::vector<sftensor> tensors(batch_size);
+    for (uint32_t i = 0; i < batch_size; ++i)
+    {
+        tensors.at(i) = std::make_shared<Tensor<float>>(channels, rows, cols);
+    }
+    return tensors;
+}
+
+/**
+ * @brief Publishes the GFLOP/s and GB/s of one layer execution per iteration
+ *
+ * @param state The benchmark state
+ * @param cost The cost of one execution
+ */
+inline void ReportCost(benchmark::State& state, const utils::LayerCost& cost)
+{
+    if (cost.flops > 0.)
+    {
+        state.counters["GFLOP/s"] =
+            benchmark::Counter(cost.flops * 1e-9, benchmark::Counter::kIsIterationInvariantRate);
+    }
+    state.counters["GB/s"] = benchmark::Counter(cost.bytes * 1e-9, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+/**
+ * @brief Runs the layer of an operator in the benchmark loop
+ *
+ * @param state The benchmark state
+ * @param op The operator, the layer is created from the registry
+ * @param inputs Input tensors
+ * @param outputs Output tensors
+ */
+inline void RunLayer(benchmark::State& state, const std::shared_ptr<RuntimeOperator>& op,
+                     const std::vector<sftensor>& inputs, std::vector<sftensor>& outputs)
+{
+    std::shared_ptr<Layer<float>> layer = LayerRegisterer::CreateLayer(op);
+    for (auto _ : state)
+    {
+        const StatusCode status = layer->Forward(inputs, outputs);
+        if (status != StatusCode::kSuccess)
+        {
+            state.SkipWithError("layer forward failed");
+            break;
+        }
+        benchmark::ClobberMemory();
+    }
+    ReportCost(state, LayerCostRegisterer::EstimateCost(op));
+}
+}  // namespace bench
+}  // namespace black_scholes
+#endif
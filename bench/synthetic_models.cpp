@@ -0,0 +1,316 @@
+
+#include "synthetic_models.hpp"
+#include <glog/logging.h>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include "runtime/pnnx/ir.h"
+
+namespace black_scholes
+{
+namespace bench
+{
+std::string SyntheticModelName(SyntheticModel model)
+{
+    switch (model)
+    {
+        case SyntheticModel::kResNet:
+            return "resnet";
+        case SyntheticModel::kYoloNeck:
+            return "yolo_neck";
+        case SyntheticModel::kMobileNet:
+            return "mobilenet";
+        default:
+            LOG(FATAL) << "Unknown synthetic model: " << int32_t(model);
+            return "";
+    }
+}
+
+std::vector<std::string> SyntheticOutputNames(SyntheticModel model)
+{
+    if (model == SyntheticModel::kYoloNeck)
+    {
+        return {"pnnx_output_0", "pnnx_output_1"};
+    }
+    return {"pnnx_output_0"};
+}
+
+/**
+ * @brief Appends operators to a pnnx graph while tracking the operand shapes
+ */
+class SyntheticGraphBuilder
+{
+   public:
+    explicit SyntheticGraphBuilder(pnnx::Graph& graph) : graph_(graph), generator_(42)
+    {
+    }
+
+    pnnx::Operand* Input(const std::vector<int>& shape)
+    {
+        pnnx::Operator* op = graph_.new_operator("pnnx.Input", kSyntheticInputName);
+        return AddOutput(op, shape);
+    }
+
+    void Output(pnnx::Operand* x, const std::string& name)
+    {
+        pnnx::Operator* op = graph_.new_operator("pnnx.Output", name);
+        AddInput(op, x);
+    }
+
+    pnnx::Operand* Conv(pnnx::Operand* x, int out_channels, int kernel_size, int stride, int groups = 1)
+    {
+        const int in_channels = x->shape.at(1);
+        const int padding = kernel_size / 2;
+        const int output_h = (x->shape.at(2) + 2 * padding - kernel_size) / stride + 1;
+        const int output_w = (x->shape.at(3) + 2 * padding - kernel_size) / stride + 1;
+
+        pnnx::Operator* op = NewOperator("nn.Conv2d", "conv");
+        op->params["in_channels"] = in_channels;
+        op->params["out_channels"] = out_channels;
+        op->params["kernel_size"] = std::vector<int>{kernel_size, kernel_size};
+        op->params["stride"] = std::vector<int>{stride, stride};
+        op->params["padding"] = std::vector<int>{padding, padding};
+        op->params["dilation"] = std::vector<int>{1, 1};
+        op->params["groups"] = groups;
+        op->params["bias"] = true;
+        op->params["padding_mode"] = "zeros";
+        const int fan_in = in_channels / groups * kernel_size * kernel_size;
+        op->attrs["weight"] = RandomAttribute({out_channels, in_channels / groups, kernel_size, kernel_size}, fan_in);
+        op->attrs["bias"] = RandomAttribute({out_channels}, fan_in);
+        AddInput(op, x);
+        return AddOutput(op, {x->shape.at(0), out_channels, output_h, output_w});
+    }
+
+    /// learned 2x upsampling, nn.Upsample has no layer in the runtime
+    pnnx::Operand* Upsample(pnnx::Operand* x)
+    {
+        const int channels = x->shape.at(1);
+        pnnx::Operator* op = NewOperator("nn.ConvTranspose2d", "upsample");
+        op->params["in_channels"] = channels;
+        op->params["out_channels"] = channels;
+        op->params["kernel_size"] = std::vector<int>{2, 2};
+        op->params["stride"] = std::vector<int>{2, 2};
+        op->params["padding"] = std::vector<int>{0, 0};
+        op->params["output_padding"] = std::vector<int>{0, 0};
+        op->params["dilation"] = std::vector<int>{1, 1};
+        op->params["groups"] = 1;
+        op->params["bias"] = true;
+        op->attrs["weight"] = RandomAttribute({channels, channels, 2, 2}, channels);
+        op->attrs["bias"] = RandomAttribute({channels}, channels);
+        AddInput(op, x);
+        return AddOutput(op, {x->shape.at(0), channels, x->shape.at(2) * 2, x->shape.at(3) * 2});
+    }
+
+    pnnx::Operand* BatchNorm(pnnx::Operand* x)
+    {
+        const int channels = x->shape.at(1);
+        pnnx::Operator* op = NewOperator("nn.BatchNorm2d", "bn");
+        op->params["num_features"] = channels;
+        op->params["eps"] = 1e-5f;
+        op->params["affine"] = true;
+        op->attrs["running_mean"] = UniformAttribute({channels}, -0.1f, 0.1f);
+        op->attrs["running_var"] = UniformAttribute({channels}, 0.5f, 1.5f);
+        op->attrs["weight"] = UniformAttribute({channels}, 0.5f, 1.5f);
+        op->attrs["bias"] = UniformAttribute({channels}, -0.1f, 0.1f);
+        AddInput(op, x);
+        return AddOutput(op, x->shape);
+    }
+
+    pnnx::Operand* SiLU(pnnx::Operand* x)
+    {
+        pnnx::Operator* op = NewOperator("nn.SiLU", "silu");
+        AddInput(op, x);
+        return AddOutput(op, x->shape);
+    }
+
+    pnnx::Operand* ConvBnAct(pnnx::Operand* x, int out_channels, int kernel_size, int stride, int groups = 1)
+    {
+        return SiLU(BatchNorm(Conv(x, out_channels, kernel_size, stride, groups)));
+    }
+
+    pnnx::Operand* Add(pnnx::Operand* a, pnnx::Operand* b)
+    {
+        pnnx::Operator* op = NewOperator("pnnx.Expression", "add");
+        op->params["expr"] = "add(@0,@1)";
+        AddInput(op, a);
+        AddInput(op, b);
+        return AddOutput(op, a->shape);
+    }
+
+    pnnx::Operand* Cat(const std::vector<pnnx::Operand*>& xs)
+    {
+        pnnx::Operator* op = NewOperator("torch.cat", "cat");
+        op->params["dim"] = 1;
+        std::vector<int> shape = xs.front()->shape;
+        shape.at(1) = 0;
+        for (pnnx::Operand* x : xs)
+        {
+            AddInput(op, x);
+            shape.at(1) += x->shape.at(1);
+        }
+        return AddOutput(op, shape);
+    }
+
+    pnnx::Operand* GlobalPoolFlatten(pnnx::Operand* x)
+    {
+        pnnx::Operator* pool = NewOperator("nn.AdaptiveAvgPool2d", "pool");
+        pool->params["output_size"] = std::vector<int>{1, 1};
+        AddInput(pool, x);
+        pnnx::Operand* pooled = AddOutput(pool, {x->shape.at(0), x->shape.at(1), 1, 1});
+
+        pnnx::Operator* flatten = NewOperator("torch.flatten", "flatten");
+        flatten->params["start_dim"] = 1;
+        flatten->params["end_dim"] = -1;
+        AddInput(flatten, pooled);
+        return AddOutput(flatten, {x->shape.at(0), x->shape.at(1)});
+    }
+
+   private:
+    pnnx::Operator* NewOperator(const std::string& type, const std::string& prefix)
+    {
+        return graph_.new_operator(type, prefix + "_" + std::to_string(op_count_++));
+    }
+
+    void AddInput(pnnx::Operator* op, pnnx::Operand* x)
+    {
+        op->inputs.push_back(x);
+        x->consumers.push_back(op);
+    }
+
+    pnnx::Operand* AddOutput(pnnx::Operator* op, const std::vector<int>& shape)
+    {
+        pnnx::Operand* y = graph_.new_operand(std::to_string(operand_count_++));
+        y->type = 1;
+        y->shape = shape;
+        y->producer = op;
+        op->outputs.push_back(y);
+        return y;
+    }
+
+    pnnx::Attribute UniformAttribute(const std::vector<int>& shape, float low, float high)
+    {
+        pnnx::Attribute attr;
+        attr.type = 1;
+        attr.shape = shape;
+        std::vector<float> values(attr.elemcount());
+        std::uniform_real_distribution<float> distribution(low, high);
+        for (float& value : values)
+        {
+            value = distribution(generator_);
+        }
+        attr.data.resize(values.size() * sizeof(float));
+        std::memcpy(attr.data.data(), values.data(), attr.data.size());
+        return attr;
+    }
+
+    /// uniform in +-1/sqrt(fan_in), the PyTorch default, keeps activations bounded
+    pnnx::Attribute RandomAttribute(const std::vector<int>& shape, int fan_in)
+    {
+        const float bound = 1.f / std::sqrt(float(fan_in));
+        return UniformAttribute(shape, -bound, bound);
+    }
+
+   private:
+    pnnx::Graph& graph_;
+    std::mt19937 generator_;
+    uint32_t op_count_ = 0;
+    uint32_t operand_count_ = 0;
+};
+
+static void BuildResNet(SyntheticGraphBuilder& builder, pnnx::Operand* x)
+{
+    x = builder.ConvBnAct(x, 32, 3, 2);
+    for (int channels : {64, 128, 256})
+    {
+        for (int block = 0; block < 2; ++block)
+        {
+            const int stride = block == 0 ? 2 : 1;
+            pnnx::Operand* shortcut = x;
+            if (stride != 1 || x->shape.at(1) != channels)
+            {
+                shortcut = builder.BatchNorm(builder.Conv(x, channels, 1, stride));
+            }
+            pnnx::Operand* y = builder.ConvBnAct(x, channels, 3, stride);
+            y = builder.BatchNorm(builder.Conv(y, channels, 3, 1));
+            x = builder.SiLU(builder.Add(y, shortcut));
+        }
+    }
+    builder.Output(builder.GlobalPoolFlatten(x), "pnnx_output_0");
+}
+
+static void BuildYoloNeck(SyntheticGraphBuilder& builder, pnnx::Operand* x)
+{
+    x = builder.ConvBnAct(x, 32, 3, 2);
+    x = builder.ConvBnAct(x, 64, 3, 2);
+    pnnx::Operand* c3 = builder.ConvBnAct(x, 128, 3, 2);
+    pnnx::Operand* c4 = builder.ConvBnAct(c3, 256, 3, 2);
+    pnnx::Operand* c5 = builder.ConvBnAct(c4, 512, 3, 2);
+
+    // top-down path
+    pnnx::Operand* p5 = builder.ConvBnAct(c5, 256, 1, 1);
+    pnnx::Operand* p4 = builder.Cat({builder.Upsample(p5), c4});
+    p4 = builder.ConvBnAct(p4, 256, 3, 1);
+    pnnx::Operand* p4_reduced = builder.ConvBnAct(p4, 128, 1, 1);
+    pnnx::Operand* p3 = builder.Cat({builder.Upsample(p4_reduced), c3});
+    p3 = builder.ConvBnAct(p3, 128, 3, 1);
+
+    // bottom-up path
+    pnnx::Operand* n4 = builder.Cat({builder.ConvBnAct(p3, 128, 3, 2), p4_reduced});
+    n4 = builder.ConvBnAct(n4, 256, 3, 1);
+
+    builder.Output(builder.Conv(p3, 85, 1, 1), "pnnx_output_0");
+    builder.Output(builder.Conv(n4, 85, 1, 1), "pnnx_output_1");
+}
+
+static void BuildMobileNet(SyntheticGraphBuilder& builder, pnnx::Operand* x)
+{
+    x = builder.ConvBnAct(x, 32, 3, 2);
+    const std::vector<std::pair<int, int>> blocks{{16, 1}, {24, 2}, {24, 1},  {40, 2},  {40, 1},
+                                                  {80, 2}, {80, 1}, {112, 1}, {160, 2}, {160, 1}};
+    for (const auto& [channels, stride] : blocks)
+    {
+        const int expand_channels = x->shape.at(1) * 4;
+        pnnx::Operand* y = builder.ConvBnAct(x, expand_channels, 1, 1);
+        y = builder.ConvBnAct(y, expand_channels, 3, stride, expand_channels);
+        y = builder.BatchNorm(builder.Conv(y, channels, 1, 1));
+        if (stride == 1 && x->shape.at(1) == channels)
+        {
+            y = builder.Add(y, x);
+        }
+        x = y;
+    }
+    x = builder.ConvBnAct(x, 320, 1, 1);
+    builder.Output(builder.GlobalPoolFlatten(x), "pnnx_output_0");
+}
+
+bool SaveSyntheticModel(SyntheticModel model, uint32_t batch_size, uint32_t input_size, const std::string& param_path,
+                        const std::string& bin_path)
+{
+    pnnx::Graph graph;
+    SyntheticGraphBuilder builder(graph);
+    pnnx::Operand* input = builder.Input({int(batch_size), 3, int(input_size), int(input_size)});
+    switch (model)
+    {
+        case SyntheticModel::kResNet:
+            BuildResNet(builder, input);
+            break;
+        case SyntheticModel::kYoloNeck:
+            BuildYoloNeck(builder, input);
+            break;
+        case SyntheticModel::kMobileNet:
+            BuildMobileNet(builder, input);
+            break;
+        default:
+            LOG(ERROR) << "Unknown synthetic model: " << int32_t(model);
+            return false;
+    }
+
+    if (graph.save(param_path, bin_path) != 0)
+    {
+        LOG(ERROR) << "Can not save the synthetic model to: " << param_path << " and " << bin_path;
+        return false;
+    }
+    return true;
+}
+}  // namespace bench
+}  // namespace black_scholes
@@ -0,0 +1,63 @@
+
+#ifndef DL_BENCH_SYNTHETIC_MODELS_HPP_
+#define DL_BENCH_SYNTHETIC_MODELS_HPP_
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace black_scholes
+{
+namespace bench
+{
+/**
+ * @brief Representative network shapes of the synthetic models
+ */
+enum class SyntheticModel
+{
+    /// Basic residual blocks with projection shortcuts, conv + bn + silu
+    kResNet = 0,
+    /// Strided backbone with a top-down and bottom-up neck of cat and 2x upsampling
+    kYoloNeck = 1,
+    /// Inverted residual blocks with depthwise convolutions
+    kMobileNet = 2,
+};
+
+/**
+ * @brief Gets the name of a synthetic model
+ *
+ * @param model The model
+ * @return The name, usable in file names
+ */
+std::string SyntheticModelName(SyntheticModel model);
+
+/**
+ * @brief Name of the input operator of every synthetic model
+ */
+constexpr const char* kSyntheticInputName = "pnnx_input_0";
+
+/**
+ * @brief Names of the output operators of a synthetic model
+ *
+ * @param model The model
+ * @return The output operator names
+ */
+std::vector<std::string> SyntheticOutputNames(SyntheticModel model);
+
+/**
+ * @brief Writes a synthetic model with random weights as a pnnx .param/.bin pair
+ *
+ * The weights are drawn from a fixed seed, so the files are reproducible.
+ * The input is (batch, 3, input_size, input_size).
+ *
+ * @param model The model to generate
+ * @param batch_size Batch size baked into the operand shapes
+ * @param input_size Height and width of the input
+ * @param param_path Output .param path
+ * @param bin_path Output .bin path
+ * @return True if both files were written
+ */
+bool SaveSyntheticModel(SyntheticModel model, uint32_t batch_size, uint32_t input_size, const std::string& param_path,
+                        const std::string& bin_path);
+}  // namespace bench
+}  // namespace black_scholes
+#endif
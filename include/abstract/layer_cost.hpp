@@ -0,0 +1,98 @@
+
+#ifndef DL_SOURCE_LAYER_LAYER_COST_HPP_
+#define DL_SOURCE_LAYER_LAYER_COST_HPP_
+#include <map>
+#include <memory>
+#include <string>
+
+#include "runtime/runtime_op.hpp"
+#include "utils/perf/roofline.hpp"
+
+namespace black_scholes
+{
+/**
+ * @brief Registry of analytic cost functions per layer type
+ *
+ * Mirrors LayerRegisterer: every layer type registers a function which
+ * derives the FLOPs and bytes of one execution from the operator shapes,
+ * parameters and attributes, so the cost is known without running it.
+ */
+class LayerCostRegisterer
+{
+   public:
+    typedef utils::LayerCost (*CostFunction)(const std::shared_ptr<RuntimeOperator>& op);
+
+    typedef std::map<std::string, CostFunction> CostRegistry;
+
+    /**
+     * @brief Registers the cost function of a layer type
+     *
+     * @param layer_type The name of the layer type
+     * @param cost_function Function computing the cost of an operator
+     */
+    static void RegisterCostFunction(const std::string& layer_type, const CostFunction& cost_function);
+
+    /**
+     * @brief Computes the cost of an operator
+     *
+     * @param op The runtime operator
+     * @return The cost, zero if the layer type has no cost function
+     */
+    static utils::LayerCost EstimateCost(const std::shared_ptr<RuntimeOperator>& op);
+
+    /**
+     * @brief Cost of a layer touching every input and output element once
+     *
+     * Helper for element-wise layers.
+     *
+     * @param op The runtime operator
+     * @param flops_per_element FLOPs spent on one output element
+     * @return The cost of the operator
+     */
+    static utils::LayerCost ElementwiseCost(const std::shared_ptr<RuntimeOperator>& op, double flops_per_element);
+
+    /**
+     * @brief Number of input elements of an operator over all its inputs
+     *
+     * @param op The runtime operator
+     * @return Number of input elements
+     */
+    static double InputElements(const std::shared_ptr<RuntimeOperator>& op);
+
+    /**
+     * @brief Number of output elements of an operator
+     *
+     * @param op The runtime operator
+     * @return Number of output elements
+     */
+    static double OutputElements(const std::shared_ptr<RuntimeOperator>& op);
+
+   private:
+    static CostRegistry& Registry();
+};
+
+/**
+ * @brief Layer cost registry wrapper
+ *
+ * Registers a cost function for one or more layer types at static
+ * initialization, next to the layer's LayerRegistererWrapper.
+ */
+class LayerCostRegistererWrapper
+{
+   public:
+    explicit LayerCostRegistererWrapper(const LayerCostRegisterer::CostFunction& cost_function,
+                                        const std::string& layer_type)
+    {
+        LayerCostRegisterer::RegisterCostFunction(layer_type, cost_function);
+    }
+
+    template <typename... Ts>
+    explicit LayerCostRegistererWrapper(const LayerCostRegisterer::CostFunction& cost_function,
+                                        const std::string& layer_type, const Ts&... other_layer_types)
+        : LayerCostRegistererWrapper(cost_function, other_layer_types...)
+    {
+        LayerCostRegisterer::RegisterCostFunction(layer_type, cost_function);
+    }
+};
+}  // namespace black_scholes
+#endif
@@ -0,0 +1,71 @@
+
+#ifndef DL_SOURCE_LAYER_LAYER_SCRATCH_HPP_
+#define DL_SOURCE_LAYER_LAYER_SCRATCH_HPP_
+#include <map>
+#include <memory>
+#include <string>
+
+#include "runtime/runtime_op.hpp"
+
+namespace black_scholes
+{
+/**
+ * @brief Registry of the scratch size of every layer type
+ *
+ * Mirrors LayerCostRegisterer: a layer type whose Forward needs temporary
+ * workspaces registers a function deriving the worst-case bytes one thread
+ * holds at a time from the operator shapes and parameters. The runtime
+ * sizes the per-thread utils::ScratchArena from it at Build.
+ */
+class LayerScratchRegisterer
+{
+   public:
+    typedef size_t (*ScratchFunction)(const std::shared_ptr<RuntimeOperator>& op);
+
+    typedef std::map<std::string, ScratchFunction> ScratchRegistry;
+
+    /**
+     * @brief Registers the scratch function of a layer type
+     *
+     * @param layer_type The name of the layer type
+     * @param scratch_function Function computing the scratch bytes of an operator
+     */
+    static void RegisterScratchFunction(const std::string& layer_type, const ScratchFunction& scratch_function);
+
+    /**
+     * @brief Computes the scratch one thread needs to run an operator
+     *
+     * @param op The runtime operator
+     * @return Bytes per thread, zero if the layer type declares none
+     */
+    static size_t ScratchBytes(const std::shared_ptr<RuntimeOperator>& op);
+
+   private:
+    static ScratchRegistry& Registry();
+};
+
+/**
+ * @brief Layer scratch registry wrapper
+ *
+ * Registers a scratch function for one or more layer types at static
+ * initialization, next to the layer's LayerRegistererWrapper.
+ */
+class LayerScratchRegistererWrapper
+{
+   public:
+    explicit LayerScratchRegistererWrapper(const LayerScratchRegisterer::ScratchFunction& scratch_function,
+                                           const std::string& layer_type)
+    {
+        LayerScratchRegisterer::RegisterScratchFunction(layer_type, scratch_function);
+    }
+
+    template <typename... Ts>
+    explicit LayerScratchRegistererWrapper(const LayerScratchRegisterer::ScratchFunction& scratch_function,
+                                           const std::string& layer_type, const Ts&... other_layer_types)
+        : LayerScratchRegistererWrapper(scratch_function, other_layer_types...)
+    {
+        LayerScratchRegisterer::RegisterScratchFunction(layer_type, scratch_function);
+    }
+};
+}  // namespace black_scholes
+#endif
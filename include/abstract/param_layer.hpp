@@ -2,6 +2,7 @@
 
 #ifndef DL_SOURCE_LAYER_PARAM_LAYER_HPP_
 #define DL_SOURCE_LAYER_PARAM_LAYER_HPP_
+#include <functional>
 #include "layer.hpp"
 
 namespace black_scholes
@@ -103,6 +104,28 @@ class ParamLayer : public Layer<float>
 
     std::shared_ptr<Tensor<float>> weight(int32_t index) const;
 
+    /**
+     * @brief Computes with the weights of the same layer loaded by another graph
+     *
+     * Layers that pack their weights at load override it, keep a reference
+     * to the replica and release their own copy. The default shares nothing,
+     * the runtime then shares the weight and bias tensors.
+     *
+     * @param replica Layer of the same operator in another graph
+     * @return True if the layer now reads the weights of the replica
+     */
+    virtual bool ShareWeights(const std::shared_ptr<ParamLayer>& replica);
+
+    /**
+     * @brief Visits the memory of the weights Forward reads
+     *
+     * The weight and bias tensors by default, the packed kernels for the
+     * layers that pack them.
+     *
+     * @param visit Called with the start and the size in bytes of every range
+     */
+    virtual void ForEachWeightRegion(const std::function<void(const void*, size_t)>& visit) const;
+
    protected:
     std::vector<std::shared_ptr<Tensor<float>>> weights_;
     std::vector<std::shared_ptr<Tensor<float>>> bias_;
@@ -5,6 +5,7 @@
 #include <vector>
 #include <armadillo>
 #include <memory>
+#include "utils/memory/memory_tracker.hpp"
 
 namespace block_scholes
 {
@@ -28,6 +29,10 @@ namespace block_scholes
         1-D tensor
         */
         explicit Tensor(uint32_t size);
+        /*
+        1-D view of size values at raw_ptr, the memory is not copied nor owned
+        */
+        explicit Tensor(float *raw_ptr, uint32_t size);
         explicit Tensor(uint32_t rows, uint32_t cols);
         explicit Tensor(const std::vector<uint32_t> &shape);
         Tensor(const Tensor &tensor);
@@ -65,10 +70,16 @@ namespace block_scholes
         float *raw_ptr();
         float *raw_ptr(uint32_t offset);
         float *matrix_raw_ptr(uint32_t index);
+        /// charges the memory owned by the tensor to another category of its account
+        void set_memory_category(utils::MemoryCategory category);
 
     private:
+        /// charges the memory owned by data_ to the current utils::MemoryScope
+        void TrackDataMemory();
+
         std::vector<uint32_t> raw_shapes_;
         arma::fcube data_;
+        utils::TrackedMemory tracked_memory_;
     };
 
     using ftensor = Tensor<float>;
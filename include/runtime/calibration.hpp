@@ -0,0 +1,168 @@
+
+#ifndef DL_INCLUDE_RUNTIME_CALIBRATION_HPP_
+#define DL_INCLUDE_RUNTIME_CALIBRATION_HPP_
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "data/tensor.hpp"
+
+namespace black_scholes
+{
+/**
+ * @brief How the int8 range of a tensor is chosen from its statistics
+ */
+enum class CalibrationMethod
+{
+    /// Largest absolute value seen, no value is clipped
+    kMinMax = 0,
+    /// The given percentile of the absolute values, clips rare outliers
+    kPercentile = 1,
+    /// Threshold whose 127-level quantization loses the least information (KL divergence)
+    kKLDivergence = 2,
+};
+
+const char* CalibrationMethodName(CalibrationMethod method);
+
+/**
+ * @brief Options of RuntimeGraph::Calibrate
+ */
+struct CalibrationConfig
+{
+    CalibrationMethod method = CalibrationMethod::kKLDivergence;
+    /// Percentile of the absolute values kept by kPercentile
+    float percentile = 99.99f;
+    /// Bins of the histograms of absolute values used by kPercentile and kKLDivergence
+    uint32_t histogram_bins = 2048;
+};
+
+/**
+ * @brief Range and histogram of the values a tensor took over the calibration dataset
+ *
+ * The range is collected by a first pass over the dataset, the histogram of
+ * absolute values over [0, abs_max] by a second one. Both are computed in
+ * parallel over the samples of a batch.
+ */
+class TensorStatistics
+{
+   public:
+    explicit TensorStatistics(uint32_t histogram_bins = 2048);
+
+    /**
+     * @brief Extends the range with the values of a batch
+     *
+     * @param tensors One tensor per sample
+     */
+    void UpdateRange(const std::vector<sftensor>& tensors);
+
+    /**
+     * @brief Adds the absolute values of a batch to the histogram, the range must be complete
+     *
+     * @param tensors One tensor per sample
+     */
+    void UpdateHistogram(const std::vector<sftensor>& tensors);
+
+    /**
+     * @brief Computes the quantization scale of the tensor
+     *
+     * @return threshold / 127, where values beyond the threshold are clipped
+     */
+    float Scale(const CalibrationConfig& config) const;
+
+    float min() const;
+
+    float max() const;
+
+    float abs_max() const;
+
+   private:
+    float PercentileThreshold(float percentile) const;
+
+    float KLDivergenceThreshold() const;
+
+    float min_;
+    float max_;
+    std::vector<uint64_t> histogram_;
+};
+
+/**
+ * @brief Per-tensor int8 scales, keyed by the name of the operator producing the tensor
+ *
+ * Saved as a text sidecar next to the model, one "name scale" line per
+ * tensor, and applied to a graph with RuntimeGraph::set_calibration_table
+ * before Build: int8 convolutions get the input_scale and pnnx.Quantize
+ * operators the scale they are missing.
+ */
+class CalibrationTable
+{
+   public:
+    void set_scale(const std::string& tensor_name, float scale);
+
+    bool has_scale(const std::string& tensor_name) const;
+
+    float scale(const std::string& tensor_name) const;
+
+    const std::map<std::string, float>& scales() const;
+
+    bool empty() const;
+
+    /**
+     * @brief Writes the sidecar file
+     *
+     * @param path Path of the file
+     * @return True if the file was written
+     */
+    bool Save(const std::string& path) const;
+
+    /**
+     * @brief Reads a sidecar file written by Save
+     *
+     * @param path Path of the file
+     * @param table The table receiving the scales
+     * @return True if the file was read
+     */
+    static bool Load(const std::string& path, CalibrationTable& table);
+
+   private:
+    std::map<std::string, float> scales_;
+};
+
+/**
+ * @brief Collects the statistics of the operator outputs while RuntimeGraph::Calibrate runs Forward
+ */
+class CalibrationCollector
+{
+   public:
+    explicit CalibrationCollector(const CalibrationConfig& config);
+
+    /**
+     * @brief Records the outputs of an operator for the current pass
+     *
+     * @param tensor_name Name of the operator producing the tensors
+     * @param tensors One tensor per sample
+     */
+    void Observe(const std::string& tensor_name, const std::vector<sftensor>& tensors);
+
+    /**
+     * @brief Switches from the range pass to the histogram pass
+     */
+    void StartHistogramPass();
+
+    /**
+     * @brief Whether the method needs a histogram pass over the dataset
+     */
+    bool needs_histogram() const;
+
+    /**
+     * @brief Computes the scales of every observed tensor
+     */
+    CalibrationTable Finish() const;
+
+   private:
+    CalibrationConfig config_;
+    bool histogram_pass_ = false;
+    std::map<std::string, TensorStatistics> statistics_;
+};
+}  // namespace black_scholes
+#endif
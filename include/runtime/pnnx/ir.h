@@ -208,6 +208,9 @@ public:
 
 bool operator==(const Parameter& lhs, const Parameter& rhs);
 
+unsigned short float32_to_float16(float value);
+float float16_to_float32(unsigned short value);
+
 class Attribute
 {
 public:
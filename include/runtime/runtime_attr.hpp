@@ -3,9 +3,11 @@
 #ifndef DL_PARSER_RUNTIME_ATTR_HPP_
 #define DL_PARSER_RUNTIME_ATTR_HPP_
 #include <glog/logging.h>
+#include <type_traits>
 #include <vector>
 #include "runtime_datatype.hpp"
 #include "status_code.hpp"
+#include "utils/math/half.hpp"
 
 namespace black_scholes {
 /**
@@ -46,6 +48,8 @@ struct RuntimeAttribute {
    * @brief Gets the attribute data as a typed array
    *
    * Returns the weight data as a vector of the template type T.
+   * Float16 attributes are converted when read as float, or returned as
+   * the raw half values when read as uint16_t.
    * The attribute data is cleared after get by default.
    *
    * @tparam T Data type to return (float, int, etc)
@@ -60,7 +64,8 @@ template <class T>
 std::vector<T> RuntimeAttribute::get(bool need_clear_weight) {
   CHECK(!weight_data.empty());
   CHECK(type != RuntimeDataType::kTypeUnknown);
-  const uint32_t elem_size = sizeof(T);
+  // float16 attributes hold two bytes per element whatever type they are read as
+  const uint32_t elem_size = type == RuntimeDataType::kTypeFloat16 ? sizeof(uint16_t) : sizeof(T);
   CHECK_EQ(weight_data.size() % elem_size, 0);
   const uint32_t weight_data_size = weight_data.size() / elem_size;
 
@@ -68,11 +73,44 @@ std::vector<T> RuntimeAttribute::get(bool need_clear_weight) {
   weights.reserve(weight_data_size);
   switch (type) {
     case RuntimeDataType::kTypeFloat32: {
-      static_assert(std::is_same<T, float>::value == true);
-      float* weight_data_ptr = reinterpret_cast<float*>(weight_data.data());
-      for (uint32_t i = 0; i < weight_data_size; ++i) {
-        float weight = *(weight_data_ptr + i);
-        weights.push_back(weight);
+      if constexpr (std::is_same<T, float>::value) {
+        float* weight_data_ptr = reinterpret_cast<float*>(weight_data.data());
+        for (uint32_t i = 0; i < weight_data_size; ++i) {
+          float weight = *(weight_data_ptr + i);
+          weights.push_back(weight);
+        }
+      } else {
+        LOG(FATAL) << "The float32 attribute can only be read as float";
+      }
+      break;
+    }
+    case RuntimeDataType::kTypeFloat16: {
+      const uint16_t* weight_data_ptr = reinterpret_cast<const uint16_t*>(weight_data.data());
+      if constexpr (std::is_same<T, float>::value) {
+        weights.resize(weight_data_size);
+        utils::HalfToFloat(weight_data_ptr, weights.data(), weights.size());
+      } else if constexpr (std::is_same<T, uint16_t>::value) {
+        weights.assign(weight_data_ptr, weight_data_ptr + weight_data_size);
+      } else {
+        LOG(FATAL) << "The float16 attribute can only be read as float or uint16_t";
+      }
+      break;
+    }
+    case RuntimeDataType::kTypeInt8: {
+      if constexpr (std::is_same<T, int8_t>::value) {
+        const int8_t* weight_data_ptr = reinterpret_cast<const int8_t*>(weight_data.data());
+        weights.assign(weight_data_ptr, weight_data_ptr + weight_data_size);
+      } else {
+        LOG(FATAL) << "The int8 attribute can only be read as int8_t";
+      }
+      break;
+    }
+    case RuntimeDataType::kTypeUInt8: {
+      if constexpr (std::is_same<T, uint8_t>::value) {
+        const uint8_t* weight_data_ptr = reinterpret_cast<const uint8_t*>(weight_data.data());
+        weights.assign(weight_data_ptr, weight_data_ptr + weight_data_size);
+      } else {
+        LOG(FATAL) << "The uint8 attribute can only be read as uint8_t";
       }
       break;
     }
@@ -18,4 +18,15 @@ enum class RuntimeDataType {
   kTypeInt8 = 7,
   kTypeUInt8 = 8,
 };
+
+/**
+ * @brief Precision of the GEMMs of a graph
+ */
+enum class ComputePrecision {
+  kFloat32 = 0,
+  /// bf16 operands with float accumulation where the CPU has AVX512-BF16, float32 elsewhere
+  kBFloat16 = 1,
+  /// bf16 operands on any CPU, the emulated kernel runs when there is no native one
+  kBFloat16Emulated = 2,
+};
 #endif  
\ No newline at end of file
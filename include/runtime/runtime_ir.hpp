@@ -10,9 +10,15 @@
 #include <vector>
 
 #include "layer/abstract/layer.hpp"
+#include "runtime/calibration.hpp"
 #include "runtime/pnnx/ir.h"
 #include "runtime/runtime_operand.hpp"
 #include "runtime_op.hpp"
+#include "utils/memory/memory_tracker.hpp"
+#include "utils/numa/numa_utils.hpp"
+#include "utils/parallel/thread_pool.hpp"
+#include "utils/perf/perf_counters.hpp"
+#include "utils/time/latency_histogram.hpp"
 
 namespace black_scholes
 {
@@ -119,11 +125,187 @@ class RuntimeGraph
      * @brief Executes the computation graph
      *
      * Executes the graph operations in depth-first order.
+     * While utils::TraceProfiler is started, every layer and every parallel
+     * task is recorded as a span of the timeline. In debug mode the per
+     * layer times are followed by the achieved GFLOP/s and GB/s of every
+     * layer against the measured peak of the machine, and by the memory
+     * report.
      *
      * @param debug Whether to print debugging information during execution
      */
     void Forward(bool debug = false);
 
+    /**
+     * @brief Sets the NUMA placement policy
+     *
+     * Pins the graph instance to a NUMA node. Weights and intermediate
+     * tensors are allocated on that node during Build, and the threads
+     * calling Forward are bound to the node's cores. Must be called
+     * before Build.
+     *
+     * @param numa_policy The NUMA placement policy
+     */
+    void set_numa_policy(const utils::NumaPolicy& numa_policy);
+
+    /**
+     * @brief Gets the NUMA placement policy
+     *
+     * @return The NUMA placement policy
+     */
+    const utils::NumaPolicy& numa_policy() const;
+
+    /**
+     * @brief Runs the graph on another batch than the exported one
+     *
+     * Every operand whose first dimension is the exported batch of the
+     * inputs takes the new batch when the graph is loaded, so the outputs
+     * are allocated for it. Operators with the batch written in their
+     * parameters, like a view to a fixed shape, keep the exported one.
+     * Must be called before Build.
+     *
+     * @param batch_size The batch size, zero for the exported batch
+     */
+    void set_batch_size(uint32_t batch_size);
+
+    /**
+     * @brief Sets how the parallel loops of Forward are executed
+     *
+     * In the spinning mode the graph owns a thread pool whose idle workers
+     * busy-wait between the layers of one Forward instead of going to sleep,
+     * which removes the wake-up latency of every parallel loop.
+     *
+     * @param worker_config The worker configuration
+     */
+    void set_worker_config(const utils::WorkerConfig& worker_config);
+
+    /**
+     * @brief Gets the worker configuration
+     *
+     * @return The worker configuration
+     */
+    const utils::WorkerConfig& worker_config() const;
+
+    /**
+     * @brief Enables hardware performance counters per layer
+     *
+     * When enabled, Forward(true) reads cycles, instructions, L1D and LLC
+     * misses, and vector instructions where the CPU exposes them, around
+     * every layer and adds them to the layer time summary. Counters are
+     * opened on all threads of the process by the first debug Forward.
+     *
+     * @param enabled True to collect the counters
+     */
+    void set_perf_counters_enabled(bool enabled);
+
+    /**
+     * @brief Checks whether hardware performance counters are collected
+     *
+     * @return True if enabled
+     */
+    bool perf_counters_enabled() const;
+
+    /**
+     * @brief Enables the always-on latency histograms
+     *
+     * Enabled by default. Every Forward records its end to end latency and
+     * the latency of every layer into lock-free histograms of the calling
+     * thread, which costs two clock reads per layer.
+     *
+     * @param enabled True to record the latencies
+     */
+    void set_latency_histograms_enabled(bool enabled);
+
+    /**
+     * @brief Checks whether the latency histograms are recorded
+     *
+     * @return True if enabled
+     */
+    bool latency_histograms_enabled() const;
+
+    /**
+     * @brief Gets the latency percentiles recorded since Build or the last reset
+     *
+     * Safe to call from a metrics exporter thread while Forward is running.
+     * The first snapshot is the end to end "forward" metric, followed by one
+     * snapshot per executed layer named after its operator.
+     *
+     * @return Percentiles of every recorded metric
+     */
+    std::vector<utils::LatencySnapshot> latency_snapshot() const;
+
+    /**
+     * @brief Clears the latency histograms
+     */
+    void ResetLatencyHistograms();
+
+    /**
+     * @brief Gets the memory held by the graph per category and per layer
+     *
+     * Weights are charged while the layers are created, activations while
+     * the output tensors are allocated, scratch for the workspaces a layer
+     * takes during Forward, and parse buffers for the pnnx graph and the
+     * attribute data not yet consumed by the layers. The per-thread scratch
+     * arenas backing the workspaces are shared by all graphs and reported
+     * separately. Peaks cover the lifetime of the graph or the
+     * time since the last ResetMemoryPeaks, so a report taken after a
+     * Forward shows the footprint a container limit has to cover.
+     *
+     * @return Current and peak bytes of the graph and of every operator
+     */
+    utils::MemoryReport memory_report() const;
+
+    /**
+     * @brief Restarts the memory peaks of the graph and its layers from the current usage
+     */
+    void ResetMemoryPeaks();
+
+    /**
+     * @brief Computes the int8 scales of the graph input and of every operator output
+     *
+     * Runs Forward over the dataset, once to record the range of every
+     * tensor and, for the percentile and KL divergence methods, a second
+     * time to fill the histograms of absolute values. The statistics of a
+     * batch are collected in parallel over its samples.
+     *
+     * @param input_name Name of the input the dataset is fed to
+     * @param dataset Batches of input tensors, one tensor per sample
+     * @param config Calibration method and histogram options
+     * @return The scales, keyed by the name of the operator producing each tensor
+     */
+    CalibrationTable Calibrate(const std::string& input_name, const std::vector<std::vector<sftensor>>& dataset,
+                               const CalibrationConfig& config = CalibrationConfig());
+
+    /**
+     * @brief Sets the scales completing the int8 operators, e.g. read from a calibration sidecar file
+     *
+     * Convolutions with int8 weights get the scale of their input tensor as
+     * input_scale and pnnx.Quantize operators without a scale the one of the
+     * tensor they quantize. Must be called before Build.
+     *
+     * @param calibration_table The scales written by Calibrate
+     */
+    void set_calibration_table(const CalibrationTable& calibration_table);
+
+    /**
+     * @brief Sets the precision of the convolution GEMMs
+     *
+     * With kBFloat16 the weights are rounded to bf16 when the layers are
+     * created and the activations while they are unfolded, the products are
+     * accumulated in float and the tensors between the layers stay float.
+     * Hosts without AVX512-BF16 keep float32, unless kBFloat16Emulated asks
+     * for the emulated kernel. Must be called before Build.
+     *
+     * @param compute_precision The precision
+     */
+    void set_compute_precision(ComputePrecision compute_precision);
+
+    /**
+     * @brief Gets the requested precision of the convolution GEMMs
+     *
+     * @return The precision
+     */
+    ComputePrecision compute_precision() const;
+
    private:
     /**
      * @brief Initializes the graph
@@ -159,6 +341,36 @@ class RuntimeGraph
      */
     void CreateNodeRelation();
 
+    /**
+     * @brief Adds the scales of the calibration table an int8 operator is missing
+     *
+     * @param op The operator, before its layer is created
+     */
+    void ApplyCalibration(const std::shared_ptr<RuntimeOperator>& op) const;
+
+    /**
+     * @brief Shares the layer weights with graphs on the same NUMA node
+     *
+     * Each parameterized layer computes with the replica already loaded on
+     * the graph's node, the packed kernels for the layers packing them and
+     * the weight tensors for the others, or registers itself as the node
+     * replica.
+     */
+    void ShareNodeWeights();
+
+    /**
+     * @brief Moves the weights Forward reads and the intermediate tensors to the graph's NUMA node
+     */
+    void PlaceGraphMemory();
+
+    /**
+     * @brief Starts the worker pool of a spinning configuration if it is missing
+     *
+     * The scratch arena of every new worker is grown to the reserved size
+     * before the pool runs a layer.
+     */
+    void PrepareThreadPool();
+
     /**
      * @brief Initializes operator inputs
      *
@@ -248,12 +460,48 @@ class RuntimeGraph
      */
     GraphState graph_state() const;
 
+    /**
+     * @brief Gets the names of the input operators
+     *
+     * @return The input names, valid after Build
+     */
+    std::vector<std::string> input_names() const;
+
+    /**
+     * @brief Gets the names of the output operators
+     *
+     * @return The output names, valid after Build
+     */
+    std::vector<std::string> output_names() const;
+
+    /**
+     * @brief Gets the shape the model declares for an input
+     *
+     * @param input_name Name of the input operator
+     * @return The shape with the batch first, e.g. (1, 3, 224, 224)
+     */
+    std::vector<int32_t> input_shape(const std::string& input_name) const;
+
    private:
     std::string bin_path_;
     std::string param_path_;
     std::unique_ptr<pnnx::Graph> graph_;
 
     GraphState graph_state_ = GraphState::NeedInit;
+    utils::NumaPolicy numa_policy_;
+    /// zero keeps the exported batch
+    uint32_t batch_size_ = 0;
+    utils::WorkerConfig worker_config_;
+    std::unique_ptr<utils::ThreadPool> thread_pool_;
+    bool perf_counters_enabled_ = false;
+    std::unique_ptr<utils::PerfCounterSet> perf_counters_;
+    bool latency_histograms_enabled_ = true;
+    std::unique_ptr<utils::LatencyRecorder> latency_recorder_;
+    std::shared_ptr<utils::MemoryAccount> memory_account_;
+    utils::TrackedMemory pnnx_memory_;
+    CalibrationTable calibration_table_;
+    ComputePrecision compute_precision_ = ComputePrecision::kFloat32;
+    CalibrationCollector* calibration_collector_ = nullptr;
     std::vector<std::shared_ptr<RuntimeOperator>> input_ops_;
     std::vector<std::shared_ptr<RuntimeOperator>> output_ops_;
     std::vector<std::shared_ptr<RuntimeOperator>> operators_;
@@ -12,6 +12,7 @@
 #include "runtime_attr.hpp"
 #include "runtime_operand.hpp"
 #include "runtime_parameter.hpp"
+#include "utils/memory/memory_tracker.hpp"
 
 namespace black_scholes {
 template <typename T>
@@ -68,6 +69,12 @@ struct RuntimeOperatorBase {
   /// Operator attributes like weights
   std::map<std::string, std::shared_ptr<RuntimeAttribute>> attribute;
 
+  /// Memory charged to this operator, created by the runtime graph
+  std::shared_ptr<utils::MemoryAccount> memory_account;
+
+  /// Precision of the layer GEMMs, set by the runtime graph before the layer is created
+  ComputePrecision compute_precision = ComputePrecision::kFloat32;
+
   bool has_parameter(const std::string& param_name);
 
   bool has_attribute(const std::string& attr_name);
@@ -0,0 +1,58 @@
+
+#ifndef DL_INCLUDE_UTILS_CPU_CPU_FEATURES_HPP_
+#define DL_INCLUDE_UTILS_CPU_CPU_FEATURES_HPP_
+#include <string>
+
+namespace black_scholes
+{
+namespace utils
+{
+/**
+ * @brief Instruction set extensions of the running CPU
+ *
+ * Kernels are compiled for them with target attributes and chosen at run
+ * time, so one binary runs everywhere and uses what the machine offers.
+ */
+struct CpuFeatures
+{
+    bool avx2 = false;
+    bool fma = false;
+    bool f16c = false;
+    bool avx512f = false;
+    bool avx512bw = false;
+    bool avx512vnni = false;
+    bool avx512bf16 = false;
+    bool avx_vnni = false;
+};
+
+/**
+ * @brief Gets the features of the running CPU, detected once
+ *
+ * @return The features, without those hidden by LimitCpuFeatures
+ */
+const CpuFeatures& GetCpuFeatures();
+
+/**
+ * @brief Hides features from the kernel selection so the narrower kernels run on a wider CPU
+ *
+ * The tests use it to cover every kernel on one machine. Features the CPU
+ * lacks stay off. Must not be called while kernels run.
+ *
+ * @param features The features the kernels may use
+ */
+void LimitCpuFeatures(const CpuFeatures& features);
+
+/**
+ * @brief Gives the kernels every detected feature again
+ */
+void ResetCpuFeatures();
+
+/**
+ * @brief Lists the detected features, e.g. "avx2 fma f16c"
+ *
+ * @return The names separated by spaces
+ */
+std::string CpuFeaturesString();
+}  // namespace utils
+}  // namespace black_scholes
+#endif
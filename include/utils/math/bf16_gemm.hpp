@@ -0,0 +1,100 @@
+
+#ifndef DL_INCLUDE_UTILS_MATH_BF16_GEMM_HPP_
+#define DL_INCLUDE_UTILS_MATH_BF16_GEMM_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace black_scholes
+{
+namespace utils
+{
+/// The reduction dimension of packed bf16 matrices is padded to one AVX-512 register
+constexpr uint32_t kBf16DepthAlignment = 32;
+
+/**
+ * @brief Instruction sets of the bf16 GEMM
+ */
+enum class Bf16Kernel
+{
+    /// Portable C++, widens the bf16 operands and accumulates with float FMAs, runs on any CPU
+    kEmulated = 0,
+    /// vdpbf16ps on 512-bit registers
+    kAvx512Bf16 = 1,
+};
+
+/**
+ * @brief Gets the native bf16 kernel of the running CPU, kEmulated when there is none
+ */
+Bf16Kernel SelectBf16Kernel();
+
+const char* Bf16KernelName(Bf16Kernel kernel);
+
+inline uint32_t Bf16PaddedDepth(uint32_t depth)
+{
+    return (depth + kBf16DepthAlignment - 1) / kBf16DepthAlignment * kBf16DepthAlignment;
+}
+
+/**
+ * @brief Rounds a float to bfloat16, to nearest even
+ */
+inline uint16_t FloatToBf16(float value)
+{
+    uint32_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x7fffffffu) > 0x7f800000u)
+    {
+        // keep NaN a quiet NaN instead of rounding it to infinity
+        return uint16_t((bits >> 16) | 0x40u);
+    }
+    bits += 0x7fffu + ((bits >> 16) & 1u);
+    return uint16_t(bits >> 16);
+}
+
+inline float Bf16ToFloat(uint16_t value)
+{
+    const uint32_t bits = uint32_t(value) << 16;
+    float result = 0.f;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+/**
+ * @brief Row-major bf16 weights packed for Bf16Gemm, every row zero padded to padded_depth
+ */
+struct Bf16PackedMatrix
+{
+    std::vector<uint16_t> data;
+    uint32_t rows = 0;
+    uint32_t depth = 0;
+    uint32_t padded_depth = 0;
+    Bf16Kernel kernel = Bf16Kernel::kEmulated;
+
+    size_t bytes() const;
+};
+
+/**
+ * @brief Rounds row-major float weights to bf16 and packs them for a kernel
+ *
+ * @param weights rows * depth values
+ */
+Bf16PackedMatrix PackBf16Matrix(const float* weights, uint32_t rows, uint32_t depth, Bf16Kernel kernel);
+
+/**
+ * @brief Multiplies packed bf16 weights with bf16 activations, accumulating in float
+ *
+ * output[row * output_stride + column] = bias[row] + sum_k weights[row][k] * activations[column][k]
+ *
+ * @param weights Packed weights, rows * padded_depth
+ * @param activations columns * padded_depth bf16 values, the padding must be finite
+ * @param columns Number of activation columns
+ * @param bias Per output row, may be null
+ * @param output Float results, one row of columns values per weight row
+ * @param output_stride Distance between two output rows
+ */
+void Bf16Gemm(const Bf16PackedMatrix& weights, const uint16_t* activations, uint32_t columns, const float* bias,
+              float* output, size_t output_stride);
+}  // namespace utils
+}  // namespace black_scholes
+#endif
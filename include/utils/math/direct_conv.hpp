@@ -0,0 +1,103 @@
+
+#ifndef DL_INCLUDE_UTILS_MATH_DIRECT_CONV_HPP_
+#define DL_INCLUDE_UTILS_MATH_DIRECT_CONV_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace black_scholes
+{
+namespace utils
+{
+/// Output channels computed together by the direct kernels, the weights are packed in blocks of it
+constexpr uint32_t kDirectConvBlock = 8;
+
+/**
+ * @brief Micro-kernels of the direct stride-2 convolution
+ */
+enum class DirectConvKernel
+{
+    /// Portable C++, 8 channels x 8 output rows
+    kGeneric = 0,
+    /// 8 channels x 24 output rows on 256-bit FMA, in two halves of 4 channels
+    kAvx2 = 1,
+    /// 8 channels x 32 output rows on 512-bit FMA
+    kAvx512 = 2,
+};
+
+/**
+ * @brief Gets the best direct convolution micro-kernel of the running CPU
+ */
+DirectConvKernel SelectDirectConvKernel();
+
+const char* DirectConvKernelName(DirectConvKernel kernel);
+
+/**
+ * @brief Whether the direct kernels compute a convolution of this shape
+ *
+ * 3x3 and 1x1 kernels of stride 2 without dilation, the downsampling
+ * layers of the backbones.
+ */
+bool SupportsDirectConv(uint32_t kernel_h, uint32_t kernel_w, uint32_t stride_h, uint32_t stride_w,
+                        uint32_t dilation_h, uint32_t dilation_w);
+
+/**
+ * @brief Weights of one group packed for the direct kernels
+ *
+ * Per block of kDirectConvBlock output channels, per input channel and
+ * kernel tap, the weights of the channels of the block are consecutive so
+ * one input vector feeds every channel of the block. Channels past the end
+ * of the last block hold zeros.
+ */
+struct DirectConvWeights
+{
+    uint32_t output_channels = 0;
+    uint32_t channels = 0;
+    uint32_t kernel_size = 0;
+    std::vector<float> values;
+
+    size_t bytes() const;
+};
+
+/**
+ * @brief Packs the kernels of one group
+ *
+ * @param weights output_channels rows of channels * kernel_size * kernel_size values, each channel
+ * in the (kw, kh) order of the im2col rows
+ * @param kernel_size 3 or 1
+ */
+DirectConvWeights PackDirectConvWeights(const float* weights, uint32_t output_channels, uint32_t channels,
+                                        uint32_t kernel_size);
+
+/**
+ * @brief Gets the workspace DirectConvStride2 takes from the scratch arena of its thread
+ *
+ * @return Bytes of the stride-2 phases of the padded input
+ */
+size_t DirectConvWorkspaceBytes(uint32_t channels, uint32_t kernel_size, uint32_t output_h, uint32_t output_w);
+
+/**
+ * @brief Convolves one group with a 3x3 or 1x1 kernel of stride 2
+ *
+ * The padded input is split once into its even and odd rows, so every tap
+ * of every output row reads consecutive values. A micro-kernel then keeps
+ * kDirectConvBlock output channels times a run of output rows in
+ * registers and accumulates every input channel and tap with FMAs.
+ *
+ * @param input channels column-major input_h x input_w matrices, one after the other
+ * @param bias Per output channel, may be null
+ * @param output output_channels column-major output_h x output_w matrices, one after the other
+ */
+void DirectConvStride2(const DirectConvWeights& weights, const float* input, uint32_t input_h, uint32_t input_w,
+                       uint32_t padding_h, uint32_t padding_w, const float* bias, float* output, uint32_t output_h,
+                       uint32_t output_w);
+
+/**
+ * @brief Whether the convolutions of the next graphs use the direct kernels, true by default
+ */
+bool DirectConvEnabled();
+
+void SetDirectConvEnabled(bool enabled);
+}  // namespace utils
+}  // namespace black_scholes
+#endif
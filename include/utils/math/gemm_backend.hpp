@@ -0,0 +1,68 @@
+
+#ifndef DL_INCLUDE_UTILS_MATH_GEMM_BACKEND_HPP_
+#define DL_INCLUDE_UTILS_MATH_GEMM_BACKEND_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "utils/math/sgemm.hpp"
+
+namespace black_scholes
+{
+namespace utils
+{
+/**
+ * @brief Implementations of the float GEMM used by the convolutions
+ */
+enum class GemmBackendType
+{
+    /// In-tree packed SGEMM, the same speed whatever BLAS is linked
+    kPacked = 0,
+    /// sgemm of the BLAS library linked with Armadillo
+    kBlas = 1,
+};
+
+const char* GemmBackendName(GemmBackendType type);
+
+/**
+ * @brief Parses a backend name, "packed" or "blas"
+ *
+ * @return True if the name is known
+ */
+bool ParseGemmBackend(const std::string& name, GemmBackendType& type);
+
+/**
+ * @brief Float GEMM used by the convolution and deconvolution layers
+ *
+ * Same contract as utils::Sgemm: row-major C = epilogue(op(A) * op(B)).
+ */
+class GemmBackend
+{
+   public:
+    virtual ~GemmBackend() = default;
+
+    virtual GemmBackendType type() const = 0;
+
+    virtual void Sgemm(bool transpose_a, bool transpose_b, uint32_t m, uint32_t n, uint32_t k, const float* a,
+                       size_t lda, const float* b, size_t ldb, float* c, size_t ldc,
+                       const SgemmEpilogue& epilogue = SgemmEpilogue()) const = 0;
+
+    /**
+     * @brief Sgemm with a half precision A, as utils::SgemmHalfA
+     */
+    virtual void SgemmHalfA(bool transpose_a, bool transpose_b, uint32_t m, uint32_t n, uint32_t k,
+                            const uint16_t* a, size_t lda, const float* b, size_t ldb, float* c, size_t ldc,
+                            const SgemmEpilogue& epilogue = SgemmEpilogue()) const = 0;
+};
+
+/**
+ * @brief Gets the backend of the process, kPacked unless SetGemmBackend chose another
+ */
+const GemmBackend& GetGemmBackend();
+
+/**
+ * @brief Chooses the backend of the process, takes effect for the next GEMM
+ */
+void SetGemmBackend(GemmBackendType type);
+}  // namespace utils
+}  // namespace black_scholes
+#endif
@@ -0,0 +1,30 @@
+
+#ifndef DL_INCLUDE_UTILS_MATH_HALF_HPP_
+#define DL_INCLUDE_UTILS_MATH_HALF_HPP_
+#include <cstddef>
+#include <cstdint>
+
+namespace black_scholes
+{
+namespace utils
+{
+/**
+ * @brief Converts IEEE half precision values to float
+ *
+ * Uses vcvtph2ps when the CPU has F16C, the scalar pnnx conversion otherwise.
+ *
+ * @param src count half values
+ * @param dst count floats
+ */
+void HalfToFloat(const uint16_t* src, float* dst, size_t count);
+
+/**
+ * @brief Converts floats to IEEE half precision values, rounding to nearest even with F16C
+ *
+ * @param src count floats
+ * @param dst count half values
+ */
+void FloatToHalf(const float* src, uint16_t* dst, size_t count);
+}  // namespace utils
+}  // namespace black_scholes
+#endif
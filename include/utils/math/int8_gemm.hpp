@@ -0,0 +1,120 @@
+
+#ifndef DL_INCLUDE_UTILS_MATH_INT8_GEMM_HPP_
+#define DL_INCLUDE_UTILS_MATH_INT8_GEMM_HPP_
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace black_scholes
+{
+namespace utils
+{
+/// The reduction dimension of packed int8 matrices is padded to one AVX-512 register
+constexpr uint32_t kInt8DepthAlignment = 64;
+
+/// Offset turning a symmetric int8 activation into the unsigned operand of maddubs / dpbusd
+constexpr int32_t kInt8ActivationOffset = 128;
+
+/**
+ * @brief Instruction sets of the int8 GEMM
+ */
+enum class Int8Kernel
+{
+    /// No kernel on this CPU, the layers keep their float path
+    kNone = 0,
+    /// vpmaddubsw, rows with levels past 63 are halved to at most 64 so the 16-bit pair sums never saturate
+    kAvx2 = 1,
+    /// vpdpbusd on 256-bit registers
+    kAvxVnni = 2,
+    /// vpdpbusd on 512-bit registers
+    kAvx512Vnni = 3,
+};
+
+/**
+ * @brief Gets the best int8 kernel of the running CPU
+ */
+Int8Kernel SelectInt8Kernel();
+
+const char* Int8KernelName(Int8Kernel kernel);
+
+inline uint32_t Int8PaddedDepth(uint32_t depth)
+{
+    return (depth + kInt8DepthAlignment - 1) / kInt8DepthAlignment * kInt8DepthAlignment;
+}
+
+/**
+ * @brief Symmetric int8 weights packed for Int8GemmRequantize
+ *
+ * Row major, one row per output channel, every row zero padded to
+ * padded_depth. scales are the dequantization scales of the packed rows,
+ * which differ from the given ones when the kernel had to drop a bit.
+ */
+struct Int8PackedMatrix
+{
+    std::vector<int8_t> data;
+    /// Sum of every row, removes the activation offset from the accumulators
+    std::vector<int32_t> row_sums;
+    std::vector<float> scales;
+    uint32_t rows = 0;
+    uint32_t depth = 0;
+    uint32_t padded_depth = 0;
+    Int8Kernel kernel = Int8Kernel::kNone;
+
+    size_t bytes() const;
+};
+
+/**
+ * @brief Packs row-major int8 weights for a kernel
+ *
+ * @param weights rows * depth values in [-127, 127]
+ * @param scales One scale per row
+ * @param kernel Kernel the matrix is packed for
+ */
+Int8PackedMatrix PackInt8Matrix(const int8_t* weights, const float* scales, uint32_t rows, uint32_t depth,
+                                Int8Kernel kernel);
+
+/**
+ * @brief Quantizes a value to a symmetric int8 level held in an unsigned byte
+ *
+ * @param value Real value
+ * @param inverse_scale One over the quantization scale
+ * @return value * inverse_scale rounded to nearest even, clamped to [-127, 127], plus kInt8ActivationOffset
+ */
+inline uint8_t QuantizeActivation(float value, float inverse_scale)
+{
+    float level = value * inverse_scale;
+    level = level < -127.f ? -127.f : (level > 127.f ? 127.f : level);
+    return uint8_t(int32_t(std::nearbyint(level)) + kInt8ActivationOffset);
+}
+
+/**
+ * @brief Epilogue of the int8 GEMM, applied to the int32 accumulators in registers
+ */
+struct Int8Epilogue
+{
+    /// Per output row, activation scale * weight scale, divided by the output scale when requantizing
+    const float* scales = nullptr;
+    /// Per output row, may be null, already divided by the output scale when requantizing
+    const float* bias = nullptr;
+    /// Rounds the results to the int8 levels of the output scale instead of dequantizing them
+    bool requantize = false;
+};
+
+/**
+ * @brief Multiplies packed int8 weights with unsigned int8 activations
+ *
+ * output[row * output_stride + column] = epilogue(sum_k weights[row][k] * (activations[column][k] - 128))
+ *
+ * @param weights Packed weights, rows * padded_depth
+ * @param activations columns * padded_depth offset activations, see QuantizeActivation
+ * @param columns Number of activation columns
+ * @param epilogue Scales, bias and requantization of the results
+ * @param output Float results, one row of columns values per weight row
+ * @param output_stride Distance between two output rows
+ */
+void Int8GemmRequantize(const Int8PackedMatrix& weights, const uint8_t* activations, uint32_t columns,
+                        const Int8Epilogue& epilogue, float* output, size_t output_stride);
+}  // namespace utils
+}  // namespace black_scholes
+#endif
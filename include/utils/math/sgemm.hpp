@@ -0,0 +1,90 @@
+
+#ifndef DL_INCLUDE_UTILS_MATH_SGEMM_HPP_
+#define DL_INCLUDE_UTILS_MATH_SGEMM_HPP_
+#include <cstddef>
+#include <cstdint>
+
+namespace black_scholes
+{
+namespace utils
+{
+/**
+ * @brief Activations the SGEMM epilogue applies to the results
+ */
+enum class GemmActivation
+{
+    kNone = 0,
+    kRelu = 1,
+    kRelu6 = 2,
+};
+
+/**
+ * @brief Epilogue of the SGEMM, applied to every tile of C while it is in cache
+ */
+struct SgemmEpilogue
+{
+    /// Per row of C, may be null
+    const float* bias = nullptr;
+    GemmActivation activation = GemmActivation::kNone;
+};
+
+/**
+ * @brief Micro-kernels of the packed SGEMM
+ */
+enum class SgemmKernel
+{
+    /// Portable C++, 6x16 tiles
+    kGeneric = 0,
+    /// 6x16 tiles on 256-bit FMA
+    kAvx2 = 1,
+    /// 12x32 tiles on 512-bit FMA
+    kAvx512 = 2,
+};
+
+/**
+ * @brief Gets the best SGEMM micro-kernel of the running CPU
+ */
+SgemmKernel SelectSgemmKernel();
+
+const char* SgemmKernelName(SgemmKernel kernel);
+
+/**
+ * @brief Gets the workspace Sgemm takes from the scratch arena of its thread
+ *
+ * @return Bytes of the packed panels of A and B
+ */
+size_t SgemmWorkspaceBytes(uint32_t m, uint32_t n, uint32_t k);
+
+/**
+ * @brief Multiplies row-major float matrices with the in-tree packed engine
+ *
+ * C = epilogue(op(A) * op(B)), where op(A) is m x k and op(B) is k x n.
+ * Blocks of A and B are packed into panels of the micro-kernel tile, the
+ * tiles of C are computed in parallel, and the bias and activation are
+ * applied when the last block of the reduction is stored.
+ *
+ * @param transpose_a A is stored k x m
+ * @param transpose_b B is stored n x k
+ * @param lda Distance between two rows of the stored A
+ * @param ldb Distance between two rows of the stored B
+ * @param ldc Distance between two rows of C
+ */
+void Sgemm(bool transpose_a, bool transpose_b, uint32_t m, uint32_t n, uint32_t k, const float* a, size_t lda,
+           const float* b, size_t ldb, float* c, size_t ldc, const SgemmEpilogue& epilogue = SgemmEpilogue());
+
+/**
+ * @brief Sgemm with a half precision A, widened to float while its panels are packed
+ *
+ * Same contract as Sgemm, A holds IEEE half precision values.
+ */
+void SgemmHalfA(bool transpose_a, bool transpose_b, uint32_t m, uint32_t n, uint32_t k, const uint16_t* a,
+                size_t lda, const float* b, size_t ldb, float* c, size_t ldc,
+                const SgemmEpilogue& epilogue = SgemmEpilogue());
+
+/**
+ * @brief Applies an epilogue to an m x n row-major matrix in place
+ */
+void ApplySgemmEpilogue(uint32_t m, uint32_t n, float* c, size_t ldc, const SgemmEpilogue& epilogue);
+}  // namespace utils
+}  // namespace black_scholes
+#endif
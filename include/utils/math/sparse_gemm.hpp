@@ -0,0 +1,68 @@
+
+#ifndef DL_INCLUDE_UTILS_MATH_SPARSE_GEMM_HPP_
+#define DL_INCLUDE_UTILS_MATH_SPARSE_GEMM_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace black_scholes
+{
+namespace utils
+{
+/**
+ * @brief Sparse weights in blocked CSR
+ *
+ * The rows are grouped into blocks of block_rows consecutive rows. A block
+ * row stores the columns where at least one of its rows is nonzero, with
+ * block_rows values per stored column, so one activation row loaded by the
+ * GEMM feeds block_rows outputs. block_rows is 1, 2 or 4, whichever does
+ * the least work for the sparsity pattern of the matrix.
+ */
+struct BlockedCsrMatrix
+{
+    uint32_t rows = 0;
+    uint32_t depth = 0;
+    uint32_t block_rows = 1;
+    /// Per block row, the first of its stored columns, plus the total at the end
+    std::vector<uint32_t> block_offsets;
+    std::vector<uint32_t> columns;
+    /// block_rows values per stored column, rows past the end of the matrix hold zeros
+    std::vector<float> values;
+
+    size_t bytes() const;
+};
+
+/**
+ * @brief Gets the fraction of zeros of a weight
+ *
+ * @param weights count values
+ */
+float WeightSparsity(const float* weights, size_t count);
+
+/**
+ * @brief Packs row-major weights into blocked CSR, the zeros are dropped
+ *
+ * @param weights rows * depth values
+ */
+BlockedCsrMatrix PackBlockedCsr(const float* weights, uint32_t rows, uint32_t depth);
+
+/**
+ * @brief Multiplies sparse weights with dense activations
+ *
+ * output[row * output_stride + column] = bias[row] + sum_k weights[row][k] * activations[k * columns + column]
+ *
+ * Only the stored weights are visited, the work is proportional to the
+ * number of nonzeros.
+ *
+ * @param weights Packed weights
+ * @param activations depth rows of columns values
+ * @param columns Number of activation columns
+ * @param bias Per weight row, may be null
+ * @param output One row of columns values per weight row
+ * @param output_stride Distance between two output rows
+ */
+void SparseGemm(const BlockedCsrMatrix& weights, const float* activations, uint32_t columns, const float* bias,
+                float* output, size_t output_stride);
+}  // namespace utils
+}  // namespace black_scholes
+#endif
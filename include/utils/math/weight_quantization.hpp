@@ -0,0 +1,75 @@
+
+#ifndef DL_INCLUDE_UTILS_MATH_WEIGHT_QUANTIZATION_HPP_
+#define DL_INCLUDE_UTILS_MATH_WEIGHT_QUANTIZATION_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace black_scholes
+{
+namespace utils
+{
+/**
+ * @brief Gets the output channel of an element of a convolution weight
+ *
+ * @param index Flat index of the element
+ * @param shape (out, in / groups, kh, kw), or (in, out / groups, kh, kw) when transposed
+ * @param transposed Whether the weight belongs to a transposed convolution
+ * @param groups Number of groups
+ */
+uint32_t ConvWeightChannel(size_t index, const std::vector<int32_t>& shape, bool transposed, uint32_t groups);
+
+/**
+ * @brief Quantizes a convolution weight to symmetric int8 with one scale per output channel
+ *
+ * @param levels Receives one level in [-127, 127] per weight
+ * @param scales Receives one scale per output channel
+ */
+void QuantizeConvWeightsInt8(const std::vector<float>& weights, const std::vector<int32_t>& shape, bool transposed,
+                             uint32_t groups, std::vector<int8_t>& levels, std::vector<float>& scales);
+
+/**
+ * @brief Dequantizes int8 convolution weights
+ *
+ * @param scales One scale per output channel, or one for the whole tensor
+ */
+std::vector<float> DequantizeConvWeightsInt8(const std::vector<int8_t>& levels, const std::vector<float>& scales,
+                                             const std::vector<int32_t>& shape, bool transposed, uint32_t groups);
+
+/**
+ * @brief Dequantizes int8 weights with one scale per row
+ *
+ * @param row_len Values of a row, the weights are row-major
+ * @param scales One scale per row, or one for the whole tensor
+ */
+std::vector<float> DequantizeWeightsInt8(const std::vector<int8_t>& levels, const std::vector<float>& scales,
+                                         size_t row_len);
+
+/**
+ * @brief Number of int4 groups of a weight, every row of row_len values is split into groups of group_size
+ */
+size_t Int4GroupCount(size_t count, size_t row_len, uint32_t group_size);
+
+/**
+ * @brief Quantizes a weight to symmetric int4 with one scale per group
+ *
+ * Two levels in [-7, 7] are packed per byte, offset by 8, the even element
+ * in the low nibble.
+ *
+ * @param weights Row-major weights, rows of row_len values
+ * @param packed Receives (count + 1) / 2 bytes
+ * @param scales Receives Int4GroupCount scales
+ */
+void QuantizeWeightsInt4(const std::vector<float>& weights, size_t row_len, uint32_t group_size,
+                         std::vector<uint8_t>& packed, std::vector<float>& scales);
+
+/**
+ * @brief Dequantizes weights written by QuantizeWeightsInt4
+ *
+ * @param count Number of weights
+ */
+std::vector<float> DequantizeWeightsInt4(const std::vector<uint8_t>& packed, const std::vector<float>& scales,
+                                         size_t count, size_t row_len, uint32_t group_size);
+}  // namespace utils
+}  // namespace black_scholes
+#endif
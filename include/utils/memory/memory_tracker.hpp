@@ -0,0 +1,225 @@
+
+#ifndef DL_INCLUDE_UTILS_MEMORY_MEMORY_TRACKER_HPP_
+#define DL_INCLUDE_UTILS_MEMORY_MEMORY_TRACKER_HPP_
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace black_scholes
+{
+namespace utils
+{
+/**
+ * @brief What a block of tracked memory is used for
+ */
+enum class MemoryCategory
+{
+    /// Layer weights, biases and their packed copies
+    kWeights = 0,
+    /// Operator output tensors living across layers
+    kActivations = 1,
+    /// Temporary workspaces of a layer Forward, like im2col matrices
+    kScratch = 2,
+    /// Attribute data read from the pnnx .bin file
+    kParseBuffers = 3,
+    kCategoryCount = 4,
+};
+
+constexpr uint32_t kMemoryCategoryCount = uint32_t(MemoryCategory::kCategoryCount);
+
+/**
+ * @brief Gets the display name of a memory category
+ *
+ * @param category The category
+ * @return The name, e.g. "weights"
+ */
+const char* MemoryCategoryName(MemoryCategory category);
+
+/**
+ * @brief Current and peak bytes of an account
+ */
+struct MemoryUsage
+{
+    int64_t current_bytes = 0;
+    int64_t peak_bytes = 0;
+};
+
+/**
+ * @brief Byte counters of one owner of memory, like a graph or a layer
+ *
+ * Counters are updated with relaxed atomics and every change is forwarded to
+ * the parent account, so a graph account sees the sum of its layers and the
+ * process account sees every tracked byte. The peak of the total is the
+ * real simultaneous peak, not the sum of the category peaks.
+ */
+class MemoryAccount : public std::enable_shared_from_this<MemoryAccount>
+{
+   public:
+    /**
+     * @brief Creates an account
+     *
+     * @param name Name shown in the reports
+     * @param parent Account receiving every change too, the process account when null
+     * @return The account
+     */
+    static std::shared_ptr<MemoryAccount> Create(std::string name, std::shared_ptr<MemoryAccount> parent = nullptr);
+
+    /**
+     * @brief Gets the root account of the process
+     *
+     * @return The account every other account reports to
+     */
+    static const std::shared_ptr<MemoryAccount>& Process();
+
+    void Allocate(MemoryCategory category, int64_t bytes);
+
+    void Release(MemoryCategory category, int64_t bytes);
+
+    MemoryUsage usage(MemoryCategory category) const;
+
+    /**
+     * @brief Gets the usage summed over the categories
+     */
+    MemoryUsage total() const;
+
+    /**
+     * @brief Restarts the peaks from the current usage, the parents are untouched
+     */
+    void ResetPeak();
+
+    const std::string& name() const;
+
+   private:
+    MemoryAccount(std::string name, std::shared_ptr<MemoryAccount> parent);
+
+    std::string name_;
+    std::shared_ptr<MemoryAccount> parent_;
+    std::array<std::atomic<int64_t>, kMemoryCategoryCount> current_bytes_{};
+    std::array<std::atomic<int64_t>, kMemoryCategoryCount> peak_bytes_{};
+    std::atomic<int64_t> total_current_bytes_{0};
+    std::atomic<int64_t> total_peak_bytes_{0};
+};
+
+/**
+ * @brief Selects the account and category charged by allocations of the calling thread
+ *
+ * Scopes nest, the destructor restores the enclosing scope. Allocations
+ * outside of any scope are charged to the process account as activations.
+ * utils::ParallelFor hands the scope of the calling thread to its tasks.
+ */
+class MemoryScope
+{
+   public:
+    struct State
+    {
+        /// Not owned, the creator of the scope keeps the account alive
+        MemoryAccount* account = nullptr;
+        MemoryCategory category = MemoryCategory::kActivations;
+    };
+
+    MemoryScope(MemoryAccount* account, MemoryCategory category);
+
+    explicit MemoryScope(const State& state);
+
+    ~MemoryScope();
+
+    MemoryScope(const MemoryScope&) = delete;
+    MemoryScope& operator=(const MemoryScope&) = delete;
+
+    /**
+     * @brief Gets the scope of the calling thread
+     *
+     * @return The innermost scope, a null account when there is none
+     */
+    static const State& Current();
+
+   private:
+    State previous_;
+};
+
+/**
+ * @brief Bytes of one allocation charged to the scope it was made in
+ *
+ * Embedded next to the memory it describes. The account and category are
+ * bound by the first non-zero size and kept until the size drops to zero,
+ * so memory freed in another scope is still returned to its owner. Copies
+ * are new allocations of the scope they are made in, moves carry the charge.
+ */
+class TrackedMemory
+{
+   public:
+    TrackedMemory() = default;
+
+    TrackedMemory(const TrackedMemory& other);
+
+    TrackedMemory(TrackedMemory&& other) noexcept;
+
+    TrackedMemory& operator=(const TrackedMemory& other);
+
+    TrackedMemory& operator=(TrackedMemory&& other) noexcept;
+
+    ~TrackedMemory();
+
+    /**
+     * @brief Updates the size of the allocation
+     *
+     * @param bytes New size in bytes, zero releases the charge
+     */
+    void Resize(size_t bytes);
+
+    /**
+     * @brief Moves the charge to another category of the same account
+     *
+     * Does nothing while the size is zero, the next allocation binds the category of its scope.
+     */
+    void set_category(MemoryCategory category);
+
+    size_t bytes() const;
+
+   private:
+    std::shared_ptr<MemoryAccount> account_;
+    MemoryCategory category_ = MemoryCategory::kActivations;
+    int64_t bytes_ = 0;
+};
+
+/**
+ * @brief Memory of one layer
+ */
+struct LayerMemoryReport
+{
+    std::string name;
+    std::string type;
+    std::array<MemoryUsage, kMemoryCategoryCount> categories;
+    MemoryUsage total;
+};
+
+/**
+ * @brief Memory of a graph broken down by category and layer
+ */
+struct MemoryReport
+{
+    std::array<MemoryUsage, kMemoryCategoryCount> categories;
+    MemoryUsage total;
+    std::vector<LayerMemoryReport> layers;
+    /// Capacity of the per-thread scratch arenas, shared by every graph of the process
+    int64_t scratch_arena_bytes = 0;
+
+    const MemoryUsage& category(MemoryCategory memory_category) const
+    {
+        return categories.at(uint32_t(memory_category));
+    }
+};
+
+/**
+ * @brief Prints the current and peak bytes of a report per category and per layer
+ *
+ * @param report The report
+ */
+void MemoryReportLogging(const MemoryReport& report);
+}  // namespace utils
+}  // namespace black_scholes
+#endif
@@ -0,0 +1,135 @@
+
+#ifndef DL_INCLUDE_UTILS_MEMORY_SCRATCH_ARENA_HPP_
+#define DL_INCLUDE_UTILS_MEMORY_SCRATCH_ARENA_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "utils/memory/memory_tracker.hpp"
+
+namespace black_scholes
+{
+namespace utils
+{
+/**
+ * @brief Per-thread bump allocator for the temporaries of a layer Forward
+ *
+ * Every thread owns one arena, sized to the largest scratch a layer
+ * declared for one task when its graph was built. Workspaces are taken
+ * from it through a ScratchFrame and given back all at once when the frame
+ * ends, so a steady-state Forward does not touch the heap.
+ *
+ * A request beyond the capacity is served from a heap block for the
+ * duration of the frame, and the arena grows to the observed size the next
+ * time the thread enters a frame with nothing else in use.
+ */
+class ScratchArena
+{
+   public:
+    /// Alignment of every workspace, one cache line
+    static constexpr size_t kAlignment = 64;
+
+    /**
+     * @brief Gets the arena of the calling thread
+     *
+     * @return The thread's arena
+     */
+    static ScratchArena& Local();
+
+    /**
+     * @brief Raises the scratch every thread has to provide
+     *
+     * Called by the runtime at Build with the worst case of the graph's
+     * layers. The arenas grow to it the next time they are prepared.
+     *
+     * @param bytes Bytes one thread needs for one task
+     */
+    static void Reserve(size_t bytes);
+
+    /**
+     * @brief Gets the scratch every thread has to provide
+     *
+     * @return The largest size passed to Reserve
+     */
+    static size_t reserved_bytes();
+
+    /**
+     * @brief Gets the capacity of the arenas of all threads
+     *
+     * @return Bytes held by every arena of the process
+     */
+    static size_t total_capacity();
+
+    /**
+     * @brief Grows the arena to the reserved size while no frame is open
+     */
+    void Prepare();
+
+    size_t capacity() const;
+
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+   private:
+    friend class ScratchFrame;
+
+    ScratchArena();
+
+    ~ScratchArena();
+
+    void* Allocate(size_t bytes);
+
+    char* buffer_ = nullptr;
+    size_t capacity_ = 0;
+    size_t offset_ = 0;
+    /// bytes of the overflow blocks held by the open frames
+    size_t overflow_bytes_ = 0;
+    /// most bytes in use at once since the last growth, overflow blocks included
+    size_t high_water_ = 0;
+    uint32_t frame_depth_ = 0;
+    std::vector<void*> overflow_blocks_;
+};
+
+/**
+ * @brief Scope of the workspaces a layer takes from the arena of its thread
+ *
+ * Workspaces stay valid until the frame is destroyed. Frames nest on one
+ * thread and must be destroyed in reverse order. The bytes in use are
+ * charged as scratch to the current MemoryScope, so the per-layer memory
+ * report shows the real workspace of every layer.
+ */
+class ScratchFrame
+{
+   public:
+    ScratchFrame();
+
+    ~ScratchFrame();
+
+    ScratchFrame(const ScratchFrame&) = delete;
+    ScratchFrame& operator=(const ScratchFrame&) = delete;
+
+    /**
+     * @brief Takes an uninitialized workspace of count elements
+     *
+     * @param count Number of elements
+     * @return Pointer aligned to ScratchArena::kAlignment
+     */
+    template <typename T>
+    T* Allocate(size_t count)
+    {
+        return static_cast<T*>(AllocateBytes(count * sizeof(T)));
+    }
+
+   private:
+    void* AllocateBytes(size_t bytes);
+
+    ScratchArena& arena_;
+    size_t offset_ = 0;
+    size_t overflow_count_ = 0;
+    size_t overflow_bytes_ = 0;
+    MemoryAccount* account_ = nullptr;
+    int64_t charged_bytes_ = 0;
+};
+}  // namespace utils
+}  // namespace black_scholes
+#endif
@@ -0,0 +1,136 @@
+
+#ifndef DL_INCLUDE_UTILS_NUMA_UTILS_HPP_
+#define DL_INCLUDE_UTILS_NUMA_UTILS_HPP_
+#include <sched.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace black_scholes
+{
+namespace utils
+{
+/**
+ * @brief NUMA placement policy of a runtime graph
+ *
+ * A node of -1 disables NUMA placement and keeps the default behaviour of
+ * the operating system.
+ */
+struct NumaPolicy
+{
+    /// NUMA node the graph instance is pinned to, -1 means not pinned
+    int32_t node = -1;
+
+    /// Whether the calling thread and the OpenMP workers are bound to the node's cores
+    bool bind_threads = true;
+
+    /**
+     * @brief Whether graphs on the same node share one weight replica
+     *
+     * When enabled, every node keeps a single copy of the weights of a model
+     * and all graph instances built on that node use it.
+     */
+    bool replicate_weights = false;
+};
+
+/**
+ * @brief NUMA topology of the host
+ *
+ * Reads the node to cpu mapping from sysfs once. Hosts without NUMA
+ * information are reported as a single node holding every online cpu.
+ */
+class NumaTopology
+{
+   public:
+    /**
+     * @brief Gets the topology singleton
+     *
+     * @return The host topology
+     */
+    static const NumaTopology& Instance();
+
+    /**
+     * @brief Gets the number of NUMA nodes
+     *
+     * @return Number of nodes, at least one
+     */
+    uint32_t node_count() const;
+
+    /**
+     * @brief Gets the cpus belonging to a node
+     *
+     * @param node Index of the node
+     * @return Cpu ids of the node in ascending order
+     */
+    const std::vector<uint32_t>& node_cpus(uint32_t node) const;
+
+   private:
+    NumaTopology();
+
+    std::vector<std::vector<uint32_t>> node_cpus_;
+};
+
+/**
+ * @brief Binds the calling thread to every cpu of a node
+ *
+ * @param node Index of the node
+ * @return True if the affinity was applied
+ */
+bool BindCurrentThreadToNode(int32_t node);
+
+/**
+ * @brief Binds the calling thread to a single cpu
+ *
+ * @param cpu Cpu id
+ * @return True if the affinity was applied
+ */
+bool BindCurrentThreadToCpu(uint32_t cpu);
+
+/**
+ * @brief Binds the OpenMP worker threads to the cores of a node
+ *
+ * Sizes the OpenMP team of the calling thread to the number of cpus of the
+ * node and pins worker i to the i-th cpu of the node.
+ *
+ * @param node Index of the node
+ */
+void BindOpenMPThreadsToNode(int32_t node);
+
+/**
+ * @brief Moves the pages backing a memory range to a node
+ *
+ * Pages already touched are migrated, pages touched later are allocated on
+ * the node. Only the pages fully inside the range are affected.
+ *
+ * @param ptr Start of the range
+ * @param size Size of the range in bytes
+ * @param node Index of the node
+ * @return True if the kernel accepted the policy
+ */
+bool MoveMemoryToNode(void* ptr, size_t size, int32_t node);
+
+/**
+ * @brief Scoped thread affinity
+ *
+ * Binds the calling thread to a node for the lifetime of the object and
+ * restores the previous affinity mask on destruction. Memory first touched
+ * in the scope is therefore allocated on the node.
+ */
+class ScopedNodeAffinity
+{
+   public:
+    explicit ScopedNodeAffinity(int32_t node);
+
+    ~ScopedNodeAffinity();
+
+    ScopedNodeAffinity(const ScopedNodeAffinity&) = delete;
+    ScopedNodeAffinity& operator=(const ScopedNodeAffinity&) = delete;
+
+   private:
+    bool restore_ = false;
+    cpu_set_t previous_mask_;
+};
+}  // namespace utils
+}  // namespace black_scholes
+#endif
@@ -0,0 +1,159 @@
+
+#ifndef DL_INCLUDE_UTILS_PARALLEL_UTILS_HPP_
+#define DL_INCLUDE_UTILS_PARALLEL_UTILS_HPP_
+#include <omp.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "utils/memory/memory_tracker.hpp"
+#include "utils/parallel/thread_pool.hpp"
+#include "utils/time/trace_profiler.hpp"
+
+namespace black_scholes
+{
+namespace utils
+{
+/**
+ * @brief Minimum number of elements handled by one parallel task
+ *
+ * Work smaller than this stays on the calling thread, so tiny tensors do not
+ * pay the fork/join cost of a parallel region.
+ */
+constexpr size_t kParallelGrainSize = 16384;
+
+/**
+ * @brief Number of threads available to parallel loops on the calling thread
+ *
+ * @return Size of the installed thread pool, or the OpenMP thread count
+ */
+inline uint32_t ParallelThreadCount()
+{
+    ThreadPool* thread_pool = ThreadPool::Current();
+    if (thread_pool != nullptr)
+    {
+        return thread_pool->num_threads();
+    }
+    return omp_get_max_threads();
+}
+
+/**
+ * @brief Checks whether a piece of work is worth splitting across threads
+ *
+ * @param total_work Number of elements touched by the whole operation
+ * @param grain_size Minimum number of elements per task
+ * @return True if at least two tasks of grain_size can be formed
+ */
+inline bool ShouldParallel(size_t total_work, size_t grain_size = kParallelGrainSize)
+{
+    return ParallelThreadCount() > 1 && total_work >= 2 * grain_size;
+}
+
+/**
+ * @brief Runs func(task) for every task in [0, task_count)
+ *
+ * The tasks are distributed over the thread pool installed on the calling
+ * thread, or the OpenMP threads when there is none, only when the total work
+ * (task_count * work_per_task elements) exceeds the parallel grain.
+ *
+ * @param task_count Number of independent tasks
+ * @param work_per_task Approximate number of elements touched per task
+ * @param func Callable invoked as func(uint32_t task)
+ */
+template <typename Func>
+void ParallelForImpl(uint32_t task_count, bool use_parallel, const Func& func)
+{
+    ThreadPool* thread_pool = ThreadPool::Current();
+    if (thread_pool != nullptr)
+    {
+        if (use_parallel)
+        {
+            thread_pool->Run(task_count, func);
+        }
+        else
+        {
+            for (uint32_t task = 0; task < task_count; ++task)
+            {
+                func(task);
+            }
+        }
+        return;
+    }
+#pragma omp parallel for schedule(static) if (use_parallel)
+    for (uint32_t task = 0; task < task_count; ++task)
+    {
+        func(task);
+    }
+}
+
+template <typename Func>
+void ParallelForScoped(uint32_t task_count, bool use_parallel, const Func& func)
+{
+    const MemoryScope::State memory_state = MemoryScope::Current();
+    if (use_parallel && memory_state.account != nullptr)
+    {
+        // the tasks allocate on behalf of the layer that started them
+        ParallelForImpl(task_count, use_parallel, [&](uint32_t task) {
+            MemoryScope task_memory_scope(memory_state);
+            func(task);
+        });
+        return;
+    }
+    ParallelForImpl(task_count, use_parallel, func);
+}
+
+template <typename Func>
+void ParallelFor(uint32_t task_count, size_t work_per_task, const Func& func)
+{
+    const bool use_parallel = task_count > 1 && ShouldParallel(size_t(task_count) * work_per_task);
+    if (use_parallel && TraceProfiler::Instance().enabled())
+    {
+        // one span per task shows which thread ran which part of the layer
+        const std::string task_name = CurrentTraceName() + " task";
+        ParallelForScoped(task_count, use_parallel, [&](uint32_t task) {
+            TraceScope task_scope(task_name, "parallel_task");
+            func(task);
+        });
+        return;
+    }
+    ParallelForScoped(task_count, use_parallel, func);
+}
+
+/**
+ * @brief Runs func(begin, end) over contiguous chunks of [0, total_size)
+ *
+ * Splits a flat element range into chunks of at least grain_size elements,
+ * which lets element-wise layers parallelize inside a single image.
+ *
+ * @param total_size Number of elements in the range
+ * @param func Callable invoked as func(size_t begin, size_t end)
+ * @param grain_size Minimum number of elements per chunk
+ */
+template <typename Func>
+void ParallelForRange(size_t total_size, const Func& func, size_t grain_size = kParallelGrainSize)
+{
+    if (total_size == 0)
+    {
+        return;
+    }
+    if (!ShouldParallel(total_size, grain_size))
+    {
+        func(size_t(0), total_size);
+        return;
+    }
+
+    const size_t max_chunks = size_t(ParallelThreadCount()) * 4;
+    const size_t chunk_count = std::min(max_chunks, total_size / grain_size);
+    // keep chunk boundaries on 16 element multiples so vector loops stay aligned
+    const size_t chunk_size = ((total_size + chunk_count - 1) / chunk_count + 15) / 16 * 16;
+    const uint32_t task_count = uint32_t((total_size + chunk_size - 1) / chunk_size);
+    ParallelFor(task_count, chunk_size, [&](uint32_t task) {
+        const size_t begin = size_t(task) * chunk_size;
+        const size_t end = std::min(total_size, begin + chunk_size);
+        func(begin, end);
+    });
+}
+}  // namespace utils
+}  // namespace black_scholes
+#endif
@@ -0,0 +1,148 @@
+
+#ifndef DL_INCLUDE_UTILS_THREAD_POOL_HPP_
+#define DL_INCLUDE_UTILS_THREAD_POOL_HPP_
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace black_scholes
+{
+namespace utils
+{
+/**
+ * @brief How the parallel loops of a graph are executed
+ */
+enum class WorkerMode
+{
+    /// Parallel loops use the OpenMP runtime
+    kOpenMP = 0,
+    /// Parallel loops use a graph owned pool whose idle workers spin before sleeping
+    kSpinning = 1,
+};
+
+/**
+ * @brief Worker configuration of a runtime graph
+ */
+struct WorkerConfig
+{
+    WorkerMode mode = WorkerMode::kOpenMP;
+
+    /// Number of threads including the caller, zero means omp_get_max_threads()
+    uint32_t num_threads = 0;
+
+    /// Time an idle worker busy-waits for the next parallel loop before sleeping
+    uint32_t spin_time_us = 200;
+
+    /// NUMA node the workers are pinned to, -1 leaves them unpinned
+    int32_t numa_node = -1;
+};
+
+/**
+ * @brief Thread pool with bounded spin-waiting workers
+ *
+ * Between two parallel loops the workers spin with the pause instruction for
+ * a bounded time, so the back-to-back small layers of one Forward do not pay
+ * a futex wake-up each. After the spin budget the workers sleep on a
+ * condition variable and cost nothing while the graph is idle.
+ *
+ * The calling thread always takes part in the work. A loop started from
+ * inside a pool task runs serially on that task's thread.
+ */
+class ThreadPool
+{
+   public:
+    /**
+     * @brief Creates the pool and starts its workers
+     *
+     * @param num_threads Number of threads including the caller, at least one
+     * @param spin_time_us Spin budget of an idle worker in microseconds
+     * @param numa_node NUMA node to pin the workers to, -1 for none
+     */
+    explicit ThreadPool(uint32_t num_threads, uint32_t spin_time_us, int32_t numa_node = -1);
+
+    /**
+     * @brief Stops and joins the workers
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Gets the number of threads including the caller
+     *
+     * @return Number of threads
+     */
+    uint32_t num_threads() const;
+
+    /**
+     * @brief Runs task(i) for every i in [0, task_count) and waits for completion
+     *
+     * @param task_count Number of tasks
+     * @param task Callable invoked with the task index
+     */
+    void Run(uint32_t task_count, const std::function<void(uint32_t)>& task);
+
+    /**
+     * @brief Runs func once on every thread of the pool, the caller included, and waits for completion
+     *
+     * Used to set up thread-local state such as the scratch arenas.
+     *
+     * @param func Callable invoked with the thread index, 0 for the caller
+     */
+    void Broadcast(const std::function<void(uint32_t)>& func);
+
+    /**
+     * @brief Gets the pool installed on the calling thread
+     *
+     * @return The current pool, nullptr if parallel loops should use OpenMP
+     */
+    static ThreadPool* Current();
+
+    /**
+     * @brief Installs a pool on the calling thread for the lifetime of the scope
+     */
+    class Scope
+    {
+       public:
+        explicit Scope(ThreadPool* thread_pool);
+
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+       private:
+        ThreadPool* previous_pool_ = nullptr;
+    };
+
+   private:
+    void WorkerLoop(uint32_t worker_index);
+
+    void RunTasks();
+
+   private:
+    uint32_t spin_time_us_ = 0;
+    int32_t numa_node_ = -1;
+    std::vector<std::thread> workers_;
+
+    const std::function<void(uint32_t)>* task_ = nullptr;
+    uint32_t task_count_ = 0;
+    /// Whether task_ is a broadcast, run once per worker instead of claimed per index
+    bool broadcast_ = false;
+    std::atomic<uint32_t> next_task_{0};
+    std::atomic<uint32_t> pending_workers_{0};
+    std::atomic<uint64_t> generation_{0};
+    std::atomic<uint32_t> sleeping_workers_{0};
+    std::atomic<bool> stop_{false};
+
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cond_;
+};
+}  // namespace utils
+}  // namespace black_scholes
+#endif
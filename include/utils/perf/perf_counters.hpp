@@ -0,0 +1,115 @@
+
+#ifndef DL_INCLUDE_UTILS_PERF_COUNTERS_HPP_
+#define DL_INCLUDE_UTILS_PERF_COUNTERS_HPP_
+#include <sys/types.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace black_scholes
+{
+namespace utils
+{
+/**
+ * @brief Hardware events counted per layer
+ */
+enum class PerfEvent
+{
+    kCycles = 0,
+    kInstructions = 1,
+    kL1DMisses = 2,
+    kLLCMisses = 3,
+    /// Retired floating point vector instructions, Intel only
+    kVectorInstructions = 4,
+    kEventCount = 5,
+};
+
+/**
+ * @brief Gets the printable name of an event
+ *
+ * @param event The event
+ * @return Name of the event
+ */
+const char* PerfEventName(PerfEvent event);
+
+/**
+ * @brief Counter values of one measurement
+ *
+ * Values are scaled for multiplexing. An event the host does not support
+ * is reported as unavailable and keeps a zero value.
+ */
+struct PerfCounterValues
+{
+    std::array<uint64_t, size_t(PerfEvent::kEventCount)> values{};
+    std::array<bool, size_t(PerfEvent::kEventCount)> available{};
+
+    uint64_t value(PerfEvent event) const
+    {
+        return values.at(size_t(event));
+    }
+
+    bool has(PerfEvent event) const
+    {
+        return available.at(size_t(event));
+    }
+
+    PerfCounterValues& operator+=(const PerfCounterValues& other);
+
+    PerfCounterValues operator-(const PerfCounterValues& other) const;
+};
+
+/**
+ * @brief Linux perf_event_open counters over every thread of the process
+ *
+ * Opens one counter group per thread found in /proc/self/task when it is
+ * created, so the OpenMP and pool workers must already exist. Reading sums
+ * the groups of all threads, which attributes the work of a parallel layer
+ * to that layer no matter which worker ran it.
+ */
+class PerfCounterSet
+{
+   public:
+    PerfCounterSet();
+
+    ~PerfCounterSet();
+
+    PerfCounterSet(const PerfCounterSet&) = delete;
+    PerfCounterSet& operator=(const PerfCounterSet&) = delete;
+
+    /**
+     * @brief Checks whether at least the cycle counter could be opened
+     *
+     * Fails when perf_event_paranoid forbids user space counting.
+     *
+     * @return True if counters are available
+     */
+    bool valid() const;
+
+    /**
+     * @brief Reads the current totals of all threads
+     *
+     * @return The counter values
+     */
+    PerfCounterValues Read() const;
+
+   private:
+    struct ThreadCounters
+    {
+        pid_t tid = 0;
+        int leader_fd = -1;
+        std::array<int, size_t(PerfEvent::kEventCount)> fds{};
+        /// Position of each event inside the group read buffer, -1 if not opened
+        std::array<int32_t, size_t(PerfEvent::kEventCount)> group_index{};
+        uint32_t group_size = 0;
+    };
+
+    void OpenThread(pid_t tid);
+
+   private:
+    std::vector<ThreadCounters> threads_;
+};
+}  // namespace utils
+}  // namespace black_scholes
+#endif
@@ -0,0 +1,66 @@
+
+#ifndef DL_INCLUDE_UTILS_PERF_ROOFLINE_HPP_
+#define DL_INCLUDE_UTILS_PERF_ROOFLINE_HPP_
+#include <map>
+#include <string>
+
+namespace black_scholes
+{
+namespace utils
+{
+/**
+ * @brief Analytic work of one layer execution
+ *
+ * A multiply-add counts as two FLOPs. Bytes are the compulsory traffic:
+ * every input, output and weight element touched once.
+ */
+struct LayerCost
+{
+    /// Floating point operations
+    double flops = 0.;
+
+    /// Bytes read and written
+    double bytes = 0.;
+
+    LayerCost& operator+=(const LayerCost& other)
+    {
+        flops += other.flops;
+        bytes += other.bytes;
+        return *this;
+    }
+};
+
+/**
+ * @brief Measured peak throughput of the machine
+ */
+struct MachinePeak
+{
+    /// Peak single precision FLOP rate over all threads, in GFLOP/s
+    double gflops = 0.;
+
+    /// Peak memory bandwidth of a triad stream over all threads, in GB/s
+    double gbytes_per_second = 0.;
+};
+
+/**
+ * @brief Measures the machine peak once and caches it
+ *
+ * Runs an FMA chain kernel and a triad stream on all OpenMP threads, which
+ * takes a fraction of a second on the first call.
+ *
+ * @return The measured peak
+ */
+const MachinePeak& MeasuredMachinePeak();
+
+/**
+ * @brief Prints achieved GFLOP/s and GB/s per layer against the machine peak
+ *
+ * Uses the durations collected by LayerTimeLogging in the last debug
+ * Forward, so it has to be called after the layers were executed.
+ *
+ * @param layer_costs Cost of each layer keyed by layer name
+ */
+void RooflineLogging(const std::map<std::string, LayerCost>& layer_costs);
+}  // namespace utils
+}  // namespace black_scholes
+#endif
@@ -0,0 +1,240 @@
+
+#ifndef DL_INCLUDE_UTILS_LATENCY_HISTOGRAM_HPP_
+#define DL_INCLUDE_UTILS_LATENCY_HISTOGRAM_HPP_
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace black_scholes
+{
+namespace utils
+{
+/**
+ * @brief Percentiles of one latency metric
+ *
+ * Values are nanoseconds. A percentile is the lower bound of its bucket,
+ * which is within 1/32 (about 3%) of the recorded value.
+ */
+struct LatencySnapshot
+{
+    std::string name;
+    uint64_t count = 0;
+    uint64_t min_ns = 0;
+    uint64_t max_ns = 0;
+    double mean_ns = 0.;
+    uint64_t p50_ns = 0;
+    uint64_t p90_ns = 0;
+    uint64_t p99_ns = 0;
+    uint64_t p999_ns = 0;
+};
+
+/**
+ * @brief Log-linear latency histogram in the style of HdrHistogram
+ *
+ * Each power of two range of nanoseconds is split into 32 linear buckets,
+ * values below 32ns are exact and values from 2^36ns (about 68s) on share
+ * the last bucket. The histogram has a single writer: counts are updated
+ * with relaxed loads and stores, so recording costs no locked instruction,
+ * while readers on other threads may take a snapshot at any time.
+ */
+class LatencyHistogram
+{
+   public:
+    static constexpr uint32_t kSubBucketBits = 5;
+    static constexpr uint32_t kSubBucketCount = 1 << kSubBucketBits;
+    static constexpr uint32_t kMaxValueBits = 36;
+    static constexpr uint32_t kBucketCount = (kMaxValueBits - kSubBucketBits + 1) * kSubBucketCount;
+
+    /**
+     * @brief Records one value, only the owning thread may call it
+     *
+     * @param value_ns The latency in ns
+     */
+    void Record(uint64_t value_ns)
+    {
+        const uint32_t bucket = BucketIndex(value_ns);
+        Increment(counts_[bucket], 1);
+        Increment(total_count_, 1);
+        Increment(total_sum_ns_, value_ns);
+        if (value_ns > max_ns_.load(std::memory_order_relaxed))
+        {
+            max_ns_.store(value_ns, std::memory_order_relaxed);
+        }
+        if (value_ns < min_ns_.load(std::memory_order_relaxed))
+        {
+            min_ns_.store(value_ns, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Adds the counts of this histogram to a plain bucket array
+     *
+     * @param counts Bucket counts of size kBucketCount
+     * @param total_count Accumulated number of values
+     * @param total_sum_ns Accumulated sum of values
+     * @param min_ns Accumulated minimum
+     * @param max_ns Accumulated maximum
+     */
+    void MergeInto(std::vector<uint64_t>& counts, uint64_t& total_count, uint64_t& total_sum_ns, uint64_t& min_ns,
+                   uint64_t& max_ns) const;
+
+    /**
+     * @brief Clears the histogram
+     *
+     * Values recorded concurrently may be lost.
+     */
+    void Reset();
+
+    /**
+     * @brief Gets the bucket of a value
+     *
+     * @param value_ns The latency in ns
+     * @return Index of the bucket
+     */
+    static uint32_t BucketIndex(uint64_t value_ns)
+    {
+        if (value_ns < kSubBucketCount)
+        {
+            return uint32_t(value_ns);
+        }
+        const uint32_t msb = 63 - uint32_t(__builtin_clzll(value_ns));
+        if (msb >= kMaxValueBits)
+        {
+            return kBucketCount - 1;
+        }
+        const uint32_t sub_bucket = uint32_t(value_ns >> (msb - kSubBucketBits)) & (kSubBucketCount - 1);
+        return (msb - kSubBucketBits + 1) * kSubBucketCount + sub_bucket;
+    }
+
+    /**
+     * @brief Gets the smallest value falling into a bucket
+     *
+     * @param bucket Index of the bucket
+     * @return The lower bound in ns
+     */
+    static uint64_t BucketLowerBound(uint32_t bucket)
+    {
+        if (bucket < kSubBucketCount)
+        {
+            return bucket;
+        }
+        const uint32_t msb = bucket / kSubBucketCount + kSubBucketBits - 1;
+        const uint64_t sub_bucket = bucket % kSubBucketCount;
+        return (kSubBucketCount + sub_bucket) << (msb - kSubBucketBits);
+    }
+
+   private:
+    static void Increment(std::atomic<uint64_t>& counter, uint64_t value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+   private:
+    std::array<std::atomic<uint64_t>, kBucketCount> counts_{};
+    std::atomic<uint64_t> total_count_{0};
+    std::atomic<uint64_t> total_sum_ns_{0};
+    std::atomic<uint64_t> min_ns_{UINT64_MAX};
+    std::atomic<uint64_t> max_ns_{0};
+};
+
+/**
+ * @brief Named latency metrics with one histogram set per recording thread
+ *
+ * Every thread records into its own shard, found through a thread local
+ * cache, so recording never takes a lock or shares a cache line with other
+ * threads. Snapshot merges the shards of all threads and may be called by
+ * a metrics exporter while inference is running.
+ */
+class LatencyRecorder
+{
+   public:
+    /**
+     * @brief Histograms of one recording thread
+     */
+    struct Shard
+    {
+        explicit Shard(size_t metric_count) : histograms(metric_count)
+        {
+        }
+
+        void Record(uint32_t metric, uint64_t value_ns)
+        {
+            histograms[metric].Record(value_ns);
+        }
+
+        std::vector<LatencyHistogram> histograms;
+    };
+
+    /**
+     * @brief Creates the metrics
+     *
+     * @param metric_names Name of every metric, a metric is addressed by its index
+     */
+    explicit LatencyRecorder(std::vector<std::string> metric_names);
+
+    LatencyRecorder(const LatencyRecorder&) = delete;
+    LatencyRecorder& operator=(const LatencyRecorder&) = delete;
+
+    /**
+     * @brief Gets the shard of the calling thread
+     *
+     * Callers recording many values in a row can keep the shard and skip
+     * the lookup.
+     *
+     * @return The histograms of the calling thread
+     */
+    Shard& LocalShard();
+
+    /**
+     * @brief Records one value on the calling thread's shard
+     *
+     * @param metric Index of the metric
+     * @param value_ns The latency in ns
+     */
+    void Record(uint32_t metric, uint64_t value_ns)
+    {
+        LocalShard().Record(metric, value_ns);
+    }
+
+    /**
+     * @brief Computes the percentiles of one metric over all threads
+     *
+     * @param metric Index of the metric
+     * @return The snapshot
+     */
+    LatencySnapshot Snapshot(uint32_t metric) const;
+
+    /**
+     * @brief Computes the percentiles of every metric
+     *
+     * @return One snapshot per metric, in index order
+     */
+    std::vector<LatencySnapshot> SnapshotAll() const;
+
+    /**
+     * @brief Clears every histogram of every thread
+     */
+    void Reset();
+
+    /**
+     * @brief Gets the names of the metrics
+     *
+     * @return The metric names
+     */
+    const std::vector<std::string>& metric_names() const;
+
+   private:
+    const uint64_t recorder_id_;
+    std::vector<std::string> metric_names_;
+
+    mutable std::mutex shards_mutex_;
+    std::vector<std::pair<std::thread::id, std::unique_ptr<Shard>>> shards_;
+};
+}  // namespace utils
+}  // namespace black_scholes
+#endif
@@ -3,11 +3,13 @@
 #ifndef DL_INCLUDE_UTILS_TIME_LOGGING_HPP_
 #define DL_INCLUDE_UTILS_TIME_LOGGING_HPP_
 #include <chrono>
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <utility>
+#include "utils/perf/perf_counters.hpp"
 namespace black_scholes
 {
 namespace utils
@@ -42,6 +44,9 @@ struct LayerTimeState
     /// Duration in ms
     long duration_time_;
 
+    /// Duration in ns, precise enough for the throughput of short layers
+    int64_t duration_ns_ = 0;
+
     /**
      * @brief Mutex for thread safety
      *
@@ -54,6 +59,9 @@ struct LayerTimeState
 
     /// Type of the layer
     std::string layer_type_;
+
+    /// Hardware counters accumulated over the layer executions
+    PerfCounterValues perf_counters_;
 };
 
 using LayerTimeStatesCollector = std::map<std::string, std::shared_ptr<LayerTimeState>>;
@@ -112,8 +120,10 @@ class LayerTimeLogging
      *
      * @param layer_name Name of the layer
      * @param layer_type Type of the layer
+     * @param perf_counters Hardware counters read around the layer, optional
      */
-    explicit LayerTimeLogging(std::string layer_name, std::string layer_type);
+    explicit LayerTimeLogging(std::string layer_name, std::string layer_type,
+                              const PerfCounterSet* perf_counters = nullptr);
 
     /**
      * @brief Stop time log and record duration
@@ -125,7 +135,9 @@ class LayerTimeLogging
     /**
      * @brief Prints summary of layer times
      *
-     * Prints collected per layer type execution times.
+     * Prints collected per layer execution times, followed by the
+     * aggregate per layer type. Hardware counters, when collected, are
+     * printed as IPC and misses per thousand instructions.
      */
     static void SummaryLogging();
 
@@ -133,6 +145,8 @@ class LayerTimeLogging
     std::string layer_name_;
     std::string layer_type_;
     std::chrono::steady_clock::time_point start_time_;
+    const PerfCounterSet* perf_counters_ = nullptr;
+    PerfCounterValues start_counters_;
 };
 }  // namespace utils
 }  // namespace black_scholes
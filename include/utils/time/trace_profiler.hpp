@@ -0,0 +1,172 @@
+
+#ifndef DL_INCLUDE_UTILS_TRACE_PROFILER_HPP_
+#define DL_INCLUDE_UTILS_TRACE_PROFILER_HPP_
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace black_scholes
+{
+namespace utils
+{
+/**
+ * @brief One complete span of the timeline
+ *
+ * Timestamps are nanoseconds of the steady clock, relative to the start of
+ * the profiling session.
+ */
+struct TraceEvent
+{
+    /// Name of the span, the layer name for layer spans
+    std::string name;
+
+    /// Category of the span, the layer type for layer spans
+    std::string category;
+
+    /// Start timestamp in ns
+    uint64_t start_ns = 0;
+
+    /// End timestamp in ns
+    uint64_t end_ns = 0;
+
+    /// Input shapes, e.g. "[1,3,224,224]"
+    std::string input_shapes;
+
+    /// Output shapes
+    std::string output_shapes;
+};
+
+/**
+ * @brief Events recorded by one thread
+ *
+ * Only the owning thread appends, so recording never takes a lock.
+ */
+struct ThreadTraceBuffer
+{
+    uint32_t thread_index = 0;
+    std::vector<TraceEvent> events;
+};
+
+/**
+ * @brief Timeline profiler with Chrome trace export
+ *
+ * Records per thread spans into lock-free thread local buffers and exports
+ * them in the Chrome trace_event JSON format, viewable in chrome://tracing
+ * or Perfetto. A thread registers its buffer once per session, afterwards
+ * recording is a plain vector append.
+ *
+ * Export and Start must not run concurrently with recording threads.
+ */
+class TraceProfiler
+{
+   public:
+    /**
+     * @brief Gets the profiler singleton
+     *
+     * @return The profiler
+     */
+    static TraceProfiler& Instance();
+
+    /**
+     * @brief Starts a new session, dropping previously recorded events
+     */
+    void Start();
+
+    /**
+     * @brief Stops recording, the events are kept for export
+     */
+    void Stop();
+
+    /**
+     * @brief Checks whether spans are being recorded
+     *
+     * @return True between Start and Stop
+     */
+    bool enabled() const;
+
+    /**
+     * @brief Gets the current timestamp of the session
+     *
+     * @return Nanoseconds since Start
+     */
+    uint64_t NowNs() const;
+
+    /**
+     * @brief Appends an event to the calling thread's buffer
+     *
+     * @param event The finished span
+     */
+    void Record(TraceEvent event);
+
+    /**
+     * @brief Gets every recorded event grouped by thread
+     *
+     * @return The thread buffers of the session
+     */
+    std::vector<std::shared_ptr<ThreadTraceBuffer>> buffers() const;
+
+    /**
+     * @brief Writes the session as Chrome trace_event JSON
+     *
+     * @param path Output file path
+     * @return True if the file was written
+     */
+    bool ExportChromeTrace(const std::string& path) const;
+
+   private:
+    TraceProfiler() = default;
+
+    ThreadTraceBuffer* LocalBuffer();
+
+   private:
+    std::atomic<bool> enabled_{false};
+    std::atomic<uint64_t> session_{0};
+    int64_t session_start_ns_ = 0;
+
+    mutable std::mutex buffers_mutex_;
+    std::vector<std::shared_ptr<ThreadTraceBuffer>> buffers_;
+};
+
+/**
+ * @brief Records a span from construction to destruction
+ *
+ * Does nothing when the profiler is disabled.
+ */
+class TraceScope
+{
+   public:
+    /**
+     * @brief Opens a span, the name and category are copied only when the profiler is enabled
+     */
+    explicit TraceScope(const std::string& name, const std::string& category);
+
+    ~TraceScope();
+
+    /**
+     * @brief Attaches input and output shapes to the span
+     *
+     * @param input_shapes Formatted input shapes
+     * @param output_shapes Formatted output shapes
+     */
+    void set_shapes(std::string input_shapes, std::string output_shapes);
+
+   private:
+    bool enabled_ = false;
+    TraceEvent event_;
+    std::string parent_name_;
+};
+
+/**
+ * @brief Name of the span the calling thread is executing
+ *
+ * Parallel loops use it to label the per thread spans of their tasks.
+ *
+ * @return The name of the current span, empty if there is none
+ */
+const std::string& CurrentTraceName();
+}  // namespace utils
+}  // namespace black_scholes
+#endif
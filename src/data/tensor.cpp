@@ -73,6 +73,7 @@ template <typename T>
 Tensor<T>::Tensor(uint32_t channels, uint32_t rows, uint32_t cols)
 {
     data_ = arma::Cube<T>(rows, cols, channels);
+    this->TrackDataMemory();
     if (channels == 1 && rows == 1)
     {
         this->raw_shapes_ = std::vector<uint32_t>{cols};
@@ -91,6 +92,7 @@ template <typename T>
 Tensor<T>::Tensor(uint32_t size)
 {
     data_ = arma::Cube<T>(1, size, 1);
+    this->TrackDataMemory();
     this->raw_shapes_ = std::vector<uint32_t>{size};
 }
 
@@ -98,6 +100,7 @@ template <typename T>
 Tensor<T>::Tensor(uint32_t rows, uint32_t cols)
 {
     data_ = arma::Cube<T>(rows, cols, 1);
+    this->TrackDataMemory();
     if (rows == 1)
     {
         this->raw_shapes_ = std::vector<uint32_t>{cols};
@@ -122,6 +125,7 @@ Tensor<T>::Tensor(const std::vector<uint32_t>& shapes)
     uint32_t cols = shapes_.at(2);
 
     data_ = arma::Cube<T>(rows, cols, channels);
+    this->TrackDataMemory();
     if (channels == 1 && rows == 1)
     {
         this->raw_shapes_ = std::vector<uint32_t>{cols};
@@ -268,6 +272,7 @@ void Tensor<T>::Padding(const std::vector<uint32_t>& pads, T padding_value)
     new_data.subcube(pad_rows1, pad_cols1, 0, new_data.n_rows - pad_rows2 - 1, new_data.n_cols - pad_cols2 - 1,
                      new_data.n_slices - 1) = this->data_;
     this->data_ = std::move(new_data);
+    this->TrackDataMemory();
     this->raw_shapes_ = std::vector<uint32_t>{this->channels(), this->rows(), this->cols()};
 }
 
@@ -564,6 +569,20 @@ void Tensor<T>::Review(const std::vector<uint32_t>& shapes)
         }
     }
     this->data_ = std::move(new_data);
+    this->TrackDataMemory();
+}
+
+template <typename T>
+void Tensor<T>::set_memory_category(utils::MemoryCategory category)
+{
+    this->tracked_memory_.set_category(category);
+}
+
+template <typename T>
+void Tensor<T>::TrackDataMemory()
+{
+    // a mem_state of zero is memory owned by the cube, the others wrap external memory
+    this->tracked_memory_.Resize(this->data_.mem_state == 0 ? this->data_.n_elem * sizeof(T) : 0);
 }
 
 template class Tensor<float>;
@@ -0,0 +1,65 @@
+
+#include "layer/abstract/layer_cost.hpp"
+#include <glog/logging.h>
+
+namespace black_scholes
+{
+LayerCostRegisterer::CostRegistry& LayerCostRegisterer::Registry()
+{
+    static CostRegistry registry;
+    return registry;
+}
+
+void LayerCostRegisterer::RegisterCostFunction(const std::string& layer_type, const CostFunction& cost_function)
+{
+    CHECK(!layer_type.empty());
+    CHECK(cost_function != nullptr);
+    CostRegistry& registry = Registry();
+    CHECK_EQ(registry.count(layer_type), 0) << "Layer type: " << layer_type << " has already registered a cost!";
+    registry.insert({layer_type, cost_function});
+}
+
+utils::LayerCost LayerCostRegisterer::EstimateCost(const std::shared_ptr<RuntimeOperator>& op)
+{
+    CHECK(op != nullptr);
+    const CostRegistry& registry = Registry();
+    const auto cost_iter = registry.find(op->type);
+    if (cost_iter == registry.end())
+    {
+        return utils::LayerCost{};
+    }
+    return cost_iter->second(op);
+}
+
+double LayerCostRegisterer::InputElements(const std::shared_ptr<RuntimeOperator>& op)
+{
+    double elements = 0.;
+    for (const auto& input_operand : op->input_operands_seq)
+    {
+        if (input_operand != nullptr)
+        {
+            elements += double(input_operand->size());
+        }
+    }
+    return elements;
+}
+
+double LayerCostRegisterer::OutputElements(const std::shared_ptr<RuntimeOperator>& op)
+{
+    if (op->output_operands == nullptr)
+    {
+        return 0.;
+    }
+    return double(op->output_operands->size());
+}
+
+utils::LayerCost LayerCostRegisterer::ElementwiseCost(const std::shared_ptr<RuntimeOperator>& op,
+                                                      double flops_per_element)
+{
+    utils::LayerCost cost;
+    const double output_elements = OutputElements(op);
+    cost.flops = flops_per_element * output_elements;
+    cost.bytes = (InputElements(op) + output_elements) * sizeof(float);
+    return cost;
+}
+}  // namespace black_scholes
@@ -0,0 +1,34 @@
+
+#include "layer/abstract/layer_scratch.hpp"
+#include <glog/logging.h>
+
+namespace black_scholes
+{
+LayerScratchRegisterer::ScratchRegistry& LayerScratchRegisterer::Registry()
+{
+    static ScratchRegistry registry;
+    return registry;
+}
+
+void LayerScratchRegisterer::RegisterScratchFunction(const std::string& layer_type,
+                                                     const ScratchFunction& scratch_function)
+{
+    CHECK(!layer_type.empty());
+    CHECK(scratch_function != nullptr);
+    ScratchRegistry& registry = Registry();
+    CHECK_EQ(registry.count(layer_type), 0) << "Layer type: " << layer_type << " has already registered a scratch!";
+    registry.insert({layer_type, scratch_function});
+}
+
+size_t LayerScratchRegisterer::ScratchBytes(const std::shared_ptr<RuntimeOperator>& op)
+{
+    CHECK(op != nullptr);
+    const ScratchRegistry& registry = Registry();
+    const auto scratch_iter = registry.find(op->type);
+    if (scratch_iter == registry.end())
+    {
+        return 0;
+    }
+    return scratch_iter->second(op);
+}
+}  // namespace black_scholes
@@ -72,6 +72,19 @@ void ParamLayer::set_weights(const std::vector<float>& weights) {
   }
 }
 
+bool ParamLayer::ShareWeights(const std::shared_ptr<ParamLayer>& replica) { return false; }
+
+void ParamLayer::ForEachWeightRegion(
+    const std::function<void(const void*, size_t)>& visit) const {
+  for (const std::vector<sftensor>* tensors : {&this->weights_, &this->bias_}) {
+    for (const sftensor& tensor : *tensors) {
+      if (tensor != nullptr && !tensor->empty()) {
+        visit(tensor->raw_ptr(), tensor->size() * sizeof(float));
+      }
+    }
+  }
+}
+
 std::shared_ptr<Tensor<float>> ParamLayer::weight(int32_t index) const {
   CHECK_LE(index, this->weights_.size());
   return this->weights_.at(index);
@@ -1,8 +1,16 @@
 
 #include "activation.hpp"
 #include "simd.hpp"
+#include "utils/parallel/parallel_utils.hpp"
 namespace black_scholes {
 namespace activation {
+static sftensor TensorRangeView(const sftensor& tensor, size_t begin, size_t end) {
+  if (begin == 0 && end == tensor->size()) {
+    return tensor;
+  }
+  return std::make_shared<Tensor<float>>(tensor->raw_ptr(begin), uint32_t(end - begin));
+}
+
 std::string ActivationTypeToString(ActivationType type) {
   std::string activate_type;
   switch (type) {
@@ -69,7 +77,6 @@ StatusCode ActivationLayer::Forward(const std::vector<std::shared_ptr<Tensor<flo
   const uint32_t batch_size = inputs.size();
   const std::string& act_type_str = ActivationTypeToString(act_type_);
   ActivationFunc activation_function = ApplySSEActivation(act_type_);
-#pragma omp parallel for num_threads(batch_size)
   for (uint32_t i = 0; i < batch_size; ++i) {
     const std::shared_ptr<Tensor<float>>& input = inputs.at(i);
     CHECK(input != nullptr && !input->empty())
@@ -84,7 +91,22 @@ StatusCode ActivationLayer::Forward(const std::vector<std::shared_ptr<Tensor<flo
     CHECK(output != nullptr && output->shapes() == input->shapes())
         << "The input and output tensor shapes of the " + act_type_str + " layer do not match " << i
         << " th";
-    activation_function(input, output);
+  }
+
+  const size_t input_size = inputs.front()->size();
+  if (batch_size == 1 || utils::ShouldParallel(input_size)) {
+    // split every image into element ranges so a single image uses all cores
+    for (uint32_t i = 0; i < batch_size; ++i) {
+      const sftensor& input = inputs.at(i);
+      const sftensor& output = outputs.at(i);
+      utils::ParallelForRange(input->size(), [&](size_t begin, size_t end) {
+        activation_function(TensorRangeView(input, begin, end), TensorRangeView(output, begin, end));
+      });
+    }
+  } else {
+    utils::ParallelFor(batch_size, input_size, [&](uint32_t i) {
+      activation_function(inputs.at(i), outputs.at(i));
+    });
   }
   return StatusCode::kSuccess;
 }
@@ -4,6 +4,7 @@
 #include <glog/logging.h>
 
 #include "layer/abstract/layer_factory.hpp"
+#include "utils/parallel/parallel_utils.hpp"
 
 namespace black_scholes
 {
@@ -25,24 +26,25 @@ StatusCode AdaptiveAveragePoolingLayer::Forward(const std::vector<std::shared_pt
     }
 
     const uint32_t batch = inputs.size();
-#pragma omp parallel for num_threads(batch)
-    for (uint32_t i = 0; i < batch; ++i)
-    {
-        const std::shared_ptr<Tensor<float>>& input_data = inputs.at(i);
+    const uint32_t input_h = inputs.front()->rows();
+    const uint32_t input_w = inputs.front()->cols();
+    const uint32_t input_c = inputs.front()->channels();
+    const uint32_t stride_h = uint32_t(std::floor(input_h / output_h_));
+    const uint32_t stride_w = uint32_t(std::floor(input_w / output_w_));
+    CHECK(stride_w > 0 && stride_h > 0) << "The stride parameter is set incorrectly. It must always be greater "
+                                           "than 0";
 
-        const uint32_t input_h = input_data->rows();
-        const uint32_t input_w = input_data->cols();
-        const uint32_t input_c = input_data->channels();
-        const uint32_t stride_h = uint32_t(std::floor(input_h / output_h_));
-        const uint32_t stride_w = uint32_t(std::floor(input_w / output_w_));
-        CHECK(stride_w > 0 && stride_h > 0) << "The stride parameter is set incorrectly. It must always be greater "
-                                               "than 0";
+    const uint32_t pooling_h = (int32_t)input_h - (int32_t(output_h_) - 1) * int32_t(stride_h);
+    const uint32_t pooling_w = (int32_t)input_w - (int32_t(output_w_) - 1) * int32_t(stride_w);
 
-        const uint32_t pooling_h = (int32_t)input_h - (int32_t(output_h_) - 1) * int32_t(stride_h);
-        const uint32_t pooling_w = (int32_t)input_w - (int32_t(output_w_) - 1) * int32_t(stride_w);
+    CHECK(pooling_w > 0 && pooling_h > 0) << "The pooling parameter is set incorrectly. It must always be "
+                                             "greater than 0";
 
-        CHECK(pooling_w > 0 && pooling_h > 0) << "The pooling parameter is set incorrectly. It must always be "
-                                                 "greater than 0";
+    for (uint32_t i = 0; i < batch; ++i)
+    {
+        const std::shared_ptr<Tensor<float>>& input_data = inputs.at(i);
+        CHECK(input_data->rows() == input_h && input_data->cols() == input_w && input_data->channels() == input_c)
+            << "The input tensor array in the adaptive pooling layer has tensors of different shapes " << i << "th";
 
         std::shared_ptr<Tensor<float>> output_data = outputs.at(i);
         if (output_data == nullptr || output_data->empty())
@@ -56,34 +58,36 @@ StatusCode AdaptiveAveragePoolingLayer::Forward(const std::vector<std::shared_pt
             << "The output tensor array in the adaptive pooling layer has an "
                "incorrectly sized tensor "
             << i << "th";
+    }
 
-        const uint32_t pooling_size = pooling_h * pooling_w;
-        for (uint32_t ic = 0; ic < input_c; ++ic)
+    // one task per (image, channel) pair, so batch 1 still spreads over the channels
+    const uint32_t pooling_size = pooling_h * pooling_w;
+    utils::ParallelFor(batch * input_c, size_t(input_h) * input_w, [&](uint32_t task) {
+        const uint32_t i = task / input_c;
+        const uint32_t ic = task % input_c;
+        const arma::fmat& input_channel = inputs.at(i)->slice(ic);
+        arma::fmat& output_channel = outputs.at(i)->slice(ic);
+        for (uint32_t c = 0; c < input_w - pooling_w + 1; c += stride_w)
         {
-            const arma::fmat& input_channel = input_data->slice(ic);
-            arma::fmat& output_channel = output_data->slice(ic);
-            for (uint32_t c = 0; c < input_w - pooling_w + 1; c += stride_w)
+            uint32_t output_col = uint32_t(c / stride_w);
+            for (uint32_t r = 0; r < input_h - pooling_h + 1; r += stride_h)
             {
-                uint32_t output_col = uint32_t(c / stride_w);
-                for (uint32_t r = 0; r < input_h - pooling_h + 1; r += stride_h)
+                float mean_value = 0.f;
+                uint32_t output_row = uint32_t(r / stride_h);
+                float* output_channel_ptr = output_channel.colptr(output_col);
+                for (uint32_t w = 0; w < pooling_w; ++w)
                 {
-                    float mean_value = 0.f;
-                    uint32_t output_row = uint32_t(r / stride_h);
-                    float* output_channel_ptr = output_channel.colptr(output_col);
-                    for (uint32_t w = 0; w < pooling_w; ++w)
+                    const float* col_ptr = input_channel.colptr(c + w) + r;
+                    for (uint32_t h = 0; h < pooling_h; ++h)
                     {
-                        const float* col_ptr = input_channel.colptr(c + w) + r;
-                        for (uint32_t h = 0; h < pooling_h; ++h)
-                        {
-                            float current_value = *(col_ptr + h);
-                            mean_value = mean_value + current_value;
-                        }
+                        float current_value = *(col_ptr + h);
+                        mean_value = mean_value + current_value;
                     }
-                    *(output_channel_ptr + output_row) = mean_value / float(pooling_size);
                 }
+                *(output_channel_ptr + output_row) = mean_value / float(pooling_size);
             }
         }
-    }
+    });
     return StatusCode::kSuccess;
 }
 
@@ -160,6 +164,16 @@ StatusCode AdaptiveAveragePoolingLayer::Check(const std::vector<sftensor>& input
     return StatusCode::kSuccess;
 }
 
+utils::LayerCost AdaptiveAveragePoolingLayer::EstimateCost(const std::shared_ptr<RuntimeOperator>& op)
+{
+    // every input element is added to its window, every output is divided once
+    utils::LayerCost cost = LayerCostRegisterer::ElementwiseCost(op, 1.);
+    cost.flops += LayerCostRegisterer::InputElements(op);
+    return cost;
+}
+
 LayerRegistererWrapper kAdaptiveAvgPoolingCreateInstance(AdaptiveAveragePoolingLayer::CreateInstance,
                                                          "nn.AdaptiveAvgPool2d", "F.adaptive_avg_pool2d");
+LayerCostRegistererWrapper kAdaptiveAvgPoolingCost(AdaptiveAveragePoolingLayer::EstimateCost, "nn.AdaptiveAvgPool2d",
+                                                   "F.adaptive_avg_pool2d");
 }  // namespace black_scholes
@@ -2,6 +2,7 @@
 
 #ifndef DL_SOURCE_LAYER_AVGPOOLING_HPP_
 #define DL_SOURCE_LAYER_AVGPOOLING_HPP_
+#include "layer/abstract/layer_cost.hpp"
 #include "layer/abstract/non_param_layer.hpp"
 
 namespace block_scholes {
@@ -17,6 +18,8 @@ class AdaptiveAveragePoolingLayer : public NonParamLayer {
 
   static StatusCode CreateInstance(const std::shared_ptr<RuntimeOperator>& op,
                                    std::shared_ptr<Layer<float>>& avg_layer);
+
+  static utils::LayerCost EstimateCost(const std::shared_ptr<RuntimeOperator>& op);
  private:
   uint32_t output_h_ = 0;
   uint32_t output_w_ = 0;
@@ -1,9 +1,19 @@
 
 #include "base_convolution.hpp"
+#include <algorithm>
+#include <typeinfo>
+#include "bf16_convolution.hpp"
 #include "convolution.hpp"
 #include "deconvolution.hpp"
+#include "direct_convolution.hpp"
 #include "layer/abstract/layer.hpp"
+#include "quantized_convolution.hpp"
 #include "status_code.hpp"
+#include "utils/math/direct_conv.hpp"
+#include "utils/math/sgemm.hpp"
+#include "utils/math/weight_quantization.hpp"
+#include "utils/memory/scratch_arena.hpp"
+#include "utils/parallel/parallel_utils.hpp"
 namespace block_scholes
 {
 BaseConvolutionLayer::BaseConvolutionLayer(ConvType conv_type, uint32_t output_channel, uint32_t in_channel,
@@ -54,6 +64,10 @@ BaseConvolutionLayer::BaseConvolutionLayer(ConvType conv_type, uint32_t output_c
 
     CHECK_GT(kernel_h, 0);
     CHECK_GT(kernel_w, 0);
+    this->kernel_count_ = output_channel;
+    this->kernel_channel_ = in_channel;
+    this->kernel_h_ = kernel_h;
+    this->kernel_w_ = kernel_w;
     this->InitWeightParam(output_channel, in_channel, kernel_h, kernel_w);
     if (use_bias_)
     {
@@ -65,22 +79,118 @@ void BaseConvolutionLayer::InitIm2ColWeight()
 {
 }
 
-void BaseConvolutionLayer::AddBias(arma::fmat& output, uint32_t bias_index) const
+void BaseConvolutionLayer::set_fp16_weights(const std::vector<uint16_t>& weight_values)
 {
-    if (!this->bias_.empty() && this->use_bias_)
+    CHECK(!weights_packed_) << "The precision of the kernels must be set before they are packed";
+    const uint32_t row_len = kernel_h_ * kernel_w_;
+    const size_t kernel_size = size_t(kernel_channel_) * row_len;
+    CHECK_EQ(weight_values.size(), kernel_count_ * kernel_size)
+        << "The number of half precision weights does not match the kernels";
+
+    // the attribute stores each channel row by row, the kernel tensors and the GEMM column by column
+    fp16_kernel_matrix_.resize(weight_values.size());
+    for (size_t channel = 0; channel < size_t(kernel_count_) * kernel_channel_; ++channel)
     {
-        std::shared_ptr<Tensor<float>> bias;
-        bias = this->bias_.at(bias_index);
-        if (bias != nullptr && !bias->empty())
+        const uint16_t* src = weight_values.data() + channel * row_len;
+        uint16_t* dst = fp16_kernel_matrix_.data() + channel * row_len;
+        for (uint32_t h = 0; h < kernel_h_; ++h)
         {
-            float bias_value = bias->index(0);
-            output += bias_value;
-        }
-        else
-        {
-            LOG(FATAL) << "Bias tensor is empty or nullptr";
+            for (uint32_t w = 0; w < kernel_w_; ++w)
+            {
+                dst[w * kernel_h_ + h] = src[h * kernel_w_ + w];
+            }
         }
     }
+    this->fp16_weights_ = true;
+    ReleaseWeights();
+}
+
+void BaseConvolutionLayer::ReleaseWeights()
+{
+    std::vector<std::shared_ptr<Tensor<float>>>().swap(this->weights_);
+}
+
+void BaseConvolutionLayer::ReleaseKernels()
+{
+    std::vector<arma::fmat>().swap(kernel_matrix_arr_);
+    std::vector<uint16_t>().swap(fp16_kernel_matrix_);
+    kernel_matrix_memory_.Resize(0);
+}
+
+bool BaseConvolutionLayer::ShareWeights(const std::shared_ptr<ParamLayer>& replica)
+{
+    auto conv_replica = std::dynamic_pointer_cast<BaseConvolutionLayer>(replica);
+    if (conv_replica == nullptr || conv_replica.get() == this || typeid(*conv_replica) != typeid(*this) ||
+        !weights_packed_ || !conv_replica->weights_packed_)
+    {
+        return false;
+    }
+    const bool same_layer =
+        conv_replica->conv_type_ == conv_type_ && conv_replica->kernel_count_ == kernel_count_ &&
+        conv_replica->kernel_channel_ == kernel_channel_ && conv_replica->kernel_h_ == kernel_h_ &&
+        conv_replica->kernel_w_ == kernel_w_ && conv_replica->groups_ == groups_ &&
+        conv_replica->use_bias_ == use_bias_ && conv_replica->padding_h_ == padding_h_ &&
+        conv_replica->padding_w_ == padding_w_ && conv_replica->stride_h_ == stride_h_ &&
+        conv_replica->stride_w_ == stride_w_ && conv_replica->output_padding_h_ == output_padding_h_ &&
+        conv_replica->output_padding_w_ == output_padding_w_ && conv_replica->dilation_h_ == dilation_h_ &&
+        conv_replica->dilation_w_ == dilation_w_ && conv_replica->padding_mode_ == padding_mode_ &&
+        conv_replica->fp16_weights_ == fp16_weights_;
+    if (!same_layer)
+    {
+        return false;
+    }
+    // always point at the owner, a layer sharing kernels holds none to share
+    kernel_source_ = conv_replica->kernel_source_ != nullptr ? conv_replica->kernel_source_ : conv_replica;
+    ReleaseKernels();
+    ReleaseWeights();
+    return true;
+}
+
+void BaseConvolutionLayer::ForEachWeightRegion(const std::function<void(const void*, size_t)>& visit) const
+{
+    for (const arma::fmat& kernel_matrix : kernel_matrix_arr_)
+    {
+        visit(kernel_matrix.memptr(), kernel_matrix.n_elem * sizeof(float));
+    }
+    if (!fp16_kernel_matrix_.empty())
+    {
+        visit(fp16_kernel_matrix_.data(), fp16_kernel_matrix_.size() * sizeof(uint16_t));
+    }
+}
+
+void BaseConvolutionLayer::set_padding_mode(PaddingMode padding_mode)
+{
+    CHECK(conv_type_ == ConvType::kOpConv || padding_mode == PaddingMode::kZeros)
+        << "The transposed convolution only pads with zeros";
+    this->padding_mode_ = padding_mode;
+}
+
+void BaseConvolutionLayer::PackWeights()
+{
+    InitIm2ColWeight();
+    weights_packed_ = true;
+}
+
+float BaseConvolutionLayer::BiasValue(uint32_t bias_index) const
+{
+    if (this->bias_.empty() || !this->use_bias_)
+    {
+        return 0.f;
+    }
+    const std::shared_ptr<Tensor<float>>& bias = this->bias_.at(bias_index);
+    if (bias == nullptr || bias->empty())
+    {
+        LOG(FATAL) << "Bias tensor is empty or nullptr";
+    }
+    return bias->index(0);
+}
+
+void BaseConvolutionLayer::AddBias(arma::fmat& output, uint32_t bias_index) const
+{
+    if (!this->bias_.empty() && this->use_bias_)
+    {
+        output += BiasValue(bias_index);
+    }
 }
 
 StatusCode BaseConvolutionLayer::Forward(const std::vector<std::shared_ptr<Tensor<float>>>& inputs,
@@ -92,21 +202,58 @@ StatusCode BaseConvolutionLayer::Forward(const std::vector<std::shared_ptr<Tenso
         return check_code;
     }
 
-    const uint32_t kernel_count = this->weights_.size();
-    const uint32_t kernel_h = this->weights_.at(0)->rows();
-    const uint32_t kernel_w = this->weights_.at(0)->cols();
-    const uint32_t kernel_channel = this->weights_.at(0)->channels();
+    const uint32_t kernel_count = this->kernel_count_;
+    const uint32_t kernel_h = this->kernel_h_;
+    const uint32_t kernel_w = this->kernel_w_;
+    const uint32_t kernel_channel = this->kernel_channel_;
 
-    if (kernel_matrix_arr_.size() != kernel_count)
+    if (!weights_packed_)
     {
-        InitIm2ColWeight();
+        PackWeights();
     }
+    // a layer sharing the kernels of another graph computes with the owner, whose settings are the same
+    const BaseConvolutionLayer& kernels = kernel_source_ != nullptr ? *kernel_source_ : *this;
     const uint32_t batch_size = inputs.size();
     const uint32_t kernel_count_group = kernel_count / groups_;
+    const auto check_groups = [&](uint32_t input_c) {
+        if (groups_ != 1)
+        {
+            CHECK(kernel_count % groups_ == 0);
+            CHECK(input_c % groups_ == 0);
+        }
+        CHECK(input_c / groups_ == kernel_channel) << "The number of channel for the kernel "
+                                                      "matrix and input tensor do not match";
+    };
 
-#pragma omp parallel for num_threads(batch_size)
-    for (uint32_t i = 0; i < batch_size; ++i)
+    // a batch of images of one shape can share one GEMM per group, the images become more columns
+    const sftensor& first_input = inputs.front();
+    const bool same_shape = std::all_of(inputs.begin(), inputs.end(), [&](const sftensor& input) {
+        return input->shapes() == first_input->shapes();
+    });
+    if (batch_size > 1 && same_shape)
     {
+        const uint32_t input_h = first_input->rows();
+        const uint32_t input_w = first_input->cols();
+        const uint32_t input_c = first_input->channels();
+        const auto& output_size = ComputeOutputSize(input_h, input_w, kernel_h, kernel_w);
+        if (kernels.UseBatchOutput(batch_size, output_size.first, output_size.second))
+        {
+            check_groups(input_c);
+            for (uint32_t i = 0; i < batch_size; ++i)
+            {
+                PrepareOutput(outputs, i, kernel_count, output_size.first, output_size.second);
+            }
+            utils::ParallelFor(groups_, utils::kParallelGrainSize, [&](uint32_t group) {
+                kernels.ComputeBatchOutput(inputs, outputs, kernel_h, kernel_w, kernel_count_group, input_h,
+                                           input_w, input_c / groups_, output_size.first, output_size.second,
+                                           group);
+            });
+            return StatusCode::kSuccess;
+        }
+    }
+
+    // every image and group carries a full im2col + GEMM, always worth a task
+    utils::ParallelFor(batch_size, utils::kParallelGrainSize, [&](uint32_t i) {
         const std::shared_ptr<Tensor<float>>& input = inputs.at(i);
         const uint32_t input_h = input->rows();
         const uint32_t input_w = input->cols();
@@ -116,38 +263,322 @@ StatusCode BaseConvolutionLayer::Forward(const std::vector<std::shared_ptr<Tenso
         const auto& output_size = ComputeOutputSize(input_h, input_w, kernel_h, kernel_w);
         const uint32_t output_h = output_size.first;
         const uint32_t output_w = output_size.second;
-        CHECK(output_h > 0 && output_w > 0)
-            << "The size of the output tensor should be greater than zero " << i << " th";
+        const sftensor& output_tensor = PrepareOutput(outputs, i, kernel_count, output_h, output_w);
 
-        std::shared_ptr<Tensor<float>> output_tensor = outputs.at(i);
-        if (output_tensor == nullptr || output_tensor->empty())
-        {
-            output_tensor = std::make_shared<Tensor<float>>(kernel_count, output_h, output_w);
-            outputs.at(i) = output_tensor;
-        }
+        utils::ParallelFor(groups_, utils::kParallelGrainSize, [&](uint32_t group) {
+            check_groups(input_c);
+            kernels.ComputeOutput(input, output_tensor, kernel_h, kernel_w, kernel_count_group, input_h, input_w,
+                                  input_c / groups_, output_h, output_w, group);
+        });
+    });
+    return StatusCode::kSuccess;
+}
 
-        CHECK(output_tensor->rows() == output_h && output_tensor->cols() == output_w &&
-              output_tensor->channels() == kernel_count)
-            << "The output tensor array in the convolution layer has an "
-               "incorrectly sized tensor "
-            << i << "th";
+const sftensor& BaseConvolutionLayer::PrepareOutput(std::vector<sftensor>& outputs, uint32_t index,
+                                                    uint32_t kernel_count, uint32_t output_h, uint32_t output_w)
+{
+    CHECK(output_h > 0 && output_w > 0)
+        << "The size of the output tensor should be greater than zero " << index << " th";
 
-#pragma omp parallel for if (groups_ > 1)
-        for (uint32_t group = 0; group < groups_; ++group)
-        {
-            if (groups_ != 1)
-            {
-                CHECK(kernel_count % groups_ == 0);
-                CHECK(input_c % groups_ == 0);
-            }
-            const uint32_t channels_per_group = input_c / groups_;
-            CHECK(channels_per_group == kernel_channel) << "The number of channel for the kernel "
-                                                           "matrix and input tensor do not match";
-            ComputeOutput(input, output_tensor, kernel_h, kernel_w, kernel_count_group, input_h, input_w,
-                          channels_per_group, output_h, output_w, group);
-        }
+    sftensor& output_tensor = outputs.at(index);
+    if (output_tensor == nullptr || output_tensor->empty())
+    {
+        output_tensor = std::make_shared<Tensor<float>>(kernel_count, output_h, output_w);
     }
-    return StatusCode::kSuccess;
+
+    CHECK(output_tensor->rows() == output_h && output_tensor->cols() == output_w &&
+          output_tensor->channels() == kernel_count)
+        << "The output tensor array in the convolution layer has an "
+           "incorrectly sized tensor "
+        << index << "th";
+    return output_tensor;
+}
+
+bool BaseConvolutionLayer::UseBatchOutput(uint32_t batch_size, uint32_t output_h, uint32_t output_w) const
+{
+    return false;
+}
+
+void BaseConvolutionLayer::ComputeBatchOutput(const std::vector<sftensor>& inputs,
+                                              const std::vector<sftensor>& outputs, uint32_t kernel_h,
+                                              uint32_t kernel_w, uint32_t kernel_count_group, uint32_t input_h,
+                                              uint32_t input_w, uint32_t channels_per_group, uint32_t output_h,
+                                              uint32_t output_w, uint32_t group) const
+{
+    LOG(FATAL) << "The layer has no batched convolution";
+}
+
+utils::LayerCost BaseConvolutionLayer::EstimateCost(const std::shared_ptr<RuntimeOperator>& op)
+{
+    utils::LayerCost cost;
+    if (!op->has_attribute("weight"))
+    {
+        return cost;
+    }
+    const std::vector<int32_t>& weight_shape = op->attribute.at("weight")->shape;
+    if (weight_shape.size() != 4)
+    {
+        return cost;
+    }
+    const double weight_count =
+        double(weight_shape.at(0)) * weight_shape.at(1) * weight_shape.at(2) * weight_shape.at(3);
+    const double input_elements = LayerCostRegisterer::InputElements(op);
+    const double output_elements = LayerCostRegisterer::OutputElements(op);
+    // conv weights are (out, in / groups, kh, kw), every output element reduces one filter;
+    // deconv weights are (in, out / groups, kh, kw), every input element scatters one filter
+    const double macs_per_element = weight_count / weight_shape.at(0);
+    const double elements = op->type == "nn.ConvTranspose2d" ? input_elements : output_elements;
+    cost.flops = 2. * macs_per_element * elements;
+
+    double bias_count = 0.;
+    if (op->has_attribute("bias"))
+    {
+        const std::vector<int32_t>& bias_shape = op->attribute.at("bias")->shape;
+        bias_count = bias_shape.empty() ? 0. : double(bias_shape.at(0));
+        cost.flops += output_elements;
+    }
+    cost.bytes = (input_elements + output_elements + weight_count + bias_count) * sizeof(float);
+    return cost;
+}
+
+static std::vector<int32_t> IntArrayParameter(const std::shared_ptr<RuntimeOperator>& op, const std::string& name,
+                                              const std::vector<int32_t>& default_value)
+{
+    if (!op->has_parameter(name))
+    {
+        return default_value;
+    }
+    auto parameter = std::dynamic_pointer_cast<RuntimeParameterIntArray>(op->params.at(name));
+    if (parameter == nullptr || parameter->value.size() != default_value.size())
+    {
+        return default_value;
+    }
+    return parameter->value;
+}
+
+static int32_t IntParameter(const std::shared_ptr<RuntimeOperator>& op, const std::string& name, int32_t default_value)
+{
+    if (!op->has_parameter(name))
+    {
+        return default_value;
+    }
+    auto parameter = std::dynamic_pointer_cast<RuntimeParameterInt>(op->params.at(name));
+    return parameter == nullptr ? default_value : parameter->value;
+}
+
+static float FloatParameter(const std::shared_ptr<RuntimeOperator>& op, const std::string& name, float default_value)
+{
+    if (!op->has_parameter(name))
+    {
+        return default_value;
+    }
+    auto parameter = std::dynamic_pointer_cast<RuntimeParameterFloat>(op->params.at(name));
+    return parameter == nullptr ? default_value : parameter->value;
+}
+
+static bool BoolParameter(const std::shared_ptr<RuntimeOperator>& op, const std::string& name, bool default_value)
+{
+    if (!op->has_parameter(name))
+    {
+        return default_value;
+    }
+    auto parameter = std::dynamic_pointer_cast<RuntimeParameterBool>(op->params.at(name));
+    return parameter == nullptr ? default_value : parameter->value;
+}
+
+/**
+ * @brief Parses the padding_mode of nn.Conv2d, "zeros", "reflect" or "replicate"
+ *
+ * @return True if the mode is known
+ */
+static bool ParsePaddingMode(const std::string& name, PaddingMode& padding_mode)
+{
+    if (name == "zeros")
+    {
+        padding_mode = PaddingMode::kZeros;
+    }
+    else if (name == "reflect")
+    {
+        padding_mode = PaddingMode::kReflect;
+    }
+    else if (name == "replicate")
+    {
+        padding_mode = PaddingMode::kReplicate;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Whether the operator pads with zeros, the int8 and bf16 kernels know no other padding
+ */
+static bool UseZeroPadding(const std::shared_ptr<RuntimeOperator>& op)
+{
+    if (!op->has_parameter("padding_mode"))
+    {
+        return true;
+    }
+    auto parameter = std::dynamic_pointer_cast<RuntimeParameterString>(op->params.at("padding_mode"));
+    return parameter == nullptr || parameter->value == "zeros";
+}
+
+/**
+ * @brief Whether the operator runs on the int8 kernels
+ *
+ * Needs int8 weights, the scale of the input activations and an int8 GEMM
+ * on this CPU, other int8 weights are dequantized for the float layers.
+ */
+static bool UseInt8Convolution(const std::shared_ptr<RuntimeOperator>& op)
+{
+    return op->type == "nn.Conv2d" && UseZeroPadding(op) && op->has_attribute("weight") &&
+           op->attribute.at("weight")->type == RuntimeDataType::kTypeInt8 &&
+           FloatParameter(op, "input_scale", 0.f) > 0.f && utils::SelectInt8Kernel() != utils::Int8Kernel::kNone;
+}
+
+/**
+ * @brief Whether the operator runs on the bf16 GEMM, and on which kernel
+ *
+ * kBFloat16 falls back to float32 on CPUs without AVX512-BF16, the int8
+ * convolutions keep their own kernels.
+ */
+static bool UseBf16Convolution(const std::shared_ptr<RuntimeOperator>& op, utils::Bf16Kernel& bf16_kernel)
+{
+    if (op->type != "nn.Conv2d" || !UseZeroPadding(op) || UseInt8Convolution(op))
+    {
+        return false;
+    }
+    bf16_kernel = utils::SelectBf16Kernel();
+    if (op->compute_precision == ComputePrecision::kBFloat16Emulated)
+    {
+        return true;
+    }
+    return op->compute_precision == ComputePrecision::kBFloat16 && bf16_kernel != utils::Bf16Kernel::kEmulated;
+}
+
+/**
+ * @brief Whether the operator runs on the direct stride-2 kernels
+ *
+ * Float 3x3 and 1x1 convolutions of stride 2 padded with zeros, with at
+ * least one block of output channels per group so the register block is
+ * not mostly empty. Half precision weights stay on the im2col convolution,
+ * whose GEMM keeps them in half precision.
+ */
+static bool UseDirectConvolution(const std::shared_ptr<RuntimeOperator>& op)
+{
+    utils::Bf16Kernel bf16_kernel = utils::Bf16Kernel::kEmulated;
+    if (op->type != "nn.Conv2d" || !utils::DirectConvEnabled() || !UseZeroPadding(op) || UseInt8Convolution(op) ||
+        UseBf16Convolution(op, bf16_kernel))
+    {
+        return false;
+    }
+    if (op->has_attribute("weight") && op->attribute.at("weight")->type == RuntimeDataType::kTypeFloat16)
+    {
+        return false;
+    }
+    const std::vector<int32_t> kernel = IntArrayParameter(op, "kernel_size", {0, 0});
+    const std::vector<int32_t> stride = IntArrayParameter(op, "stride", {1, 1});
+    const std::vector<int32_t> dilation = IntArrayParameter(op, "dilation", {1, 1});
+    if (kernel.at(0) <= 0 || kernel.at(1) <= 0 || stride.at(0) <= 0 || stride.at(1) <= 0 || dilation.at(0) <= 0 ||
+        dilation.at(1) <= 0)
+    {
+        return false;
+    }
+    const int32_t groups = std::max(IntParameter(op, "groups", 1), 1);
+    return utils::SupportsDirectConv(kernel.at(0), kernel.at(1), stride.at(0), stride.at(1), dilation.at(0),
+                                     dilation.at(1)) &&
+           IntParameter(op, "out_channels", 0) / groups >= int32_t(utils::kDirectConvBlock);
+}
+
+size_t BaseConvolutionLayer::ScratchBytes(const std::shared_ptr<RuntimeOperator>& op)
+{
+    if (!op->has_attribute("weight") || op->input_operands_seq.empty() || op->output_operands == nullptr)
+    {
+        return 0;
+    }
+    const std::vector<int32_t>& weight_shape = op->attribute.at("weight")->shape;
+    const std::vector<int32_t>& input_shape = op->input_operands_seq.front()->shapes;
+    const std::vector<int32_t>& output_shape = op->output_operands->shapes;
+    if (weight_shape.size() != 4 || input_shape.size() != 4 || output_shape.size() != 4)
+    {
+        return 0;
+    }
+    const std::vector<int32_t> kernel = {weight_shape.at(2), weight_shape.at(3)};
+    const std::vector<int32_t> stride = IntArrayParameter(op, "stride", {1, 1});
+    const std::vector<int32_t> padding = IntArrayParameter(op, "padding", {0, 0});
+    const std::vector<int32_t> dilation = IntArrayParameter(op, "dilation", {1, 1});
+    const size_t output_h = output_shape.at(2);
+    const size_t output_w = output_shape.at(3);
+
+    // one task of Forward holds the workspaces of one image and group at a time
+    if (op->type == "nn.ConvTranspose2d")
+    {
+        // the GEMM of a group holds every kernel tap of its output channels for all the input pixels,
+        // the sub-pixel engine one phase im2col matrix and its result
+        const size_t gemm_size =
+            size_t(weight_shape.at(1)) * kernel.at(0) * kernel.at(1) * input_shape.at(2) * input_shape.at(3);
+        const int32_t groups = std::max(IntParameter(op, "groups", 1), 1);
+        const size_t subpixel_size = DeconvolutionLayer::SubPixelWorkspaceSize(
+            weight_shape.at(0) / groups, weight_shape.at(1), kernel.at(0), kernel.at(1), output_h, output_w,
+            stride.at(0), stride.at(1), dilation.at(0), dilation.at(1), padding.at(0), padding.at(1));
+        // plus the packed panels of the GEMM, bounded by the larger of the two products
+        const size_t sgemm_bytes = std::max(
+            utils::SgemmWorkspaceBytes(uint32_t(weight_shape.at(1)) * kernel.at(0) * kernel.at(1),
+                                       input_shape.at(2) * input_shape.at(3), weight_shape.at(0) / groups),
+            utils::SgemmWorkspaceBytes(weight_shape.at(1), output_h * output_w,
+                                       uint32_t(weight_shape.at(0) / groups) * kernel.at(0) * kernel.at(1)));
+        return std::max(gemm_size, subpixel_size) * sizeof(float) + 2 * utils::ScratchArena::kAlignment +
+               sgemm_bytes;
+    }
+
+    const bool is_1x1_no_padding = kernel == std::vector<int32_t>{1, 1} && stride == std::vector<int32_t>{1, 1} &&
+                                   padding == std::vector<int32_t>{0, 0} && dilation == std::vector<int32_t>{1, 1};
+    if (UseInt8Convolution(op))
+    {
+        // the int8 convolution unfolds every input, one padded byte row per output pixel
+        const uint32_t depth = uint32_t(weight_shape.at(1)) * kernel.at(0) * kernel.at(1);
+        return utils::Int8PaddedDepth(depth) * output_h * output_w + utils::ScratchArena::kAlignment;
+    }
+    utils::Bf16Kernel bf16_kernel = utils::Bf16Kernel::kEmulated;
+    if (UseBf16Convolution(op, bf16_kernel))
+    {
+        const uint32_t depth = uint32_t(weight_shape.at(1)) * kernel.at(0) * kernel.at(1);
+        return utils::Bf16PaddedDepth(depth) * output_h * output_w * sizeof(uint16_t) +
+               utils::ScratchArena::kAlignment;
+    }
+    if (UseDirectConvolution(op))
+    {
+        // the direct kernels split the input channels of a group into their stride-2 phases
+        return utils::DirectConvWorkspaceBytes(weight_shape.at(1), kernel.at(0), output_h, output_w);
+    }
+    // the GEMM packs panels of the kernels and of the im2col tile, half precision kernels are widened
+    // into the panels, pruned kernels unfold the same tiles for the sparse GEMM
+    const size_t kernel_size = size_t(weight_shape.at(1)) * kernel.at(0) * kernel.at(1);
+    const uint32_t kernel_count_group = weight_shape.at(0) / std::max(IntParameter(op, "groups", 1), 1);
+    size_t image_bytes = 0;
+    if (is_1x1_no_padding)
+    {
+        image_bytes += utils::SgemmWorkspaceBytes(kernel_count_group, output_h * output_w, kernel_size);
+    }
+    else
+    {
+        const uint32_t tile_columns = ConvolutionLayer::Im2ColTileColumns(kernel_size, output_h * output_w);
+        image_bytes += tile_columns * kernel_size * sizeof(float) + utils::ScratchArena::kAlignment +
+                       utils::SgemmWorkspaceBytes(kernel_count_group, tile_columns, kernel_size);
+    }
+    // a folded batch unfolds several images and keeps the result before scattering it
+    const uint32_t fold_images = ConvolutionLayer::BatchFoldImages(input_shape.at(0), output_h, output_w);
+    if (fold_images == 1)
+    {
+        return image_bytes;
+    }
+    const size_t columns = fold_images * output_h * output_w;
+    const size_t batch_bytes = columns * (kernel_size + kernel_count_group) * sizeof(float) +
+                               2 * utils::ScratchArena::kAlignment +
+                               utils::SgemmWorkspaceBytes(kernel_count_group, columns, kernel_size);
+    return std::max(image_bytes, batch_bytes);
 }
 
 StatusCode BaseConvolutionLayer::CreateInstance(const std::shared_ptr<RuntimeOperator>& op,
@@ -256,20 +687,21 @@ StatusCode BaseConvolutionLayer::CreateInstance(const std::shared_ptr<RuntimeOpe
         return StatusCode::kParseParamError;
     }
 
+    PaddingMode padding_mode = PaddingMode::kZeros;
     if (op->type == "nn.Conv2d")
     {
         if (op->has_parameter("padding_mode"))
         {
-            auto padding_mode = std::dynamic_pointer_cast<RuntimeParameterString>(params.at("padding_mode"));
-            if (padding_mode == nullptr)
+            auto padding_mode_param = std::dynamic_pointer_cast<RuntimeParameterString>(params.at("padding_mode"));
+            if (padding_mode_param == nullptr)
             {
                 LOG(ERROR) << "Can not find the padding parameter";
                 return StatusCode::kParseParamError;
             }
             else
             {
-                const std::string& padding_mode_str = padding_mode->value;
-                if (padding_mode_str != "zeros")
+                const std::string& padding_mode_str = padding_mode_param->value;
+                if (!ParsePaddingMode(padding_mode_str, padding_mode))
                 {
                     LOG(ERROR) << "Padding mode unsupported: " << padding_mode_str;
                     return StatusCode::kParseParamError;
@@ -360,8 +792,37 @@ StatusCode BaseConvolutionLayer::CreateInstance(const std::shared_ptr<RuntimeOpe
         return StatusCode::kParseParamError;
     }
 
-    if (conv_type == ConvType::kOpConv)
+    const bool use_int8 = UseInt8Convolution(op);
+    // only the float im2col convolution packs half precision kernels
+    bool half_kernels = false;
+    utils::Bf16Kernel bf16_kernel = utils::Bf16Kernel::kEmulated;
+    if (op->compute_precision != ComputePrecision::kFloat32 && !UseBf16Convolution(op, bf16_kernel))
+    {
+        LOG(INFO) << "The convolution " << op->name << " keeps float32, there is no bf16 kernel for it";
+    }
+    if (use_int8)
+    {
+        conv_layer = std::make_shared<QuantizedConvolutionLayer>(
+            out_channel->value, in_channel->value, kernels.at(0), kernels.at(1), paddings.at(0), paddings.at(1),
+            strides.at(0), strides.at(1), groups->value, use_bias->value, dilation_h, dilation_w,
+            FloatParameter(op, "input_scale", 0.f), BoolParameter(op, "input_quantized", false),
+            FloatParameter(op, "output_scale", 0.f));
+    }
+    else if (UseBf16Convolution(op, bf16_kernel))
+    {
+        conv_layer = std::make_shared<Bf16ConvolutionLayer>(
+            out_channel->value, in_channel->value, kernels.at(0), kernels.at(1), paddings.at(0), paddings.at(1),
+            strides.at(0), strides.at(1), groups->value, use_bias->value, dilation_h, dilation_w, bf16_kernel);
+    }
+    else if (UseDirectConvolution(op))
+    {
+        conv_layer = std::make_shared<DirectConvolutionLayer>(
+            out_channel->value, in_channel->value, kernels.at(0), kernels.at(1), paddings.at(0), paddings.at(1),
+            strides.at(0), strides.at(1), groups->value, use_bias->value, dilation_h, dilation_w);
+    }
+    else if (conv_type == ConvType::kOpConv)
     {
+        half_kernels = true;
         conv_layer = std::make_shared<ConvolutionLayer>(out_channel->value, in_channel->value, kernels.at(0),
                                                         kernels.at(1), paddings.at(0), paddings.at(1), strides.at(0),
                                                         strides.at(1), groups->value, use_bias->value, output_padding_h,
@@ -375,6 +836,13 @@ StatusCode BaseConvolutionLayer::CreateInstance(const std::shared_ptr<RuntimeOpe
                                                           output_padding_h, output_padding_w, dilation_h, dilation_w);
     }
 
+    if (padding_mode != PaddingMode::kZeros)
+    {
+        auto base_layer = std::dynamic_pointer_cast<BaseConvolutionLayer>(conv_layer);
+        CHECK(base_layer != nullptr);
+        base_layer->set_padding_mode(padding_mode);
+    }
+
     const std::map<std::string, std::shared_ptr<RuntimeAttribute>>& attrs = op->attribute;
     if (use_bias->value)
     {
@@ -409,12 +877,51 @@ StatusCode BaseConvolutionLayer::CreateInstance(const std::shared_ptr<RuntimeOpe
         return StatusCode::kParseWeightError;
     }
 
-    const std::vector<float>& weight_values = weight->get<float>();
-    conv_layer->set_weights(weight_values);
+    if (weight->type == RuntimeDataType::kTypeInt8)
+    {
+        if (!op->has_attribute("weight_scales"))
+        {
+            LOG(ERROR) << "Can not find the weight_scales attribute of the int8 weights";
+            return StatusCode::kParseWeightError;
+        }
+        const auto& weight_scales = attrs.at("weight_scales");
+        const std::vector<float>& scales = weight_scales->get<float>();
+        if (scales.size() != 1 && scales.size() != size_t(out_channel->value))
+        {
+            LOG(ERROR) << "The int8 weights need one scale or one per output channel";
+            return StatusCode::kParseWeightError;
+        }
+
+        const std::vector<int8_t>& weight_levels = weight->get<int8_t>();
+        if (use_int8)
+        {
+            auto quantized_layer = std::dynamic_pointer_cast<QuantizedConvolutionLayer>(conv_layer);
+            CHECK(quantized_layer != nullptr);
+            quantized_layer->set_quantized_weights(weight_levels, scales);
+        }
+        else
+        {
+            LOG(INFO) << "The int8 weights of " << op->name << " are dequantized for the float kernels";
+            conv_layer->set_weights(utils::DequantizeConvWeightsInt8(
+                weight_levels, scales, weight_shape, conv_type == ConvType::kOpDeconv, groups->value));
+        }
+    }
+    else if (weight->type == RuntimeDataType::kTypeFloat16 && half_kernels)
+    {
+        // the half values are packed as they are, the float kernels are never built
+        auto float_conv_layer = std::dynamic_pointer_cast<BaseConvolutionLayer>(conv_layer);
+        CHECK(float_conv_layer != nullptr);
+        float_conv_layer->set_fp16_weights(weight->get<uint16_t>());
+    }
+    else
+    {
+        const std::vector<float>& weight_values = weight->get<float>();
+        conv_layer->set_weights(weight_values);
+    }
 
     auto conv_layer_derived = std::dynamic_pointer_cast<BaseConvolutionLayer>(conv_layer);
     CHECK(conv_layer_derived != nullptr);
-    conv_layer_derived->InitIm2ColWeight();
+    conv_layer_derived->PackWeights();
 
     return StatusCode::kSuccess;
 }
@@ -450,14 +957,15 @@ StatusCode BaseConvolutionLayer::Check(const std::vector<sftensor>& inputs, cons
         return StatusCode::kInferDimMismatch;
     }
 
-    if (weights_.empty())
+    // the float kernels are released by the layers that pack their own copy
+    if (weights_.empty() && !weights_packed_)
     {
         LOG(ERROR) << "The number of kernel matrix in the convolution layer should "
                       "be greater than zero";
         return StatusCode::kInferParamError;
     }
 
-    if (this->use_bias_ && this->bias_.size() != this->weights_.size())
+    if (this->use_bias_ && this->bias_.size() != this->kernel_count_)
     {
         LOG(ERROR) << "The number of kernel matrix and bias matrix do not match";
         return StatusCode::kInferParamError;
@@ -493,7 +1001,7 @@ StatusCode BaseConvolutionLayer::Check(const std::vector<sftensor>& inputs, cons
         }
     }
 
-    const uint32_t kernel_count = this->weights_.size();
+    const uint32_t kernel_count = this->kernel_count_;
     if (!kernel_count)
     {
         LOG(ERROR) << "The size of kernel matrix in the convolution layer should be greater "
@@ -501,9 +1009,9 @@ StatusCode BaseConvolutionLayer::Check(const std::vector<sftensor>& inputs, cons
         return StatusCode::kInferParamError;
     }
 
-    const uint32_t kernel_h = this->weights_.at(0)->rows();
-    const uint32_t kernel_w = this->weights_.at(0)->cols();
-    const uint32_t kernel_channel = this->weights_.at(0)->channels();
+    const uint32_t kernel_h = this->kernel_h_;
+    const uint32_t kernel_w = this->kernel_w_;
+    const uint32_t kernel_channel = this->kernel_channel_;
 
     if (!kernel_h || !kernel_w || !kernel_channel)
     {
@@ -512,7 +1020,11 @@ StatusCode BaseConvolutionLayer::Check(const std::vector<sftensor>& inputs, cons
         return StatusCode::kInferParamError;
     }
 
-    for (uint32_t k = 0; k < kernel_count; ++k)
+    if (!weights_.empty() && weights_.size() != kernel_count)
+    {
+        return StatusCode::kInferParamError;
+    }
+    for (uint32_t k = 0; k < weights_.size(); ++k)
     {
         const std::shared_ptr<Tensor<float>>& kernel = this->weights_.at(k);
         if (kernel->rows() != kernel_h)
@@ -1,5 +1,7 @@
 #ifndef KUIPER_INFER_SOURCE_LAYER_DETAILS_BASE_CONVOLUTION_H
 #define KUIPER_INFER_SOURCE_LAYER_DETAILS_BASE_CONVOLUTION_H
+#include "layer/abstract/layer_cost.hpp"
+#include "layer/abstract/layer_scratch.hpp"
 #include "layer/abstract/param_layer.hpp"
 namespace black_scholes
 {
@@ -10,6 +12,18 @@ enum class ConvType
     kOpDeconv = 1, 
 };
 
+/**
+ * @brief Values read by the kernel taps falling outside the input
+ */
+enum class PaddingMode
+{
+    kZeros = 0,
+    /// Mirrored about the border without repeating it, the padding must be smaller than the input
+    kReflect = 1,
+    /// The nearest border value
+    kReplicate = 2,
+};
+
 class BaseConvolutionLayer : public ParamLayer
 {
    public:
@@ -22,6 +36,10 @@ class BaseConvolutionLayer : public ParamLayer
     static StatusCode CreateInstance(const std::shared_ptr<RuntimeOperator>& op,
                                      std::shared_ptr<Layer<float>>& conv_layer);
 
+    static utils::LayerCost EstimateCost(const std::shared_ptr<RuntimeOperator>& op);
+
+    static size_t ScratchBytes(const std::shared_ptr<RuntimeOperator>& op);
+
     StatusCode Forward(const std::vector<std::shared_ptr<Tensor<float>>>& inputs,
                        std::vector<std::shared_ptr<Tensor<float>>>& outputs) override;
 
@@ -33,15 +51,85 @@ class BaseConvolutionLayer : public ParamLayer
     virtual std::pair<uint32_t, uint32_t> ComputeOutputSize(uint32_t input_h, uint32_t input_w, uint32_t kernel_h,
                                                             uint32_t kernel_w) const = 0;
 
+    /**
+     * @brief Whether Forward computes every group once for the whole batch with ComputeBatchOutput
+     *
+     * Asked only for batches of images of one shape.
+     */
+    virtual bool UseBatchOutput(uint32_t batch_size, uint32_t output_h, uint32_t output_w) const;
+
+    /**
+     * @brief Computes one group of every image of the batch, the outputs are already allocated
+     */
+    virtual void ComputeBatchOutput(const std::vector<sftensor>& inputs, const std::vector<sftensor>& outputs,
+                                    uint32_t kernel_h, uint32_t kernel_w, uint32_t kernel_count_group,
+                                    uint32_t input_h, uint32_t input_w, uint32_t channels_per_group,
+                                    uint32_t output_h, uint32_t output_w, uint32_t group) const;
+
+    /**
+     * @brief Allocates the output of an image when it is missing and checks its shape
+     */
+    static const sftensor& PrepareOutput(std::vector<sftensor>& outputs, uint32_t index, uint32_t kernel_count,
+                                         uint32_t output_h, uint32_t output_w);
+
    public:
     StatusCode Check(const std::vector<sftensor>& inputs, const std::vector<sftensor>& outputs);
 
+    /**
+     * @brief Keeps the packed kernels in half precision, widened to float when a GEMM packs them
+     *
+     * Set for float16 models instead of set_weights, the half values are
+     * laid out for the GEMM as they are and the float kernels are released,
+     * so the layer holds half the memory and reads half the bandwidth. Only
+     * the float im2col convolution reads half precision kernels.
+     *
+     * @param weight_values Half precision values in the order of the weight attribute
+     */
+    void set_fp16_weights(const std::vector<uint16_t>& weight_values);
+
+    /**
+     * @brief Sets the values of the padding, only the float convolution reads other than kZeros
+     */
+    void set_padding_mode(PaddingMode padding_mode);
+
+    /**
+     * @brief Computes with the packed kernels of an identical layer and releases its own
+     *
+     * @return False if the replica is not a layer of the same type and shape
+     */
+    bool ShareWeights(const std::shared_ptr<ParamLayer>& replica) override;
+
+    /**
+     * @brief Visits the packed kernels owned by the layer, nothing once they are shared
+     */
+    void ForEachWeightRegion(const std::function<void(const void*, size_t)>& visit) const override;
+
    private:
     virtual void InitIm2ColWeight();
 
+    /**
+     * @brief Runs InitIm2ColWeight once, the packed kernels are reused by every Forward
+     */
+    void PackWeights();
+
    protected:
     void AddBias(arma::fmat& output, uint32_t bias_index) const;
 
+    /**
+     * @brief Frees the float kernels once the layer holds its own packed copy
+     */
+    void ReleaseWeights();
+
+    /**
+     * @brief Frees the packed kernels, Forward then computes with those of kernel_source_
+     */
+    virtual void ReleaseKernels();
+
+    /**
+     * @brief Gets the bias of an output channel, zero when the layer has none
+     */
+    float BiasValue(uint32_t bias_index) const;
+
    protected:
     uint32_t groups_ = 1;
     bool use_bias_ = false;
@@ -57,8 +145,22 @@ class BaseConvolutionLayer : public ParamLayer
     uint32_t dilation_h_ = 1;
     uint32_t dilation_w_ = 1;
 
+    /// Shape of the kernels, kept when the float kernels are released
+    uint32_t kernel_count_ = 0;
+    uint32_t kernel_channel_ = 0;
+    uint32_t kernel_h_ = 0;
+    uint32_t kernel_w_ = 0;
+
+    PaddingMode padding_mode_ = PaddingMode::kZeros;
     ConvType conv_type_ = ConvType::kOpConvUnknown;
     std::vector<arma::fmat> kernel_matrix_arr_;
+    /// Half precision kernels replacing kernel_matrix_arr_ when fp16_weights_ is set
+    std::vector<uint16_t> fp16_kernel_matrix_;
+    utils::TrackedMemory kernel_matrix_memory_;
+    /// Layer whose packed kernels Forward computes with, set when they are shared
+    std::shared_ptr<const BaseConvolutionLayer> kernel_source_;
+    bool fp16_weights_ = false;
+    bool weights_packed_ = false;
 };
 }  // namespace black_scholes
 #endif
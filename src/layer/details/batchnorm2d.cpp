@@ -3,6 +3,8 @@
 
 #include "layer/abstract/layer_factory.hpp"
 #include "runtime/runtime_ir.hpp"
+#include "utils/memory/scratch_arena.hpp"
+#include "utils/parallel/parallel_utils.hpp"
 
 namespace block_scholes
 {
@@ -51,7 +53,6 @@ StatusCode BatchNorm2dLayer::Forward(const std::vector<std::shared_ptr<Tensor<fl
         return StatusCode::kInferParamError;
     }
     const uint32_t batch_size = inputs.size();
-#pragma omp parallel for num_threads(batch_size)
     for (uint32_t b = 0; b < batch_size; ++b)
     {
         const auto& input = inputs.at(b);
@@ -69,18 +70,48 @@ StatusCode BatchNorm2dLayer::Forward(const std::vector<std::shared_ptr<Tensor<fl
         CHECK(output->shapes() == input->shapes()) << "The input and output tensor shapes of the batchnorm2d "
                                                       "layer do not match "
                                                    << b << " th";
-
-        for (uint32_t i = 0; i < mean_value_size; ++i)
+        CHECK(input->channels() >= mean_value_size) << "In the batchnorm2d layer, too few channels for input tensor "
+                                                    << b << " th";
+        CHECK(input->plane_size() == inputs.front()->plane_size());
+    }
+
+    // fold (x - mean) / sqrt(var + eps) * weight + bias into x * scale + shift
+    utils::ScratchFrame scratch_frame;
+    float* channel_scale = scratch_frame.Allocate<float>(mean_value_size);
+    float* channel_shift = scratch_frame.Allocate<float>(mean_value_size);
+    for (uint32_t i = 0; i < mean_value_size; ++i)
+    {
+        CHECK(weights_.at(i)->size() == 1 && bias_.at(i)->size() == 1);
+        const float mean_value = weights_.at(i)->index(0);
+        const float var_value = std::sqrt(bias_.at(i)->index(0) + eps_);
+        channel_scale[i] = affine_weight_.at(i) / var_value;
+        channel_shift[i] = affine_bias_.at(i) - mean_value * channel_scale[i];
+    }
+
+    // partition the whole batch as one flat range over (batch, channel, plane)
+    const size_t plane_size = inputs.front()->plane_size();
+    const size_t image_size = plane_size * mean_value_size;
+    utils::ParallelForRange(image_size * batch_size, [&](size_t begin, size_t end) {
+        size_t pos = begin;
+        while (pos < end)
         {
-            CHECK(weights_.at(i)->size() == 1 && bias_.at(i)->size() == 1);
-            const float mean_value = weights_.at(i)->index(0);
-            CHECK(input->channels() > i) << "In the batchnorm2d layer, too few channels for input tensor " << b
-                                         << " th";
-
-            const float var_value = std::sqrt(bias_.at(i)->index(0) + eps_);
-            output->slice(i) = ((input->slice(i) - mean_value) / var_value) * affine_weight_.at(i) + affine_bias_.at(i);
+            const uint32_t b = uint32_t(pos / image_size);
+            const size_t image_pos = pos - b * image_size;
+            const uint32_t c = uint32_t(image_pos / plane_size);
+            const size_t plane_pos = image_pos - c * plane_size;
+            const size_t count = std::min(end - pos, plane_size - plane_pos);
+
+            const float scale = channel_scale[c];
+            const float shift = channel_shift[c];
+            const float* input_ptr = inputs[b]->raw_ptr() + c * plane_size + plane_pos;
+            float* output_ptr = outputs[b]->raw_ptr() + c * plane_size + plane_pos;
+            for (size_t j = 0; j < count; ++j)
+            {
+                output_ptr[j] = input_ptr[j] * scale + shift;
+            }
+            pos += count;
         }
-    }
+    });
     return StatusCode::kSuccess;
 }
 
@@ -185,6 +216,31 @@ BatchNorm2dLayer::BatchNorm2dLayer(uint32_t num_features, float eps, std::vector
     this->InitBiasParam(num_features, 1, 1, 1);
 }
 
+utils::LayerCost BatchNorm2dLayer::EstimateCost(const std::shared_ptr<RuntimeOperator>& op)
+{
+    // the folded scale and shift are one multiply-add per element
+    utils::LayerCost cost = LayerCostRegisterer::ElementwiseCost(op, 2.);
+    const auto& input_operands = op->input_operands_seq;
+    if (!input_operands.empty() && input_operands.front()->shapes.size() > 1)
+    {
+        cost.bytes += 2. * input_operands.front()->shapes.at(1) * sizeof(float);
+    }
+    return cost;
+}
+
+size_t BatchNorm2dLayer::ScratchBytes(const std::shared_ptr<RuntimeOperator>& op)
+{
+    // the folded scale and shift of every channel
+    const auto& input_operands = op->input_operands_seq;
+    if (input_operands.empty() || input_operands.front()->shapes.size() < 2)
+    {
+        return 0;
+    }
+    return 2 * (size_t(input_operands.front()->shapes.at(1)) * sizeof(float) + utils::ScratchArena::kAlignment);
+}
+
 LayerRegistererWrapper kBatchNorm2dCreateInstance(BatchNorm2dLayer::CreateInstance, "nn.BatchNorm2d");
+LayerCostRegistererWrapper kBatchNorm2dCost(BatchNorm2dLayer::EstimateCost, "nn.BatchNorm2d");
+LayerScratchRegistererWrapper kBatchNorm2dScratch(BatchNorm2dLayer::ScratchBytes, "nn.BatchNorm2d");
 
 }  // namespace block_scholes
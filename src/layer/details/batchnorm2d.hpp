@@ -3,6 +3,8 @@
 #ifndef DL_SOURCE_LAYER_BATCHNORM2D_HPP_
 #define DL_SOURCE_LAYER_BATCHNORM2D_HPP_
 
+#include "layer/abstract/layer_cost.hpp"
+#include "layer/abstract/layer_scratch.hpp"
 #include "layer/abstract/param_layer.hpp"
 #include "runtime/runtime_op.hpp"
 
@@ -20,6 +22,10 @@ class BatchNorm2dLayer : public ParamLayer
     static StatusCode CreateInstance(const std::shared_ptr<RuntimeOperator>& op,
                                      std::shared_ptr<Layer<float>>& batch_layer);
 
+    static utils::LayerCost EstimateCost(const std::shared_ptr<RuntimeOperator>& op);
+
+    static size_t ScratchBytes(const std::shared_ptr<RuntimeOperator>& op);
+
    private:
     float eps_ = 1e-5f;
     std::vector<float> affine_weight_;
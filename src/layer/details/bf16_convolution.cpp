@@ -0,0 +1,121 @@
+
+#include "bf16_convolution.hpp"
+#include <glog/logging.h>
+#include <cstring>
+#include "utils/memory/scratch_arena.hpp"
+#include "utils/parallel/parallel_utils.hpp"
+
+namespace black_scholes {
+Bf16ConvolutionLayer::Bf16ConvolutionLayer(uint32_t output_channel, uint32_t in_channel,
+                                           uint32_t kernel_h, uint32_t kernel_w,
+                                           uint32_t padding_h, uint32_t padding_w,
+                                           uint32_t stride_h, uint32_t stride_w, uint32_t groups,
+                                           bool use_bias, uint32_t dilation_h, uint32_t dilation_w,
+                                           utils::Bf16Kernel bf16_kernel)
+    : ConvolutionLayer(output_channel, in_channel, kernel_h, kernel_w, padding_h, padding_w,
+                       stride_h, stride_w, groups, use_bias, 0, 0, dilation_h, dilation_w),
+      bf16_kernel_(bf16_kernel) {}
+
+void Bf16ConvolutionLayer::InitIm2ColWeight() {
+  const uint32_t kernel_count = this->weights_.size();
+  CHECK(kernel_count > 0) << "kernel count must greater than zero";
+  const uint32_t kernel_h = this->weights_.at(0)->rows();
+  const uint32_t kernel_w = this->weights_.at(0)->cols();
+  const uint32_t kernel_c = this->weights_.at(0)->channels();
+  const uint32_t kernel_count_group = kernel_count / groups_;
+  const uint32_t row_len = kernel_h * kernel_w;
+  const uint32_t depth = kernel_c * row_len;
+
+  // the channel matrices of the kernels are already in the (ic, kw, kh) order of the im2col rows
+  packed_weights_.resize(groups_);
+  size_t packed_bytes = 0;
+  std::vector<float> group_weights(size_t(kernel_count_group) * depth);
+  for (uint32_t group = 0; group < groups_; ++group) {
+    for (uint32_t kg = 0; kg < kernel_count_group; ++kg) {
+      const std::shared_ptr<Tensor<float>>& kernel =
+          this->weights_.at(group * kernel_count_group + kg);
+      CHECK(kernel->rows() == kernel_h && kernel->cols() == kernel_w &&
+            kernel->channels() == kernel_c);
+      for (uint32_t ic = 0; ic < kernel_c; ++ic) {
+        std::memcpy(group_weights.data() + size_t(kg) * depth + ic * row_len,
+                    kernel->matrix_raw_ptr(ic), row_len * sizeof(float));
+      }
+    }
+    packed_weights_.at(group) =
+        utils::PackBf16Matrix(group_weights.data(), kernel_count_group, depth, bf16_kernel_);
+    packed_bytes += packed_weights_.at(group).bytes();
+  }
+
+  bias_values_.resize(kernel_count);
+  for (uint32_t k = 0; k < kernel_count; ++k) {
+    bias_values_.at(k) = BiasValue(k);
+  }
+  kernel_matrix_memory_.Resize(packed_bytes + size_t(kernel_count) * sizeof(float));
+  LOG(INFO) << "Bf16 convolution uses the " << utils::Bf16KernelName(bf16_kernel_) << " kernel";
+}
+
+void Bf16ConvolutionLayer::ReleaseKernels() {
+  std::vector<utils::Bf16PackedMatrix>().swap(packed_weights_);
+  ConvolutionLayer::ReleaseKernels();
+}
+
+void Bf16ConvolutionLayer::ForEachWeightRegion(
+    const std::function<void(const void*, size_t)>& visit) const {
+  ConvolutionLayer::ForEachWeightRegion(visit);
+  for (const utils::Bf16PackedMatrix& packed : packed_weights_) {
+    visit(packed.data.data(), packed.data.size() * sizeof(uint16_t));
+  }
+}
+
+void Bf16ConvolutionLayer::ComputeOutput(sftensor input, sftensor output_tensor, uint32_t kernel_h,
+                                         uint32_t kernel_w, uint32_t kernel_count_group,
+                                         uint32_t input_h, uint32_t input_w,
+                                         uint32_t channels_per_group, uint32_t output_h,
+                                         uint32_t output_w, uint32_t group) const {
+  CHECK(group < packed_weights_.size());
+  const utils::Bf16PackedMatrix& packed = packed_weights_.at(group);
+  const uint32_t output_hw = output_h * output_w;
+
+  utils::ScratchFrame scratch_frame;
+  uint16_t* activations = scratch_frame.Allocate<uint16_t>(size_t(output_hw) * packed.padded_depth);
+  Bf16Im2Col(input, activations, kernel_h, kernel_w, input_h, input_w, channels_per_group,
+             output_h, output_w, group, packed.padded_depth);
+
+  const uint32_t kernel_offset = group * kernel_count_group;
+  utils::Bf16Gemm(packed, activations, output_hw, bias_values_.data() + kernel_offset,
+                  output_tensor->matrix_raw_ptr(kernel_offset), output_hw);
+}
+
+void Bf16ConvolutionLayer::Bf16Im2Col(const sftensor& input, uint16_t* activations,
+                                      uint32_t kernel_h, uint32_t kernel_w, uint32_t input_h,
+                                      uint32_t input_w, uint32_t channels_per_group,
+                                      uint32_t output_h, uint32_t output_w, uint32_t group,
+                                      uint32_t padded_depth) const {
+  CHECK(input && !input->empty()) << "The input tensor of the im2col function cannot be empty.";
+  const uint32_t depth = channels_per_group * kernel_h * kernel_w;
+  const uint32_t channels_offset = group * channels_per_group;
+
+  utils::ParallelFor(output_w, size_t(output_h) * padded_depth, [&](uint32_t w) {
+    for (uint32_t r = 0; r < output_h; ++r) {
+      uint16_t* row_ptr = activations + (size_t(w) * output_h + r) * padded_depth;
+      for (uint32_t ic = 0; ic < channels_per_group; ++ic) {
+        const float* input_channel_ptr = input->matrix_raw_ptr(ic + channels_offset);
+        for (uint32_t kw = 0; kw < kernel_w; ++kw) {
+          const int32_t iw = int32_t(w * stride_w_ + kw * dilation_w_) - int32_t(padding_w_);
+          const bool inside_w = iw >= 0 && iw < int32_t(input_w);
+          for (uint32_t kh = 0; kh < kernel_h; ++kh) {
+            const int32_t ih = int32_t(r * stride_h_ + kh * dilation_h_) - int32_t(padding_h_);
+            if (inside_w && ih >= 0 && ih < int32_t(input_h)) {
+              *row_ptr++ = utils::FloatToBf16(input_channel_ptr[size_t(iw) * input_h + ih]);
+            } else {
+              *row_ptr++ = 0;
+            }
+          }
+        }
+      }
+      // bf16 zeros, the padded weights are zero too
+      std::memset(row_ptr, 0, (padded_depth - depth) * sizeof(uint16_t));
+    }
+  });
+}
+}  // namespace black_scholes
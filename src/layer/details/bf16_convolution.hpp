@@ -0,0 +1,52 @@
+
+#ifndef DL_SOURCE_LAYER_BF16_CONVOLUTION_HPP_
+#define DL_SOURCE_LAYER_BF16_CONVOLUTION_HPP_
+#include "convolution.hpp"
+#include "utils/math/bf16_gemm.hpp"
+
+namespace black_scholes {
+/**
+ * @brief Convolution computed on bf16 operands with float accumulation
+ *
+ * The kernels are rounded to bf16 once when they are packed, the input is
+ * rounded while it is unfolded, so the GEMM streams half the bytes of the
+ * float convolution. The bias is added in float by the GEMM.
+ */
+class Bf16ConvolutionLayer : public ConvolutionLayer {
+ public:
+  /**
+   * @param bf16_kernel Kernel of the GEMM, kEmulated runs on any CPU
+   */
+  explicit Bf16ConvolutionLayer(uint32_t output_channel, uint32_t in_channel, uint32_t kernel_h,
+                                uint32_t kernel_w, uint32_t padding_h, uint32_t padding_w,
+                                uint32_t stride_h, uint32_t stride_w, uint32_t groups,
+                                bool use_bias, uint32_t dilation_h, uint32_t dilation_w,
+                                utils::Bf16Kernel bf16_kernel);
+
+ private:
+  void InitIm2ColWeight() override;
+
+  void ReleaseKernels() override;
+
+  void ForEachWeightRegion(
+      const std::function<void(const void*, size_t)>& visit) const override;
+
+  void ComputeOutput(sftensor input, sftensor output_tensor, uint32_t kernel_h, uint32_t kernel_w,
+                     uint32_t kernel_count_group, uint32_t input_h, uint32_t input_w,
+                     uint32_t channels_per_group, uint32_t output_h, uint32_t output_w,
+                     uint32_t group) const override;
+
+  /**
+   * @brief Unfolds the input patches of one group as bf16, one padded row per output pixel
+   */
+  void Bf16Im2Col(const sftensor& input, uint16_t* activations, uint32_t kernel_h,
+                  uint32_t kernel_w, uint32_t input_h, uint32_t input_w,
+                  uint32_t channels_per_group, uint32_t output_h, uint32_t output_w,
+                  uint32_t group, uint32_t padded_depth) const;
+
+  utils::Bf16Kernel bf16_kernel_ = utils::Bf16Kernel::kEmulated;
+  std::vector<utils::Bf16PackedMatrix> packed_weights_;
+};
+}  // namespace black_scholes
+
+#endif
@@ -1,6 +1,7 @@
 
 #include "cat.hpp"
 #include "layer/abstract/layer_factory.hpp"
+#include "utils/parallel/parallel_utils.hpp"
 
 namespace black_scholes
 {
@@ -19,7 +20,17 @@ StatusCode CatLayer::Forward(const std::vector<std::shared_ptr<Tensor<float>>>&
 
     const uint32_t output_size = outputs.size();
     const uint32_t packet_size = inputs.size() / output_size;
-#pragma omp parallel for num_threads(outputs.size())
+
+    // collect one contiguous copy per (output, input) pair first, then split
+    // the copies into blocks so a single output is filled by all threads
+    struct CopyRegion
+    {
+        const float* src;
+        float* dst;
+        size_t size;
+    };
+    std::vector<CopyRegion> copy_regions;
+    copy_regions.reserve(inputs.size());
     for (uint32_t i = 0; i < outputs.size(); ++i)
     {
         uint32_t copy_channel_offset = 0;
@@ -36,17 +47,46 @@ StatusCode CatLayer::Forward(const std::vector<std::shared_ptr<Tensor<float>>>&
                 output = std::make_shared<Tensor<float>>(in_channels * packet_size, in_rows, in_cols);
                 outputs.at(i) = output;
             }
-            CHECK(output->channels() == in_channels * packet_size && output->rows() == in_rows &&
-                  output->cols() == in_cols)
+            CHECK(output->rows() == in_rows && output->cols() == in_cols &&
+                  copy_channel_offset + in_channels <= output->channels())
                 << "The output tensor array in the cat layer "
                    "has an incorrectly sized tensor "
                 << i << " th";
 
             const uint32_t plane_size = in_rows * in_cols;
-            memcpy(output->raw_ptr(copy_channel_offset * plane_size), input->raw_ptr(),
-                   sizeof(float) * plane_size * in_channels);
+            copy_regions.push_back({input->raw_ptr(), output->raw_ptr(copy_channel_offset * plane_size),
+                                    size_t(plane_size) * in_channels});
             copy_channel_offset += input->channels();
         }
+        CHECK(copy_channel_offset == output->channels()) << "The output tensor array in the cat layer "
+                                                            "has an incorrectly sized tensor "
+                                                         << i << " th";
+    }
+
+    size_t max_region_size = 0;
+    size_t total_size = 0;
+    for (const CopyRegion& region : copy_regions)
+    {
+        max_region_size = std::max(max_region_size, region.size);
+        total_size += region.size;
+    }
+
+    if (utils::ShouldParallel(max_region_size))
+    {
+        for (const CopyRegion& region : copy_regions)
+        {
+            utils::ParallelForRange(region.size, [&region](size_t begin, size_t end) {
+                memcpy(region.dst + begin, region.src + begin, sizeof(float) * (end - begin));
+            });
+        }
+    }
+    else
+    {
+        const uint32_t region_count = copy_regions.size();
+        utils::ParallelFor(region_count, total_size / region_count, [&copy_regions](uint32_t r) {
+            const CopyRegion& region = copy_regions.at(r);
+            memcpy(region.dst, region.src, sizeof(float) * region.size);
+        });
     }
     return StatusCode::kSuccess;
 }
@@ -121,5 +161,12 @@ StatusCode CatLayer::Check(const std::vector<sftensor>& inputs, const std::vecto
     return StatusCode::kSuccess;
 }
 
+utils::LayerCost CatLayer::EstimateCost(const std::shared_ptr<RuntimeOperator>& op)
+{
+    // a pure copy
+    return LayerCostRegisterer::ElementwiseCost(op, 0.);
+}
+
 LayerRegistererWrapper kCatCreateInstance(CatLayer::CreateInstance, "torch.cat");
+LayerCostRegistererWrapper kCatCost(CatLayer::EstimateCost, "torch.cat");
 }  // namespace black_scholes
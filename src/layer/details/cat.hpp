@@ -2,6 +2,7 @@
 
 #ifndef DL_SOURCE_LAYER_DETAILS_CAT_HPP_
 #define DL_SOURCE_LAYER_DETAILS_CAT_HPP_
+#include "layer/abstract/layer_cost.hpp"
 #include "layer/abstract/non_param_layer.hpp"
 namespace black_scholes
 {
@@ -18,6 +19,8 @@ class CatLayer : public NonParamLayer
     static StatusCode CreateInstance(const std::shared_ptr<RuntimeOperator>& op,
                                      std::shared_ptr<Layer<float>>& cat_layer);
 
+    static utils::LayerCost EstimateCost(const std::shared_ptr<RuntimeOperator>& op);
+
    private:
     int32_t dim_ = 0;
 };
@@ -2,10 +2,75 @@
 
 #include "convolution.hpp"
 #include <glog/logging.h>
+#include <algorithm>
 #include "layer/abstract/layer_factory.hpp"
 #include "utils/math/fmath.hpp"
+#include "utils/math/gemm_backend.hpp"
+#include "utils/math/half.hpp"
+#include "utils/memory/scratch_arena.hpp"
+#include "utils/parallel/parallel_utils.hpp"
 
 namespace black_scholes {
+/// Fraction of zero weights from which the sparse GEMM beats the dense one
+constexpr float kSparseWeightThreshold = 0.7f;
+/// Output pixels up to which the images of a batch are folded into one GEMM
+constexpr uint32_t kBatchFoldMaxPixels = 256;
+/// Columns of a folded GEMM, bounds its unfolded input to the size of one 45x45 image
+constexpr uint32_t kBatchFoldColumns = 2048;
+/// Bytes of one im2col tile, it stays in L2 until the GEMM has consumed it
+constexpr size_t kIm2ColTileBytes = 256 * 1024;
+/// Fewest output pixels of a tile, below it the GEMM repacks the kernels too often
+constexpr uint32_t kIm2ColMinTileColumns = 64;
+
+/**
+ * @brief Gets the outputs [begin, end) whose kernel tap reads inside the input
+ *
+ * @param offset Position of the tap relative to the first input of the output, padding removed
+ */
+static std::pair<uint32_t, uint32_t> TapInsideRange(int32_t offset, uint32_t stride,
+                                                    uint32_t input_size, uint32_t output_size) {
+  const int32_t last = int32_t(input_size) - 1 - offset;
+  if (last < 0) {
+    return {0, 0};
+  }
+  const uint32_t begin = offset < 0 ? uint32_t(-offset + int32_t(stride) - 1) / stride : 0;
+  const uint32_t end = std::min(uint32_t(last) / stride + 1, output_size);
+  return {std::min(begin, end), end};
+}
+
+/**
+ * @brief Maps a padded input position to the input, -1 for a zero
+ */
+static int32_t PaddedIndex(int32_t index, int32_t size, PaddingMode padding_mode) {
+  if (index >= 0 && index < size) {
+    return index;
+  }
+  switch (padding_mode) {
+    case PaddingMode::kReflect:
+      return index < 0 ? -index : 2 * (size - 1) - index;
+    case PaddingMode::kReplicate:
+      return index < 0 ? 0 : size - 1;
+    default:
+      return -1;
+  }
+}
+
+uint32_t ConvolutionLayer::Im2ColTileColumns(uint32_t depth, uint32_t output_hw) {
+  const size_t fitting_columns = kIm2ColTileBytes / (std::max(depth, 1u) * sizeof(float));
+  const uint32_t tile_columns =
+      std::max(uint32_t(fitting_columns / 32 * 32), kIm2ColMinTileColumns);
+  return std::min(tile_columns, std::max(output_hw, 1u));
+}
+
+uint32_t ConvolutionLayer::BatchFoldImages(uint32_t batch_size, uint32_t output_h,
+                                           uint32_t output_w) {
+  const uint32_t output_hw = output_h * output_w;
+  if (batch_size <= 1 || output_hw == 0 || output_hw > kBatchFoldMaxPixels) {
+    return 1;
+  }
+  return std::min(batch_size, std::max(kBatchFoldColumns / output_hw, 1u));
+}
+
 bool ConvolutionLayer::Is1x1KernelNoPadding(uint32_t kernel_h, uint32_t kernel_w) const {
   if (stride_h_ == 1 && stride_w_ == 1 && dilation_h_ == 1 && dilation_w_ == 1 && kernel_w == 1 &&
       kernel_h == 1) {
@@ -17,44 +82,119 @@ bool ConvolutionLayer::Is1x1KernelNoPadding(uint32_t kernel_h, uint32_t kernel_w
 }
 
 void ConvolutionLayer::InitIm2ColWeight() {
-  const uint32_t kernel_count = this->weights_.size();
+  const uint32_t kernel_count = this->kernel_count_;
   CHECK(kernel_count > 0) << "kernel count must greater than zero";
-  const uint32_t kernel_h = this->weights_.at(0)->rows();
-  const uint32_t kernel_w = this->weights_.at(0)->cols();
-  const uint32_t kernel_c = this->weights_.at(0)->channels();
+  const uint32_t kernel_h = this->kernel_h_;
+  const uint32_t kernel_w = this->kernel_w_;
+  const uint32_t kernel_c = this->kernel_channel_;
   const uint32_t row_len = kernel_h * kernel_w;
   CHECK(kernel_h > 0 && kernel_w > 0 && kernel_c > 0)
       << "The size of kernel matrix should be greater than zero";
 
+  bias_values_.resize(kernel_count);
+  for (uint32_t k = 0; k < kernel_count; ++k) {
+    bias_values_.at(k) = BiasValue(k);
+  }
+
+  if (fp16_weights_) {
+    // set_fp16_weights laid the half kernels out as the row-major A operand of every group, the
+    // GEMM widens them while it packs its panels
+    const size_t kernel_size = size_t(row_len) * kernel_c;
+    CHECK(fp16_kernel_matrix_.size() == kernel_count * kernel_size);
+    const size_t zeros = std::count_if(fp16_kernel_matrix_.begin(), fp16_kernel_matrix_.end(),
+                                       [](uint16_t value) { return (value & 0x7fff) == 0; });
+    const float sparsity = float(double(zeros) / double(fp16_kernel_matrix_.size()));
+    if (sparsity >= kSparseWeightThreshold) {
+      std::vector<float> kernels(fp16_kernel_matrix_.size());
+      utils::HalfToFloat(fp16_kernel_matrix_.data(), kernels.data(), kernels.size());
+      InitSparseWeight(kernels.data(), kernel_size, sparsity);
+      return;
+    }
+    kernel_matrix_arr_.clear();
+    kernel_matrix_memory_.Resize(fp16_kernel_matrix_.size() * sizeof(uint16_t));
+    return;
+  }
+
+  CHECK(this->weights_.size() == kernel_count);
   for (uint32_t k = 0; k < kernel_count; ++k) {
     const std::shared_ptr<Tensor<float>>& kernel = this->weights_.at(k);
     CHECK(kernel->rows() == kernel_h);
     CHECK(kernel->cols() == kernel_w);
     CHECK(kernel->channels() == kernel_c);
   }
-
-  kernel_matrix_arr_.resize(kernel_count);
-  for (uint32_t k = 0; k < kernel_count; ++k) {
-    arma::fmat kernel_matrix_c;
-    if (Is1x1KernelNoPadding(kernel_h, kernel_w)) {
-      kernel_matrix_c = arma::fmat(row_len * kernel_c, 1);
-    } else {
-      kernel_matrix_c = arma::fmat(1, row_len * kernel_c);
+  double zeros = 0;
+  size_t weight_count = 0;
+  for (const std::shared_ptr<Tensor<float>>& kernel : this->weights_) {
+    zeros += double(utils::WeightSparsity(kernel->raw_ptr(), kernel->size())) * kernel->size();
+    weight_count += kernel->size();
+  }
+  const float sparsity = float(zeros / double(weight_count));
+  if (sparsity >= kSparseWeightThreshold) {
+    // every kernel is one row of the sparse operand, its channels one after the other
+    const size_t kernel_size = size_t(row_len) * kernel_c;
+    std::vector<float> kernels(kernel_count * kernel_size);
+    for (uint32_t k = 0; k < kernel_count; ++k) {
+      const std::shared_ptr<Tensor<float>>& kernel = this->weights_.at(k);
+      for (uint32_t ic = 0; ic < kernel_c; ++ic) {
+        memcpy(kernels.data() + k * kernel_size + ic * row_len, kernel->matrix_raw_ptr(ic),
+               row_len * sizeof(float));
+      }
     }
-    const std::shared_ptr<Tensor<float>>& kernel = this->weights_.at(k);
-    for (uint32_t ic = 0; ic < kernel->channels(); ++ic) {
-      memcpy(kernel_matrix_c.memptr() + row_len * ic, kernel->matrix_raw_ptr(ic),
-             row_len * sizeof(float));
+    InitSparseWeight(kernels.data(), kernel_size, sparsity);
+    return;
+  }
+
+  // one matrix per group, column kg holds the kernel of output channel kg, so the memory is the
+  // row-major (kernel_count_group, depth) operand of the GEMM
+  const uint32_t kernel_count_group = kernel_count / groups_;
+  kernel_matrix_arr_.resize(groups_);
+  for (uint32_t group = 0; group < groups_; ++group) {
+    arma::fmat kernel_matrix(row_len * kernel_c, kernel_count_group);
+    for (uint32_t kg = 0; kg < kernel_count_group; ++kg) {
+      const std::shared_ptr<Tensor<float>>& kernel =
+          this->weights_.at(group * kernel_count_group + kg);
+      for (uint32_t ic = 0; ic < kernel->channels(); ++ic) {
+        memcpy(kernel_matrix.colptr(kg) + row_len * ic, kernel->matrix_raw_ptr(ic),
+               row_len * sizeof(float));
+      }
     }
-    kernel_matrix_arr_.at(k) = kernel_matrix_c;
+    kernel_matrix_arr_.at(group) = std::move(kernel_matrix);
   }
+  kernel_matrix_memory_.Resize(size_t(kernel_count) * (row_len * kernel_c + 1) * sizeof(float));
+  CHECK(kernel_matrix_arr_.size() == groups_)
+      << "The number of kernel matrix and the number of groups do not match";
+}
 
-  if (groups_ == 1) {
-    CHECK(kernel_matrix_arr_.size() == kernel_count / groups_)
-        << "The number of kernel matrix and kernel_count_group do not match";
-  } else {
-    CHECK(kernel_matrix_arr_.size() == kernel_count)
-        << "The number of kernel matrix and kernel_count do not match";
+void ConvolutionLayer::InitSparseWeight(const float* kernels, uint32_t depth, float sparsity) {
+  const uint32_t kernel_count = this->kernel_count_;
+  const uint32_t kernel_count_group = kernel_count / groups_;
+  size_t packed_bytes = 0;
+  sparse_kernels_.resize(groups_);
+  for (uint32_t group = 0; group < groups_; ++group) {
+    sparse_kernels_.at(group) = utils::PackBlockedCsr(
+        kernels + size_t(group) * kernel_count_group * depth, kernel_count_group, depth);
+    packed_bytes += sparse_kernels_.at(group).bytes();
+  }
+
+  kernel_matrix_arr_.clear();
+  std::vector<uint16_t>().swap(fp16_kernel_matrix_);
+  fp16_weights_ = false;
+  kernel_matrix_memory_.Resize(packed_bytes + size_t(kernel_count) * sizeof(float));
+  LOG(INFO) << "Convolution weights are " << sparsity * 100.f << "% zeros, using the sparse GEMM";
+}
+
+void ConvolutionLayer::ReleaseKernels() {
+  std::vector<utils::BlockedCsrMatrix>().swap(sparse_kernels_);
+  std::vector<float>().swap(bias_values_);
+  BaseConvolutionLayer::ReleaseKernels();
+}
+
+void ConvolutionLayer::ForEachWeightRegion(
+    const std::function<void(const void*, size_t)>& visit) const {
+  BaseConvolutionLayer::ForEachWeightRegion(visit);
+  for (const utils::BlockedCsrMatrix& sparse_kernel : sparse_kernels_) {
+    visit(sparse_kernel.values.data(), sparse_kernel.values.size() * sizeof(float));
+    visit(sparse_kernel.columns.data(), sparse_kernel.columns.size() * sizeof(uint32_t));
   }
 }
 
@@ -64,76 +204,286 @@ void ConvolutionLayer::ComputeOutput(sftensor input, sftensor output_tensor, uin
                                      uint32_t channels_per_group, uint32_t output_h,
                                      uint32_t output_w, uint32_t group) const {
   bool is_1x1conv = Is1x1KernelNoPadding(kernel_h, kernel_w);
-  const arma::fmat& input_matrix =
-      ConvIm2Col(input, kernel_h, kernel_w, input_h, input_w, channels_per_group, output_h,
-                 output_w, group, kernel_h * kernel_w, output_h * output_w);
-#pragma omp parallel for
-  for (uint32_t k = 0; k < kernel_count_group; ++k) {
-    ConvGEMMBias(input_matrix, output_tensor, group, k, kernel_count_group, output_h, output_w,
-                 is_1x1conv);
+  if (!sparse_kernels_.empty()) {
+    // the sparse GEMM streams rows of output pixels, a 1x1 convolution reads them from the input
+    // channels
+    const uint32_t output_hw = output_h * output_w;
+    const uint32_t kernel_offset = group * kernel_count_group;
+    const float* bias = bias_values_.data() + kernel_offset;
+    float* output_ptr = output_tensor->matrix_raw_ptr(kernel_offset);
+    if (is_1x1conv) {
+      utils::SparseGemm(sparse_kernels_.at(group),
+                        input->matrix_raw_ptr(group * channels_per_group), output_hw, bias,
+                        output_ptr, output_hw);
+      return;
+    }
+    // the taps are unfolded over the same tiles of output pixels as the dense path, so the
+    // workspace stays the size of one tile
+    const uint32_t depth = channels_per_group * kernel_h * kernel_w;
+    const uint32_t tile_columns = Im2ColTileColumns(depth, output_hw);
+    for (uint32_t column_begin = 0; column_begin < output_hw; column_begin += tile_columns) {
+      utils::ScratchFrame tile_frame;
+      const uint32_t columns = std::min(tile_columns, output_hw - column_begin);
+      float* rows = tile_frame.Allocate<float>(size_t(columns) * depth);
+      SparseIm2Col(input, rows, kernel_h, kernel_w, input_h, input_w, channels_per_group,
+                   output_h, output_w, group, column_begin, columns);
+      utils::SparseGemm(sparse_kernels_.at(group), rows, columns, bias,
+                        output_ptr + column_begin, output_hw);
+    }
+    return;
+  }
+  const uint32_t row_len = kernel_h * kernel_w;
+  const uint32_t depth = channels_per_group * row_len;
+  const uint32_t output_hw = output_h * output_w;
+
+  // the output channels of the group are the rows of C, the output pixels its columns
+  const uint32_t kernel_offset = group * kernel_count_group;
+  float* output_ptr = output_tensor->matrix_raw_ptr(kernel_offset);
+  utils::SgemmEpilogue epilogue;
+  epilogue.bias = bias_values_.data() + kernel_offset;
+  if (is_1x1conv) {
+    // the input channels are the rows of B as they are
+    const arma::fmat& input_matrix =
+        ConvIm2Col(input, nullptr, kernel_h, kernel_w, input_h, input_w, channels_per_group,
+                   output_h, output_w, group, row_len, 0, output_hw);
+    KernelGemm(group, false, kernel_count_group, output_hw, depth, input_matrix.memptr(),
+               output_hw, output_ptr, output_hw, epilogue);
+    return;
+  }
+
+  // the im2col matrix is built one tile of output pixels at a time, each tile is consumed by the
+  // GEMM while it is still in L2 and the workspace stays the size of one tile
+  const uint32_t tile_columns = Im2ColTileColumns(depth, output_hw);
+  const uint32_t tiles = (output_hw + tile_columns - 1) / tile_columns;
+  const auto compute_tile = [&](uint32_t tile) {
+    utils::ScratchFrame tile_frame;
+    const uint32_t column_begin = tile * tile_columns;
+    const uint32_t columns = std::min(tile_columns, output_hw - column_begin);
+    float* tile_workspace = tile_frame.Allocate<float>(size_t(columns) * depth);
+    const arma::fmat& tile_matrix =
+        ConvIm2Col(input, tile_workspace, kernel_h, kernel_w, input_h, input_w,
+                   channels_per_group, output_h, output_w, group, row_len, column_begin, columns);
+    KernelGemm(group, true, kernel_count_group, columns, depth, tile_matrix.memptr(), depth,
+               output_ptr + column_begin, output_hw, epilogue);
+  };
+  // with enough tiles every thread works on its own, otherwise the tiles run in order and each
+  // one is split by im2col and the GEMM
+  if (tiles >= 2 * utils::ParallelThreadCount()) {
+    utils::ParallelFor(tiles, size_t(tile_columns) * depth, compute_tile);
+  } else {
+    for (uint32_t tile = 0; tile < tiles; ++tile) {
+      compute_tile(tile);
+    }
+  }
+}
+
+bool ConvolutionLayer::UseBatchOutput(uint32_t batch_size, uint32_t output_h,
+                                      uint32_t output_w) const {
+  // only the dense float kernels, the derived layers and the sparse path keep their own
+  const bool dense_kernels = !kernel_matrix_arr_.empty() || !fp16_kernel_matrix_.empty();
+  return dense_kernels && BatchFoldImages(batch_size, output_h, output_w) > 1;
+}
+
+void ConvolutionLayer::ComputeBatchOutput(const std::vector<sftensor>& inputs,
+                                          const std::vector<sftensor>& outputs, uint32_t kernel_h,
+                                          uint32_t kernel_w, uint32_t kernel_count_group,
+                                          uint32_t input_h, uint32_t input_w,
+                                          uint32_t channels_per_group, uint32_t output_h,
+                                          uint32_t output_w, uint32_t group) const {
+  const uint32_t batch_size = inputs.size();
+  const bool is_1x1conv = Is1x1KernelNoPadding(kernel_h, kernel_w);
+  const uint32_t row_len = kernel_h * kernel_w;
+  const uint32_t depth = channels_per_group * row_len;
+  const uint32_t output_hw = output_h * output_w;
+  const uint32_t fold_images = BatchFoldImages(batch_size, output_h, output_w);
+  const uint32_t kernel_offset = group * kernel_count_group;
+
+  utils::ScratchFrame scratch_frame;
+  const size_t max_columns = size_t(fold_images) * output_hw;
+  float* batch_matrix = scratch_frame.Allocate<float>(max_columns * depth);
+  float* batch_result = scratch_frame.Allocate<float>(max_columns * kernel_count_group);
+  utils::SgemmEpilogue epilogue;
+  epilogue.bias = bias_values_.data() + kernel_offset;
+
+  for (uint32_t first = 0; first < batch_size; first += fold_images) {
+    const uint32_t images = std::min(fold_images, batch_size - first);
+    const uint32_t columns = images * output_hw;
+    // image i owns the columns [i * output_hw, (i + 1) * output_hw): the im2col matrix keeps one
+    // output pixel per column, a 1x1 input is gathered into one row of columns per channel
+    for (uint32_t i = 0; i < images; ++i) {
+      const sftensor& input = inputs.at(first + i);
+      if (is_1x1conv) {
+        const float* input_ptr = input->matrix_raw_ptr(group * channels_per_group);
+        utils::ParallelFor(channels_per_group, output_hw, [&](uint32_t ic) {
+          std::copy(input_ptr + size_t(ic) * output_hw, input_ptr + size_t(ic + 1) * output_hw,
+                    batch_matrix + size_t(ic) * columns + size_t(i) * output_hw);
+        });
+      } else {
+        const arma::fmat& image_matrix =
+            ConvIm2Col(input, batch_matrix + size_t(i) * output_hw * depth, kernel_h, kernel_w,
+                       input_h, input_w, channels_per_group, output_h, output_w, group, row_len,
+                       0, output_hw);
+        CHECK(image_matrix.n_cols == output_hw);
+      }
+    }
+
+    KernelGemm(group, !is_1x1conv, kernel_count_group, columns, depth, batch_matrix,
+               is_1x1conv ? columns : depth, batch_result, columns, epilogue);
+
+    // scatter the columns of every image back to its output channels
+    utils::ParallelFor(images * kernel_count_group, output_hw, [&](uint32_t task) {
+      const uint32_t i = task / kernel_count_group;
+      const uint32_t kg = task % kernel_count_group;
+      const float* result_ptr = batch_result + size_t(kg) * columns + size_t(i) * output_hw;
+      std::copy(result_ptr, result_ptr + output_hw,
+                outputs.at(first + i)->matrix_raw_ptr(kernel_offset + kg));
+    });
   }
 }
 
-arma::fmat ConvolutionLayer::ConvIm2Col(sftensor input, uint32_t kernel_h, uint32_t kernel_w,
-                                        uint32_t input_h, uint32_t input_w,
-                                        uint32_t channels_per_group, uint32_t output_h,
-                                        uint32_t output_w, uint32_t group, uint32_t row_len,
+void ConvolutionLayer::KernelGemm(uint32_t group, bool transpose_b, uint32_t kernel_count_group,
+                                  uint32_t columns, uint32_t depth, const float* b, size_t ldb,
+                                  float* c, size_t ldc,
+                                  const utils::SgemmEpilogue& epilogue) const {
+  const utils::GemmBackend& backend = utils::GetGemmBackend();
+  if (!fp16_weights_) {
+    backend.Sgemm(false, transpose_b, kernel_count_group, columns, depth,
+                  kernel_matrix_arr_.at(group).memptr(), depth, b, ldb, c, ldc, epilogue);
+    return;
+  }
+  const size_t group_size = size_t(kernel_count_group) * depth;
+  backend.SgemmHalfA(false, transpose_b, kernel_count_group, columns, depth,
+                     fp16_kernel_matrix_.data() + group * group_size, depth, b, ldb, c, ldc,
+                     epilogue);
+}
+
+arma::fmat ConvolutionLayer::ConvIm2Col(sftensor input, float* im2col_workspace,
+                                        uint32_t kernel_h, uint32_t kernel_w, uint32_t input_h,
+                                        uint32_t input_w, uint32_t channels_per_group,
+                                        uint32_t output_h, uint32_t output_w, uint32_t group,
+                                        uint32_t row_len, uint32_t col_begin,
                                         uint32_t col_len) const {
   CHECK(input && !input->empty()) << "The input tensor of the im2col function cannot be empty.";
-  const float padding_value = 0.f;
   if (Is1x1KernelNoPadding(kernel_h, kernel_w)) {
-    arma::fmat input_matrix(input->raw_ptr(), col_len, channels_per_group * row_len, false, true);
+    arma::fmat input_matrix(input->matrix_raw_ptr(group * channels_per_group), col_len,
+                            channels_per_group * row_len, false, true);
     return input_matrix;
   }
 
+  CHECK(im2col_workspace != nullptr);
   const uint32_t channels_offset = group * channels_per_group;
-  arma::fmat input_matrix(channels_per_group * row_len, col_len);
-#pragma omp parallel for
-  for (uint32_t ic = 0; ic < channels_per_group; ++ic) {
-    float* input_channel_ptr = input->matrix_raw_ptr(ic + channels_offset);
-    uint32_t current_col = 0;
-    uint32_t channel_row = ic * row_len;
-    for (uint32_t w = 0, iw = 0; w < output_w; ++w, iw += stride_w_) {
-      for (uint32_t r = 0, ih = 0; r < output_h; ++r, ih += stride_h_) {
-        float* input_matrix_ptr = input_matrix.colptr(current_col) + channel_row;
-        for (uint32_t kw = 0; kw < kernel_w * dilation_w_; kw += dilation_w_) {
-          const uint32_t region_w = input_h * (iw + kw - padding_w_);
-          for (uint32_t kh = 0; kh < kernel_h * dilation_h_; kh += dilation_h_) {
-            if ((kh + ih >= padding_h_ && kw + iw >= padding_w_) &&
-                (kh + ih < input_h + padding_h_ && kw + iw < input_w + padding_w_)) {
-              float* region_ptr = input_channel_ptr + region_w + (ih + kh - padding_h_);
-              *input_matrix_ptr = *region_ptr;
-            } else {
-              *input_matrix_ptr = padding_value;  // only support zero mode
-            }
-            input_matrix_ptr++;
+  // outputs whose first and last taps are inside the input read it without any check, the
+  // border outputs map every tap through the padding mode
+  const uint32_t interior_h_begin =
+      TapInsideRange(-int32_t(padding_h_), stride_h_, input_h, output_h).first;
+  const uint32_t interior_w_begin =
+      TapInsideRange(-int32_t(padding_w_), stride_w_, input_w, output_w).first;
+  const int32_t span_h = int32_t((kernel_h - 1) * dilation_h_);
+  const int32_t span_w = int32_t((kernel_w - 1) * dilation_w_);
+  const uint32_t interior_h_end =
+      std::max(interior_h_begin, TapInsideRange(span_h - int32_t(padding_h_), stride_h_, input_h,
+                                       output_h).second);
+  const uint32_t interior_w_end =
+      std::max(interior_w_begin, TapInsideRange(span_w - int32_t(padding_w_), stride_w_, input_w,
+                                       output_w).second);
+
+  // every element is written below, the workspace needs no clearing
+  arma::fmat input_matrix(im2col_workspace, channels_per_group * row_len, col_len, false, true);
+  utils::ParallelFor(channels_per_group, size_t(row_len) * col_len, [&](uint32_t ic) {
+    const float* input_channel_ptr = input->matrix_raw_ptr(ic + channels_offset);
+    const uint32_t channel_row = ic * row_len;
+    uint32_t w = col_begin / output_h;
+    uint32_t r = col_begin % output_h;
+    for (uint32_t current_col = 0; current_col < col_len; ++current_col) {
+      const int32_t iw = int32_t(w * stride_w_) - int32_t(padding_w_);
+      const int32_t ih = int32_t(r * stride_h_) - int32_t(padding_h_);
+      float* input_matrix_ptr = input_matrix.colptr(current_col) + channel_row;
+      if (w >= interior_w_begin && w < interior_w_end && r >= interior_h_begin &&
+          r < interior_h_end) {
+        const float* region_ptr = input_channel_ptr + size_t(iw) * input_h + ih;
+        for (uint32_t kw = 0; kw < kernel_w; ++kw) {
+          const float* column_ptr = region_ptr + size_t(kw) * dilation_w_ * input_h;
+          for (uint32_t kh = 0; kh < kernel_h; ++kh) {
+            input_matrix_ptr[kh] = column_ptr[kh * dilation_h_];
           }
+          input_matrix_ptr += kernel_h;
         }
-        current_col += 1;
+      } else {
+        for (uint32_t kw = 0; kw < kernel_w; ++kw) {
+          const int32_t column =
+              PaddedIndex(iw + int32_t(kw * dilation_w_), int32_t(input_w), padding_mode_);
+          for (uint32_t kh = 0; kh < kernel_h; ++kh) {
+            const int32_t row =
+                PaddedIndex(ih + int32_t(kh * dilation_h_), int32_t(input_h), padding_mode_);
+            input_matrix_ptr[kh] = column < 0 || row < 0
+                                       ? 0.f
+                                       : input_channel_ptr[size_t(column) * input_h + row];
+          }
+          input_matrix_ptr += kernel_h;
+        }
+      }
+      if (++r == output_h) {
+        r = 0;
+        w += 1;
       }
     }
-  }
+  });
   return input_matrix;
 }
 
-void ConvolutionLayer::ConvGEMMBias(const arma::fmat& input_matrix, sftensor output_tensor,
-                                    uint32_t group, uint32_t kernel_index,
-                                    uint32_t kernel_count_group, uint32_t output_h,
-                                    uint32_t output_w, bool is_1x1conv_nopadding) const {
-  CHECK(!input_matrix.empty()) << "The input tensor of the gemm function cannot be empty.";
-  CHECK(output_tensor && !output_tensor->empty())
-      << "The output tensor of the gemm function cannot be empty.";
-
-  kernel_index = kernel_index + group * kernel_count_group;
-  const arma::fmat& kernel = this->kernel_matrix_arr_.at(kernel_index);
-
-  arma::fmat output(output_tensor->matrix_raw_ptr(kernel_index), output_h, output_w, false, true);
-  if (is_1x1conv_nopadding) {
-    output = input_matrix * kernel;
-  } else {
-    output = kernel * input_matrix;
-  }
-  return AddBias(output, kernel_index);
+void ConvolutionLayer::SparseIm2Col(const sftensor& input, float* rows, uint32_t kernel_h,
+                                    uint32_t kernel_w, uint32_t input_h, uint32_t input_w,
+                                    uint32_t channels_per_group, uint32_t output_h,
+                                    uint32_t output_w, uint32_t group, uint32_t col_begin,
+                                    uint32_t col_len) const {
+  CHECK(input && !input->empty()) << "The input tensor of the im2col function cannot be empty.";
+  CHECK(rows != nullptr);
+  CHECK_LE(size_t(col_begin) + col_len, size_t(output_h) * output_w);
+  const uint32_t row_len = kernel_h * kernel_w;
+  const uint32_t col_end = col_begin + col_len;
+  const uint32_t channels_offset = group * channels_per_group;
+  utils::ParallelFor(channels_per_group, size_t(row_len) * col_len, [&](uint32_t ic) {
+    const float* input_channel_ptr = input->matrix_raw_ptr(ic + channels_offset);
+    for (uint32_t kw = 0; kw < kernel_w; ++kw) {
+      for (uint32_t kh = 0; kh < kernel_h; ++kh) {
+        float* row_ptr = rows + (size_t(ic) * row_len + kw * kernel_h + kh) * col_len;
+        const int32_t offset_h = int32_t(kh * dilation_h_) - int32_t(padding_h_);
+        const int32_t offset_w = int32_t(kw * dilation_w_) - int32_t(padding_w_);
+        // the rows of the tap inside the input are copied without checks
+        const auto [inside_begin, inside_end] =
+            TapInsideRange(offset_h, stride_h_, input_h, output_h);
+        // the tile starts and ends inside output columns, [r_begin, r_end) is the part of column w
+        for (uint32_t w = col_begin / output_h; w < output_w && w * output_h < col_end; ++w) {
+          const uint32_t r_begin = std::max(col_begin, w * output_h) - w * output_h;
+          const uint32_t r_end = std::min(col_end, (w + 1) * output_h) - w * output_h;
+          float* col_ptr = row_ptr + (w * output_h + r_begin - col_begin);
+          const int32_t iw =
+              PaddedIndex(int32_t(w * stride_w_) + offset_w, int32_t(input_w), padding_mode_);
+          if (iw < 0) {
+            std::fill(col_ptr, col_ptr + (r_end - r_begin), 0.f);
+            continue;
+          }
+          const float* input_col_ptr = input_channel_ptr + size_t(iw) * input_h;
+          const uint32_t copy_begin = std::max(inside_begin, r_begin);
+          const uint32_t copy_end = std::max(std::min(inside_end, r_end), copy_begin);
+          for (uint32_t r = copy_begin; r < copy_end; ++r) {
+            col_ptr[r - r_begin] = input_col_ptr[int32_t(r * stride_h_) + offset_h];
+          }
+          const auto border_value = [&](uint32_t r) {
+            const int32_t ih =
+                PaddedIndex(int32_t(r * stride_h_) + offset_h, int32_t(input_h), padding_mode_);
+            return ih < 0 ? 0.f : input_col_ptr[ih];
+          };
+          for (uint32_t r = r_begin; r < std::min(inside_begin, r_end); ++r) {
+            col_ptr[r - r_begin] = border_value(r);
+          }
+          for (uint32_t r = std::max(inside_end, r_begin); r < r_end; ++r) {
+            col_ptr[r - r_begin] = border_value(r);
+          }
+        }
+      }
+    }
+  });
 }
 
 std::pair<uint32_t, uint32_t> ConvolutionLayer::ComputeOutputSize(const uint32_t input_h,
@@ -145,6 +495,10 @@ std::pair<uint32_t, uint32_t> ConvolutionLayer::ComputeOutputSize(const uint32_t
 
   CHECK_GT(kernel_h, 0);
   CHECK_GT(kernel_w, 0);
+  if (padding_mode_ == PaddingMode::kReflect) {
+    CHECK(padding_h_ < input_h && padding_w_ < input_w)
+        << "The reflect padding must be smaller than the input";
+  }
 
   output_h = (input_h + 2 * padding_h_ - dilation_h_ * (kernel_h - 1) - 1) / stride_h_ + 1;
   output_w = (input_w + 2 * padding_w_ - dilation_w_ * (kernel_w - 1) - 1) / stride_w_ + 1;
@@ -152,5 +506,7 @@ std::pair<uint32_t, uint32_t> ConvolutionLayer::ComputeOutputSize(const uint32_t
 }
 
 LayerRegistererWrapper kConvCreateInstance(BaseConvolutionLayer::CreateInstance, "nn.Conv2d");
+LayerCostRegistererWrapper kConvCost(BaseConvolutionLayer::EstimateCost, "nn.Conv2d");
+LayerScratchRegistererWrapper kConvScratch(BaseConvolutionLayer::ScratchBytes, "nn.Conv2d");
 
 }   
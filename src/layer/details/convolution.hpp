@@ -3,6 +3,9 @@
 #define DL_SOURCE_LAYER_CONVOLUTION_HPP_
 #include "base_convolution.hpp"
 #include "layer/abstract/param_layer.hpp"
+#include "utils/math/sgemm.hpp"
+#include "utils/math/sparse_gemm.hpp"
+#include "utils/memory/scratch_arena.hpp"
 
 namespace black_scholes {
 
@@ -18,11 +21,37 @@ class ConvolutionLayer : public BaseConvolutionLayer {
                              padding_h, padding_w, stride_h, stride_w, groups, use_bias,
                              output_padding_h, output_padding_w, dilation_h, dilation_w) {}
 
+ public:
+  /**
+   * @brief Gets how many images of a batch share one GEMM per group
+   *
+   * Small feature maps give GEMMs with few columns, the images of the batch
+   * are folded into the columns of one GEMM up to a bounded workspace.
+   *
+   * @return Images per GEMM, 1 when the images run one by one
+   */
+  static uint32_t BatchFoldImages(uint32_t batch_size, uint32_t output_h, uint32_t output_w);
+
+  /**
+   * @brief Gets the output pixels of one im2col tile, sized so the tile fits in L2
+   *
+   * @param depth Rows of the im2col matrix
+   */
+  static uint32_t Im2ColTileColumns(uint32_t depth, uint32_t output_hw);
+
  private:
   bool Is1x1KernelNoPadding(uint32_t kernel_h, uint32_t kernel_w) const;
 
   void InitIm2ColWeight() override;
 
+  /**
+   * @brief Packs the kernels of every group in blocked CSR, for weights with enough zeros
+   *
+   * @param kernels kernel_count_ rows of depth values, one output channel per row
+   * @param sparsity Fraction of zero weights, logged
+   */
+  void InitSparseWeight(const float* kernels, uint32_t depth, float sparsity);
+
   void ComputeOutput(sftensor input, sftensor output_tensor, uint32_t kernel_h, uint32_t kernel_w,
                      uint32_t kernel_count_group, uint32_t input_h, uint32_t input_w,
                      uint32_t channels_per_group, uint32_t output_h, uint32_t output_w,
@@ -32,15 +61,63 @@ class ConvolutionLayer : public BaseConvolutionLayer {
                                                   uint32_t kernel_h,
                                                   uint32_t kernel_w) const override;
 
-  void ConvGEMMBias(const arma::fmat& input_matrix, sftensor output_tensor, uint32_t group,
-                    uint32_t kernel_index, uint32_t kernel_count_group, uint32_t output_h,
-                    uint32_t output_w, bool is_1x1conv_nopadding) const;
+  bool UseBatchOutput(uint32_t batch_size, uint32_t output_h, uint32_t output_w) const override;
+
+  void ComputeBatchOutput(const std::vector<sftensor>& inputs,
+                          const std::vector<sftensor>& outputs, uint32_t kernel_h,
+                          uint32_t kernel_w, uint32_t kernel_count_group, uint32_t input_h,
+                          uint32_t input_w, uint32_t channels_per_group, uint32_t output_h,
+                          uint32_t output_w, uint32_t group) const override;
+
+  /**
+   * @brief Multiplies the kernels of a group with B, C = epilogue(kernels * op(B))
+   *
+   * Half precision kernels are widened by the GEMM while it packs them.
+   *
+   * @param transpose_b B is stored columns x depth
+   */
+  void KernelGemm(uint32_t group, bool transpose_b, uint32_t kernel_count_group, uint32_t columns,
+                  uint32_t depth, const float* b, size_t ldb, float* c, size_t ldc,
+                  const utils::SgemmEpilogue& epilogue) const;
 
-  [[nodiscard]] arma::fmat ConvIm2Col(sftensor input, uint32_t kernel_h, uint32_t kernel_w,
-                                      uint32_t input_h, uint32_t input_w,
+  /**
+   * @brief Unfolds the input patches of one group into a matrix
+   *
+   * @param im2col_workspace Scratch of channels_per_group * row_len * col_len floats holding
+   * the matrix, unused by 1x1 convolutions without padding which view the input directly
+   * @param col_begin First output pixel unfolded, the matrix holds the pixels
+   * [col_begin, col_begin + col_len) in column-major order of the output
+   */
+  [[nodiscard]] arma::fmat ConvIm2Col(sftensor input, float* im2col_workspace, uint32_t kernel_h,
+                                      uint32_t kernel_w, uint32_t input_h, uint32_t input_w,
                                       uint32_t channels_per_group, uint32_t output_h,
                                       uint32_t output_w, uint32_t group, uint32_t row_len,
-                                      uint32_t col_len) const;
+                                      uint32_t col_begin, uint32_t col_len) const;
+
+  /**
+   * @brief Unfolds the input patches of one group for the sparse GEMM
+   *
+   * @param rows Receives one row of col_len values per kernel tap, in the order of the kernel
+   * weights
+   * @param col_begin First output pixel of the tile, the pixels are column-major
+   * @param col_len Number of output pixels of the tile
+   */
+  void SparseIm2Col(const sftensor& input, float* rows, uint32_t kernel_h, uint32_t kernel_w,
+                    uint32_t input_h, uint32_t input_w, uint32_t channels_per_group,
+                    uint32_t output_h, uint32_t output_w, uint32_t group, uint32_t col_begin,
+                    uint32_t col_len) const;
+
+  /// One blocked CSR matrix per group, replaces kernel_matrix_arr_ for pruned weights
+  std::vector<utils::BlockedCsrMatrix> sparse_kernels_;
+
+ protected:
+  void ReleaseKernels() override;
+
+  void ForEachWeightRegion(
+      const std::function<void(const void*, size_t)>& visit) const override;
+
+  /// Bias of every output channel, zero without bias, for the GEMM epilogues
+  std::vector<float> bias_values_;
 };
 }  
 
@@ -1,8 +1,12 @@
 
 
 #include "deconvolution.hpp"
+#include <algorithm>
 
 #include "layer/abstract/layer_factory.hpp"
+#include "utils/math/gemm_backend.hpp"
+#include "utils/memory/scratch_arena.hpp"
+#include "utils/parallel/parallel_utils.hpp"
 namespace black_scholes
 {
 void DeconvolutionLayer::set_weights(const std::vector<std::shared_ptr<Tensor<float>>>& weights)
@@ -70,19 +74,127 @@ void DeconvolutionLayer::set_weights(const std::vector<float>& weights)
     }
 }
 
+void DeconvolutionLayer::InitIm2ColWeight()
+{
+    const uint32_t kernel_count = this->weights_.size();
+    CHECK(kernel_count > 0) << "kernel count must greater than zero";
+    const uint32_t kernel_h = this->weights_.at(0)->rows();
+    const uint32_t kernel_w = this->weights_.at(0)->cols();
+    const uint32_t kernel_c = this->weights_.at(0)->channels();
+    CHECK(kernel_h > 0 && kernel_w > 0 && kernel_c > 0) << "The size of kernel matrix should be greater than zero";
+    CHECK(kernel_count % groups_ == 0);
+
+    // the kernels are stored dilated, only the taps on the dilation grid are packed
+    const uint32_t tap_h = (kernel_h - 1) / dilation_h_ + 1;
+    const uint32_t tap_w = (kernel_w - 1) / dilation_w_ + 1;
+    const uint32_t taps = tap_h * tap_w;
+    const uint32_t kernel_count_group = kernel_count / groups_;
+
+    // one (channels, kernels * taps) matrix per group, column kg * taps + tx * tap_h + ty
+    kernel_matrix_arr_.resize(groups_);
+    for (uint32_t group = 0; group < groups_; ++group)
+    {
+        arma::fmat kernel_matrix(kernel_c, kernel_count_group * taps);
+        for (uint32_t kg = 0; kg < kernel_count_group; ++kg)
+        {
+            const std::shared_ptr<Tensor<float>>& kernel = this->weights_.at(group * kernel_count_group + kg);
+            CHECK(kernel->rows() == kernel_h && kernel->cols() == kernel_w && kernel->channels() == kernel_c);
+            for (uint32_t tx = 0; tx < tap_w; ++tx)
+            {
+                for (uint32_t ty = 0; ty < tap_h; ++ty)
+                {
+                    float* kernel_matrix_ptr = kernel_matrix.colptr(kg * taps + tx * tap_h + ty);
+                    const uint32_t kernel_offset = tx * dilation_w_ * kernel_h + ty * dilation_h_;
+                    for (uint32_t ic = 0; ic < kernel_c; ++ic)
+                    {
+                        kernel_matrix_ptr[ic] = kernel->matrix_raw_ptr(ic)[kernel_offset];
+                    }
+                }
+            }
+        }
+        kernel_matrix_arr_.at(group) = std::move(kernel_matrix);
+    }
+
+    // strided layers also keep the kernels split by sub-pixel phase, rows (tap_x, tap_y, channel) of the phase
+    size_t subpixel_size = 0;
+    subpixel_kernel_arr_.clear();
+    if (stride_h_ > 1 || stride_w_ > 1)
+    {
+        const uint32_t phases = stride_h_ * stride_w_;
+        subpixel_kernel_arr_.resize(size_t(groups_) * phases);
+        for (uint32_t group = 0; group < groups_; ++group)
+        {
+            for (uint32_t phase_x = 0; phase_x < stride_w_; ++phase_x)
+            {
+                const auto& taps_x = SubPixelTaps(phase_x, tap_w, stride_w_, dilation_w_, padding_w_);
+                for (uint32_t phase_y = 0; phase_y < stride_h_; ++phase_y)
+                {
+                    const auto& taps_y = SubPixelTaps(phase_y, tap_h, stride_h_, dilation_h_, padding_h_);
+                    arma::fmat phase_matrix(size_t(kernel_c) * taps_x.size() * taps_y.size(), kernel_count_group);
+                    for (uint32_t kg = 0; kg < kernel_count_group; ++kg)
+                    {
+                        const sftensor& kernel = this->weights_.at(group * kernel_count_group + kg);
+                        float* phase_matrix_ptr = phase_matrix.colptr(kg);
+                        for (const auto& tap_x : taps_x)
+                        {
+                            for (const auto& tap_y : taps_y)
+                            {
+                                const uint32_t kernel_offset =
+                                    tap_x.first * dilation_w_ * kernel_h + tap_y.first * dilation_h_;
+                                for (uint32_t ic = 0; ic < kernel_c; ++ic)
+                                {
+                                    *phase_matrix_ptr++ = kernel->matrix_raw_ptr(ic)[kernel_offset];
+                                }
+                            }
+                        }
+                    }
+                    subpixel_size += phase_matrix.n_elem;
+                    subpixel_kernel_arr_.at(group * phases + phase_x * stride_h_ + phase_y) = std::move(phase_matrix);
+                }
+            }
+        }
+    }
+    kernel_matrix_memory_.Resize((size_t(kernel_count) * kernel_c * taps + subpixel_size) * sizeof(float));
+}
+
+void DeconvolutionLayer::ReleaseKernels()
+{
+    std::vector<arma::fmat>().swap(subpixel_kernel_arr_);
+    BaseConvolutionLayer::ReleaseKernels();
+}
+
+void DeconvolutionLayer::ForEachWeightRegion(const std::function<void(const void*, size_t)>& visit) const
+{
+    BaseConvolutionLayer::ForEachWeightRegion(visit);
+    for (const arma::fmat& kernel_matrix : subpixel_kernel_arr_)
+    {
+        visit(kernel_matrix.memptr(), kernel_matrix.n_elem * sizeof(float));
+    }
+}
+
 void DeconvolutionLayer::ComputeOutput(sftensor input, sftensor output_tensor, uint32_t kernel_h, uint32_t kernel_w,
                                        uint32_t kernel_count_group, uint32_t input_h, uint32_t input_w,
                                        uint32_t channels_per_group, uint32_t output_h, uint32_t output_w,
                                        uint32_t group) const
 {
-#pragma omp parallel for
-    for (uint32_t k = 0; k < kernel_count_group; ++k)
+    const uint32_t tap_h = (kernel_h - 1) / dilation_h_ + 1;
+    const uint32_t tap_w = (kernel_w - 1) / dilation_w_ + 1;
+    const size_t input_hw = size_t(input_h) * input_w;
+
+    if (UseSubPixel(input_h, input_w, channels_per_group, kernel_count_group, tap_h, tap_w, output_h, output_w))
     {
-        const arma::fmat& gemm_result =
-            DeconvGEMM(input, input_h, input_w, channels_per_group, group, k, kernel_count_group);
-        DeconvCol2ImBias(gemm_result, output_tensor, input_h, input_w, group, k, kernel_count_group, kernel_h, kernel_w,
-                         output_h, output_w);
+        return SubPixelDeconv(input, output_tensor, input_h, input_w, channels_per_group, kernel_count_group, tap_h,
+                              tap_w, output_h, output_w, group);
     }
+
+    utils::ScratchFrame scratch_frame;
+    float* gemm_workspace = scratch_frame.Allocate<float>(input_hw * kernel_count_group * tap_h * tap_w);
+    const arma::fmat& gemm_result =
+        DeconvGEMM(input, gemm_workspace, input_h, input_w, channels_per_group, group, kernel_count_group);
+    utils::ParallelFor(kernel_count_group, input_hw * tap_h * tap_w, [&](uint32_t k) {
+        DeconvCol2ImBias(gemm_result, output_tensor, input_h, input_w, group, k, kernel_count_group, tap_h, tap_w,
+                         output_h, output_w);
+    });
 }
 
 std::pair<uint32_t, uint32_t> DeconvolutionLayer::ComputeOutputSize(const uint32_t input_h, const uint32_t input_w,
@@ -100,71 +212,269 @@ std::pair<uint32_t, uint32_t> DeconvolutionLayer::ComputeOutputSize(const uint32
     return {output_h, output_w};
 }
 
-arma::fmat DeconvolutionLayer::DeconvGEMM(const sftensor& input, uint32_t input_h, uint32_t input_w,
-                                          uint32_t channels_per_group, uint32_t group, uint32_t kernel_index,
+arma::fmat DeconvolutionLayer::DeconvGEMM(const sftensor& input, float* gemm_workspace, uint32_t input_h,
+                                          uint32_t input_w, uint32_t channels_per_group, uint32_t group,
                                           uint32_t kernel_count_group) const
 {
     CHECK(input != nullptr && !input->empty());
+    CHECK(group < this->kernel_matrix_arr_.size());
 
-    kernel_index = kernel_index + group * kernel_count_group;
-    CHECK(kernel_index < this->weights_.size());
-
-    sftensor group_kernel = this->weights_.at(kernel_index);
-    CHECK(group_kernel != nullptr && !group_kernel->empty());
-
-    uint32_t input_hw = input_h * input_w;
-    uint32_t kernel_hw = group_kernel->rows() * group_kernel->cols();
+    const arma::fmat& kernel_matrix = this->kernel_matrix_arr_.at(group);
+    CHECK(kernel_matrix.n_rows == channels_per_group && kernel_matrix.n_cols % kernel_count_group == 0);
 
+    const uint32_t input_hw = input_h * input_w;
     arma::fmat multi_input_channel(input->matrix_raw_ptr(group * channels_per_group), input_hw, channels_per_group,
                                    false, true);
+    // every column holds one kernel tap for all the input pixels, in the column-major order of the input
+    arma::fmat gemm_result(gemm_workspace, input_hw, kernel_matrix.n_cols, false, true);
+    // row-major, the transposed kernel matrix times the transposed input gives the transposed result
+    utils::GetGemmBackend().Sgemm(false, false, kernel_matrix.n_cols, input_hw, channels_per_group,
+                                  kernel_matrix.memptr(), channels_per_group, multi_input_channel.memptr(), input_hw,
+                                  gemm_result.memptr(), input_hw);
+    return gemm_result;
+}
 
-    arma::fmat multi_kernel_channel(group_kernel->raw_ptr(), kernel_hw, channels_per_group, false, true);
-    return multi_kernel_channel * (multi_input_channel.t());
+/**
+ * @brief Gets the input positions whose scattered tap lands inside the output
+ *
+ * The input position i writes the output position i * stride + offset.
+ */
+static std::pair<uint32_t, uint32_t> Col2ImRange(int32_t offset, uint32_t stride, uint32_t input_size,
+                                                 uint32_t output_size)
+{
+    const int64_t begin = offset >= 0 ? 0 : (int64_t(stride) - 1 - offset) / stride;
+    const int64_t end = std::min<int64_t>(input_size, (int64_t(output_size) - offset + stride - 1) / stride);
+    if (end <= begin)
+    {
+        return {0, 0};
+    }
+    return {uint32_t(begin), uint32_t(end)};
 }
 
 void DeconvolutionLayer::DeconvCol2ImBias(const arma::fmat& gemm_result, sftensor output_tensor, uint32_t input_h,
                                           uint32_t input_w, uint32_t group, uint32_t kernel_index,
-                                          uint32_t kernel_count_group, uint32_t kernel_h, uint32_t kernel_w,
+                                          uint32_t kernel_count_group, uint32_t tap_h, uint32_t tap_w,
                                           uint32_t output_h, uint32_t output_w) const
 {
     CHECK(!gemm_result.empty());
     CHECK(input_h > 0 && input_w > 0);
     CHECK(output_tensor != nullptr && !output_tensor->empty());
 
-    arma::fmat output_padding(output_h + 2 * padding_h_, output_w + 2 * padding_w_);
-
-    uint32_t slide_w = input_w;
-    uint32_t slide_h = input_h;
-    uint32_t slide_size = slide_h * slide_w;
-    for (uint32_t index = 0; index < slide_size; ++index)
-    {
-        uint32_t x = index / slide_h;
-        uint32_t y = index % slide_h;
-        const uint32_t offset_x = x * stride_w_;
-        const uint32_t offset_y = y * stride_h_;
-        arma::fmat gemm_column(const_cast<float*>(gemm_result.colptr(index)), kernel_h, kernel_w, false, true);
+    const uint32_t taps = tap_h * tap_w;
+    const uint32_t gemm_offset = kernel_index * taps;
+    kernel_index = kernel_index + group * kernel_count_group;
 
-        uint32_t gemm_rows = gemm_column.n_rows;
-        uint32_t gemm_cols = gemm_column.n_cols;
+    // the taps are accumulated straight into the output channel, starting from the bias
+    arma::fmat output(output_tensor->matrix_raw_ptr(kernel_index), output_h, output_w, false, true);
+    output.fill(BiasValue(kernel_index));
 
-        for (uint32_t col = 0; col < gemm_cols; ++col)
+    for (uint32_t tx = 0; tx < tap_w; ++tx)
+    {
+        const int32_t offset_x = int32_t(tx * dilation_w_) - int32_t(padding_w_);
+        const std::pair<uint32_t, uint32_t> x_range = Col2ImRange(offset_x, stride_w_, input_w, output_w);
+        for (uint32_t ty = 0; ty < tap_h; ++ty)
         {
-            float* column_ptr = gemm_column.colptr(col);
-            float* output_ptr = output_padding.colptr(offset_x + col);
-            for (uint32_t row = 0; row < gemm_rows; ++row)
+            const int32_t offset_y = int32_t(ty * dilation_h_) - int32_t(padding_h_);
+            const std::pair<uint32_t, uint32_t> y_range = Col2ImRange(offset_y, stride_h_, input_h, output_h);
+            const uint32_t y_begin = y_range.first;
+            const uint32_t count = y_range.second - y_range.first;
+            const float* gemm_column = gemm_result.colptr(gemm_offset + tx * tap_h + ty);
+            for (uint32_t x = x_range.first; x < x_range.second; ++x)
             {
-                *(output_ptr + offset_y + row) += *(column_ptr + row);
+                const float* gemm_ptr = gemm_column + size_t(x) * input_h + y_begin;
+                float* output_ptr = output.colptr(x * stride_w_ + offset_x) + (int32_t(y_begin * stride_h_) + offset_y);
+                if (stride_h_ == 1)
+                {
+#pragma omp simd
+                    for (uint32_t y = 0; y < count; ++y)
+                    {
+                        output_ptr[y] += gemm_ptr[y];
+                    }
+                }
+                else
+                {
+                    for (uint32_t y = 0; y < count; ++y)
+                    {
+                        output_ptr[y * stride_h_] += gemm_ptr[y];
+                    }
+                }
             }
         }
     }
+}
 
-    kernel_index = kernel_index + group * kernel_count_group;
-    arma::fmat output(output_tensor->matrix_raw_ptr(kernel_index), output_h, output_w, false, true);
+std::vector<std::pair<uint32_t, int32_t>> DeconvolutionLayer::SubPixelTaps(uint32_t phase, uint32_t taps,
+                                                                           uint32_t stride, uint32_t dilation,
+                                                                           uint32_t padding)
+{
+    // tap t of input i lands on i * stride + t * dilation - padding, which is q * stride + phase
+    // when phase + padding - t * dilation is a multiple of the stride
+    std::vector<std::pair<uint32_t, int32_t>> phase_taps;
+    for (uint32_t t = 0; t < taps; ++t)
+    {
+        const int32_t delta = int32_t(phase + padding) - int32_t(t * dilation);
+        if (delta % int32_t(stride) == 0)
+        {
+            phase_taps.emplace_back(t, delta / int32_t(stride));
+        }
+    }
+    return phase_taps;
+}
+
+/**
+ * @brief Gets the number of output positions of a sub-pixel phase along a dimension
+ */
+static uint32_t SubPixelPhaseSize(uint32_t phase, uint32_t output_size, uint32_t stride)
+{
+    return phase < output_size ? (output_size - phase + stride - 1) / stride : 0;
+}
+
+size_t DeconvolutionLayer::SubPixelWorkspaceSize(uint32_t input_channels, uint32_t output_channels, uint32_t tap_h,
+                                                 uint32_t tap_w, uint32_t output_h, uint32_t output_w,
+                                                 uint32_t stride_h, uint32_t stride_w, uint32_t dilation_h,
+                                                 uint32_t dilation_w, uint32_t padding_h, uint32_t padding_w)
+{
+    size_t im2col_size = 0;
+    size_t result_size = 0;
+    for (uint32_t phase_x = 0; phase_x < stride_w; ++phase_x)
+    {
+        const size_t taps_x = SubPixelTaps(phase_x, tap_w, stride_w, dilation_w, padding_w).size();
+        const size_t phase_w = SubPixelPhaseSize(phase_x, output_w, stride_w);
+        for (uint32_t phase_y = 0; phase_y < stride_h; ++phase_y)
+        {
+            const size_t taps_y = SubPixelTaps(phase_y, tap_h, stride_h, dilation_h, padding_h).size();
+            const size_t phase_hw = phase_w * SubPixelPhaseSize(phase_y, output_h, stride_h);
+            im2col_size = std::max(im2col_size, phase_hw * input_channels * taps_x * taps_y);
+            result_size = std::max(result_size, phase_hw * output_channels);
+        }
+    }
+    return im2col_size + result_size;
+}
+
+bool DeconvolutionLayer::UseSubPixel(uint32_t input_h, uint32_t input_w, uint32_t channels_per_group,
+                                     uint32_t kernel_count_group, uint32_t tap_h, uint32_t tap_w, uint32_t output_h,
+                                     uint32_t output_w) const
+{
+    if ((stride_h_ == 1 && stride_w_ == 1) || subpixel_kernel_arr_.empty())
+    {
+        return false;
+    }
+    const double input_hw = double(input_h) * input_w;
+    const double output_hw = double(output_h) * output_w;
+    // both engines do the same multiply-adds, they differ in the intermediate traffic:
+    // the GEMM writes every tap of every input pixel, col2im reads it back and accumulates it into the output
+    const double col2im_elements = channels_per_group * input_hw +
+                                   3. * kernel_count_group * tap_h * tap_w * input_hw + kernel_count_group * output_hw;
+
+    // the phases unfold the input once per tap they own, the GEMM result is interleaved into the output
+    double im2col_rows_h = 0.;
+    double im2col_rows_w = 0.;
+    for (uint32_t phase_y = 0; phase_y < stride_h_; ++phase_y)
+    {
+        im2col_rows_h += double(SubPixelTaps(phase_y, tap_h, stride_h_, dilation_h_, padding_h_).size()) *
+                         SubPixelPhaseSize(phase_y, output_h, stride_h_);
+    }
+    for (uint32_t phase_x = 0; phase_x < stride_w_; ++phase_x)
+    {
+        im2col_rows_w += double(SubPixelTaps(phase_x, tap_w, stride_w_, dilation_w_, padding_w_).size()) *
+                         SubPixelPhaseSize(phase_x, output_w, stride_w_);
+    }
+    const double subpixel_elements =
+        2. * channels_per_group * im2col_rows_h * im2col_rows_w + 2. * kernel_count_group * output_hw;
+    return subpixel_elements < col2im_elements;
+}
+
+void DeconvolutionLayer::SubPixelDeconv(const sftensor& input, const sftensor& output_tensor, uint32_t input_h,
+                                        uint32_t input_w, uint32_t channels_per_group, uint32_t kernel_count_group,
+                                        uint32_t tap_h, uint32_t tap_w, uint32_t output_h, uint32_t output_w,
+                                        uint32_t group) const
+{
+    CHECK(input != nullptr && !input->empty());
+    CHECK(output_tensor != nullptr && !output_tensor->empty());
+
+    const uint32_t phases = stride_h_ * stride_w_;
+    const uint32_t channels_offset = group * channels_per_group;
+    for (uint32_t phase_x = 0; phase_x < stride_w_; ++phase_x)
+    {
+        const auto& taps_x = SubPixelTaps(phase_x, tap_w, stride_w_, dilation_w_, padding_w_);
+        const uint32_t phase_w = SubPixelPhaseSize(phase_x, output_w, stride_w_);
+        for (uint32_t phase_y = 0; phase_y < stride_h_; ++phase_y)
+        {
+            const auto& taps_y = SubPixelTaps(phase_y, tap_h, stride_h_, dilation_h_, padding_h_);
+            const uint32_t phase_h = SubPixelPhaseSize(phase_y, output_h, stride_h_);
+            const uint32_t phase_hw = phase_h * phase_w;
+            if (phase_hw == 0)
+            {
+                continue;
+            }
+            const arma::fmat& kernel_matrix = subpixel_kernel_arr_.at(group * phases + phase_x * stride_h_ + phase_y);
+            CHECK(kernel_matrix.n_cols == kernel_count_group);
 
-    output = output_padding.submat(padding_h_, padding_w_, output_h + padding_h_ - 1, output_w + padding_w_ - 1);
+            utils::ScratchFrame scratch_frame;
+            arma::fmat phase_result(scratch_frame.Allocate<float>(size_t(phase_hw) * kernel_count_group), phase_hw,
+                                    kernel_count_group, false, true);
+            if (kernel_matrix.n_rows == 0)
+            {
+                // no tap reaches this phase, it only holds the bias
+                phase_result.zeros();
+            }
+            else
+            {
+                // every column is one (tap, channel) pair over the phase positions, in column-major order
+                arma::fmat phase_input(scratch_frame.Allocate<float>(size_t(phase_hw) * kernel_matrix.n_rows),
+                                       phase_hw, kernel_matrix.n_rows, false, true);
+                utils::ParallelFor(kernel_matrix.n_rows, phase_hw, [&](uint32_t column) {
+                    const uint32_t ic = column % channels_per_group;
+                    const uint32_t tap_index = column / channels_per_group;
+                    const int32_t offset_y = taps_y.at(tap_index % taps_y.size()).second;
+                    const int32_t offset_x = taps_x.at(tap_index / taps_y.size()).second;
+                    const float* input_channel_ptr = input->matrix_raw_ptr(channels_offset + ic);
+                    // the phase rows whose input row lies inside the image
+                    const int32_t y_begin = std::min<int32_t>(std::max(-offset_y, 0), phase_h);
+                    const int32_t y_end = std::max<int32_t>(std::min<int32_t>(phase_h, int32_t(input_h) - offset_y),
+                                                            y_begin);
+                    for (uint32_t x = 0; x < phase_w; ++x)
+                    {
+                        float* phase_input_ptr = phase_input.colptr(column) + size_t(x) * phase_h;
+                        const int32_t input_x = int32_t(x) + offset_x;
+                        if (input_x < 0 || input_x >= int32_t(input_w))
+                        {
+                            std::fill(phase_input_ptr, phase_input_ptr + phase_h, 0.f);
+                            continue;
+                        }
+                        const float* input_ptr = input_channel_ptr + size_t(input_x) * input_h + (y_begin + offset_y);
+                        std::fill(phase_input_ptr, phase_input_ptr + y_begin, 0.f);
+                        std::copy(input_ptr, input_ptr + (y_end - y_begin), phase_input_ptr + y_begin);
+                        std::fill(phase_input_ptr + y_end, phase_input_ptr + phase_h, 0.f);
+                    }
+                });
+                // the kernels of the phase are the rows of C, so the result stays column-major per kernel
+                utils::GetGemmBackend().Sgemm(false, false, kernel_count_group, phase_hw, kernel_matrix.n_rows,
+                                              kernel_matrix.memptr(), kernel_matrix.n_rows, phase_input.memptr(),
+                                              phase_hw, phase_result.memptr(), phase_hw);
+            }
 
-    return AddBias(output, kernel_index);
+            // interleave the phase into the output channels, pixel shuffle style
+            utils::ParallelFor(kernel_count_group, phase_hw, [&](uint32_t k) {
+                const uint32_t kernel_index = group * kernel_count_group + k;
+                const float bias_value = BiasValue(kernel_index);
+                const float* phase_result_ptr = phase_result.colptr(k);
+                arma::fmat output(output_tensor->matrix_raw_ptr(kernel_index), output_h, output_w, false, true);
+                for (uint32_t x = 0; x < phase_w; ++x)
+                {
+                    float* output_ptr = output.colptr(x * stride_w_ + phase_x) + phase_y;
+                    const float* result_ptr = phase_result_ptr + size_t(x) * phase_h;
+                    for (uint32_t y = 0; y < phase_h; ++y)
+                    {
+                        output_ptr[y * stride_h_] = result_ptr[y] + bias_value;
+                    }
+                }
+            });
+        }
+    }
 }
 
 LayerRegistererWrapper kDeConvCreateInstance(BaseConvolutionLayer::CreateInstance, "nn.ConvTranspose2d");
+LayerCostRegistererWrapper kDeConvCost(BaseConvolutionLayer::EstimateCost, "nn.ConvTranspose2d");
+LayerScratchRegistererWrapper kDeConvScratch(BaseConvolutionLayer::ScratchBytes, "nn.ConvTranspose2d");
 }  // namespace black_scholes
@@ -23,6 +23,30 @@ class DeconvolutionLayer : public BaseConvolutionLayer
 
     void set_weights(const std::vector<float>& weights) override;
     void set_weights(const std::vector<std::shared_ptr<Tensor<float>>>& weights) override;
+
+    /**
+     * @brief Gets the kernel taps feeding one sub-pixel phase along a dimension
+     *
+     * The output position q * stride + phase receives tap t from the input
+     * position q + offset, for every returned pair (t, offset).
+     *
+     * @param phase Output position modulo the stride
+     * @param taps Kernel taps, without the dilation holes
+     * @return The taps of the phase and their input offsets
+     */
+    static std::vector<std::pair<uint32_t, int32_t>> SubPixelTaps(uint32_t phase, uint32_t taps, uint32_t stride,
+                                                                  uint32_t dilation, uint32_t padding);
+
+    /**
+     * @brief Gets the workspace of the sub-pixel engine for one image and group
+     *
+     * @return Floats of the largest phase im2col matrix plus its GEMM result
+     */
+    static size_t SubPixelWorkspaceSize(uint32_t input_channels, uint32_t output_channels, uint32_t tap_h,
+                                        uint32_t tap_w, uint32_t output_h, uint32_t output_w, uint32_t stride_h,
+                                        uint32_t stride_w, uint32_t dilation_h, uint32_t dilation_w,
+                                        uint32_t padding_h, uint32_t padding_w);
+
    private:
     void ComputeOutput(sftensor input, sftensor output_tensor, uint32_t kernel_h, uint32_t kernel_w,
                        uint32_t kernel_count_group, uint32_t input_h, uint32_t input_w, uint32_t channels_per_group,
@@ -31,13 +55,54 @@ class DeconvolutionLayer : public BaseConvolutionLayer
     std::pair<uint32_t, uint32_t> ComputeOutputSize(uint32_t input_h, uint32_t input_w, uint32_t kernel_h,
                                                     uint32_t kernel_w) const override;
 
+    /**
+     * @brief Packs the kernels of every group into one matrix, so a group takes a single GEMM
+     */
+    void InitIm2ColWeight() override;
+
+    void ReleaseKernels() override;
+
+    void ForEachWeightRegion(const std::function<void(const void*, size_t)>& visit) const override;
+
+    /**
+     * @brief Scatters the GEMM columns of one output channel into it and adds the bias
+     *
+     * @param tap_h Kernel taps along the height, without the dilation holes
+     * @param tap_w Kernel taps along the width, without the dilation holes
+     */
     void DeconvCol2ImBias(const arma::fmat& gemm_result, sftensor output_tensor, uint32_t input_h, uint32_t input_w,
-                          uint32_t group, uint32_t kernel_index, uint32_t kernel_count_group, uint32_t kernel_h,
-                          uint32_t kernel_w, uint32_t output_h, uint32_t output_w) const;
+                          uint32_t group, uint32_t kernel_index, uint32_t kernel_count_group, uint32_t tap_h,
+                          uint32_t tap_w, uint32_t output_h, uint32_t output_w) const;
+
+    /**
+     * @brief Multiplies the input of one group with all its packed kernels
+     *
+     * @param gemm_workspace Scratch of input_h * input_w * kernel_count_group * taps floats holding the result
+     */
+    /**
+     * @brief Chooses the sub-pixel engine when it moves fewer bytes than GEMM plus col2im
+     */
+    bool UseSubPixel(uint32_t input_h, uint32_t input_w, uint32_t channels_per_group, uint32_t kernel_count_group,
+                     uint32_t tap_h, uint32_t tap_w, uint32_t output_h, uint32_t output_w) const;
+
+    /**
+     * @brief Computes a strided deconvolution of one group as stride_h * stride_w stride-1 convolutions
+     *
+     * Every phase of the output, the positions sharing their remainder by
+     * the stride, only sees the kernel taps aligned with it. Each phase is an
+     * im2col + GEMM over the input, its result is interleaved into the output.
+     */
+    void SubPixelDeconv(const sftensor& input, const sftensor& output_tensor, uint32_t input_h, uint32_t input_w,
+                        uint32_t channels_per_group, uint32_t kernel_count_group, uint32_t tap_h, uint32_t tap_w,
+                        uint32_t output_h, uint32_t output_w, uint32_t group) const;
 
-    [[nodiscard]] arma::fmat DeconvGEMM(const sftensor& input, uint32_t input_h, uint32_t input_w,
-                                        uint32_t channels_per_group, uint32_t group, uint32_t kernel_index,
+    [[nodiscard]] arma::fmat DeconvGEMM(const sftensor& input, float* gemm_workspace, uint32_t input_h,
+                                        uint32_t input_w, uint32_t channels_per_group, uint32_t group,
                                         uint32_t kernel_count_group) const;
+
+   private:
+    /// (channels * phase taps, kernels) matrices, indexed by group * stride_h * stride_w + phase_x * stride_h + phase_y
+    std::vector<arma::fmat> subpixel_kernel_arr_;
 };
 }  // namespace black_scholes
 
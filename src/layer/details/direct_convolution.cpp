@@ -0,0 +1,90 @@
+
+#include "direct_convolution.hpp"
+#include <glog/logging.h>
+#include <cstring>
+
+namespace black_scholes {
+DirectConvolutionLayer::DirectConvolutionLayer(uint32_t output_channel, uint32_t in_channel,
+                                               uint32_t kernel_h, uint32_t kernel_w,
+                                               uint32_t padding_h, uint32_t padding_w,
+                                               uint32_t stride_h, uint32_t stride_w,
+                                               uint32_t groups, bool use_bias,
+                                               uint32_t dilation_h, uint32_t dilation_w)
+    : ConvolutionLayer(output_channel, in_channel, kernel_h, kernel_w, padding_h, padding_w,
+                       stride_h, stride_w, groups, use_bias, 0, 0, dilation_h, dilation_w) {
+  CHECK(utils::SupportsDirectConv(kernel_h, kernel_w, stride_h, stride_w, dilation_h, dilation_w))
+      << "The direct convolution takes 3x3 and 1x1 kernels of stride 2";
+}
+
+void DirectConvolutionLayer::InitIm2ColWeight() {
+  const uint32_t kernel_count = this->weights_.size();
+  CHECK(kernel_count > 0) << "kernel count must greater than zero";
+  const uint32_t kernel_h = this->weights_.at(0)->rows();
+  const uint32_t kernel_w = this->weights_.at(0)->cols();
+  const uint32_t kernel_c = this->weights_.at(0)->channels();
+  const uint32_t kernel_count_group = kernel_count / groups_;
+  const uint32_t row_len = kernel_h * kernel_w;
+  const uint32_t depth = kernel_c * row_len;
+
+  // the channel matrices of the kernels are already in the (kw, kh) order of the direct kernels
+  packed_weights_.resize(groups_);
+  size_t packed_bytes = 0;
+  std::vector<float> group_weights(size_t(kernel_count_group) * depth);
+  for (uint32_t group = 0; group < groups_; ++group) {
+    for (uint32_t kg = 0; kg < kernel_count_group; ++kg) {
+      const std::shared_ptr<Tensor<float>>& kernel =
+          this->weights_.at(group * kernel_count_group + kg);
+      CHECK(kernel->rows() == kernel_h && kernel->cols() == kernel_w &&
+            kernel->channels() == kernel_c);
+      for (uint32_t ic = 0; ic < kernel_c; ++ic) {
+        std::memcpy(group_weights.data() + size_t(kg) * depth + ic * row_len,
+                    kernel->matrix_raw_ptr(ic), row_len * sizeof(float));
+      }
+    }
+    packed_weights_.at(group) = utils::PackDirectConvWeights(
+        group_weights.data(), kernel_count_group, kernel_c, kernel_h);
+    packed_bytes += packed_weights_.at(group).bytes();
+  }
+
+  bias_values_.resize(kernel_count);
+  for (uint32_t k = 0; k < kernel_count; ++k) {
+    bias_values_.at(k) = BiasValue(k);
+  }
+  kernel_matrix_memory_.Resize(packed_bytes + size_t(kernel_count) * sizeof(float));
+  LOG(INFO) << "Direct " << kernel_h << "x" << kernel_w << " stride-2 convolution uses the "
+            << utils::DirectConvKernelName(utils::SelectDirectConvKernel()) << " kernel";
+}
+
+void DirectConvolutionLayer::ReleaseKernels() {
+  std::vector<utils::DirectConvWeights>().swap(packed_weights_);
+  ConvolutionLayer::ReleaseKernels();
+}
+
+void DirectConvolutionLayer::ForEachWeightRegion(
+    const std::function<void(const void*, size_t)>& visit) const {
+  ConvolutionLayer::ForEachWeightRegion(visit);
+  for (const utils::DirectConvWeights& packed : packed_weights_) {
+    visit(packed.values.data(), packed.values.size() * sizeof(float));
+  }
+}
+
+void DirectConvolutionLayer::ComputeOutput(sftensor input, sftensor output_tensor,
+                                           uint32_t kernel_h, uint32_t kernel_w,
+                                           uint32_t kernel_count_group, uint32_t input_h,
+                                           uint32_t input_w, uint32_t channels_per_group,
+                                           uint32_t output_h, uint32_t output_w,
+                                           uint32_t group) const {
+  CHECK(input && !input->empty()) << "The input tensor of the direct convolution cannot be empty.";
+  CHECK(group < packed_weights_.size());
+  const uint32_t kernel_offset = group * kernel_count_group;
+  utils::DirectConvStride2(packed_weights_.at(group),
+                           input->matrix_raw_ptr(group * channels_per_group), input_h, input_w,
+                           padding_h_, padding_w_, bias_values_.data() + kernel_offset,
+                           output_tensor->matrix_raw_ptr(kernel_offset), output_h, output_w);
+}
+
+bool DirectConvolutionLayer::UseBatchOutput(uint32_t batch_size, uint32_t output_h,
+                                            uint32_t output_w) const {
+  return false;
+}
+}  // namespace black_scholes
@@ -0,0 +1,42 @@
+
+#ifndef DL_SOURCE_LAYER_DIRECT_CONVOLUTION_HPP_
+#define DL_SOURCE_LAYER_DIRECT_CONVOLUTION_HPP_
+#include "convolution.hpp"
+#include "utils/math/direct_conv.hpp"
+
+namespace black_scholes {
+/**
+ * @brief Stride-2 3x3 and 1x1 convolution computed without im2col
+ *
+ * The downsampling layers of the backbones unfold badly, every patch is a
+ * strided gather and the unfolded input is 9 or 1/4 times the input. The
+ * direct kernels read the input split into its even and odd rows and keep
+ * a block of output channels in registers.
+ */
+class DirectConvolutionLayer : public ConvolutionLayer {
+ public:
+  explicit DirectConvolutionLayer(uint32_t output_channel, uint32_t in_channel, uint32_t kernel_h,
+                                  uint32_t kernel_w, uint32_t padding_h, uint32_t padding_w,
+                                  uint32_t stride_h, uint32_t stride_w, uint32_t groups,
+                                  bool use_bias, uint32_t dilation_h, uint32_t dilation_w);
+
+ private:
+  void InitIm2ColWeight() override;
+
+  void ReleaseKernels() override;
+
+  void ForEachWeightRegion(
+      const std::function<void(const void*, size_t)>& visit) const override;
+
+  void ComputeOutput(sftensor input, sftensor output_tensor, uint32_t kernel_h, uint32_t kernel_w,
+                     uint32_t kernel_count_group, uint32_t input_h, uint32_t input_w,
+                     uint32_t channels_per_group, uint32_t output_h, uint32_t output_w,
+                     uint32_t group) const override;
+
+  bool UseBatchOutput(uint32_t batch_size, uint32_t output_h, uint32_t output_w) const override;
+
+  std::vector<utils::DirectConvWeights> packed_weights_;
+};
+}  // namespace black_scholes
+
+#endif
@@ -3,6 +3,8 @@
 #include <stack>
 #include "data/tensor_util.hpp"
 #include "layer/abstract/layer_factory.hpp"
+#include "utils/memory/scratch_arena.hpp"
+#include "utils/parallel/parallel_utils.hpp"
 
 namespace black_scholes {
 ExpressionLayer::ExpressionLayer(std::string statement)
@@ -34,6 +36,8 @@ StatusCode ExpressionLayer::Forward(const std::vector<std::shared_ptr<Tensor<flo
       << "The expression parser failed to parse " << statement_;
 
   const uint32_t batch_size = outputs.size();
+  // results of inner operators live in the scratch arena until the root operator consumes them
+  utils::ScratchFrame scratch_frame;
   std::stack<std::vector<std::shared_ptr<Tensor<float>>>> op_stack;
   for (auto iter = tokens.rbegin(); iter != tokens.rend(); ++iter) {
     const auto& current_token = *iter;
@@ -79,9 +83,49 @@ StatusCode ExpressionLayer::Forward(const std::vector<std::shared_ptr<Tensor<flo
         LOG(FATAL) << "Unsupported operator type in the expression layer: "
                    << int(current_token.token_type);
       }
-#pragma omp parallel for num_threads(batch_size)
+      bool same_shape = true;
       for (uint32_t i = 0; i < batch_size; ++i) {
-        output_token_nodes.at(i) = function(input_node1.at(i), input_node2.at(i));
+        same_shape = same_shape && input_node1.at(i)->shapes() == input_node2.at(i)->shapes();
+      }
+
+      const size_t elem_size = input_node1.front()->size();
+      const bool is_root = std::next(iter) == tokens.rend();
+      if (same_shape && (batch_size == 1 || utils::ShouldParallel(elem_size))) {
+        // no broadcast needed: split each image into element ranges
+        const bool is_add = current_token.token_type == TokenType::TokenAdd;
+        for (uint32_t i = 0; i < batch_size; ++i) {
+          const sftensor& input1 = input_node1.at(i);
+          const sftensor& input2 = input_node2.at(i);
+          sftensor output;
+          if (!is_root) {
+            output = std::make_shared<Tensor<float>>(scratch_frame.Allocate<float>(input1->size()),
+                                                     input1->shapes());
+          } else if (outputs.at(i) != nullptr && !outputs.at(i)->empty() &&
+                     outputs.at(i)->shapes() == input1->shapes()) {
+            output = outputs.at(i);
+          } else {
+            output = std::make_shared<Tensor<float>>(input1->shapes());
+          }
+          const float* input1_ptr = input1->raw_ptr();
+          const float* input2_ptr = input2->raw_ptr();
+          float* output_ptr = output->raw_ptr();
+          utils::ParallelForRange(output->size(), [&](size_t begin, size_t end) {
+            if (is_add) {
+              for (size_t j = begin; j < end; ++j) {
+                output_ptr[j] = input1_ptr[j] + input2_ptr[j];
+              }
+            } else {
+              for (size_t j = begin; j < end; ++j) {
+                output_ptr[j] = input1_ptr[j] * input2_ptr[j];
+              }
+            }
+          });
+          output_token_nodes.at(i) = output;
+        }
+      } else {
+        utils::ParallelFor(batch_size, elem_size, [&](uint32_t i) {
+          output_token_nodes.at(i) = function(input_node1.at(i), input_node2.at(i));
+        });
       }
       op_stack.push(output_token_nodes);
     }
@@ -127,6 +171,41 @@ StatusCode ExpressionLayer::CreateInstance(const std::shared_ptr<RuntimeOperator
   expression_layer = std::make_shared<ExpressionLayer>(statement_param->value);
   return StatusCode::kSuccess;
 }
+static uint32_t CountExpressionOperators(const std::shared_ptr<RuntimeOperator>& op) {
+  uint32_t operator_count = 0;
+  if (op->has_parameter("expr")) {
+    auto statement_param = std::dynamic_pointer_cast<RuntimeParameterString>(op->params.at("expr"));
+    if (statement_param != nullptr) {
+      const std::string& statement = statement_param->value;
+      for (const std::string& op_name : {"add(", "mul("}) {
+        for (size_t pos = statement.find(op_name); pos != std::string::npos;
+             pos = statement.find(op_name, pos + 1)) {
+          operator_count += 1;
+        }
+      }
+    }
+  }
+  return operator_count;
+}
+
+utils::LayerCost ExpressionLayer::EstimateCost(const std::shared_ptr<RuntimeOperator>& op) {
+  // every binary operator of the statement costs one FLOP per output element
+  return LayerCostRegisterer::ElementwiseCost(op, double(CountExpressionOperators(op)));
+}
+
+size_t ExpressionLayer::ScratchBytes(const std::shared_ptr<RuntimeOperator>& op) {
+  // the root operator writes the outputs, every inner one holds a result per image
+  const uint32_t operator_count = CountExpressionOperators(op);
+  if (operator_count <= 1 || op->output_operands == nullptr || op->output_operands->shapes.empty()) {
+    return 0;
+  }
+  const size_t batch_size = op->output_operands->shapes.front();
+  return (operator_count - 1) * (op->output_operands->size() * sizeof(float) +
+                                 batch_size * utils::ScratchArena::kAlignment);
+}
+
 LayerRegistererWrapper kExpressionCreateInstance(ExpressionLayer::CreateInstance,
                                                  "pnnx.Expression");
+LayerCostRegistererWrapper kExpressionCost(ExpressionLayer::EstimateCost, "pnnx.Expression");
+LayerScratchRegistererWrapper kExpressionScratch(ExpressionLayer::ScratchBytes, "pnnx.Expression");
 }
@@ -2,6 +2,8 @@
 
 #ifndef DL_LAYER_MONOCULAR_EXPRESSION_HPP_
 #define DL_LAYER_MONOCULAR_EXPRESSION_HPP_
+#include "layer/abstract/layer_cost.hpp"
+#include "layer/abstract/layer_scratch.hpp"
 #include "layer/abstract/non_param_layer.hpp"
 #include "parser/parse_expression.hpp"
 
@@ -17,6 +19,11 @@ class ExpressionLayer : public NonParamLayer {
 
   static StatusCode CreateInstance(const std::shared_ptr<RuntimeOperator>& op,
                                    std::shared_ptr<Layer<float>>& expression_layer);
+
+  static utils::LayerCost EstimateCost(const std::shared_ptr<RuntimeOperator>& op);
+
+  static size_t ScratchBytes(const std::shared_ptr<RuntimeOperator>& op);
+
  private:
   std::string statement_;
   std::unique_ptr<ExpressionParser> parser_;
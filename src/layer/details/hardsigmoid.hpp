@@ -1,27 +1,22 @@
 
-#include "hardsigmoid.hpp"
-#include "layer/abstract/layer_factory.hpp"
-#include "simd.hpp"
 
-namespace black_scholes {
-using namespace activation;
-HardSigmoid::HardSigmoid()
-    : ActivationLayer(ActivationType::kActivationHardSigmoid, "HardSigmoid") {}
+#ifndef KUIPER_INFER_SOURCE_LAYER_DETAILS_HARDSIGMOID_HPP_
+#define KUIPER_INFER_SOURCE_LAYER_DETAILS_HARDSIGMOID_HPP_
+
+#include "activation.hpp"
+#include "layer/abstract/layer_cost.hpp"
+#include "layer/abstract/non_param_layer.hpp"
 
-StatusCode HardSigmoid::Forward(const std::vector<std::shared_ptr<Tensor<float>>>& inputs,
-                                std::vector<std::shared_ptr<Tensor<float>>>& outputs) {
-  using namespace activation;
-  return ActivationLayer::Forward(inputs, outputs);
-}
+namespace black_scholes {
+class HardSigmoid : public activation::ActivationLayer {
+ public:
+  explicit HardSigmoid();
+  StatusCode Forward(const std::vector<std::shared_ptr<Tensor<float>>>& inputs,
+                     std::vector<std::shared_ptr<Tensor<float>>>& outputs) override;
+  static StatusCode CreateInstance(const std::shared_ptr<RuntimeOperator>& op,
+                                   std::shared_ptr<Layer<float>>& hardsigmoid_layer);
 
-StatusCode HardSigmoid::CreateInstance(const std::shared_ptr<RuntimeOperator>& op,
-                                       std::shared_ptr<Layer<float>>& hardsigmoid_layer) {
-  if (!op) {
-    LOG(ERROR) << "The hardsigmoid operator parameter in the layer is null pointer.";
-    return StatusCode::kParseNullOperator;
-  }
-  hardsigmoid_layer = std::make_shared<HardSigmoid>();
-  return StatusCode::kSuccess;
-}
-LayerRegistererWrapper kHardSigmoidCreateInstance(HardSigmoid::CreateInstance, "nn.Hardsigmoid");
-}
+  static utils::LayerCost EstimateCost(const std::shared_ptr<RuntimeOperator>& op);
+};
+} 
+#endif
@@ -0,0 +1,101 @@
+
+#include "quantize.hpp"
+#include <algorithm>
+#include <cmath>
+#include "layer/abstract/layer_factory.hpp"
+#include "utils/parallel/parallel_utils.hpp"
+
+namespace black_scholes {
+QuantizeLayer::QuantizeLayer(float scale, bool dequantize)
+    : NonParamLayer(dequantize ? "Dequantize" : "Quantize"), scale_(scale), dequantize_(dequantize) {
+  CHECK_GT(scale_, 0.f) << "The quantization scale must be positive";
+}
+
+StatusCode QuantizeLayer::Forward(const std::vector<std::shared_ptr<Tensor<float>>>& inputs,
+                                  std::vector<std::shared_ptr<Tensor<float>>>& outputs) {
+  if (inputs.empty()) {
+    LOG(ERROR) << "The input tensor array in the quantize layer is empty";
+    return StatusCode::kInferInputsEmpty;
+  }
+
+  if (inputs.size() != outputs.size()) {
+    LOG(ERROR) << "The input and output tensor array size of the quantize layer do not match";
+    return StatusCode::kInferDimMismatch;
+  }
+
+  const float inverse_scale = 1.f / scale_;
+  const uint32_t batch_size = inputs.size();
+  for (uint32_t i = 0; i < batch_size; ++i) {
+    const sftensor& input = inputs.at(i);
+    if (input == nullptr || input->empty()) {
+      LOG(ERROR) << "The input tensor array in the quantize layer has an empty tensor " << i << " th";
+      return StatusCode::kInferInputsEmpty;
+    }
+
+    sftensor output = outputs.at(i);
+    if (output == nullptr || output->empty()) {
+      output = std::make_shared<Tensor<float>>(input->shapes());
+      outputs.at(i) = output;
+    }
+    if (output->shapes() != input->shapes()) {
+      LOG(ERROR) << "The input and output tensor shapes of the quantize layer do not match " << i << " th";
+      return StatusCode::kInferDimMismatch;
+    }
+
+    const float* input_ptr = input->raw_ptr();
+    float* output_ptr = output->raw_ptr();
+    utils::ParallelForRange(input->size(), [&](size_t begin, size_t end) {
+      if (dequantize_) {
+        for (size_t j = begin; j < end; ++j) {
+          output_ptr[j] = input_ptr[j] * scale_;
+        }
+      } else {
+        for (size_t j = begin; j < end; ++j) {
+          output_ptr[j] = std::min(std::max(std::nearbyint(input_ptr[j] * inverse_scale), -127.f), 127.f);
+        }
+      }
+    });
+  }
+  return StatusCode::kSuccess;
+}
+
+StatusCode QuantizeLayer::CreateInstance(const std::shared_ptr<RuntimeOperator>& op,
+                                         std::shared_ptr<Layer<float>>& quantize_layer) {
+  if (!op) {
+    LOG(ERROR) << "The quantize operator parameter in the layer is null pointer.";
+    return StatusCode::kParseNullOperator;
+  }
+
+  if (!op->has_parameter("scale")) {
+    LOG(ERROR) << "Can not find the scale parameter";
+    return StatusCode::kParseParamError;
+  }
+  auto scale = std::dynamic_pointer_cast<RuntimeParameterFloat>(op->params.at("scale"));
+  if (scale == nullptr || !(scale->value > 0.f)) {
+    LOG(ERROR) << "The scale parameter of the quantize operator should be a positive float";
+    return StatusCode::kParseParamError;
+  }
+
+  // only symmetric quantization, the zero point of the int8 levels is 0
+  if (op->has_parameter("zero_point")) {
+    auto zero_point = std::dynamic_pointer_cast<RuntimeParameterInt>(op->params.at("zero_point"));
+    if (zero_point == nullptr || zero_point->value != 0) {
+      LOG(ERROR) << "Only symmetric quantization with a zero point of 0 is supported";
+      return StatusCode::kParseParamError;
+    }
+  }
+
+  quantize_layer = std::make_shared<QuantizeLayer>(scale->value, op->type == "pnnx.Dequantize");
+  return StatusCode::kSuccess;
+}
+
+utils::LayerCost QuantizeLayer::EstimateCost(const std::shared_ptr<RuntimeOperator>& op) {
+  // multiply, round and clamp per element
+  return LayerCostRegisterer::ElementwiseCost(op, 3.);
+}
+
+LayerRegistererWrapper kQuantizeCreateInstance(QuantizeLayer::CreateInstance, "pnnx.Quantize");
+LayerCostRegistererWrapper kQuantizeCost(QuantizeLayer::EstimateCost, "pnnx.Quantize");
+LayerRegistererWrapper kDequantizeCreateInstance(QuantizeLayer::CreateInstance, "pnnx.Dequantize");
+LayerCostRegistererWrapper kDequantizeCost(QuantizeLayer::EstimateCost, "pnnx.Dequantize");
+}  // namespace black_scholes
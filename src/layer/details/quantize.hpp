@@ -0,0 +1,32 @@
+
+#ifndef DL_LAYER_DETAILS_QUANTIZE_HPP_
+#define DL_LAYER_DETAILS_QUANTIZE_HPP_
+#include "layer/abstract/layer_cost.hpp"
+#include "layer/abstract/non_param_layer.hpp"
+
+namespace black_scholes {
+/**
+ * @brief Converts between real values and symmetric int8 levels
+ *
+ * The runtime keeps float tensors, a quantized tensor holds the int8
+ * levels round(x / scale) clamped to [-127, 127] as floats. pnnx.Quantize
+ * produces them, pnnx.Dequantize multiplies them back by the scale.
+ */
+class QuantizeLayer : public NonParamLayer {
+ public:
+  explicit QuantizeLayer(float scale, bool dequantize);
+
+  StatusCode Forward(const std::vector<std::shared_ptr<Tensor<float>>>& inputs,
+                     std::vector<std::shared_ptr<Tensor<float>>>& outputs) override;
+
+  static StatusCode CreateInstance(const std::shared_ptr<RuntimeOperator>& op,
+                                   std::shared_ptr<Layer<float>>& quantize_layer);
+
+  static utils::LayerCost EstimateCost(const std::shared_ptr<RuntimeOperator>& op);
+
+ private:
+  float scale_ = 1.f;
+  bool dequantize_ = false;
+};
+}  // namespace black_scholes
+#endif
@@ -0,0 +1,167 @@
+
+#include "quantized_convolution.hpp"
+#include <glog/logging.h>
+#include <cstring>
+#include "utils/memory/scratch_arena.hpp"
+#include "utils/parallel/parallel_utils.hpp"
+
+namespace black_scholes {
+QuantizedConvolutionLayer::QuantizedConvolutionLayer(
+    uint32_t output_channel, uint32_t in_channel, uint32_t kernel_h, uint32_t kernel_w,
+    uint32_t padding_h, uint32_t padding_w, uint32_t stride_h, uint32_t stride_w, uint32_t groups,
+    bool use_bias, uint32_t dilation_h, uint32_t dilation_w, float input_scale,
+    bool input_quantized, float output_scale)
+    : ConvolutionLayer(output_channel, in_channel, kernel_h, kernel_w, padding_h, padding_w,
+                       stride_h, stride_w, groups, use_bias, 0, 0, dilation_h, dilation_w),
+      input_scale_(input_scale),
+      input_quantized_(input_quantized),
+      output_scale_(output_scale),
+      int8_kernel_(utils::SelectInt8Kernel()) {
+  CHECK_GT(input_scale_, 0.f) << "The input scale of the int8 convolution must be positive";
+  CHECK_GE(output_scale_, 0.f);
+  CHECK(int8_kernel_ != utils::Int8Kernel::kNone) << "No int8 kernel on this CPU";
+}
+
+void QuantizedConvolutionLayer::set_quantized_weights(const std::vector<int8_t>& weights,
+                                                      const std::vector<float>& scales) {
+  const uint32_t kernel_count = kernel_count_;
+  CHECK_GT(kernel_count, 0);
+  const uint32_t kernel_size = kernel_channel_ * kernel_h_ * kernel_w_;
+  CHECK_EQ(weights.size(), size_t(kernel_count) * kernel_size);
+  CHECK(scales.size() == 1 || scales.size() == kernel_count)
+      << "The int8 weights need one scale or one per output channel";
+
+  weight_scales_.resize(kernel_count);
+  for (uint32_t k = 0; k < kernel_count; ++k) {
+    weight_scales_.at(k) = scales.size() == 1 ? scales.front() : scales.at(k);
+  }
+  quantized_weights_ = weights;
+
+  // the int8 levels are packed as they are, the float kernels are never built
+  ReleaseWeights();
+}
+
+void QuantizedConvolutionLayer::InitIm2ColWeight() {
+  const uint32_t kernel_count = kernel_count_;
+  CHECK(kernel_count > 0) << "kernel count must greater than zero";
+  CHECK(!quantized_weights_.empty()) << "The int8 weights of the convolution are not set";
+  const uint32_t kernel_h = kernel_h_;
+  const uint32_t kernel_w = kernel_w_;
+  const uint32_t kernel_c = kernel_channel_;
+  const uint32_t kernel_count_group = kernel_count / groups_;
+  const uint32_t depth = kernel_c * kernel_h * kernel_w;
+
+  // pytorch stores (ic, kh, kw), the im2col rows are (ic, kw, kh) like the float convolution
+  packed_weights_.resize(groups_);
+  size_t packed_bytes = 0;
+  std::vector<int8_t> group_weights(size_t(kernel_count_group) * depth);
+  for (uint32_t group = 0; group < groups_; ++group) {
+    for (uint32_t kg = 0; kg < kernel_count_group; ++kg) {
+      const int8_t* kernel_ptr =
+          quantized_weights_.data() + size_t(group * kernel_count_group + kg) * depth;
+      int8_t* group_ptr = group_weights.data() + size_t(kg) * depth;
+      for (uint32_t ic = 0; ic < kernel_c; ++ic) {
+        for (uint32_t kw = 0; kw < kernel_w; ++kw) {
+          for (uint32_t kh = 0; kh < kernel_h; ++kh) {
+            *group_ptr++ = kernel_ptr[(ic * kernel_h + kh) * kernel_w + kw];
+          }
+        }
+      }
+    }
+    packed_weights_.at(group) =
+        utils::PackInt8Matrix(group_weights.data(), weight_scales_.data() + group * kernel_count_group,
+                              kernel_count_group, depth, int8_kernel_);
+    packed_bytes += packed_weights_.at(group).bytes();
+  }
+
+  // the int32 accumulators become real values, or int8 levels of the output scale
+  const float output_scale = output_scale_ > 0.f ? output_scale_ : 1.f;
+  epilogue_scales_.resize(kernel_count);
+  epilogue_bias_.resize(kernel_count);
+  for (uint32_t k = 0; k < kernel_count; ++k) {
+    const utils::Int8PackedMatrix& packed = packed_weights_.at(k / kernel_count_group);
+    epilogue_scales_.at(k) = input_scale_ * packed.scales.at(k % kernel_count_group) / output_scale;
+    epilogue_bias_.at(k) = BiasValue(k) / output_scale;
+  }
+
+  std::vector<int8_t>().swap(quantized_weights_);
+  kernel_matrix_memory_.Resize(packed_bytes + size_t(kernel_count) * 2 * sizeof(float));
+  LOG(INFO) << "Int8 convolution uses the " << utils::Int8KernelName(int8_kernel_) << " kernel";
+}
+
+void QuantizedConvolutionLayer::ReleaseKernels() {
+  std::vector<utils::Int8PackedMatrix>().swap(packed_weights_);
+  std::vector<float>().swap(epilogue_scales_);
+  std::vector<float>().swap(epilogue_bias_);
+  ConvolutionLayer::ReleaseKernels();
+}
+
+void QuantizedConvolutionLayer::ForEachWeightRegion(
+    const std::function<void(const void*, size_t)>& visit) const {
+  ConvolutionLayer::ForEachWeightRegion(visit);
+  for (const utils::Int8PackedMatrix& packed : packed_weights_) {
+    visit(packed.data.data(), packed.data.size() * sizeof(int8_t));
+  }
+}
+
+void QuantizedConvolutionLayer::ComputeOutput(sftensor input, sftensor output_tensor,
+                                              uint32_t kernel_h, uint32_t kernel_w,
+                                              uint32_t kernel_count_group, uint32_t input_h,
+                                              uint32_t input_w, uint32_t channels_per_group,
+                                              uint32_t output_h, uint32_t output_w,
+                                              uint32_t group) const {
+  CHECK(group < packed_weights_.size());
+  const utils::Int8PackedMatrix& packed = packed_weights_.at(group);
+  const uint32_t output_hw = output_h * output_w;
+
+  utils::ScratchFrame scratch_frame;
+  uint8_t* activations = scratch_frame.Allocate<uint8_t>(size_t(output_hw) * packed.padded_depth);
+  QuantizedIm2Col(input, activations, kernel_h, kernel_w, input_h, input_w, channels_per_group,
+                  output_h, output_w, group, packed.padded_depth);
+
+  const uint32_t kernel_offset = group * kernel_count_group;
+  utils::Int8Epilogue epilogue;
+  epilogue.scales = epilogue_scales_.data() + kernel_offset;
+  epilogue.bias = use_bias_ ? epilogue_bias_.data() + kernel_offset : nullptr;
+  epilogue.requantize = output_scale_ > 0.f;
+  utils::Int8GemmRequantize(packed, activations, output_hw, epilogue,
+                            output_tensor->matrix_raw_ptr(kernel_offset), output_hw);
+}
+
+void QuantizedConvolutionLayer::QuantizedIm2Col(const sftensor& input, uint8_t* activations,
+                                                uint32_t kernel_h, uint32_t kernel_w,
+                                                uint32_t input_h, uint32_t input_w,
+                                                uint32_t channels_per_group, uint32_t output_h,
+                                                uint32_t output_w, uint32_t group,
+                                                uint32_t padded_depth) const {
+  CHECK(input && !input->empty()) << "The input tensor of the im2col function cannot be empty.";
+  const float inverse_scale = input_quantized_ ? 1.f : 1.f / input_scale_;
+  const uint8_t zero_level = uint8_t(utils::kInt8ActivationOffset);
+  const uint32_t depth = channels_per_group * kernel_h * kernel_w;
+  const uint32_t channels_offset = group * channels_per_group;
+
+  utils::ParallelFor(output_w, size_t(output_h) * padded_depth, [&](uint32_t w) {
+    for (uint32_t r = 0; r < output_h; ++r) {
+      uint8_t* row_ptr = activations + (size_t(w) * output_h + r) * padded_depth;
+      for (uint32_t ic = 0; ic < channels_per_group; ++ic) {
+        const float* input_channel_ptr = input->matrix_raw_ptr(ic + channels_offset);
+        for (uint32_t kw = 0; kw < kernel_w; ++kw) {
+          const int32_t iw = int32_t(w * stride_w_ + kw * dilation_w_) - int32_t(padding_w_);
+          const bool inside_w = iw >= 0 && iw < int32_t(input_w);
+          for (uint32_t kh = 0; kh < kernel_h; ++kh) {
+            const int32_t ih = int32_t(r * stride_h_ + kh * dilation_h_) - int32_t(padding_h_);
+            if (inside_w && ih >= 0 && ih < int32_t(input_h)) {
+              *row_ptr++ = utils::QuantizeActivation(
+                  input_channel_ptr[size_t(iw) * input_h + ih], inverse_scale);
+            } else {
+              *row_ptr++ = zero_level;
+            }
+          }
+        }
+      }
+      // the padded weights are zero, any level works for the tail
+      std::memset(row_ptr, zero_level, padded_depth - depth);
+    }
+  });
+}
+}  // namespace black_scholes
@@ -0,0 +1,73 @@
+
+#ifndef DL_SOURCE_LAYER_QUANTIZED_CONVOLUTION_HPP_
+#define DL_SOURCE_LAYER_QUANTIZED_CONVOLUTION_HPP_
+#include "convolution.hpp"
+#include "utils/math/int8_gemm.hpp"
+
+namespace black_scholes {
+/**
+ * @brief Convolution with per-channel symmetric int8 weights computed on int8 kernels
+ *
+ * The input is quantized with input_scale while it is unfolded, the GEMM
+ * accumulates in int32 and its epilogue dequantizes the results, adds the
+ * bias and, when an output scale is given, requantizes them to int8 levels
+ * for a following int8 layer.
+ */
+class QuantizedConvolutionLayer : public ConvolutionLayer {
+ public:
+  /**
+   * @param input_scale Scale of the input activations
+   * @param input_quantized The input already holds int8 levels, e.g. from pnnx.Quantize
+   * @param output_scale Scale of the int8 levels written to the output, 0 writes real values
+   */
+  explicit QuantizedConvolutionLayer(uint32_t output_channel, uint32_t in_channel, uint32_t kernel_h,
+                                     uint32_t kernel_w, uint32_t padding_h, uint32_t padding_w,
+                                     uint32_t stride_h, uint32_t stride_w, uint32_t groups, bool use_bias,
+                                     uint32_t dilation_h, uint32_t dilation_w, float input_scale,
+                                     bool input_quantized, float output_scale);
+
+  /**
+   * @brief Sets the int8 weights in the pytorch (out, in / groups, kh, kw) layout
+   *
+   * @param weights The int8 levels
+   * @param scales One scale per output channel, or one for the whole tensor
+   */
+  void set_quantized_weights(const std::vector<int8_t>& weights, const std::vector<float>& scales);
+
+ private:
+  void InitIm2ColWeight() override;
+
+  void ReleaseKernels() override;
+
+  void ForEachWeightRegion(
+      const std::function<void(const void*, size_t)>& visit) const override;
+
+  void ComputeOutput(sftensor input, sftensor output_tensor, uint32_t kernel_h, uint32_t kernel_w,
+                     uint32_t kernel_count_group, uint32_t input_h, uint32_t input_w,
+                     uint32_t channels_per_group, uint32_t output_h, uint32_t output_w,
+                     uint32_t group) const override;
+
+  /**
+   * @brief Unfolds and quantizes the input patches of one group, one padded row per output pixel
+   */
+  void QuantizedIm2Col(const sftensor& input, uint8_t* activations, uint32_t kernel_h,
+                       uint32_t kernel_w, uint32_t input_h, uint32_t input_w,
+                       uint32_t channels_per_group, uint32_t output_h, uint32_t output_w,
+                       uint32_t group, uint32_t padded_depth) const;
+
+  float input_scale_ = 1.f;
+  bool input_quantized_ = false;
+  float output_scale_ = 0.f;
+  utils::Int8Kernel int8_kernel_ = utils::Int8Kernel::kNone;
+
+  /// int8 levels and scales until they are packed
+  std::vector<int8_t> quantized_weights_;
+  std::vector<float> weight_scales_;
+
+  std::vector<utils::Int8PackedMatrix> packed_weights_;
+  std::vector<float> epilogue_scales_;
+  std::vector<float> epilogue_bias_;
+};
+}  // namespace black_scholes
+
+#endif
@@ -24,5 +24,11 @@ StatusCode SiLULayer::CreateInstance(const std::shared_ptr<RuntimeOperator>& op,
   return StatusCode::kSuccess;
 }
 SiLULayer::SiLULayer() : ActivationLayer(ActivationType::kActivationSilu, "nn.SiLU") {}
+utils::LayerCost SiLULayer::EstimateCost(const std::shared_ptr<RuntimeOperator>& op) {
+  // x / (1 + exp(-x)): negate, exp, add and divide per element
+  return LayerCostRegisterer::ElementwiseCost(op, 4.);
+}
+
 LayerRegistererWrapper kSiluCreateInstance(SiLULayer::CreateInstance, "nn.SiLU");
+LayerCostRegistererWrapper kSiluCost(SiLULayer::EstimateCost, "nn.SiLU");
 }  // namespace kuiper_infer
@@ -2,6 +2,7 @@
 #ifndef DL_LAYER_DETAILS_SILU_HPP_
 #define DL_LAYER_DETAILS_SILU_HPP_
 #include "activation.hpp"
+#include "layer/abstract/layer_cost.hpp"
 #include "layer/abstract/non_param_layer.hpp"
 namespace black_scholes {
 class SiLULayer : public activation::ActivationLayer {
@@ -13,6 +14,8 @@ class SiLULayer : public activation::ActivationLayer {
 
   static StatusCode CreateInstance(const std::shared_ptr<RuntimeOperator>& op,
                                    std::shared_ptr<Layer<float>>& silu_layer);
+
+  static utils::LayerCost EstimateCost(const std::shared_ptr<RuntimeOperator>& op);
 };
 } 
 #endif 
\ No newline at end of file
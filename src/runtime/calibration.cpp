@@ -0,0 +1,371 @@
+
+#include "runtime/calibration.hpp"
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include "utils/parallel/parallel_utils.hpp"
+
+namespace black_scholes
+{
+/// Positive int8 levels of the symmetric quantization
+constexpr uint32_t kQuantizeLevels = 128;
+
+const char* CalibrationMethodName(CalibrationMethod method)
+{
+    switch (method)
+    {
+        case CalibrationMethod::kMinMax:
+            return "minmax";
+        case CalibrationMethod::kPercentile:
+            return "percentile";
+        case CalibrationMethod::kKLDivergence:
+            return "kl";
+        default:
+            return "unknown";
+    }
+}
+
+TensorStatistics::TensorStatistics(uint32_t histogram_bins)
+    : min_(std::numeric_limits<float>::max()),
+      max_(std::numeric_limits<float>::lowest()),
+      histogram_(std::max(histogram_bins, kQuantizeLevels), 0)
+{
+}
+
+void TensorStatistics::UpdateRange(const std::vector<sftensor>& tensors)
+{
+    const uint32_t samples = tensors.size();
+    std::vector<float> sample_min(samples, std::numeric_limits<float>::max());
+    std::vector<float> sample_max(samples, std::numeric_limits<float>::lowest());
+    const size_t sample_size = tensors.empty() || tensors.front() == nullptr ? 0 : tensors.front()->size();
+    utils::ParallelFor(samples, sample_size,
+                       [&](uint32_t sample)
+                       {
+                           const sftensor& tensor = tensors.at(sample);
+                           if (tensor == nullptr || tensor->empty())
+                           {
+                               return;
+                           }
+                           const float* data = tensor->raw_ptr();
+                           const uint32_t size = tensor->size();
+                           float local_min = sample_min.at(sample);
+                           float local_max = sample_max.at(sample);
+                           for (uint32_t i = 0; i < size; ++i)
+                           {
+                               local_min = std::min(local_min, data[i]);
+                               local_max = std::max(local_max, data[i]);
+                           }
+                           sample_min.at(sample) = local_min;
+                           sample_max.at(sample) = local_max;
+                       });
+    for (uint32_t sample = 0; sample < samples; ++sample)
+    {
+        min_ = std::min(min_, sample_min.at(sample));
+        max_ = std::max(max_, sample_max.at(sample));
+    }
+}
+
+void TensorStatistics::UpdateHistogram(const std::vector<sftensor>& tensors)
+{
+    const float range = abs_max();
+    if (range <= 0.f)
+    {
+        return;
+    }
+    const uint32_t bins = histogram_.size();
+    const float bins_per_value = float(bins) / range;
+    const uint32_t samples = tensors.size();
+    // one histogram per sample, so the samples are counted without atomics
+    std::vector<std::vector<uint64_t>> sample_histograms(samples);
+    const size_t sample_size = tensors.empty() || tensors.front() == nullptr ? 0 : tensors.front()->size();
+    utils::ParallelFor(samples, sample_size,
+                       [&](uint32_t sample)
+                       {
+                           const sftensor& tensor = tensors.at(sample);
+                           if (tensor == nullptr || tensor->empty())
+                           {
+                               return;
+                           }
+                           std::vector<uint64_t>& histogram = sample_histograms.at(sample);
+                           histogram.assign(bins, 0);
+                           const float* data = tensor->raw_ptr();
+                           const uint32_t size = tensor->size();
+                           for (uint32_t i = 0; i < size; ++i)
+                           {
+                               const uint32_t bin = uint32_t(std::fabs(data[i]) * bins_per_value);
+                               histogram[std::min(bin, bins - 1)] += 1;
+                           }
+                       });
+    for (const std::vector<uint64_t>& histogram : sample_histograms)
+    {
+        for (uint32_t bin = 0; bin < histogram.size(); ++bin)
+        {
+            histogram_.at(bin) += histogram.at(bin);
+        }
+    }
+}
+
+float TensorStatistics::PercentileThreshold(float percentile) const
+{
+    uint64_t total = 0;
+    for (uint64_t count : histogram_)
+    {
+        total += count;
+    }
+    if (total == 0)
+    {
+        return abs_max();
+    }
+    const double kept = double(total) * std::min(std::max(percentile, 0.f), 100.f) / 100.;
+    const float bin_width = abs_max() / histogram_.size();
+    uint64_t cumulative = 0;
+    for (uint32_t bin = 0; bin < histogram_.size(); ++bin)
+    {
+        cumulative += histogram_.at(bin);
+        if (double(cumulative) >= kept)
+        {
+            return (bin + 1) * bin_width;
+        }
+    }
+    return abs_max();
+}
+
+float TensorStatistics::KLDivergenceThreshold() const
+{
+    // every candidate threshold clips the histogram at a bin boundary, P folds the clipped tail into its last bin
+    // and Q is P merged into the 128 quantization levels and spread back over the non-empty bins
+    const uint32_t bins = histogram_.size();
+    const float bin_width = abs_max() / bins;
+    uint32_t best_bins = bins;
+    double best_divergence = std::numeric_limits<double>::max();
+
+    std::vector<double> reference(bins);
+    std::vector<double> expanded(bins);
+    uint64_t outliers = 0;
+    for (uint32_t bin = kQuantizeLevels; bin < bins; ++bin)
+    {
+        outliers += histogram_.at(bin);
+    }
+    for (uint32_t threshold_bins = kQuantizeLevels; threshold_bins <= bins; ++threshold_bins)
+    {
+        for (uint32_t bin = 0; bin < threshold_bins; ++bin)
+        {
+            reference.at(bin) = double(histogram_.at(bin));
+        }
+        reference.at(threshold_bins - 1) += double(outliers);
+        if (threshold_bins < bins)
+        {
+            outliers -= histogram_.at(threshold_bins);
+        }
+
+        const double bins_per_level = double(threshold_bins) / kQuantizeLevels;
+        for (uint32_t level = 0; level < kQuantizeLevels; ++level)
+        {
+            const uint32_t begin = uint32_t(level * bins_per_level);
+            const uint32_t end = level + 1 == kQuantizeLevels
+                                     ? threshold_bins
+                                     : std::max(uint32_t((level + 1) * bins_per_level), begin + 1);
+            double level_count = 0;
+            uint32_t nonzero_bins = 0;
+            for (uint32_t bin = begin; bin < end; ++bin)
+            {
+                level_count += double(histogram_.at(bin));
+                nonzero_bins += reference.at(bin) != 0;
+            }
+            for (uint32_t bin = begin; bin < end; ++bin)
+            {
+                expanded.at(bin) = reference.at(bin) != 0 ? level_count / nonzero_bins : 0.;
+            }
+        }
+
+        double reference_sum = 0;
+        double expanded_sum = 0;
+        for (uint32_t bin = 0; bin < threshold_bins; ++bin)
+        {
+            reference_sum += reference.at(bin);
+            expanded_sum += expanded.at(bin);
+        }
+        if (reference_sum == 0 || expanded_sum == 0)
+        {
+            continue;
+        }
+        double divergence = 0;
+        for (uint32_t bin = 0; bin < threshold_bins; ++bin)
+        {
+            const double p = reference.at(bin) / reference_sum;
+            if (p == 0)
+            {
+                continue;
+            }
+            // a level whose bins were all clipped into the tail has no mass in Q, keep the divergence finite
+            const double q = std::max(expanded.at(bin) / expanded_sum, 1e-12);
+            divergence += p * std::log(p / q);
+        }
+        if (divergence < best_divergence)
+        {
+            best_divergence = divergence;
+            best_bins = threshold_bins;
+        }
+    }
+    return (best_bins + 0.5f) * bin_width;
+}
+
+float TensorStatistics::Scale(const CalibrationConfig& config) const
+{
+    float threshold = abs_max();
+    if (threshold > 0.f && config.method == CalibrationMethod::kPercentile)
+    {
+        threshold = PercentileThreshold(config.percentile);
+    }
+    else if (threshold > 0.f && config.method == CalibrationMethod::kKLDivergence)
+    {
+        threshold = std::min(KLDivergenceThreshold(), threshold);
+    }
+    if (!(threshold > 0.f))
+    {
+        // a tensor that stayed zero quantizes exactly with any scale
+        return 1.f / 127.f;
+    }
+    return threshold / 127.f;
+}
+
+float TensorStatistics::min() const
+{
+    return this->min_;
+}
+
+float TensorStatistics::max() const
+{
+    return this->max_;
+}
+
+float TensorStatistics::abs_max() const
+{
+    if (min_ > max_)
+    {
+        return 0.f;
+    }
+    return std::max(std::fabs(min_), std::fabs(max_));
+}
+
+void CalibrationTable::set_scale(const std::string& tensor_name, float scale)
+{
+    CHECK_GT(scale, 0.f) << "The scale of " << tensor_name << " must be positive";
+    this->scales_[tensor_name] = scale;
+}
+
+bool CalibrationTable::has_scale(const std::string& tensor_name) const
+{
+    return scales_.find(tensor_name) != scales_.end();
+}
+
+float CalibrationTable::scale(const std::string& tensor_name) const
+{
+    auto scale_iter = scales_.find(tensor_name);
+    CHECK(scale_iter != scales_.end()) << "Can not find the scale of the tensor: " << tensor_name;
+    return scale_iter->second;
+}
+
+const std::map<std::string, float>& CalibrationTable::scales() const
+{
+    return this->scales_;
+}
+
+bool CalibrationTable::empty() const
+{
+    return scales_.empty();
+}
+
+bool CalibrationTable::Save(const std::string& path) const
+{
+    std::ofstream table_file(path);
+    if (!table_file.is_open())
+    {
+        LOG(ERROR) << "Can not open the calibration file: " << path;
+        return false;
+    }
+    table_file << "# tensor scale\n";
+    table_file << std::setprecision(9);
+    for (const auto& [tensor_name, scale] : scales_)
+    {
+        table_file << tensor_name << " " << scale << "\n";
+    }
+    return table_file.good();
+}
+
+bool CalibrationTable::Load(const std::string& path, CalibrationTable& table)
+{
+    std::ifstream table_file(path);
+    if (!table_file.is_open())
+    {
+        LOG(ERROR) << "Can not open the calibration file: " << path;
+        return false;
+    }
+    std::string line;
+    uint32_t line_number = 0;
+    while (std::getline(table_file, line))
+    {
+        line_number += 1;
+        if (line.empty() || line.front() == '#')
+        {
+            continue;
+        }
+        std::istringstream line_stream(line);
+        std::string tensor_name;
+        float scale = 0.f;
+        if (!(line_stream >> tensor_name >> scale) || !(scale > 0.f))
+        {
+            LOG(ERROR) << "Wrong calibration entry at line " << line_number << " of " << path;
+            return false;
+        }
+        table.set_scale(tensor_name, scale);
+    }
+    return true;
+}
+
+CalibrationCollector::CalibrationCollector(const CalibrationConfig& config) : config_(config)
+{
+}
+
+void CalibrationCollector::Observe(const std::string& tensor_name, const std::vector<sftensor>& tensors)
+{
+    auto statistics_iter = statistics_.find(tensor_name);
+    if (statistics_iter == statistics_.end())
+    {
+        CHECK(!histogram_pass_) << "The tensor " << tensor_name << " was not seen by the range pass";
+        statistics_iter = statistics_.emplace(tensor_name, TensorStatistics(config_.histogram_bins)).first;
+    }
+    if (histogram_pass_)
+    {
+        statistics_iter->second.UpdateHistogram(tensors);
+    }
+    else
+    {
+        statistics_iter->second.UpdateRange(tensors);
+    }
+}
+
+void CalibrationCollector::StartHistogramPass()
+{
+    this->histogram_pass_ = true;
+}
+
+bool CalibrationCollector::needs_histogram() const
+{
+    return config_.method != CalibrationMethod::kMinMax;
+}
+
+CalibrationTable CalibrationCollector::Finish() const
+{
+    CalibrationTable table;
+    for (const auto& [tensor_name, statistics] : statistics_)
+    {
+        table.set_scale(tensor_name, statistics.Scale(config_));
+    }
+    return table;
+}
+}  // namespace black_scholes
@@ -1,13 +1,26 @@
 
 #include "runtime/runtime_ir.hpp"
+#include <omp.h>
+#include <algorithm>
+#include <cstring>
 #include <deque>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <utility>
 #include <vector>
+#include "layer/abstract/layer_cost.hpp"
 #include "layer/abstract/layer_factory.hpp"
+#include "layer/abstract/layer_scratch.hpp"
+#include "layer/abstract/param_layer.hpp"
 #include "runtime/runtime_ir.hpp"
+#include "utils/math/weight_quantization.hpp"
+#include "utils/memory/scratch_arena.hpp"
+#include "utils/time/latency_histogram.hpp"
 #include "utils/time/time_logging.hpp"
+#include "utils/time/trace_profiler.hpp"
 
 namespace black_scholes
 {
@@ -38,9 +51,188 @@ const std::string& RuntimeGraph::bin_path() const
 
 static bool IsQuantizeOp(const pnnx::Operator* op)
 {
+    if (op->type == "pnnx.Quantize" || op->type == "pnnx.Dequantize")
+    {
+        return true;
+    }
+    for (const auto& [_, attr] : op->attrs)
+    {
+        // int8 levels, or int4 levels packed in bytes by the weight compression tool
+        if (attr.type == 7 || attr.type == 8)
+        {
+            return true;
+        }
+    }
     return false;
 }
 
+static bool IsSupportedQuantizeOp(const pnnx::Operator* op)
+{
+    // int8 convolution weights run on the int8 kernels or are dequantized for the float layers
+    static const std::set<std::string> quantize_op_types = {"pnnx.Quantize", "pnnx.Dequantize", "nn.Conv2d",
+                                                            "nn.ConvTranspose2d"};
+    return quantize_op_types.find(op->type) != quantize_op_types.end();
+}
+
+static size_t PnnxAttributeBytes(const std::vector<pnnx::Operator*>& operators)
+{
+    size_t attribute_bytes = 0;
+    for (const pnnx::Operator* op : operators)
+    {
+        if (op == nullptr)
+        {
+            continue;
+        }
+        for (const auto& [_, attr] : op->attrs)
+        {
+            attribute_bytes += attr.data.size();
+        }
+    }
+    return attribute_bytes;
+}
+
+static int64_t RuntimeAttributeBytes(const std::shared_ptr<RuntimeOperator>& op)
+{
+    int64_t attribute_bytes = 0;
+    for (const auto& [_, attribute] : op->attribute)
+    {
+        if (attribute != nullptr)
+        {
+            attribute_bytes += int64_t(attribute->weight_data.size());
+        }
+    }
+    return attribute_bytes;
+}
+
+/**
+ * @brief Dequantizes a weight compressed to int4 groups by the weight compression tool
+ *
+ * The "weight" attribute holds the packed levels and "weight_scales" one
+ * scale per group, the weight_bits, weight_group_size and weight_shape
+ * parameters describe them. Int8 weights are left to the layers, which
+ * either compute on them or dequantize them, see DequantizeInt8Weights for
+ * the layers without int8 kernels.
+ */
+static void DecompressInt4Weight(const std::shared_ptr<RuntimeOperator>& op)
+{
+    if (!op->has_parameter("weight_bits"))
+    {
+        return;
+    }
+    auto weight_bits = std::dynamic_pointer_cast<RuntimeParameterInt>(op->params.at("weight_bits"));
+    LOG_IF(FATAL, weight_bits == nullptr) << "The weight_bits parameter of " << op->name << " is not an integer";
+    if (weight_bits->value != 4)
+    {
+        LOG_IF(FATAL, weight_bits->value != 8)
+            << "Unsupported weight bits " << weight_bits->value << " of " << op->name;
+        return;
+    }
+
+    auto group_size = op->has_parameter("weight_group_size")
+                          ? std::dynamic_pointer_cast<RuntimeParameterInt>(op->params.at("weight_group_size"))
+                          : nullptr;
+    auto weight_shape = op->has_parameter("weight_shape")
+                            ? std::dynamic_pointer_cast<RuntimeParameterIntArray>(op->params.at("weight_shape"))
+                            : nullptr;
+    LOG_IF(FATAL, group_size == nullptr || group_size->value <= 0 || weight_shape == nullptr ||
+                      weight_shape->value.empty() || !op->has_attribute("weight") ||
+                      !op->has_attribute("weight_scales"))
+        << "The int4 weight of " << op->name << " needs weight_group_size, weight_shape and weight_scales";
+
+    const std::vector<int32_t>& shape = weight_shape->value;
+    size_t count = 1;
+    for (int32_t dim : shape)
+    {
+        count *= dim;
+    }
+    const size_t row_len = count / shape.front();
+    const std::shared_ptr<RuntimeAttribute>& weight = op->attribute.at("weight");
+    LOG_IF(FATAL, weight->type != RuntimeDataType::kTypeUInt8) << "The int4 weight of " << op->name << " is not packed";
+    const std::vector<float> weights = utils::DequantizeWeightsInt4(
+        weight->get<uint8_t>(), op->attribute.at("weight_scales")->get<float>(), count, row_len, group_size->value);
+
+    std::vector<char> weight_data(count * sizeof(float));
+    std::memcpy(weight_data.data(), weights.data(), weight_data.size());
+    op->attribute["weight"] = std::make_shared<RuntimeAttribute>(shape, RuntimeDataType::kTypeFloat32, weight_data);
+    op->attribute.erase("weight_scales");
+}
+
+/**
+ * @brief Dequantizes the int8 attributes of an operator without int8 kernels
+ *
+ * Every int8 attribute "name" comes with a "name_scales" attribute holding
+ * one scale per row of its first dimension, or one for the whole tensor.
+ * The attribute is replaced by its float32 values so the float layer runs
+ * on it.
+ */
+static void DequantizeInt8Weights(const std::shared_ptr<RuntimeOperator>& op)
+{
+    std::vector<std::string> quantized_names;
+    for (const auto& [name, attribute] : op->attribute)
+    {
+        if (attribute->type == RuntimeDataType::kTypeInt8)
+        {
+            quantized_names.push_back(name);
+        }
+    }
+
+    for (const std::string& name : quantized_names)
+    {
+        const std::string scales_name = name + "_scales";
+        LOG_IF(FATAL, !op->has_attribute(scales_name))
+            << "Can not find the " << scales_name << " attribute of the int8 " << name << " of " << op->name;
+        const std::shared_ptr<RuntimeAttribute>& attribute = op->attribute.at(name);
+        const std::vector<int32_t> shape = attribute->shape;
+        const std::vector<int8_t> levels = attribute->get<int8_t>();
+        const size_t row_len = shape.empty() || shape.front() <= 0 ? levels.size() : levels.size() / shape.front();
+        const std::vector<float> weights =
+            utils::DequantizeWeightsInt8(levels, op->attribute.at(scales_name)->get<float>(), row_len);
+
+        std::vector<char> weight_data(weights.size() * sizeof(float));
+        std::memcpy(weight_data.data(), weights.data(), weight_data.size());
+        op->attribute[name] = std::make_shared<RuntimeAttribute>(shape, RuntimeDataType::kTypeFloat32, weight_data);
+        op->attribute.erase(scales_name);
+    }
+    if (!quantized_names.empty())
+    {
+        LOG(INFO) << "The int8 weights of " << op->name << " type: " << op->type
+                  << " are dequantized for the float layer";
+    }
+}
+
+/**
+ * @brief Rewrites the batch of the operands of a loaded graph
+ *
+ * The batch of the model is the first dimension of its inputs, every
+ * operand starting with it takes the new batch.
+ */
+static void ResizeOperandBatch(pnnx::Graph& graph, int32_t batch_size)
+{
+    int32_t exported_batch = 0;
+    for (const pnnx::Operator* op : graph.ops)
+    {
+        if (op->type == "pnnx.Input" && !op->outputs.empty() && !op->outputs.front()->shape.empty())
+        {
+            exported_batch = op->outputs.front()->shape.front();
+            break;
+        }
+    }
+    LOG_IF(FATAL, exported_batch <= 0) << "Can not find the batch of the model inputs";
+    if (exported_batch == batch_size)
+    {
+        return;
+    }
+
+    for (pnnx::Operand* operand : graph.operands)
+    {
+        if (!operand->shape.empty() && operand->shape.front() == exported_batch)
+        {
+            operand->shape.front() = batch_size;
+        }
+    }
+    LOG(INFO) << "The batch of the model is changed from " << exported_batch << " to " << batch_size;
+}
+
 bool RuntimeGraph::Init()
 {
     if (this->bin_path_.empty() || this->param_path_.empty())
@@ -56,6 +248,10 @@ bool RuntimeGraph::Init()
         LOG(ERROR) << "Can not find the param path or bin path: " << param_path_ << " " << bin_path_;
         return false;
     }
+    if (batch_size_ > 0)
+    {
+        ResizeOperandBatch(*graph_, int32_t(batch_size_));
+    }
 
     std::vector<pnnx::Operator*> operators = this->graph_->ops;
     if (operators.empty())
@@ -64,6 +260,13 @@ bool RuntimeGraph::Init()
         return false;
     }
 
+    this->memory_account_ = utils::MemoryAccount::Create(param_path_);
+    {
+        // the attribute data of the pnnx graph lives until the end of Build
+        utils::MemoryScope memory_scope(memory_account_.get(), utils::MemoryCategory::kParseBuffers);
+        this->pnnx_memory_.Resize(PnnxAttributeBytes(operators));
+    }
+
     operators_.clear();
     for (const pnnx::Operator* op : operators)
     {
@@ -74,29 +277,29 @@ bool RuntimeGraph::Init()
         }
         else
         {
-            if (!IsQuantizeOp(op))
+            std::shared_ptr<RuntimeOperator> runtime_operator = std::make_shared<RuntimeOperator>();
+            // 初始化算子的名称
+            runtime_operator->name = op->name;
+            runtime_operator->type = op->type;
+            runtime_operator->memory_account = utils::MemoryAccount::Create(op->name, memory_account_);
+
+            // 初始化算子中的input
+            InitGraphOperatorsInput(op->inputs, runtime_operator);
+
+            // 记录输出operand中的名称
+            InitGraphOperatorsOutput(op->outputs, runtime_operator);
+
+            // 初始化算子中的attribute(权重)
+            InitGraphAttrs(op->attrs, runtime_operator);
+            InitGraphParams(op->params, runtime_operator);
+            DecompressInt4Weight(runtime_operator);
+            if (IsQuantizeOp(op) && !IsSupportedQuantizeOp(op))
             {
-                std::shared_ptr<RuntimeOperator> runtime_operator = std::make_shared<RuntimeOperator>();
-                // 初始化算子的名称
-                runtime_operator->name = op->name;
-                runtime_operator->type = op->type;
-
-                // 初始化算子中的input
-                InitGraphOperatorsInput(op->inputs, runtime_operator);
-
-                // 记录输出operand中的名称
-                InitGraphOperatorsOutput(op->outputs, runtime_operator);
-
-                // 初始化算子中的attribute(权重)
-                InitGraphAttrs(op->attrs, runtime_operator);
-
-                InitGraphParams(op->params, runtime_operator);
-                this->operators_.push_back(runtime_operator);
-            }
-            else
-            {
-                LOG(FATAL) << "UnSupported quantize operator in the model " << op->name << " type: " << op->type;
+                DequantizeInt8Weights(runtime_operator);
             }
+            runtime_operator->memory_account->Allocate(utils::MemoryCategory::kParseBuffers,
+                                                       RuntimeAttributeBytes(runtime_operator));
+            this->operators_.push_back(runtime_operator);
         }
     }
 
@@ -114,6 +317,7 @@ void RuntimeGraph::Build()
 
     if (graph_state_ == GraphState::NeedInit)
     {
+        utils::ScopedNodeAffinity init_affinity(numa_policy_.node);
         bool init_graph = Init();
         LOG_IF(FATAL, !init_graph || graph_state_ == GraphState::NeedInit) << "Init graph failed!";
     }
@@ -121,6 +325,8 @@ void RuntimeGraph::Build()
     CHECK(graph_state_ >= GraphState::NeedBuild) << "Graph status error, current state is " << int32_t(graph_state_);
     LOG_IF(FATAL, this->operators_.empty()) << "Graph operators is empty, may be no init";
 
+    // everything allocated below is first touched by a thread running on the graph's node
+    utils::ScopedNodeAffinity node_affinity(numa_policy_.node);
     CreateNodeRelation();
 
     ReverseTopoSort();
@@ -128,32 +334,119 @@ void RuntimeGraph::Build()
     RuntimeOperatorUtils<float>::InitOperatorInput(operators_);
     RuntimeOperatorUtils<float>::InitOperatorOutput(graph_->ops, operators_);
 
+    // size the per-thread scratch arenas for the most demanding layer, so Forward never grows them
+    size_t scratch_bytes = 0;
+    for (const auto& op : operators_)
+    {
+        if (op->layer != nullptr)
+        {
+            scratch_bytes = std::max(scratch_bytes, LayerScratchRegisterer::ScratchBytes(op));
+        }
+    }
+    utils::ScratchArena::Reserve(scratch_bytes);
+#pragma omp parallel
+    {
+        utils::ScratchArena::Local().Prepare();
+    }
+    if (thread_pool_ != nullptr)
+    {
+        thread_pool_->Broadcast([](uint32_t) { utils::ScratchArena::Local().Prepare(); });
+    }
+    PrepareThreadPool();
+
+    if (numa_policy_.node >= 0)
+    {
+        if (numa_policy_.replicate_weights)
+        {
+            ShareNodeWeights();
+        }
+        PlaceGraphMemory();
+    }
+
+    // metric 0 is the whole Forward, metric i + 1 the operator i
+    std::vector<std::string> metric_names{"forward"};
+    for (const auto& op : operators_)
+    {
+        metric_names.push_back(op->name);
+    }
+    latency_recorder_ = std::make_unique<utils::LatencyRecorder>(std::move(metric_names));
+
     graph_state_ = GraphState::Complete;
     if (graph_ != nullptr)
     {
         graph_.reset();
         graph_ = nullptr;
+        this->pnnx_memory_.Resize(0);
+    }
+}
+
+template <typename T>
+static std::string FormatOperandShapes(const std::vector<std::shared_ptr<RuntimeOperandBase<T>>>& operands)
+{
+    std::string shapes;
+    for (const auto& operand : operands)
+    {
+        if (operand == nullptr)
+        {
+            continue;
+        }
+        shapes += "[";
+        for (size_t i = 0; i < operand->shapes.size(); ++i)
+        {
+            shapes += (i == 0 ? "" : ",") + std::to_string(operand->shapes.at(i));
+        }
+        shapes += "]";
     }
+    return shapes;
 }
 
 template <typename T>
-StatusCode ExecuteLayer(const std::shared_ptr<Layer<T>>& layer, const std::string& op_name, const std::string& op_type,
-                        bool is_debug)
+StatusCode ExecuteLayer(const std::shared_ptr<RuntimeOperatorBase<T>>& op, bool is_debug,
+                        const utils::PerfCounterSet* perf_counters)
 {
+    const std::shared_ptr<Layer<T>>& layer = op->layer;
     CHECK(layer != nullptr);
     StatusCode status;
+    utils::TraceScope trace_scope(op->name, op->type);
+    utils::MemoryScope memory_scope(op->memory_account.get(), utils::MemoryCategory::kScratch);
+    if (utils::TraceProfiler::Instance().enabled())
+    {
+        trace_scope.set_shapes(FormatOperandShapes(op->input_operands_seq),
+                               FormatOperandShapes<T>({op->output_operands}));
+    }
+
     if (is_debug)
     {
-        utils::LayerTimeLogging layer_time_logging(op_name, op_type);
+        utils::LayerTimeLogging layer_time_logging(op->name, op->type, perf_counters);
         status = layer->Forward();
     }
     else
     {
         status = layer->Forward();
     }
+
+    // outputs allocated lazily by Forward were charged to the scratch scope, they live across layers
+    if (op->output_operands != nullptr)
+    {
+        for (const std::shared_ptr<Tensor<T>>& output : op->output_operands->datas)
+        {
+            if (output != nullptr)
+            {
+                output->set_memory_category(utils::MemoryCategory::kActivations);
+            }
+        }
+    }
     return status;
 }
 
+static uint64_t ElapsedNs(utils::Time::time_point start_time)
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(utils::Time::now() - start_time).count());
+}
+
+/// NUMA node the calling thread and its OpenMP workers are bound to, -1 before the first bound Forward
+static thread_local int32_t thread_numa_node = -1;
+
 void RuntimeGraph::Forward(bool debug)
 {
     if (graph_state_ < GraphState::Complete)
@@ -162,13 +455,45 @@ void RuntimeGraph::Forward(bool debug)
                    << ", current state is " << int32_t(graph_state_);
     }
 
+    // a thread running graphs of several nodes follows the graph it is running
+    if (numa_policy_.node >= 0 && numa_policy_.bind_threads && thread_numa_node != numa_policy_.node)
+    {
+        utils::BindCurrentThreadToNode(numa_policy_.node);
+        utils::BindOpenMPThreadsToNode(numa_policy_.node);
+        thread_numa_node = numa_policy_.node;
+    }
+
+    PrepareThreadPool();
+    utils::ThreadPool::Scope thread_pool_scope(thread_pool_.get());
+
     if (debug)
     {
         utils::LayerTimeStatesSingleton::LayerTimeStatesCollectorInit();
+        if (perf_counters_enabled_ && perf_counters_ == nullptr)
+        {
+            // start the OpenMP workers so that their threads are counted too
+#pragma omp parallel
+            {
+            }
+            perf_counters_ = std::make_unique<utils::PerfCounterSet>();
+        }
+    }
+    const utils::PerfCounterSet* perf_counters = nullptr;
+    if (debug && perf_counters_ != nullptr && perf_counters_->valid())
+    {
+        perf_counters = perf_counters_.get();
+    }
+
+    utils::LatencyRecorder::Shard* latency_shard = nullptr;
+    if (latency_histograms_enabled_ && latency_recorder_ != nullptr)
+    {
+        latency_shard = &latency_recorder_->LocalShard();
     }
+    const auto forward_start = utils::Time::now();
 
-    for (const auto& current_op : operators_)
+    for (uint32_t op_index = 0; op_index < operators_.size(); ++op_index)
     {
+        const auto& current_op = operators_.at(op_index);
         current_op->has_forward = false;
         CHECK_GT(current_op->start_time, 0);
 
@@ -181,17 +506,41 @@ void RuntimeGraph::Forward(bool debug)
         CHECK(current_op->layer != nullptr) << "The layer corresponding to the op " << current_op->name
                                             << " is empty, indicating that it may not have been created.";
 
-        StatusCode status = ExecuteLayer(current_op->layer, current_op->name, current_op->type, debug);
+        const auto layer_start = utils::Time::now();
+        StatusCode status = ExecuteLayer(current_op, debug, perf_counters);
         CHECK(status == StatusCode::kSuccess)
             << current_op->layer->layer_name() << " layer forward failed, error code: " << int32_t(status);
+        if (latency_shard != nullptr)
+        {
+            latency_shard->Record(op_index + 1, ElapsedNs(layer_start));
+        }
 
         current_op->has_forward = true;
+        if (calibration_collector_ != nullptr)
+        {
+            calibration_collector_->Observe(current_op->name, current_op->output_operands->datas);
+        }
         PropagateLayerOutputs(current_op, current_op->output_operands->datas);
     }
 
+    if (latency_shard != nullptr)
+    {
+        latency_shard->Record(0, ElapsedNs(forward_start));
+    }
+
     if (debug)
     {
         utils::LayerTimeLogging::SummaryLogging();
+        std::map<std::string, utils::LayerCost> layer_costs;
+        for (const auto& op : operators_)
+        {
+            if (op->layer != nullptr)
+            {
+                layer_costs.insert({op->name, LayerCostRegisterer::EstimateCost(op)});
+            }
+        }
+        utils::RooflineLogging(layer_costs);
+        utils::MemoryReportLogging(memory_report());
     }
 
     for (const auto& op : operators_)
@@ -385,6 +734,27 @@ void RuntimeGraph::InitGraphAttrs(const std::map<std::string, pnnx::Attribute>&
                 runtime_operator->attribute.insert({name, runtime_attribute});
                 break;
             }
+            case 3:
+            {
+                std::shared_ptr<RuntimeAttribute> runtime_attribute =
+                    std::make_shared<RuntimeAttribute>(attr.shape, RuntimeDataType::kTypeFloat16, attr.data);
+                runtime_operator->attribute.insert({name, runtime_attribute});
+                break;
+            }
+            case 7:
+            {
+                std::shared_ptr<RuntimeAttribute> runtime_attribute =
+                    std::make_shared<RuntimeAttribute>(attr.shape, RuntimeDataType::kTypeInt8, attr.data);
+                runtime_operator->attribute.insert({name, runtime_attribute});
+                break;
+            }
+            case 8:
+            {
+                std::shared_ptr<RuntimeAttribute> runtime_attribute =
+                    std::make_shared<RuntimeAttribute>(attr.shape, RuntimeDataType::kTypeUInt8, attr.data);
+                runtime_operator->attribute.insert({name, runtime_attribute});
+                break;
+            }
             default:
             {
                 LOG(FATAL) << "Unknown attribute type: " << attr.type;
@@ -522,6 +892,9 @@ void RuntimeGraph::CreateNodeRelation()
         // 除了输入和输出节点，都创建layer
         if (current_op->type != "pnnx.Input" && current_op->type != "pnnx.Output")
         {
+            utils::MemoryScope memory_scope(current_op->memory_account.get(), utils::MemoryCategory::kWeights);
+            current_op->compute_precision = compute_precision_;
+            ApplyCalibration(current_op);
             auto layer = RuntimeGraph::CreateLayer(current_op);
             if (layer)
             {
@@ -532,6 +905,352 @@ void RuntimeGraph::CreateNodeRelation()
             {
                 LOG(FATAL) << "Layer " << current_op->name << " create failed!";
             }
+
+            // the layers copy the attributes they consume, only the data still held stays charged
+            const int64_t charged_bytes =
+                current_op->memory_account->usage(utils::MemoryCategory::kParseBuffers).current_bytes;
+            current_op->memory_account->Release(utils::MemoryCategory::kParseBuffers,
+                                                charged_bytes - RuntimeAttributeBytes(current_op));
+        }
+    }
+}
+
+void RuntimeGraph::ApplyCalibration(const std::shared_ptr<RuntimeOperator>& op) const
+{
+    if (calibration_table_.empty() || op->input_operands_seq.empty())
+    {
+        return;
+    }
+    const std::string& input_name = op->input_operands_seq.front()->name;
+    if (!calibration_table_.has_scale(input_name))
+    {
+        return;
+    }
+
+    std::string scale_name;
+    if (op->type == "nn.Conv2d" && op->has_attribute("weight") &&
+        op->attribute.at("weight")->type == RuntimeDataType::kTypeInt8)
+    {
+        scale_name = "input_scale";
+    }
+    else if (op->type == "pnnx.Quantize")
+    {
+        scale_name = "scale";
+    }
+    if (scale_name.empty() || op->has_parameter(scale_name))
+    {
+        return;
+    }
+    op->params.insert({scale_name, std::make_shared<RuntimeParameterFloat>(calibration_table_.scale(input_name))});
+}
+
+CalibrationTable RuntimeGraph::Calibrate(const std::string& input_name,
+                                         const std::vector<std::vector<sftensor>>& dataset,
+                                         const CalibrationConfig& config)
+{
+    CHECK(graph_state_ == GraphState::Complete) << "The graph must be built before the calibration";
+    CHECK(!dataset.empty()) << "The calibration dataset is empty";
+
+    CalibrationCollector collector(config);
+    calibration_collector_ = &collector;
+    const uint32_t passes = collector.needs_histogram() ? 2 : 1;
+    for (uint32_t pass = 0; pass < passes; ++pass)
+    {
+        if (pass == 1)
+        {
+            collector.StartHistogramPass();
+        }
+        for (const std::vector<sftensor>& batch : dataset)
+        {
+            collector.Observe(input_name, batch);
+            set_inputs(input_name, batch);
+            Forward(false);
+        }
+    }
+    calibration_collector_ = nullptr;
+
+    CalibrationTable calibration_table = collector.Finish();
+    LOG(INFO) << "Calibrated " << calibration_table.scales().size() << " tensors over " << dataset.size()
+              << " batches with the " << CalibrationMethodName(config.method) << " method";
+    return calibration_table;
+}
+
+void RuntimeGraph::set_calibration_table(const CalibrationTable& calibration_table)
+{
+    CHECK(graph_state_ != GraphState::Complete) << "The calibration table must be set before the graph is built";
+    this->calibration_table_ = calibration_table;
+}
+
+void RuntimeGraph::set_compute_precision(ComputePrecision compute_precision)
+{
+    CHECK(graph_state_ != GraphState::Complete) << "The compute precision must be set before the graph is built";
+    this->compute_precision_ = compute_precision;
+}
+
+ComputePrecision RuntimeGraph::compute_precision() const
+{
+    return this->compute_precision_;
+}
+
+void RuntimeGraph::set_numa_policy(const utils::NumaPolicy& numa_policy)
+{
+    CHECK(graph_state_ != GraphState::Complete) << "The NUMA policy must be set before the graph is built";
+    if (numa_policy.node >= 0)
+    {
+        CHECK_LT(uint32_t(numa_policy.node), utils::NumaTopology::Instance().node_count())
+            << "NUMA node " << numa_policy.node << " does not exist";
+    }
+    this->numa_policy_ = numa_policy;
+}
+
+void RuntimeGraph::set_batch_size(uint32_t batch_size)
+{
+    CHECK(graph_state_ != GraphState::Complete) << "The batch size must be set before the graph is built";
+    this->batch_size_ = batch_size;
+    // the operand shapes are read when the graph is loaded
+    this->graph_state_ = GraphState::NeedInit;
+}
+
+const utils::NumaPolicy& RuntimeGraph::numa_policy() const
+{
+    return this->numa_policy_;
+}
+
+/**
+ * Weight replicas keyed by "node:bin_path:operator name". Only weak references
+ * are kept, a replica disappears with the last graph using it.
+ */
+struct NodeWeightReplica
+{
+    /// The layer itself, for the layers that share their packed kernels
+    std::weak_ptr<ParamLayer> layer;
+    std::vector<std::weak_ptr<Tensor<float>>> weights;
+    std::vector<std::weak_ptr<Tensor<float>>> bias;
+};
+
+static std::mutex node_weight_mutex;
+static std::map<std::string, NodeWeightReplica> node_weight_replicas;
+
+static bool LockReplica(const std::vector<std::weak_ptr<Tensor<float>>>& replica, std::vector<sftensor>& tensors)
+{
+    tensors.clear();
+    for (const auto& weak_tensor : replica)
+    {
+        sftensor tensor = weak_tensor.lock();
+        if (tensor == nullptr)
+        {
+            return false;
+        }
+        tensors.push_back(tensor);
+    }
+    return true;
+}
+
+void RuntimeGraph::ShareNodeWeights()
+{
+    std::lock_guard<std::mutex> lock(node_weight_mutex);
+    for (const auto& op : this->operators_)
+    {
+        auto param_layer = std::dynamic_pointer_cast<ParamLayer>(op->layer);
+        if (param_layer == nullptr)
+        {
+            continue;
+        }
+
+        // the precision picks the kernels a layer packs, graphs of other precisions keep their own
+        const std::string replica_key = std::to_string(numa_policy_.node) + ":" + bin_path_ + ":" + op->name + ":" +
+                                        std::to_string(int32_t(op->compute_precision));
+        auto replica_iter = node_weight_replicas.find(replica_key);
+        if (replica_iter != node_weight_replicas.end())
+        {
+            // layers packing their weights share the packed kernels, the others their weight tensors
+            const std::shared_ptr<ParamLayer> replica_layer = replica_iter->second.layer.lock();
+            if (replica_layer != nullptr && param_layer->ShareWeights(replica_layer))
+            {
+                continue;
+            }
+        }
+        std::vector<sftensor> weights;
+        std::vector<sftensor> bias;
+        if (replica_iter != node_weight_replicas.end() && LockReplica(replica_iter->second.weights, weights) &&
+            LockReplica(replica_iter->second.bias, bias) && weights.size() == param_layer->weights().size() &&
+            bias.size() == param_layer->bias().size())
+        {
+            param_layer->set_weights(weights);
+            param_layer->set_bias(bias);
+        }
+        else
+        {
+            NodeWeightReplica replica;
+            replica.layer = param_layer;
+            for (const auto& weight : param_layer->weights())
+            {
+                replica.weights.push_back(weight);
+            }
+            for (const auto& bias_tensor : param_layer->bias())
+            {
+                replica.bias.push_back(bias_tensor);
+            }
+            node_weight_replicas[replica_key] = std::move(replica);
+        }
+    }
+}
+
+void RuntimeGraph::PlaceGraphMemory()
+{
+    const int32_t node = numa_policy_.node;
+    for (const auto& op : this->operators_)
+    {
+        if (op->output_operands != nullptr)
+        {
+            for (const auto& tensor : op->output_operands->datas)
+            {
+                if (tensor != nullptr && !tensor->empty())
+                {
+                    utils::MoveMemoryToNode(tensor->raw_ptr(), tensor->size() * sizeof(float), node);
+                }
+            }
+        }
+        // the memory Forward reads, the packed kernels of the convolutions rather than their float weights
+        auto param_layer = std::dynamic_pointer_cast<ParamLayer>(op->layer);
+        if (param_layer != nullptr)
+        {
+            param_layer->ForEachWeightRegion([node](const void* ptr, size_t size) {
+                utils::MoveMemoryToNode(const_cast<void*>(ptr), size, node);
+            });
+        }
+    }
+}
+
+void RuntimeGraph::PrepareThreadPool()
+{
+    if (worker_config_.mode != utils::WorkerMode::kSpinning || thread_pool_ != nullptr)
+    {
+        return;
+    }
+    uint32_t num_threads = worker_config_.num_threads;
+    if (num_threads == 0)
+    {
+        num_threads = omp_get_max_threads();
+    }
+    int32_t numa_node = worker_config_.numa_node;
+    if (numa_node < 0 && numa_policy_.bind_threads)
+    {
+        numa_node = numa_policy_.node;
+    }
+    thread_pool_ = std::make_unique<utils::ThreadPool>(num_threads, worker_config_.spin_time_us, numa_node);
+    // the workers are not OpenMP threads, their arenas are sized here rather than by the first Forward
+    thread_pool_->Broadcast([](uint32_t) { utils::ScratchArena::Local().Prepare(); });
+}
+
+void RuntimeGraph::set_worker_config(const utils::WorkerConfig& worker_config)
+{
+    this->worker_config_ = worker_config;
+    // the pool is recreated with the new configuration by the next Forward
+    this->thread_pool_.reset();
+    // the counters of the old workers are gone, reopen them on the new threads
+    this->perf_counters_.reset();
+}
+
+const utils::WorkerConfig& RuntimeGraph::worker_config() const
+{
+    return this->worker_config_;
+}
+
+void RuntimeGraph::set_perf_counters_enabled(bool enabled)
+{
+    this->perf_counters_enabled_ = enabled;
+    if (!enabled)
+    {
+        this->perf_counters_.reset();
+    }
+}
+
+bool RuntimeGraph::perf_counters_enabled() const
+{
+    return this->perf_counters_enabled_;
+}
+
+void RuntimeGraph::set_latency_histograms_enabled(bool enabled)
+{
+    this->latency_histograms_enabled_ = enabled;
+}
+
+bool RuntimeGraph::latency_histograms_enabled() const
+{
+    return this->latency_histograms_enabled_;
+}
+
+std::vector<utils::LatencySnapshot> RuntimeGraph::latency_snapshot() const
+{
+    std::vector<utils::LatencySnapshot> snapshots;
+    if (latency_recorder_ == nullptr)
+    {
+        return snapshots;
+    }
+    // operators without a layer, like the inputs and outputs, are never recorded
+    for (utils::LatencySnapshot& snapshot : latency_recorder_->SnapshotAll())
+    {
+        if (snapshot.count > 0)
+        {
+            snapshots.push_back(std::move(snapshot));
+        }
+    }
+    return snapshots;
+}
+
+void RuntimeGraph::ResetLatencyHistograms()
+{
+    if (latency_recorder_ != nullptr)
+    {
+        latency_recorder_->Reset();
+    }
+}
+
+utils::MemoryReport RuntimeGraph::memory_report() const
+{
+    utils::MemoryReport report;
+    if (memory_account_ == nullptr)
+    {
+        return report;
+    }
+    for (uint32_t i = 0; i < utils::kMemoryCategoryCount; ++i)
+    {
+        report.categories.at(i) = memory_account_->usage(utils::MemoryCategory(i));
+    }
+    report.total = memory_account_->total();
+    report.scratch_arena_bytes = int64_t(utils::ScratchArena::total_capacity());
+
+    for (const auto& op : operators_)
+    {
+        if (op->memory_account == nullptr)
+        {
+            continue;
+        }
+        utils::LayerMemoryReport layer_report;
+        layer_report.name = op->name;
+        layer_report.type = op->type;
+        for (uint32_t i = 0; i < utils::kMemoryCategoryCount; ++i)
+        {
+            layer_report.categories.at(i) = op->memory_account->usage(utils::MemoryCategory(i));
+        }
+        layer_report.total = op->memory_account->total();
+        report.layers.push_back(std::move(layer_report));
+    }
+    return report;
+}
+
+void RuntimeGraph::ResetMemoryPeaks()
+{
+    if (memory_account_ != nullptr)
+    {
+        memory_account_->ResetPeak();
+    }
+    for (const auto& op : operators_)
+    {
+        if (op->memory_account != nullptr)
+        {
+            op->memory_account->ResetPeak();
         }
     }
 }
@@ -578,6 +1297,40 @@ std::vector<sftensor> RuntimeGraph::get_outputs(const std::string& output_name)
     return outputs;
 }
 
+std::vector<std::string> RuntimeGraph::input_names() const
+{
+    std::vector<std::string> names;
+    for (const auto& op : this->input_ops_)
+    {
+        names.push_back(op->name);
+    }
+    return names;
+}
+
+std::vector<std::string> RuntimeGraph::output_names() const
+{
+    std::vector<std::string> names;
+    for (const auto& op : this->output_ops_)
+    {
+        names.push_back(op->name);
+    }
+    return names;
+}
+
+std::vector<int32_t> RuntimeGraph::input_shape(const std::string& input_name) const
+{
+    for (const auto& op : this->input_ops_)
+    {
+        if (op->name == input_name)
+        {
+            CHECK(op->output_operands != nullptr) << "The input operator has no output: " << input_name;
+            return op->output_operands->shapes;
+        }
+    }
+    LOG(FATAL) << "Can not find the input operator: " << input_name;
+    return {};
+}
+
 bool RuntimeGraph::is_input_op(const std::string& op_name) const
 {
     for (auto op : this->input_ops_)
@@ -110,6 +110,7 @@ void RuntimeOperatorUtils<float>::InitOperatorOutput(const std::vector<pnnx::Ope
 
         const auto& runtime_op = operators[i];
         auto& output_tensors = runtime_op->output_operands;
+        utils::MemoryScope memory_scope(runtime_op->memory_account.get(), utils::MemoryCategory::kActivations);
         CHECK((operand_shapes.size() == 2 || operand_shapes.size() == 4 || operand_shapes.size() == 3))
             << "Unsupported shape sizes: " << operand_shapes.size();
 
@@ -0,0 +1,92 @@
+
+#include "utils/cpu/cpu_features.hpp"
+#include <cstdint>
+
+namespace black_scholes
+{
+namespace utils
+{
+static CpuFeatures DetectCpuFeatures()
+{
+    CpuFeatures features;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    features.avx2 = __builtin_cpu_supports("avx2");
+    features.fma = __builtin_cpu_supports("fma");
+    features.avx512f = __builtin_cpu_supports("avx512f");
+    features.avx512bw = __builtin_cpu_supports("avx512bw");
+    features.avx512vnni = __builtin_cpu_supports("avx512vnni");
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+    features.avx512bf16 = __builtin_cpu_supports("avx512bf16");
+    features.avx_vnni = __builtin_cpu_supports("avxvnni");
+#endif
+    // f16c is not known to __builtin_cpu_supports, read CPUID leaf 1 ECX bit 29
+    uint32_t eax = 1;
+    uint32_t ebx = 0;
+    uint32_t ecx = 0;
+    uint32_t edx = 0;
+    __asm__("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    features.f16c = (ecx >> 29) & 1u;
+#endif
+    return features;
+}
+
+static const CpuFeatures& DetectedCpuFeatures()
+{
+    static const CpuFeatures features = DetectCpuFeatures();
+    return features;
+}
+
+/// the detected features minus those hidden by LimitCpuFeatures
+static CpuFeatures& ActiveCpuFeatures()
+{
+    static CpuFeatures features = DetectedCpuFeatures();
+    return features;
+}
+
+const CpuFeatures& GetCpuFeatures()
+{
+    return ActiveCpuFeatures();
+}
+
+void LimitCpuFeatures(const CpuFeatures& features)
+{
+    const CpuFeatures& detected = DetectedCpuFeatures();
+    CpuFeatures& active = ActiveCpuFeatures();
+    active.avx2 = detected.avx2 && features.avx2;
+    active.fma = detected.fma && features.fma;
+    active.f16c = detected.f16c && features.f16c;
+    active.avx512f = detected.avx512f && features.avx512f;
+    active.avx512bw = detected.avx512bw && features.avx512bw;
+    active.avx512vnni = detected.avx512vnni && features.avx512vnni;
+    active.avx512bf16 = detected.avx512bf16 && features.avx512bf16;
+    active.avx_vnni = detected.avx_vnni && features.avx_vnni;
+}
+
+void ResetCpuFeatures()
+{
+    ActiveCpuFeatures() = DetectedCpuFeatures();
+}
+
+std::string CpuFeaturesString()
+{
+    const CpuFeatures& features = GetCpuFeatures();
+    std::string features_str;
+    auto append = [&features_str](bool supported, const char* name) {
+        if (supported)
+        {
+            features_str += features_str.empty() ? name : std::string(" ") + name;
+        }
+    };
+    append(features.avx2, "avx2");
+    append(features.fma, "fma");
+    append(features.f16c, "f16c");
+    append(features.avx512f, "avx512f");
+    append(features.avx512bw, "avx512bw");
+    append(features.avx512vnni, "avx512vnni");
+    append(features.avx512bf16, "avx512bf16");
+    append(features.avx_vnni, "avxvnni");
+    return features_str;
+}
+}  // namespace utils
+}  // namespace black_scholes
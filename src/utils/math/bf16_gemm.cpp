@@ -0,0 +1,231 @@
+
+#include "utils/math/bf16_gemm.hpp"
+#include <glog/logging.h>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "utils/cpu/cpu_features.hpp"
+#include "utils/parallel/parallel_utils.hpp"
+
+namespace black_scholes
+{
+namespace utils
+{
+/// Weight rows and activation columns of one register tile
+constexpr uint32_t kBf16RowTile = 4;
+constexpr uint32_t kBf16ColumnTile = 2;
+/// Activation columns of one task, their values stay in L2 while every weight row tile sweeps them
+constexpr uint32_t kBf16ColumnBlock = 64;
+
+Bf16Kernel SelectBf16Kernel()
+{
+    const CpuFeatures& features = GetCpuFeatures();
+    if (features.avx512bf16 && features.avx512f)
+    {
+        return Bf16Kernel::kAvx512Bf16;
+    }
+    return Bf16Kernel::kEmulated;
+}
+
+const char* Bf16KernelName(Bf16Kernel kernel)
+{
+    switch (kernel)
+    {
+        case Bf16Kernel::kEmulated:
+            return "emulated";
+        case Bf16Kernel::kAvx512Bf16:
+            return "avx512_bf16";
+        default:
+            return "unknown";
+    }
+}
+
+size_t Bf16PackedMatrix::bytes() const
+{
+    return data.size() * sizeof(uint16_t);
+}
+
+Bf16PackedMatrix PackBf16Matrix(const float* weights, uint32_t rows, uint32_t depth, Bf16Kernel kernel)
+{
+    CHECK(weights != nullptr);
+    CHECK(rows > 0 && depth > 0);
+    Bf16PackedMatrix packed;
+    packed.rows = rows;
+    packed.depth = depth;
+    packed.padded_depth = Bf16PaddedDepth(depth);
+    packed.kernel = kernel;
+    packed.data.assign(size_t(rows) * packed.padded_depth, 0);
+    for (uint32_t row = 0; row < rows; ++row)
+    {
+        const float* row_ptr = weights + size_t(row) * depth;
+        uint16_t* packed_ptr = packed.data.data() + size_t(row) * packed.padded_depth;
+        for (uint32_t k = 0; k < depth; ++k)
+        {
+            packed_ptr[k] = FloatToBf16(row_ptr[k]);
+        }
+    }
+    return packed;
+}
+
+template <uint32_t kRows, uint32_t kColumns>
+static void EmulatedTile(const uint16_t* weights, const uint16_t* activations, uint32_t depth, float* accumulators)
+{
+    // one partial sum per lane of a vdpbf16ps register keeps the summation order close to the native kernel
+    constexpr uint32_t kLanes = 16;
+    float sums[kRows][kColumns][kLanes] = {};
+    for (uint32_t k = 0; k < depth; k += 2 * kLanes)
+    {
+        for (uint32_t r = 0; r < kRows; ++r)
+        {
+            const uint16_t* weight_ptr = weights + size_t(r) * depth + k;
+            for (uint32_t c = 0; c < kColumns; ++c)
+            {
+                const uint16_t* activation_ptr = activations + size_t(c) * depth + k;
+                for (uint32_t lane = 0; lane < kLanes; ++lane)
+                {
+                    float sum = sums[r][c][lane];
+                    sum += Bf16ToFloat(weight_ptr[2 * lane]) * Bf16ToFloat(activation_ptr[2 * lane]);
+                    sum += Bf16ToFloat(weight_ptr[2 * lane + 1]) * Bf16ToFloat(activation_ptr[2 * lane + 1]);
+                    sums[r][c][lane] = sum;
+                }
+            }
+        }
+    }
+    for (uint32_t r = 0; r < kRows; ++r)
+    {
+        for (uint32_t c = 0; c < kColumns; ++c)
+        {
+            float sum = 0.f;
+            for (uint32_t lane = 0; lane < kLanes; ++lane)
+            {
+                sum += sums[r][c][lane];
+            }
+            accumulators[r * kColumns + c] = sum;
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+template <uint32_t kRows, uint32_t kColumns>
+__attribute__((target("avx512f,avx512bf16"))) static void Avx512Bf16Tile(const uint16_t* weights,
+                                                                         const uint16_t* activations,
+                                                                         uint32_t depth, float* accumulators)
+{
+    __m512 sums[kRows][kColumns];
+    for (uint32_t r = 0; r < kRows; ++r)
+    {
+        for (uint32_t c = 0; c < kColumns; ++c)
+        {
+            sums[r][c] = _mm512_setzero_ps();
+        }
+    }
+    for (uint32_t k = 0; k < depth; k += 32)
+    {
+        __m512bh activation[kColumns];
+        for (uint32_t c = 0; c < kColumns; ++c)
+        {
+            activation[c] = (__m512bh)_mm512_loadu_si512(activations + size_t(c) * depth + k);
+        }
+        for (uint32_t r = 0; r < kRows; ++r)
+        {
+            const __m512bh weight = (__m512bh)_mm512_loadu_si512(weights + size_t(r) * depth + k);
+            for (uint32_t c = 0; c < kColumns; ++c)
+            {
+                sums[r][c] = _mm512_dpbf16_ps(sums[r][c], activation[c], weight);
+            }
+        }
+    }
+    for (uint32_t r = 0; r < kRows; ++r)
+    {
+        for (uint32_t c = 0; c < kColumns; ++c)
+        {
+            accumulators[r * kColumns + c] = _mm512_reduce_add_ps(sums[r][c]);
+        }
+    }
+}
+#endif
+
+template <uint32_t kRows, uint32_t kColumns>
+static void Bf16Tile(Bf16Kernel kernel, const uint16_t* weights, const uint16_t* activations, uint32_t depth,
+                     float* accumulators)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (kernel == Bf16Kernel::kAvx512Bf16)
+    {
+        return Avx512Bf16Tile<kRows, kColumns>(weights, activations, depth, accumulators);
+    }
+#endif
+    EmulatedTile<kRows, kColumns>(weights, activations, depth, accumulators);
+}
+
+template <uint32_t kRows>
+static void Bf16RowTile(Bf16Kernel kernel, uint32_t columns, const uint16_t* weights, const uint16_t* activations,
+                        uint32_t depth, float* accumulators)
+{
+    if (columns == kBf16ColumnTile)
+    {
+        Bf16Tile<kRows, kBf16ColumnTile>(kernel, weights, activations, depth, accumulators);
+    }
+    else
+    {
+        Bf16Tile<kRows, 1>(kernel, weights, activations, depth, accumulators);
+    }
+}
+
+void Bf16Gemm(const Bf16PackedMatrix& weights, const uint16_t* activations, uint32_t columns, const float* bias,
+              float* output, size_t output_stride)
+{
+    CHECK(activations != nullptr && output != nullptr);
+    if (weights.kernel == Bf16Kernel::kAvx512Bf16)
+    {
+        CHECK(SelectBf16Kernel() == Bf16Kernel::kAvx512Bf16) << "The CPU has no AVX512-BF16 instructions";
+    }
+    const uint32_t depth = weights.padded_depth;
+    const uint32_t block_count = (columns + kBf16ColumnBlock - 1) / kBf16ColumnBlock;
+    const size_t block_work = size_t(weights.rows) * depth * kBf16ColumnBlock;
+
+    ParallelFor(block_count, block_work, [&](uint32_t block) {
+        const uint32_t column_begin = block * kBf16ColumnBlock;
+        const uint32_t column_end = std::min(columns, column_begin + kBf16ColumnBlock);
+        float accumulators[kBf16RowTile * kBf16ColumnTile];
+        for (uint32_t row = 0; row < weights.rows; row += kBf16RowTile)
+        {
+            const uint32_t tile_rows = std::min(kBf16RowTile, weights.rows - row);
+            const uint16_t* weight_ptr = weights.data.data() + size_t(row) * depth;
+            for (uint32_t column = column_begin; column < column_end; column += kBf16ColumnTile)
+            {
+                const uint32_t tile_columns = std::min(kBf16ColumnTile, column_end - column);
+                const uint16_t* activation_ptr = activations + size_t(column) * depth;
+                switch (tile_rows)
+                {
+                    case 4:
+                        Bf16RowTile<4>(weights.kernel, tile_columns, weight_ptr, activation_ptr, depth, accumulators);
+                        break;
+                    case 3:
+                        Bf16RowTile<3>(weights.kernel, tile_columns, weight_ptr, activation_ptr, depth, accumulators);
+                        break;
+                    case 2:
+                        Bf16RowTile<2>(weights.kernel, tile_columns, weight_ptr, activation_ptr, depth, accumulators);
+                        break;
+                    default:
+                        Bf16RowTile<1>(weights.kernel, tile_columns, weight_ptr, activation_ptr, depth, accumulators);
+                        break;
+                }
+
+                for (uint32_t r = 0; r < tile_rows; ++r)
+                {
+                    const uint32_t out_row = row + r;
+                    const float row_bias = bias != nullptr ? bias[out_row] : 0.f;
+                    float* output_ptr = output + out_row * output_stride + column;
+                    for (uint32_t c = 0; c < tile_columns; ++c)
+                    {
+                        output_ptr[c] = accumulators[r * tile_columns + c] + row_bias;
+                    }
+                }
+            }
+        }
+    });
+}
+}  // namespace utils
+}  // namespace black_scholes
@@ -0,0 +1,416 @@
+
+#include "utils/math/direct_conv.hpp"
+#include <glog/logging.h>
+#include <algorithm>
+#include <atomic>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "utils/cpu/cpu_features.hpp"
+#include "utils/memory/scratch_arena.hpp"
+#include "utils/parallel/parallel_utils.hpp"
+
+namespace black_scholes
+{
+namespace utils
+{
+/// Longest run of output rows of the micro-kernels, the last run of a column reads past the output rows
+constexpr uint32_t kDirectConvMaxRows = 32;
+
+DirectConvKernel SelectDirectConvKernel()
+{
+    const CpuFeatures& features = GetCpuFeatures();
+    if (features.avx512f)
+    {
+        return DirectConvKernel::kAvx512;
+    }
+    if (features.avx2 && features.fma)
+    {
+        return DirectConvKernel::kAvx2;
+    }
+    return DirectConvKernel::kGeneric;
+}
+
+const char* DirectConvKernelName(DirectConvKernel kernel)
+{
+    switch (kernel)
+    {
+        case DirectConvKernel::kGeneric:
+            return "generic";
+        case DirectConvKernel::kAvx2:
+            return "avx2";
+        case DirectConvKernel::kAvx512:
+            return "avx512";
+        default:
+            return "unknown";
+    }
+}
+
+bool SupportsDirectConv(uint32_t kernel_h, uint32_t kernel_w, uint32_t stride_h, uint32_t stride_w,
+                        uint32_t dilation_h, uint32_t dilation_w)
+{
+    return kernel_h == kernel_w && (kernel_h == 3 || kernel_h == 1) && stride_h == 2 && stride_w == 2 &&
+           dilation_h == 1 && dilation_w == 1;
+}
+
+size_t DirectConvWeights::bytes() const
+{
+    return values.size() * sizeof(float);
+}
+
+DirectConvWeights PackDirectConvWeights(const float* weights, uint32_t output_channels, uint32_t channels,
+                                        uint32_t kernel_size)
+{
+    CHECK(weights != nullptr);
+    CHECK(output_channels > 0 && channels > 0);
+    CHECK(kernel_size == 3 || kernel_size == 1) << "The direct kernels take 3x3 and 1x1 kernels";
+    const uint32_t taps = kernel_size * kernel_size;
+    const size_t depth = size_t(channels) * taps;
+    const uint32_t blocks = (output_channels + kDirectConvBlock - 1) / kDirectConvBlock;
+
+    DirectConvWeights packed;
+    packed.output_channels = output_channels;
+    packed.channels = channels;
+    packed.kernel_size = kernel_size;
+    packed.values.assign(size_t(blocks) * depth * kDirectConvBlock, 0.f);
+    for (uint32_t oc = 0; oc < output_channels; ++oc)
+    {
+        float* block_values = packed.values.data() + size_t(oc / kDirectConvBlock) * depth * kDirectConvBlock;
+        for (size_t k = 0; k < depth; ++k)
+        {
+            block_values[k * kDirectConvBlock + oc % kDirectConvBlock] = weights[oc * depth + k];
+        }
+    }
+    return packed;
+}
+
+/**
+ * @brief Layout of the stride-2 phases of the padded input of one channel
+ *
+ * Phase p holds the padded rows 2j + p, one column per padded input column
+ * a tap reads. A 1x1 kernel only reads the even rows of the even columns.
+ */
+struct DirectConvPhases
+{
+    uint32_t phases = 0;
+    uint32_t columns = 0;
+    /// Rows of a phase column, the output rows plus the overrun of the last run and the rows of the taps below
+    uint32_t rows = 0;
+    /// Padded input columns between two phase columns
+    uint32_t column_step = 0;
+
+    DirectConvPhases(uint32_t kernel_size, uint32_t output_h, uint32_t output_w)
+    {
+        phases = kernel_size == 1 ? 1 : 2;
+        columns = kernel_size == 1 ? output_w : 2 * output_w + 1;
+        column_step = kernel_size == 1 ? 2 : 1;
+        rows = output_h + kDirectConvMaxRows - 1 + kernel_size / 2;
+    }
+
+    size_t channel_size() const
+    {
+        return size_t(phases) * columns * rows;
+    }
+};
+
+size_t DirectConvWorkspaceBytes(uint32_t channels, uint32_t kernel_size, uint32_t output_h, uint32_t output_w)
+{
+    const DirectConvPhases layout(kernel_size, output_h, output_w);
+    return size_t(channels) * layout.channel_size() * sizeof(float) + ScratchArena::kAlignment;
+}
+
+/**
+ * @brief Computes kDirectConvBlock channels times kVectors * 8 output rows of one output column
+ *
+ * @param weights Block of the packed weights
+ * @param input Phases of the first channel, moved to the first output row of the run
+ * @param tap_offsets Per tap, the offset of its value for the first output row in the phases of a channel
+ * @param tile kDirectConvBlock rows of kVectors * 8 values
+ */
+template <uint32_t kTaps, uint32_t kVectors>
+static void GenericKernel(uint32_t channels, const float* weights, const float* input, size_t channel_size,
+                          const uint32_t* tap_offsets, float* tile)
+{
+    constexpr uint32_t kRows = kVectors * 8;
+    float sums[kDirectConvBlock][kRows] = {};
+    for (uint32_t ic = 0; ic < channels; ++ic)
+    {
+        for (uint32_t t = 0; t < kTaps; ++t)
+        {
+            const float* values = input + tap_offsets[t];
+            for (uint32_t o = 0; o < kDirectConvBlock; ++o)
+            {
+                for (uint32_t r = 0; r < kRows; ++r)
+                {
+                    sums[o][r] += weights[o] * values[r];
+                }
+            }
+            weights += kDirectConvBlock;
+        }
+        input += channel_size;
+    }
+    for (uint32_t o = 0; o < kDirectConvBlock; ++o)
+    {
+        std::copy(sums[o], sums[o] + kRows, tile + o * kRows);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/**
+ * @brief Half of a block, 4 channels x 3 vectors fill the 16 registers of AVX2
+ */
+template <uint32_t kTaps, uint32_t kVectors>
+__attribute__((target("avx2,fma"))) static void Avx2HalfKernel(uint32_t channels, const float* weights,
+                                                              const float* input, size_t channel_size,
+                                                              const uint32_t* tap_offsets, float* tile)
+{
+    constexpr uint32_t kChannels = kDirectConvBlock / 2;
+    __m256 sums[kChannels][3];
+    for (uint32_t o = 0; o < kChannels; ++o)
+    {
+        sums[o][0] = _mm256_setzero_ps();
+        sums[o][1] = _mm256_setzero_ps();
+        sums[o][2] = _mm256_setzero_ps();
+    }
+    for (uint32_t ic = 0; ic < channels; ++ic)
+    {
+        for (uint32_t t = 0; t < kTaps; ++t)
+        {
+            const float* values = input + tap_offsets[t];
+            const __m256 values0 = _mm256_loadu_ps(values);
+            const __m256 values1 = kVectors > 1 ? _mm256_loadu_ps(values + 8) : _mm256_setzero_ps();
+            const __m256 values2 = kVectors > 2 ? _mm256_loadu_ps(values + 16) : _mm256_setzero_ps();
+            for (uint32_t o = 0; o < kChannels; ++o)
+            {
+                const __m256 weight = _mm256_broadcast_ss(weights + o);
+                sums[o][0] = _mm256_fmadd_ps(weight, values0, sums[o][0]);
+                if constexpr (kVectors > 1)
+                {
+                    sums[o][1] = _mm256_fmadd_ps(weight, values1, sums[o][1]);
+                }
+                if constexpr (kVectors > 2)
+                {
+                    sums[o][2] = _mm256_fmadd_ps(weight, values2, sums[o][2]);
+                }
+            }
+            weights += kDirectConvBlock;
+        }
+        input += channel_size;
+    }
+    for (uint32_t o = 0; o < kChannels; ++o)
+    {
+        for (uint32_t v = 0; v < kVectors; ++v)
+        {
+            _mm256_storeu_ps(tile + (o * kVectors + v) * 8, sums[o][v]);
+        }
+    }
+}
+
+template <uint32_t kTaps, uint32_t kVectors>
+static void Avx2Kernel(uint32_t channels, const float* weights, const float* input, size_t channel_size,
+                       const uint32_t* tap_offsets, float* tile)
+{
+    constexpr uint32_t kHalf = kDirectConvBlock / 2;
+    Avx2HalfKernel<kTaps, kVectors>(channels, weights, input, channel_size, tap_offsets, tile);
+    Avx2HalfKernel<kTaps, kVectors>(channels, weights + kHalf, input, channel_size, tap_offsets,
+                                    tile + kHalf * kVectors * 8);
+}
+
+template <uint32_t kTaps, uint32_t kVectors>
+__attribute__((target("avx512f"))) static void Avx512Kernel(uint32_t channels, const float* weights,
+                                                           const float* input, size_t channel_size,
+                                                           const uint32_t* tap_offsets, float* tile)
+{
+    __m512 sums[kDirectConvBlock][2];
+    for (uint32_t o = 0; o < kDirectConvBlock; ++o)
+    {
+        sums[o][0] = _mm512_setzero_ps();
+        sums[o][1] = _mm512_setzero_ps();
+    }
+    for (uint32_t ic = 0; ic < channels; ++ic)
+    {
+        for (uint32_t t = 0; t < kTaps; ++t)
+        {
+            const float* values = input + tap_offsets[t];
+            const __m512 values0 = _mm512_loadu_ps(values);
+            const __m512 values1 = kVectors > 1 ? _mm512_loadu_ps(values + 16) : _mm512_setzero_ps();
+            for (uint32_t o = 0; o < kDirectConvBlock; ++o)
+            {
+                const __m512 weight = _mm512_set1_ps(weights[o]);
+                sums[o][0] = _mm512_fmadd_ps(weight, values0, sums[o][0]);
+                if constexpr (kVectors > 1)
+                {
+                    sums[o][1] = _mm512_fmadd_ps(weight, values1, sums[o][1]);
+                }
+            }
+            weights += kDirectConvBlock;
+        }
+        input += channel_size;
+    }
+    for (uint32_t o = 0; o < kDirectConvBlock; ++o)
+    {
+        for (uint32_t v = 0; v < kVectors; ++v)
+        {
+            _mm512_storeu_ps(tile + (o * kVectors + v) * 16, sums[o][v]);
+        }
+    }
+}
+#endif
+
+using DirectConvTileFunc = void (*)(uint32_t, const float*, const float*, size_t, const uint32_t*, float*);
+
+/// Most vectors of output rows a micro-kernel keeps per channel
+constexpr uint32_t kDirectConvMaxVectors = 3;
+
+/**
+ * @brief Output rows and micro-kernels of a kernel choice
+ *
+ * The last run of a column takes the kernel with the fewest vectors covering its rows.
+ */
+struct DirectConvMicroKernel
+{
+    uint32_t vector_rows = 8;
+    uint32_t max_vectors = 1;
+    /// Indexed by the vectors of the run minus one
+    DirectConvTileFunc kernels_3x3[kDirectConvMaxVectors] = {GenericKernel<9, 1>};
+    DirectConvTileFunc kernels_1x1[kDirectConvMaxVectors] = {GenericKernel<1, 1>};
+};
+
+static DirectConvMicroKernel GetMicroKernel(DirectConvKernel kernel)
+{
+    DirectConvMicroKernel micro_kernel;
+#if defined(__x86_64__) || defined(__i386__)
+    if (kernel == DirectConvKernel::kAvx512)
+    {
+        micro_kernel.vector_rows = 16;
+        micro_kernel.max_vectors = 2;
+        micro_kernel.kernels_3x3[0] = Avx512Kernel<9, 1>;
+        micro_kernel.kernels_3x3[1] = Avx512Kernel<9, 2>;
+        micro_kernel.kernels_1x1[0] = Avx512Kernel<1, 1>;
+        micro_kernel.kernels_1x1[1] = Avx512Kernel<1, 2>;
+    }
+    else if (kernel == DirectConvKernel::kAvx2)
+    {
+        micro_kernel.vector_rows = 8;
+        micro_kernel.max_vectors = 3;
+        micro_kernel.kernels_3x3[0] = Avx2Kernel<9, 1>;
+        micro_kernel.kernels_3x3[1] = Avx2Kernel<9, 2>;
+        micro_kernel.kernels_3x3[2] = Avx2Kernel<9, 3>;
+        micro_kernel.kernels_1x1[0] = Avx2Kernel<1, 1>;
+        micro_kernel.kernels_1x1[1] = Avx2Kernel<1, 2>;
+        micro_kernel.kernels_1x1[2] = Avx2Kernel<1, 3>;
+    }
+#endif
+    return micro_kernel;
+}
+
+/**
+ * @brief Splits the padded input of one channel into its stride-2 phases, zeros outside the input
+ */
+static void BuildPhases(const DirectConvPhases& layout, const float* input, uint32_t input_h, uint32_t input_w,
+                        uint32_t padding_h, uint32_t padding_w, float* phases)
+{
+    for (uint32_t phase = 0; phase < layout.phases; ++phase)
+    {
+        for (uint32_t column = 0; column < layout.columns; ++column)
+        {
+            float* phase_column = phases + (size_t(phase) * layout.columns + column) * layout.rows;
+            const int32_t iw = int32_t(column * layout.column_step) - int32_t(padding_w);
+            if (iw < 0 || iw >= int32_t(input_w))
+            {
+                std::fill(phase_column, phase_column + layout.rows, 0.f);
+                continue;
+            }
+            const float* input_column = input + size_t(iw) * input_h;
+            for (uint32_t j = 0; j < layout.rows; ++j)
+            {
+                const int32_t ih = int32_t(2 * j + phase) - int32_t(padding_h);
+                phase_column[j] = ih >= 0 && ih < int32_t(input_h) ? input_column[ih] : 0.f;
+            }
+        }
+    }
+}
+
+void DirectConvStride2(const DirectConvWeights& weights, const float* input, uint32_t input_h, uint32_t input_w,
+                       uint32_t padding_h, uint32_t padding_w, const float* bias, float* output, uint32_t output_h,
+                       uint32_t output_w)
+{
+    CHECK(input != nullptr && output != nullptr);
+    CHECK(weights.kernel_size == 3 || weights.kernel_size == 1);
+    const uint32_t kernel_size = weights.kernel_size;
+    CHECK(output_h == (input_h + 2 * padding_h - kernel_size) / 2 + 1 &&
+          output_w == (input_w + 2 * padding_w - kernel_size) / 2 + 1)
+        << "The output shape does not match a stride-2 convolution of the input";
+    const uint32_t channels = weights.channels;
+    const uint32_t taps = kernel_size * kernel_size;
+    const DirectConvPhases layout(kernel_size, output_h, output_w);
+    const size_t channel_size = layout.channel_size();
+
+    ScratchFrame scratch_frame;
+    float* phases = scratch_frame.Allocate<float>(size_t(channels) * channel_size);
+    ParallelFor(channels, channel_size, [&](uint32_t ic) {
+        BuildPhases(layout, input + size_t(ic) * input_h * input_w, input_h, input_w, padding_h, padding_w,
+                    phases + ic * channel_size);
+    });
+
+    const DirectConvMicroKernel micro_kernel = GetMicroKernel(SelectDirectConvKernel());
+    const DirectConvTileFunc* tile_kernels = kernel_size == 3 ? micro_kernel.kernels_3x3 : micro_kernel.kernels_1x1;
+    const uint32_t blocks = (weights.output_channels + kDirectConvBlock - 1) / kDirectConvBlock;
+    const size_t block_size = size_t(channels) * taps * kDirectConvBlock;
+    const size_t output_hw = size_t(output_h) * output_w;
+    // a task is one block of channels over one output column, the weights of the block stay in L1
+    // while the runs of rows go down the column
+    ParallelFor(blocks * output_w, block_size * output_h, [&](uint32_t task) {
+        const uint32_t block = task / output_w;
+        const uint32_t w = task % output_w;
+        uint32_t tap_offsets[9];
+        for (uint32_t kw = 0; kw < kernel_size; ++kw)
+        {
+            for (uint32_t kh = 0; kh < kernel_size; ++kh)
+            {
+                // the weights of a channel are in (kw, kh) order, padded row 2r + kh is row r + kh / 2
+                // of phase kh % 2
+                tap_offsets[kw * kernel_size + kh] =
+                    ((kh % 2) * layout.columns + w * 2 / layout.column_step + kw) * layout.rows + kh / 2;
+            }
+        }
+        const float* block_weights = weights.values.data() + block * block_size;
+        const uint32_t block_channels = std::min(kDirectConvBlock, weights.output_channels - block * kDirectConvBlock);
+        alignas(64) float tile[kDirectConvBlock * kDirectConvMaxRows];
+        for (uint32_t row = 0; row < output_h;)
+        {
+            const uint32_t vectors =
+                std::min(micro_kernel.max_vectors,
+                         (output_h - row + micro_kernel.vector_rows - 1) / micro_kernel.vector_rows);
+            const uint32_t tile_rows = vectors * micro_kernel.vector_rows;
+            tile_kernels[vectors - 1](channels, block_weights, phases + row, channel_size, tap_offsets, tile);
+            const uint32_t rows = std::min(tile_rows, output_h - row);
+            for (uint32_t o = 0; o < block_channels; ++o)
+            {
+                const uint32_t oc = block * kDirectConvBlock + o;
+                const float bias_value = bias != nullptr ? bias[oc] : 0.f;
+                float* output_ptr = output + oc * output_hw + size_t(w) * output_h + row;
+                const float* tile_row = tile + o * tile_rows;
+                for (uint32_t r = 0; r < rows; ++r)
+                {
+                    output_ptr[r] = tile_row[r] + bias_value;
+                }
+            }
+            row += rows;
+        }
+    });
+}
+
+static std::atomic<bool> direct_conv_enabled{true};
+
+bool DirectConvEnabled()
+{
+    return direct_conv_enabled.load(std::memory_order_relaxed);
+}
+
+void SetDirectConvEnabled(bool enabled)
+{
+    direct_conv_enabled.store(enabled, std::memory_order_relaxed);
+}
+}  // namespace utils
+}  // namespace black_scholes
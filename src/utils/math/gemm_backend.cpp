@@ -0,0 +1,139 @@
+
+#include "utils/math/gemm_backend.hpp"
+#include <glog/logging.h>
+#include <atomic>
+#include "utils/math/half.hpp"
+#include "utils/memory/scratch_arena.hpp"
+
+extern "C" void sgemm_(const char* transa, const char* transb, const int* m, const int* n, const int* k,
+                       const float* alpha, const float* a, const int* lda, const float* b, const int* ldb,
+                       const float* beta, float* c, const int* ldc);
+
+namespace black_scholes
+{
+namespace utils
+{
+const char* GemmBackendName(GemmBackendType type)
+{
+    switch (type)
+    {
+        case GemmBackendType::kPacked:
+            return "packed";
+        case GemmBackendType::kBlas:
+            return "blas";
+        default:
+            return "unknown";
+    }
+}
+
+bool ParseGemmBackend(const std::string& name, GemmBackendType& type)
+{
+    if (name == "packed")
+    {
+        type = GemmBackendType::kPacked;
+        return true;
+    }
+    if (name == "blas")
+    {
+        type = GemmBackendType::kBlas;
+        return true;
+    }
+    return false;
+}
+
+class PackedGemmBackend : public GemmBackend
+{
+   public:
+    GemmBackendType type() const override
+    {
+        return GemmBackendType::kPacked;
+    }
+
+    void Sgemm(bool transpose_a, bool transpose_b, uint32_t m, uint32_t n, uint32_t k, const float* a, size_t lda,
+               const float* b, size_t ldb, float* c, size_t ldc, const SgemmEpilogue& epilogue) const override
+    {
+        utils::Sgemm(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc, epilogue);
+    }
+
+    void SgemmHalfA(bool transpose_a, bool transpose_b, uint32_t m, uint32_t n, uint32_t k, const uint16_t* a,
+                    size_t lda, const float* b, size_t ldb, float* c, size_t ldc,
+                    const SgemmEpilogue& epilogue) const override
+    {
+        utils::SgemmHalfA(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc, epilogue);
+    }
+};
+
+class BlasGemmBackend : public GemmBackend
+{
+   public:
+    GemmBackendType type() const override
+    {
+        return GemmBackendType::kBlas;
+    }
+
+    void Sgemm(bool transpose_a, bool transpose_b, uint32_t m, uint32_t n, uint32_t k, const float* a, size_t lda,
+               const float* b, size_t ldb, float* c, size_t ldc, const SgemmEpilogue& epilogue) const override
+    {
+        if (m == 0 || n == 0)
+        {
+            return;
+        }
+        // the column-major BLAS computes C^T = op(B)^T * op(A)^T on the same memory
+        const char trans_b = transpose_b ? 'T' : 'N';
+        const char trans_a = transpose_a ? 'T' : 'N';
+        const int rows = int(n);
+        const int cols = int(m);
+        const int depth = int(k);
+        const int ld_b = int(ldb);
+        const int ld_a = int(lda);
+        const int ld_c = int(ldc);
+        const float alpha = 1.f;
+        const float beta = 0.f;
+        sgemm_(&trans_b, &trans_a, &rows, &cols, &depth, &alpha, b, &ld_b, a, &ld_a, &beta, c, &ld_c);
+        ApplySgemmEpilogue(m, n, c, ldc, epilogue);
+    }
+
+    void SgemmHalfA(bool transpose_a, bool transpose_b, uint32_t m, uint32_t n, uint32_t k, const uint16_t* a,
+                    size_t lda, const float* b, size_t ldb, float* c, size_t ldc,
+                    const SgemmEpilogue& epilogue) const override
+    {
+        if (m == 0 || n == 0)
+        {
+            return;
+        }
+        // sgemm_ only reads floats, widen the stored A for the duration of the call
+        const uint32_t stored_rows = transpose_a ? k : m;
+        const uint32_t stored_columns = transpose_a ? m : k;
+        ScratchFrame scratch_frame;
+        float* widened = scratch_frame.Allocate<float>(size_t(stored_rows) * stored_columns);
+        for (uint32_t row = 0; row < stored_rows; ++row)
+        {
+            HalfToFloat(a + row * lda, widened + size_t(row) * stored_columns, stored_columns);
+        }
+        Sgemm(transpose_a, transpose_b, m, n, k, widened, stored_columns, b, ldb, c, ldc, epilogue);
+    }
+};
+
+static std::atomic<GemmBackendType> gemm_backend_type{GemmBackendType::kPacked};
+
+const GemmBackend& GetGemmBackend()
+{
+    static const PackedGemmBackend packed_backend;
+    static const BlasGemmBackend blas_backend;
+    if (gemm_backend_type.load(std::memory_order_relaxed) == GemmBackendType::kBlas)
+    {
+        return blas_backend;
+    }
+    return packed_backend;
+}
+
+void SetGemmBackend(GemmBackendType type)
+{
+    if (type != GemmBackendType::kPacked && type != GemmBackendType::kBlas)
+    {
+        LOG(FATAL) << "Unknown gemm backend: " << int(type);
+    }
+    gemm_backend_type.store(type, std::memory_order_relaxed);
+}
+}  // namespace utils
+}  // namespace black_scholes
@@ -0,0 +1,65 @@
+
+#include "utils/math/half.hpp"
+#include <immintrin.h>
+#include "runtime/pnnx/ir.h"
+#include "utils/cpu/cpu_features.hpp"
+
+namespace black_scholes
+{
+namespace utils
+{
+__attribute__((target("avx,f16c"))) static void HalfToFloatF16C(const uint16_t* src, float* dst, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(half));
+    }
+    for (; i < count; ++i)
+    {
+        dst[i] = _cvtsh_ss(src[i]);
+    }
+}
+
+__attribute__((target("avx,f16c"))) static void FloatToHalfF16C(const float* src, uint16_t* dst, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), half);
+    }
+    for (; i < count; ++i)
+    {
+        dst[i] = _cvtss_sh(src[i], _MM_FROUND_TO_NEAREST_INT);
+    }
+}
+
+void HalfToFloat(const uint16_t* src, float* dst, size_t count)
+{
+    if (GetCpuFeatures().f16c)
+    {
+        HalfToFloatF16C(src, dst, count);
+        return;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        dst[i] = pnnx::float16_to_float32(src[i]);
+    }
+}
+
+void FloatToHalf(const float* src, uint16_t* dst, size_t count)
+{
+    if (GetCpuFeatures().f16c)
+    {
+        FloatToHalfF16C(src, dst, count);
+        return;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        dst[i] = pnnx::float32_to_float16(src[i]);
+    }
+}
+}  // namespace utils
+}  // namespace black_scholes
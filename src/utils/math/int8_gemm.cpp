@@ -0,0 +1,326 @@
+
+#include "utils/math/int8_gemm.hpp"
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "utils/cpu/cpu_features.hpp"
+#include "utils/parallel/parallel_utils.hpp"
+
+namespace black_scholes
+{
+namespace utils
+{
+/// Weight rows and activation columns of one register tile
+constexpr uint32_t kInt8RowTile = 4;
+constexpr uint32_t kInt8ColumnTile = 2;
+/// Activation columns of one task, their bytes stay in L2 while every weight row tile sweeps them
+constexpr uint32_t kInt8ColumnBlock = 64;
+
+Int8Kernel SelectInt8Kernel()
+{
+    const CpuFeatures& features = GetCpuFeatures();
+    if (features.avx512vnni && features.avx512bw)
+    {
+        return Int8Kernel::kAvx512Vnni;
+    }
+    if (features.avx_vnni)
+    {
+        return Int8Kernel::kAvxVnni;
+    }
+    if (features.avx2)
+    {
+        return Int8Kernel::kAvx2;
+    }
+    return Int8Kernel::kNone;
+}
+
+const char* Int8KernelName(Int8Kernel kernel)
+{
+    switch (kernel)
+    {
+        case Int8Kernel::kAvx2:
+            return "avx2";
+        case Int8Kernel::kAvxVnni:
+            return "avx_vnni";
+        case Int8Kernel::kAvx512Vnni:
+            return "avx512_vnni";
+        default:
+            return "none";
+    }
+}
+
+size_t Int8PackedMatrix::bytes() const
+{
+    return data.size() * sizeof(int8_t) + row_sums.size() * sizeof(int32_t) + scales.size() * sizeof(float);
+}
+
+Int8PackedMatrix PackInt8Matrix(const int8_t* weights, const float* scales, uint32_t rows, uint32_t depth,
+                                Int8Kernel kernel)
+{
+    CHECK(weights != nullptr && scales != nullptr);
+    CHECK(rows > 0 && depth > 0);
+    Int8PackedMatrix packed;
+    packed.rows = rows;
+    packed.depth = depth;
+    packed.padded_depth = Int8PaddedDepth(depth);
+    packed.kernel = kernel;
+    packed.data.assign(size_t(rows) * packed.padded_depth, 0);
+    packed.row_sums.resize(rows);
+    packed.scales.resize(rows);
+
+    for (uint32_t row = 0; row < rows; ++row)
+    {
+        const int8_t* row_ptr = weights + size_t(row) * depth;
+        int8_t* packed_ptr = packed.data.data() + size_t(row) * packed.padded_depth;
+        int32_t max_level = 0;
+        for (uint32_t k = 0; k < depth; ++k)
+        {
+            max_level = std::max(max_level, std::abs(int32_t(row_ptr[k])));
+        }
+        // maddubs adds two u8 * s8 products in 16 bits, rows past 63 are halved and round to at most 64,
+        // 255 * 64 * 2 = 32640 stays below the saturation at 32767
+        const bool halve = kernel == Int8Kernel::kAvx2 && max_level > 63;
+        int32_t row_sum = 0;
+        for (uint32_t k = 0; k < depth; ++k)
+        {
+            int32_t level = row_ptr[k];
+            if (halve)
+            {
+                level = int32_t(std::lround(level / 2.f));
+            }
+            level = std::min(std::max(level, -127), 127);
+            packed_ptr[k] = int8_t(level);
+            row_sum += level;
+        }
+        packed.row_sums.at(row) = row_sum;
+        packed.scales.at(row) = halve ? scales[row] * 2.f : scales[row];
+    }
+    return packed;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2"))) static inline int32_t HorizontalSum256(__m256i value)
+{
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+}
+
+template <uint32_t kRows, uint32_t kColumns>
+__attribute__((target("avx2"))) static void Avx2Tile(const int8_t* weights, const uint8_t* activations,
+                                                     uint32_t depth, int32_t* accumulators)
+{
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i sums[kRows][kColumns];
+    for (uint32_t r = 0; r < kRows; ++r)
+    {
+        for (uint32_t c = 0; c < kColumns; ++c)
+        {
+            sums[r][c] = _mm256_setzero_si256();
+        }
+    }
+    for (uint32_t k = 0; k < depth; k += 32)
+    {
+        __m256i activation[kColumns];
+        for (uint32_t c = 0; c < kColumns; ++c)
+        {
+            activation[c] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(activations + size_t(c) * depth + k));
+        }
+        for (uint32_t r = 0; r < kRows; ++r)
+        {
+            const __m256i weight =
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + size_t(r) * depth + k));
+            for (uint32_t c = 0; c < kColumns; ++c)
+            {
+                const __m256i pairs = _mm256_maddubs_epi16(activation[c], weight);
+                sums[r][c] = _mm256_add_epi32(sums[r][c], _mm256_madd_epi16(pairs, ones));
+            }
+        }
+    }
+    for (uint32_t r = 0; r < kRows; ++r)
+    {
+        for (uint32_t c = 0; c < kColumns; ++c)
+        {
+            accumulators[r * kColumns + c] = HorizontalSum256(sums[r][c]);
+        }
+    }
+}
+
+template <uint32_t kRows, uint32_t kColumns>
+__attribute__((target("avx2,avxvnni"))) static void AvxVnniTile(const int8_t* weights, const uint8_t* activations,
+                                                                uint32_t depth, int32_t* accumulators)
+{
+    __m256i sums[kRows][kColumns];
+    for (uint32_t r = 0; r < kRows; ++r)
+    {
+        for (uint32_t c = 0; c < kColumns; ++c)
+        {
+            sums[r][c] = _mm256_setzero_si256();
+        }
+    }
+    for (uint32_t k = 0; k < depth; k += 32)
+    {
+        __m256i activation[kColumns];
+        for (uint32_t c = 0; c < kColumns; ++c)
+        {
+            activation[c] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(activations + size_t(c) * depth + k));
+        }
+        for (uint32_t r = 0; r < kRows; ++r)
+        {
+            const __m256i weight =
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + size_t(r) * depth + k));
+            for (uint32_t c = 0; c < kColumns; ++c)
+            {
+                sums[r][c] = _mm256_dpbusd_avx_epi32(sums[r][c], activation[c], weight);
+            }
+        }
+    }
+    for (uint32_t r = 0; r < kRows; ++r)
+    {
+        for (uint32_t c = 0; c < kColumns; ++c)
+        {
+            accumulators[r * kColumns + c] = HorizontalSum256(sums[r][c]);
+        }
+    }
+}
+
+template <uint32_t kRows, uint32_t kColumns>
+__attribute__((target("avx512f,avx512bw,avx512vnni"))) static void Avx512VnniTile(const int8_t* weights,
+                                                                                  const uint8_t* activations,
+                                                                                  uint32_t depth,
+                                                                                  int32_t* accumulators)
+{
+    __m512i sums[kRows][kColumns];
+    for (uint32_t r = 0; r < kRows; ++r)
+    {
+        for (uint32_t c = 0; c < kColumns; ++c)
+        {
+            sums[r][c] = _mm512_setzero_si512();
+        }
+    }
+    for (uint32_t k = 0; k < depth; k += 64)
+    {
+        __m512i activation[kColumns];
+        for (uint32_t c = 0; c < kColumns; ++c)
+        {
+            activation[c] = _mm512_loadu_si512(activations + size_t(c) * depth + k);
+        }
+        for (uint32_t r = 0; r < kRows; ++r)
+        {
+            const __m512i weight = _mm512_loadu_si512(weights + size_t(r) * depth + k);
+            for (uint32_t c = 0; c < kColumns; ++c)
+            {
+                sums[r][c] = _mm512_dpbusd_epi32(sums[r][c], activation[c], weight);
+            }
+        }
+    }
+    for (uint32_t r = 0; r < kRows; ++r)
+    {
+        for (uint32_t c = 0; c < kColumns; ++c)
+        {
+            accumulators[r * kColumns + c] = _mm512_reduce_add_epi32(sums[r][c]);
+        }
+    }
+}
+#endif
+
+template <uint32_t kRows, uint32_t kColumns>
+static void Int8Tile(Int8Kernel kernel, const int8_t* weights, const uint8_t* activations, uint32_t depth,
+                     int32_t* accumulators)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    switch (kernel)
+    {
+        case Int8Kernel::kAvx512Vnni:
+            return Avx512VnniTile<kRows, kColumns>(weights, activations, depth, accumulators);
+        case Int8Kernel::kAvxVnni:
+            return AvxVnniTile<kRows, kColumns>(weights, activations, depth, accumulators);
+        case Int8Kernel::kAvx2:
+            return Avx2Tile<kRows, kColumns>(weights, activations, depth, accumulators);
+        default:
+            break;
+    }
+#endif
+    LOG(FATAL) << "The int8 kernel " << Int8KernelName(kernel) << " is not available on this CPU";
+}
+
+template <uint32_t kRows>
+static void Int8RowTile(Int8Kernel kernel, uint32_t columns, const int8_t* weights, const uint8_t* activations,
+                        uint32_t depth, int32_t* accumulators)
+{
+    if (columns == kInt8ColumnTile)
+    {
+        Int8Tile<kRows, kInt8ColumnTile>(kernel, weights, activations, depth, accumulators);
+    }
+    else
+    {
+        Int8Tile<kRows, 1>(kernel, weights, activations, depth, accumulators);
+    }
+}
+
+void Int8GemmRequantize(const Int8PackedMatrix& weights, const uint8_t* activations, uint32_t columns,
+                        const Int8Epilogue& epilogue, float* output, size_t output_stride)
+{
+    CHECK(weights.kernel != Int8Kernel::kNone) << "The int8 weights are not packed for a kernel";
+    CHECK(activations != nullptr && output != nullptr && epilogue.scales != nullptr);
+    const uint32_t depth = weights.padded_depth;
+    const uint32_t block_count = (columns + kInt8ColumnBlock - 1) / kInt8ColumnBlock;
+    const size_t block_work = size_t(weights.rows) * depth * kInt8ColumnBlock;
+
+    ParallelFor(block_count, block_work, [&](uint32_t block) {
+        const uint32_t column_begin = block * kInt8ColumnBlock;
+        const uint32_t column_end = std::min(columns, column_begin + kInt8ColumnBlock);
+        int32_t accumulators[kInt8RowTile * kInt8ColumnTile];
+        for (uint32_t row = 0; row < weights.rows; row += kInt8RowTile)
+        {
+            const uint32_t tile_rows = std::min(kInt8RowTile, weights.rows - row);
+            const int8_t* weight_ptr = weights.data.data() + size_t(row) * depth;
+            for (uint32_t column = column_begin; column < column_end; column += kInt8ColumnTile)
+            {
+                const uint32_t tile_columns = std::min(kInt8ColumnTile, column_end - column);
+                const uint8_t* activation_ptr = activations + size_t(column) * depth;
+                switch (tile_rows)
+                {
+                    case 4:
+                        Int8RowTile<4>(weights.kernel, tile_columns, weight_ptr, activation_ptr, depth, accumulators);
+                        break;
+                    case 3:
+                        Int8RowTile<3>(weights.kernel, tile_columns, weight_ptr, activation_ptr, depth, accumulators);
+                        break;
+                    case 2:
+                        Int8RowTile<2>(weights.kernel, tile_columns, weight_ptr, activation_ptr, depth, accumulators);
+                        break;
+                    default:
+                        Int8RowTile<1>(weights.kernel, tile_columns, weight_ptr, activation_ptr, depth, accumulators);
+                        break;
+                }
+
+                // the accumulators are still hot, remove the activation offset, scale, bias and requantize
+                for (uint32_t r = 0; r < tile_rows; ++r)
+                {
+                    const uint32_t out_row = row + r;
+                    const int32_t offset = kInt8ActivationOffset * weights.row_sums.at(out_row);
+                    const float bias = epilogue.bias != nullptr ? epilogue.bias[out_row] : 0.f;
+                    float* output_ptr = output + out_row * output_stride + column;
+                    for (uint32_t c = 0; c < tile_columns; ++c)
+                    {
+                        float value = float(accumulators[r * tile_columns + c] - offset) * epilogue.scales[out_row];
+                        value += bias;
+                        if (epilogue.requantize)
+                        {
+                            value = std::min(std::max(std::nearbyint(value), -127.f), 127.f);
+                        }
+                        output_ptr[c] = value;
+                    }
+                }
+            }
+        }
+    });
+}
+}  // namespace utils
+}  // namespace black_scholes
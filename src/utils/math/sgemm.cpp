@@ -0,0 +1,427 @@
+
+#include "utils/math/sgemm.hpp"
+#include <glog/logging.h>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "utils/cpu/cpu_features.hpp"
+#include "utils/math/half.hpp"
+#include "utils/memory/scratch_arena.hpp"
+#include "utils/parallel/parallel_utils.hpp"
+
+namespace black_scholes
+{
+namespace utils
+{
+/// Depth of one packed block, a panel of B stays in L1 while a panel of A streams past it
+constexpr uint32_t kSgemmDepthBlock = 256;
+/// Columns of one packed block of B, it stays in L3 while every row block of A sweeps it
+constexpr uint32_t kSgemmColumnBlock = 4096;
+/// Rows of A and columns of B of one parallel task, in micro-kernel panels
+constexpr uint32_t kSgemmTaskRowPanels = 8;
+constexpr uint32_t kSgemmTaskColumns = 128;
+/// Largest tile of the micro-kernels
+constexpr uint32_t kSgemmMaxRowTile = 12;
+constexpr uint32_t kSgemmMaxColumnTile = 32;
+
+SgemmKernel SelectSgemmKernel()
+{
+    const CpuFeatures& features = GetCpuFeatures();
+    if (features.avx512f)
+    {
+        return SgemmKernel::kAvx512;
+    }
+    if (features.avx2 && features.fma)
+    {
+        return SgemmKernel::kAvx2;
+    }
+    return SgemmKernel::kGeneric;
+}
+
+const char* SgemmKernelName(SgemmKernel kernel)
+{
+    switch (kernel)
+    {
+        case SgemmKernel::kGeneric:
+            return "generic";
+        case SgemmKernel::kAvx2:
+            return "avx2";
+        case SgemmKernel::kAvx512:
+            return "avx512";
+        default:
+            return "unknown";
+    }
+}
+
+static size_t RoundUp(size_t value, size_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+size_t SgemmWorkspaceBytes(uint32_t m, uint32_t n, uint32_t k)
+{
+    const size_t depth = std::min(k, kSgemmDepthBlock);
+    const size_t packed_a = RoundUp(m, kSgemmMaxRowTile) * depth;
+    const size_t packed_b = RoundUp(std::min(n, kSgemmColumnBlock), kSgemmMaxColumnTile) * depth;
+    return (packed_a + packed_b) * sizeof(float) + 2 * ScratchArena::kAlignment;
+}
+
+/**
+ * @brief Computes one tile of products, tile[r * kColumns + c] = sum_k a[k * kRows + r] * b[k * kColumns + c]
+ */
+template <uint32_t kRows, uint32_t kColumns>
+static void GenericKernel(uint32_t depth, const float* a, const float* b, float* tile)
+{
+    float sums[kRows][kColumns] = {};
+    for (uint32_t k = 0; k < depth; ++k)
+    {
+        const float* a_ptr = a + size_t(k) * kRows;
+        const float* b_ptr = b + size_t(k) * kColumns;
+        for (uint32_t r = 0; r < kRows; ++r)
+        {
+            for (uint32_t c = 0; c < kColumns; ++c)
+            {
+                sums[r][c] += a_ptr[r] * b_ptr[c];
+            }
+        }
+    }
+    for (uint32_t r = 0; r < kRows; ++r)
+    {
+        std::copy(sums[r], sums[r] + kColumns, tile + r * kColumns);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2,fma"))) static void Avx2Kernel(uint32_t depth, const float* a, const float* b,
+                                                          float* tile)
+{
+    constexpr uint32_t kRows = 6;
+    __m256 sums[kRows][2];
+    for (uint32_t r = 0; r < kRows; ++r)
+    {
+        sums[r][0] = _mm256_setzero_ps();
+        sums[r][1] = _mm256_setzero_ps();
+    }
+    for (uint32_t k = 0; k < depth; ++k)
+    {
+        const __m256 b0 = _mm256_loadu_ps(b);
+        const __m256 b1 = _mm256_loadu_ps(b + 8);
+        for (uint32_t r = 0; r < kRows; ++r)
+        {
+            const __m256 a_value = _mm256_broadcast_ss(a + r);
+            sums[r][0] = _mm256_fmadd_ps(a_value, b0, sums[r][0]);
+            sums[r][1] = _mm256_fmadd_ps(a_value, b1, sums[r][1]);
+        }
+        a += kRows;
+        b += 16;
+    }
+    for (uint32_t r = 0; r < kRows; ++r)
+    {
+        _mm256_storeu_ps(tile + r * 16, sums[r][0]);
+        _mm256_storeu_ps(tile + r * 16 + 8, sums[r][1]);
+    }
+}
+
+__attribute__((target("avx512f"))) static void Avx512Kernel(uint32_t depth, const float* a, const float* b,
+                                                           float* tile)
+{
+    constexpr uint32_t kRows = 12;
+    __m512 sums[kRows][2];
+    for (uint32_t r = 0; r < kRows; ++r)
+    {
+        sums[r][0] = _mm512_setzero_ps();
+        sums[r][1] = _mm512_setzero_ps();
+    }
+    for (uint32_t k = 0; k < depth; ++k)
+    {
+        const __m512 b0 = _mm512_loadu_ps(b);
+        const __m512 b1 = _mm512_loadu_ps(b + 16);
+        for (uint32_t r = 0; r < kRows; ++r)
+        {
+            const __m512 a_value = _mm512_set1_ps(a[r]);
+            sums[r][0] = _mm512_fmadd_ps(a_value, b0, sums[r][0]);
+            sums[r][1] = _mm512_fmadd_ps(a_value, b1, sums[r][1]);
+        }
+        a += kRows;
+        b += 32;
+    }
+    for (uint32_t r = 0; r < kRows; ++r)
+    {
+        _mm512_storeu_ps(tile + r * 32, sums[r][0]);
+        _mm512_storeu_ps(tile + r * 32 + 16, sums[r][1]);
+    }
+}
+#endif
+
+/**
+ * @brief Tile shape and micro-kernel of a kernel choice
+ */
+struct SgemmMicroKernel
+{
+    uint32_t rows = 6;
+    uint32_t columns = 16;
+    void (*compute)(uint32_t depth, const float* a, const float* b, float* tile) = nullptr;
+};
+
+static SgemmMicroKernel GetMicroKernel(SgemmKernel kernel)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (kernel == SgemmKernel::kAvx512)
+    {
+        return {12, 32, Avx512Kernel};
+    }
+    if (kernel == SgemmKernel::kAvx2)
+    {
+        return {6, 16, Avx2Kernel};
+    }
+#endif
+    return {6, 16, GenericKernel<6, 16>};
+}
+
+static float Activate(float value, GemmActivation activation)
+{
+    switch (activation)
+    {
+        case GemmActivation::kRelu:
+            return std::max(value, 0.f);
+        case GemmActivation::kRelu6:
+            return std::min(std::max(value, 0.f), 6.f);
+        default:
+            return value;
+    }
+}
+
+/**
+ * @brief Packs rows [row, row + rows) and depth [depth_begin, depth_begin + depth) of op(A), panel by panel
+ */
+static void PackA(bool transpose_a, const float* a, size_t lda, uint32_t row, uint32_t rows, uint32_t depth_begin,
+                  uint32_t depth, uint32_t panel_rows, float* packed)
+{
+    for (uint32_t k = 0; k < depth; ++k)
+    {
+        float* packed_ptr = packed + size_t(k) * panel_rows;
+        for (uint32_t r = 0; r < panel_rows; ++r)
+        {
+            if (r >= rows)
+            {
+                packed_ptr[r] = 0.f;
+            }
+            else if (transpose_a)
+            {
+                packed_ptr[r] = a[size_t(depth_begin + k) * lda + row + r];
+            }
+            else
+            {
+                packed_ptr[r] = a[size_t(row + r) * lda + depth_begin + k];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Packs half precision A, widening each row block while it is packed
+ *
+ * HalfToFloat converts with F16C when the CPU has it, so the widened
+ * kernels of a layer never exist outside the panel being computed.
+ */
+static void PackA(bool transpose_a, const uint16_t* a, size_t lda, uint32_t row, uint32_t rows,
+                  uint32_t depth_begin, uint32_t depth, uint32_t panel_rows, float* packed)
+{
+    if (transpose_a)
+    {
+        for (uint32_t k = 0; k < depth; ++k)
+        {
+            float* packed_ptr = packed + size_t(k) * panel_rows;
+            HalfToFloat(a + size_t(depth_begin + k) * lda + row, packed_ptr, rows);
+            std::fill(packed_ptr + rows, packed_ptr + panel_rows, 0.f);
+        }
+        return;
+    }
+    float widened[kSgemmDepthBlock];
+    for (uint32_t r = 0; r < panel_rows; ++r)
+    {
+        if (r < rows)
+        {
+            HalfToFloat(a + size_t(row + r) * lda + depth_begin, widened, depth);
+        }
+        else
+        {
+            std::fill(widened, widened + depth, 0.f);
+        }
+        for (uint32_t k = 0; k < depth; ++k)
+        {
+            packed[size_t(k) * panel_rows + r] = widened[k];
+        }
+    }
+}
+
+/**
+ * @brief Packs columns [column, column + columns) and depth [depth_begin, depth_begin + depth) of op(B)
+ */
+static void PackB(bool transpose_b, const float* b, size_t ldb, uint32_t column, uint32_t columns,
+                  uint32_t depth_begin, uint32_t depth, uint32_t panel_columns, float* packed)
+{
+    if (!transpose_b)
+    {
+        for (uint32_t k = 0; k < depth; ++k)
+        {
+            const float* b_ptr = b + size_t(depth_begin + k) * ldb + column;
+            float* packed_ptr = packed + size_t(k) * panel_columns;
+            std::copy(b_ptr, b_ptr + columns, packed_ptr);
+            std::fill(packed_ptr + columns, packed_ptr + panel_columns, 0.f);
+        }
+        return;
+    }
+    // a stored row of B is a packed column, read it contiguously
+    for (uint32_t c = 0; c < panel_columns; ++c)
+    {
+        float* packed_ptr = packed + c;
+        if (c >= columns)
+        {
+            for (uint32_t k = 0; k < depth; ++k)
+            {
+                packed_ptr[size_t(k) * panel_columns] = 0.f;
+            }
+            continue;
+        }
+        const float* b_ptr = b + size_t(column + c) * ldb + depth_begin;
+        for (uint32_t k = 0; k < depth; ++k)
+        {
+            packed_ptr[size_t(k) * panel_columns] = b_ptr[k];
+        }
+    }
+}
+
+/**
+ * @brief Writes the valid part of a tile to C, adding the previous blocks of the reduction
+ *
+ * @param last Whether the tile holds the last block of the reduction, the epilogue is applied then
+ */
+static void StoreTile(const float* tile, uint32_t tile_columns, uint32_t rows, uint32_t columns, float* c,
+                      size_t ldc, bool accumulate, bool last, const float* bias, GemmActivation activation)
+{
+    for (uint32_t r = 0; r < rows; ++r)
+    {
+        const float* tile_ptr = tile + r * tile_columns;
+        float* c_ptr = c + r * ldc;
+        const float row_bias = last && bias != nullptr ? bias[r] : 0.f;
+        for (uint32_t col = 0; col < columns; ++col)
+        {
+            float value = tile_ptr[col] + row_bias;
+            if (accumulate)
+            {
+                value += c_ptr[col];
+            }
+            c_ptr[col] = last ? Activate(value, activation) : value;
+        }
+    }
+}
+
+template <typename AType>
+static void PackedSgemm(bool transpose_a, bool transpose_b, uint32_t m, uint32_t n, uint32_t k, const AType* a,
+                        size_t lda, const float* b, size_t ldb, float* c, size_t ldc, const SgemmEpilogue& epilogue)
+{
+    CHECK(a != nullptr && b != nullptr && c != nullptr);
+    if (m == 0 || n == 0)
+    {
+        return;
+    }
+    if (k == 0)
+    {
+        for (uint32_t row = 0; row < m; ++row)
+        {
+            std::fill(c + row * ldc, c + row * ldc + n, 0.f);
+        }
+        return ApplySgemmEpilogue(m, n, c, ldc, epilogue);
+    }
+
+    const SgemmMicroKernel micro_kernel = GetMicroKernel(SelectSgemmKernel());
+    const uint32_t panel_rows = micro_kernel.rows;
+    const uint32_t panel_columns = micro_kernel.columns;
+    const uint32_t row_panels = (m + panel_rows - 1) / panel_rows;
+    const uint32_t task_rows = kSgemmTaskRowPanels * panel_rows;
+    const uint32_t row_tasks = (m + task_rows - 1) / task_rows;
+
+    ScratchFrame scratch_frame;
+    float* packed_a = scratch_frame.Allocate<float>(size_t(row_panels) * panel_rows * std::min(k, kSgemmDepthBlock));
+    float* packed_b = scratch_frame.Allocate<float>(RoundUp(std::min(n, kSgemmColumnBlock), panel_columns) *
+                                                    std::min(k, kSgemmDepthBlock));
+
+    for (uint32_t column_block = 0; column_block < n; column_block += kSgemmColumnBlock)
+    {
+        const uint32_t block_columns = std::min(kSgemmColumnBlock, n - column_block);
+        const uint32_t column_panels = (block_columns + panel_columns - 1) / panel_columns;
+        const uint32_t column_tasks = (block_columns + kSgemmTaskColumns - 1) / kSgemmTaskColumns;
+        for (uint32_t depth_block = 0; depth_block < k; depth_block += kSgemmDepthBlock)
+        {
+            const uint32_t depth = std::min(kSgemmDepthBlock, k - depth_block);
+            const bool accumulate = depth_block > 0;
+            const bool last = depth_block + depth == k;
+
+            ParallelFor(column_panels, size_t(depth) * panel_columns, [&](uint32_t panel) {
+                const uint32_t column = panel * panel_columns;
+                PackB(transpose_b, b, ldb, column_block + column, std::min(panel_columns, block_columns - column),
+                      depth_block, depth, panel_columns, packed_b + size_t(panel) * panel_columns * depth);
+            });
+            ParallelFor(row_panels, size_t(depth) * panel_rows, [&](uint32_t panel) {
+                const uint32_t row = panel * panel_rows;
+                PackA(transpose_a, a, lda, row, std::min(panel_rows, m - row), depth_block, depth, panel_rows,
+                      packed_a + size_t(panel) * panel_rows * depth);
+            });
+
+            const size_t task_work = size_t(task_rows) * kSgemmTaskColumns * depth;
+            ParallelFor(row_tasks * column_tasks, task_work, [&](uint32_t task) {
+                const uint32_t row_begin = (task / column_tasks) * task_rows;
+                const uint32_t row_end = std::min(m, row_begin + task_rows);
+                const uint32_t column_begin = (task % column_tasks) * kSgemmTaskColumns;
+                const uint32_t column_end = std::min(block_columns, column_begin + kSgemmTaskColumns);
+                alignas(64) float tile[kSgemmMaxRowTile * kSgemmMaxColumnTile];
+                for (uint32_t column = column_begin; column < column_end; column += panel_columns)
+                {
+                    const float* b_panel = packed_b + size_t(column / panel_columns) * panel_columns * depth;
+                    const uint32_t tile_columns = std::min(panel_columns, column_end - column);
+                    for (uint32_t row = row_begin; row < row_end; row += panel_rows)
+                    {
+                        const float* a_panel = packed_a + size_t(row / panel_rows) * panel_rows * depth;
+                        micro_kernel.compute(depth, a_panel, b_panel, tile);
+                        const float* bias = epilogue.bias != nullptr ? epilogue.bias + row : nullptr;
+                        StoreTile(tile, panel_columns, std::min(panel_rows, row_end - row), tile_columns,
+                                  c + row * ldc + column_block + column, ldc, accumulate, last, bias,
+                                  epilogue.activation);
+                    }
+                }
+            });
+        }
+    }
+}
+
+void Sgemm(bool transpose_a, bool transpose_b, uint32_t m, uint32_t n, uint32_t k, const float* a, size_t lda,
+           const float* b, size_t ldb, float* c, size_t ldc, const SgemmEpilogue& epilogue)
+{
+    PackedSgemm(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc, epilogue);
+}
+
+void SgemmHalfA(bool transpose_a, bool transpose_b, uint32_t m, uint32_t n, uint32_t k, const uint16_t* a,
+                size_t lda, const float* b, size_t ldb, float* c, size_t ldc, const SgemmEpilogue& epilogue)
+{
+    PackedSgemm(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc, epilogue);
+}
+
+void ApplySgemmEpilogue(uint32_t m, uint32_t n, float* c, size_t ldc, const SgemmEpilogue& epilogue)
+{
+    if (epilogue.bias == nullptr && epilogue.activation == GemmActivation::kNone)
+    {
+        return;
+    }
+    ParallelFor(m, n, [&](uint32_t row) {
+        float* c_ptr = c + row * ldc;
+        const float row_bias = epilogue.bias != nullptr ? epilogue.bias[row] : 0.f;
+        for (uint32_t col = 0; col < n; ++col)
+        {
+            c_ptr[col] = Activate(c_ptr[col] + row_bias, epilogue.activation);
+        }
+    });
+}
+}  // namespace utils
+}  // namespace black_scholes
@@ -0,0 +1,240 @@
+
+#include "utils/math/sparse_gemm.hpp"
+#include <glog/logging.h>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "utils/cpu/cpu_features.hpp"
+#include "utils/parallel/parallel_utils.hpp"
+
+namespace black_scholes
+{
+namespace utils
+{
+/// Activation columns of one register tile, two AVX2 registers
+constexpr uint32_t kSparseColumnTile = 16;
+/// Activation columns of one task, the rows of the stored columns stay in L2 while the block rows sweep them
+constexpr uint32_t kSparseColumnBlock = 128;
+/// Block rows of one task, splits layers with few output pixels over more threads
+constexpr uint32_t kSparseBlockRowChunk = 16;
+
+size_t BlockedCsrMatrix::bytes() const
+{
+    return block_offsets.size() * sizeof(uint32_t) + columns.size() * sizeof(uint32_t) +
+           values.size() * sizeof(float);
+}
+
+float WeightSparsity(const float* weights, size_t count)
+{
+    CHECK(weights != nullptr || count == 0);
+    if (count == 0)
+    {
+        return 0.f;
+    }
+    size_t zeros = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        zeros += weights[i] == 0.f;
+    }
+    return float(double(zeros) / double(count));
+}
+
+static size_t StoredBlocks(const float* weights, uint32_t rows, uint32_t depth, uint32_t block_rows)
+{
+    size_t blocks = 0;
+    for (uint32_t row = 0; row < rows; row += block_rows)
+    {
+        const uint32_t row_end = std::min(rows, row + block_rows);
+        for (uint32_t k = 0; k < depth; ++k)
+        {
+            for (uint32_t r = row; r < row_end; ++r)
+            {
+                if (weights[size_t(r) * depth + k] != 0.f)
+                {
+                    blocks += 1;
+                    break;
+                }
+            }
+        }
+    }
+    return blocks;
+}
+
+BlockedCsrMatrix PackBlockedCsr(const float* weights, uint32_t rows, uint32_t depth)
+{
+    CHECK(weights != nullptr);
+    CHECK(rows > 0 && depth > 0);
+    // a stored column costs one activation load plus block_rows multiply-adds, the zeros a block
+    // carries are wasted work, so take the block height with the least of both
+    uint32_t block_rows = 1;
+    size_t best_cost = StoredBlocks(weights, rows, depth, 1) * 2;
+    for (uint32_t candidate : {2u, 4u})
+    {
+        const size_t cost = StoredBlocks(weights, rows, depth, candidate) * (candidate + 1);
+        if (cost < best_cost)
+        {
+            best_cost = cost;
+            block_rows = candidate;
+        }
+    }
+
+    BlockedCsrMatrix packed;
+    packed.rows = rows;
+    packed.depth = depth;
+    packed.block_rows = block_rows;
+    const uint32_t block_row_count = (rows + block_rows - 1) / block_rows;
+    packed.block_offsets.reserve(block_row_count + 1);
+    packed.block_offsets.push_back(0);
+    for (uint32_t row = 0; row < rows; row += block_rows)
+    {
+        const uint32_t row_end = std::min(rows, row + block_rows);
+        for (uint32_t k = 0; k < depth; ++k)
+        {
+            bool nonzero = false;
+            for (uint32_t r = row; r < row_end; ++r)
+            {
+                nonzero = nonzero || weights[size_t(r) * depth + k] != 0.f;
+            }
+            if (!nonzero)
+            {
+                continue;
+            }
+            packed.columns.push_back(k);
+            for (uint32_t r = row; r < row + block_rows; ++r)
+            {
+                packed.values.push_back(r < row_end ? weights[size_t(r) * depth + k] : 0.f);
+            }
+        }
+        packed.block_offsets.push_back(packed.columns.size());
+    }
+    return packed;
+}
+
+template <uint32_t kRows>
+static void ScalarTile(const BlockedCsrMatrix& weights, uint32_t block_row, const float* activations,
+                       uint32_t columns, uint32_t tile_columns, float* accumulators)
+{
+    std::fill(accumulators, accumulators + kRows * kSparseColumnTile, 0.f);
+    for (uint32_t j = weights.block_offsets[block_row]; j < weights.block_offsets[block_row + 1]; ++j)
+    {
+        const float* activation_ptr = activations + size_t(weights.columns[j]) * columns;
+        const float* value_ptr = weights.values.data() + size_t(j) * kRows;
+        for (uint32_t r = 0; r < kRows; ++r)
+        {
+            float* accumulator_ptr = accumulators + r * kSparseColumnTile;
+            for (uint32_t c = 0; c < tile_columns; ++c)
+            {
+                accumulator_ptr[c] += value_ptr[r] * activation_ptr[c];
+            }
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+template <uint32_t kRows>
+__attribute__((target("avx2,fma"))) static void Avx2Tile(const BlockedCsrMatrix& weights, uint32_t block_row,
+                                                        const float* activations, uint32_t columns,
+                                                        float* accumulators)
+{
+    __m256 sums[kRows][2];
+    for (uint32_t r = 0; r < kRows; ++r)
+    {
+        sums[r][0] = _mm256_setzero_ps();
+        sums[r][1] = _mm256_setzero_ps();
+    }
+    for (uint32_t j = weights.block_offsets[block_row]; j < weights.block_offsets[block_row + 1]; ++j)
+    {
+        const float* activation_ptr = activations + size_t(weights.columns[j]) * columns;
+        const float* value_ptr = weights.values.data() + size_t(j) * kRows;
+        const __m256 activation0 = _mm256_loadu_ps(activation_ptr);
+        const __m256 activation1 = _mm256_loadu_ps(activation_ptr + 8);
+        for (uint32_t r = 0; r < kRows; ++r)
+        {
+            const __m256 value = _mm256_broadcast_ss(value_ptr + r);
+            sums[r][0] = _mm256_fmadd_ps(value, activation0, sums[r][0]);
+            sums[r][1] = _mm256_fmadd_ps(value, activation1, sums[r][1]);
+        }
+    }
+    for (uint32_t r = 0; r < kRows; ++r)
+    {
+        _mm256_storeu_ps(accumulators + r * kSparseColumnTile, sums[r][0]);
+        _mm256_storeu_ps(accumulators + r * kSparseColumnTile + 8, sums[r][1]);
+    }
+}
+#endif
+
+template <uint32_t kRows>
+static void SparseBlockRowTile(bool avx2, const BlockedCsrMatrix& weights, uint32_t block_row,
+                               const float* activations, uint32_t columns, uint32_t tile_columns,
+                               float* accumulators)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (avx2 && tile_columns == kSparseColumnTile)
+    {
+        return Avx2Tile<kRows>(weights, block_row, activations, columns, accumulators);
+    }
+#endif
+    ScalarTile<kRows>(weights, block_row, activations, columns, tile_columns, accumulators);
+}
+
+void SparseGemm(const BlockedCsrMatrix& weights, const float* activations, uint32_t columns, const float* bias,
+                float* output, size_t output_stride)
+{
+    CHECK(activations != nullptr && output != nullptr);
+    CHECK(weights.block_offsets.size() >= 1);
+    const CpuFeatures& features = GetCpuFeatures();
+    const bool avx2 = features.avx2 && features.fma;
+    const uint32_t block_rows = weights.block_rows;
+    const uint32_t block_row_count = weights.block_offsets.size() - 1;
+    const uint32_t column_blocks = (columns + kSparseColumnBlock - 1) / kSparseColumnBlock;
+    const uint32_t row_chunks = (block_row_count + kSparseBlockRowChunk - 1) / kSparseBlockRowChunk;
+    const size_t task_work =
+        (weights.values.size() + block_row_count) / std::max(row_chunks, 1u) * kSparseColumnBlock;
+
+    ParallelFor(column_blocks * row_chunks, task_work, [&](uint32_t task) {
+        const uint32_t column_begin = (task % column_blocks) * kSparseColumnBlock;
+        const uint32_t column_end = std::min(columns, column_begin + kSparseColumnBlock);
+        const uint32_t block_row_begin = (task / column_blocks) * kSparseBlockRowChunk;
+        const uint32_t block_row_end = std::min(block_row_count, block_row_begin + kSparseBlockRowChunk);
+        float accumulators[4 * kSparseColumnTile];
+        for (uint32_t block_row = block_row_begin; block_row < block_row_end; ++block_row)
+        {
+            const uint32_t row = block_row * block_rows;
+            const uint32_t tile_rows = std::min(block_rows, weights.rows - row);
+            for (uint32_t column = column_begin; column < column_end; column += kSparseColumnTile)
+            {
+                const uint32_t tile_columns = std::min(kSparseColumnTile, column_end - column);
+                const float* activation_ptr = activations + column;
+                switch (block_rows)
+                {
+                    case 4:
+                        SparseBlockRowTile<4>(avx2, weights, block_row, activation_ptr, columns, tile_columns,
+                                              accumulators);
+                        break;
+                    case 2:
+                        SparseBlockRowTile<2>(avx2, weights, block_row, activation_ptr, columns, tile_columns,
+                                              accumulators);
+                        break;
+                    default:
+                        SparseBlockRowTile<1>(avx2, weights, block_row, activation_ptr, columns, tile_columns,
+                                              accumulators);
+                        break;
+                }
+
+                for (uint32_t r = 0; r < tile_rows; ++r)
+                {
+                    const uint32_t out_row = row + r;
+                    const float row_bias = bias != nullptr ? bias[out_row] : 0.f;
+                    float* output_ptr = output + out_row * output_stride + column;
+                    for (uint32_t c = 0; c < tile_columns; ++c)
+                    {
+                        output_ptr[c] = accumulators[r * kSparseColumnTile + c] + row_bias;
+                    }
+                }
+            }
+        }
+    });
+}
+}  // namespace utils
+}  // namespace black_scholes
@@ -0,0 +1,138 @@
+
+#include "utils/math/weight_quantization.hpp"
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+
+namespace black_scholes
+{
+namespace utils
+{
+/// Largest level of the symmetric int4 quantization, -8 stays unused so the range is symmetric
+constexpr int32_t kInt4MaxLevel = 7;
+constexpr int32_t kInt4Offset = 8;
+
+uint32_t ConvWeightChannel(size_t index, const std::vector<int32_t>& shape, bool transposed, uint32_t groups)
+{
+    CHECK_EQ(shape.size(), 4);
+    const size_t kernel_size = size_t(shape.at(2)) * shape.at(3);
+    if (!transposed)
+    {
+        return uint32_t(index / (kernel_size * shape.at(1)));
+    }
+    // the transposed weights are (in, out / groups, kh, kw), the groups split the input channels
+    const size_t kernel_count_group = shape.at(1);
+    const size_t in_channel = index / (kernel_count_group * kernel_size);
+    const size_t channels_per_group = shape.at(0) / std::max(groups, 1u);
+    return uint32_t(in_channel / channels_per_group * kernel_count_group + index / kernel_size % kernel_count_group);
+}
+
+void QuantizeConvWeightsInt8(const std::vector<float>& weights, const std::vector<int32_t>& shape, bool transposed,
+                             uint32_t groups, std::vector<int8_t>& levels, std::vector<float>& scales)
+{
+    CHECK_EQ(shape.size(), 4);
+    const uint32_t channels = transposed ? uint32_t(shape.at(1)) * std::max(groups, 1u) : uint32_t(shape.at(0));
+    std::vector<float> abs_max(channels, 0.f);
+    for (size_t i = 0; i < weights.size(); ++i)
+    {
+        float& channel_max = abs_max.at(ConvWeightChannel(i, shape, transposed, groups));
+        channel_max = std::max(channel_max, std::fabs(weights.at(i)));
+    }
+
+    scales.resize(channels);
+    for (uint32_t channel = 0; channel < channels; ++channel)
+    {
+        // a channel of zeros quantizes exactly with any scale
+        scales.at(channel) = abs_max.at(channel) > 0.f ? abs_max.at(channel) / 127.f : 1.f;
+    }
+    levels.resize(weights.size());
+    for (size_t i = 0; i < weights.size(); ++i)
+    {
+        const float level = std::nearbyint(weights.at(i) / scales.at(ConvWeightChannel(i, shape, transposed, groups)));
+        levels.at(i) = int8_t(std::min(std::max(level, -127.f), 127.f));
+    }
+}
+
+std::vector<float> DequantizeConvWeightsInt8(const std::vector<int8_t>& levels, const std::vector<float>& scales,
+                                             const std::vector<int32_t>& shape, bool transposed, uint32_t groups)
+{
+    std::vector<float> weights(levels.size());
+    for (size_t i = 0; i < levels.size(); ++i)
+    {
+        const size_t channel = scales.size() > 1 ? ConvWeightChannel(i, shape, transposed, groups) : 0;
+        weights.at(i) = float(levels.at(i)) * scales.at(channel);
+    }
+    return weights;
+}
+
+std::vector<float> DequantizeWeightsInt8(const std::vector<int8_t>& levels, const std::vector<float>& scales,
+                                         size_t row_len)
+{
+    CHECK(row_len > 0 && levels.size() % row_len == 0) << "The int8 weights do not match their rows";
+    CHECK(scales.size() == 1 || scales.size() == levels.size() / row_len)
+        << "The int8 weights need one scale per row or one for the whole tensor";
+    std::vector<float> weights(levels.size());
+    for (size_t i = 0; i < levels.size(); ++i)
+    {
+        weights.at(i) = float(levels.at(i)) * scales.at(scales.size() > 1 ? i / row_len : 0);
+    }
+    return weights;
+}
+
+size_t Int4GroupCount(size_t count, size_t row_len, uint32_t group_size)
+{
+    CHECK(row_len > 0 && group_size > 0 && count % row_len == 0);
+    return count / row_len * ((row_len + group_size - 1) / group_size);
+}
+
+void QuantizeWeightsInt4(const std::vector<float>& weights, size_t row_len, uint32_t group_size,
+                         std::vector<uint8_t>& packed, std::vector<float>& scales)
+{
+    const size_t groups_per_row = (row_len + group_size - 1) / group_size;
+    scales.assign(Int4GroupCount(weights.size(), row_len, group_size), 1.f);
+    packed.assign((weights.size() + 1) / 2, 0);
+    for (size_t row_begin = 0; row_begin < weights.size(); row_begin += row_len)
+    {
+        for (size_t begin = 0; begin < row_len; begin += group_size)
+        {
+            const size_t end = std::min(row_len, begin + group_size);
+            float abs_max = 0.f;
+            for (size_t k = begin; k < end; ++k)
+            {
+                abs_max = std::max(abs_max, std::fabs(weights.at(row_begin + k)));
+            }
+            float& scale = scales.at(row_begin / row_len * groups_per_row + begin / group_size);
+            if (abs_max > 0.f)
+            {
+                scale = abs_max / kInt4MaxLevel;
+            }
+            for (size_t k = begin; k < end; ++k)
+            {
+                const size_t index = row_begin + k;
+                const float level = std::min(std::max(std::nearbyint(weights.at(index) / scale), -float(kInt4MaxLevel)),
+                                             float(kInt4MaxLevel));
+                const uint8_t nibble = uint8_t(int32_t(level) + kInt4Offset);
+                packed.at(index / 2) |= index % 2 == 0 ? nibble : uint8_t(nibble << 4);
+            }
+        }
+    }
+}
+
+std::vector<float> DequantizeWeightsInt4(const std::vector<uint8_t>& packed, const std::vector<float>& scales,
+                                         size_t count, size_t row_len, uint32_t group_size)
+{
+    CHECK_EQ(packed.size(), (count + 1) / 2) << "The int4 weights do not match their shape";
+    CHECK_EQ(scales.size(), Int4GroupCount(count, row_len, group_size)) << "The int4 weights need one scale per group";
+    const size_t groups_per_row = (row_len + group_size - 1) / group_size;
+    std::vector<float> weights(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint8_t byte = packed.at(i / 2);
+        const int32_t level = int32_t(i % 2 == 0 ? byte & 0x0f : byte >> 4) - kInt4Offset;
+        const size_t row = i / row_len;
+        weights.at(i) = float(level) * scales.at(row * groups_per_row + i % row_len / group_size);
+    }
+    return weights;
+}
+}  // namespace utils
+}  // namespace black_scholes
@@ -0,0 +1,273 @@
+
+#include "utils/memory/memory_tracker.hpp"
+#include <glog/logging.h>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+
+namespace black_scholes
+{
+namespace utils
+{
+const char* MemoryCategoryName(MemoryCategory category)
+{
+    switch (category)
+    {
+        case MemoryCategory::kWeights:
+            return "weights";
+        case MemoryCategory::kActivations:
+            return "activations";
+        case MemoryCategory::kScratch:
+            return "scratch";
+        case MemoryCategory::kParseBuffers:
+            return "parse_buffers";
+        default:
+            return "unknown";
+    }
+}
+
+static void UpdatePeak(std::atomic<int64_t>& peak_bytes, int64_t current_bytes)
+{
+    int64_t peak = peak_bytes.load(std::memory_order_relaxed);
+    while (current_bytes > peak &&
+           !peak_bytes.compare_exchange_weak(peak, current_bytes, std::memory_order_relaxed))
+    {
+    }
+}
+
+MemoryAccount::MemoryAccount(std::string name, std::shared_ptr<MemoryAccount> parent)
+    : name_(std::move(name)), parent_(std::move(parent))
+{
+}
+
+std::shared_ptr<MemoryAccount> MemoryAccount::Create(std::string name, std::shared_ptr<MemoryAccount> parent)
+{
+    if (parent == nullptr)
+    {
+        parent = Process();
+    }
+    return std::shared_ptr<MemoryAccount>(new MemoryAccount(std::move(name), std::move(parent)));
+}
+
+const std::shared_ptr<MemoryAccount>& MemoryAccount::Process()
+{
+    static const std::shared_ptr<MemoryAccount> process_account(new MemoryAccount("process", nullptr));
+    return process_account;
+}
+
+void MemoryAccount::Allocate(MemoryCategory category, int64_t bytes)
+{
+    if (bytes == 0)
+    {
+        return;
+    }
+    const uint32_t index = uint32_t(category);
+    CHECK_LT(index, kMemoryCategoryCount);
+    for (MemoryAccount* account = this; account != nullptr; account = account->parent_.get())
+    {
+        const int64_t current = account->current_bytes_[index].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        UpdatePeak(account->peak_bytes_[index], current);
+        const int64_t total = account->total_current_bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        UpdatePeak(account->total_peak_bytes_, total);
+    }
+}
+
+void MemoryAccount::Release(MemoryCategory category, int64_t bytes)
+{
+    if (bytes == 0)
+    {
+        return;
+    }
+    const uint32_t index = uint32_t(category);
+    CHECK_LT(index, kMemoryCategoryCount);
+    for (MemoryAccount* account = this; account != nullptr; account = account->parent_.get())
+    {
+        account->current_bytes_[index].fetch_sub(bytes, std::memory_order_relaxed);
+        account->total_current_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+}
+
+MemoryUsage MemoryAccount::usage(MemoryCategory category) const
+{
+    const uint32_t index = uint32_t(category);
+    CHECK_LT(index, kMemoryCategoryCount);
+    MemoryUsage usage;
+    usage.current_bytes = current_bytes_[index].load(std::memory_order_relaxed);
+    usage.peak_bytes = peak_bytes_[index].load(std::memory_order_relaxed);
+    return usage;
+}
+
+MemoryUsage MemoryAccount::total() const
+{
+    MemoryUsage usage;
+    usage.current_bytes = total_current_bytes_.load(std::memory_order_relaxed);
+    usage.peak_bytes = total_peak_bytes_.load(std::memory_order_relaxed);
+    return usage;
+}
+
+void MemoryAccount::ResetPeak()
+{
+    for (uint32_t i = 0; i < kMemoryCategoryCount; ++i)
+    {
+        peak_bytes_[i].store(current_bytes_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    total_peak_bytes_.store(total_current_bytes_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+const std::string& MemoryAccount::name() const
+{
+    return this->name_;
+}
+
+static thread_local MemoryScope::State current_memory_scope;
+
+MemoryScope::MemoryScope(MemoryAccount* account, MemoryCategory category) : previous_(current_memory_scope)
+{
+    current_memory_scope.account = account;
+    current_memory_scope.category = category;
+}
+
+MemoryScope::MemoryScope(const State& state) : previous_(current_memory_scope)
+{
+    current_memory_scope = state;
+}
+
+MemoryScope::~MemoryScope()
+{
+    current_memory_scope = previous_;
+}
+
+const MemoryScope::State& MemoryScope::Current()
+{
+    return current_memory_scope;
+}
+
+TrackedMemory::TrackedMemory(const TrackedMemory& other)
+{
+    Resize(other.bytes());
+}
+
+TrackedMemory::TrackedMemory(TrackedMemory&& other) noexcept
+    : account_(std::move(other.account_)), category_(other.category_), bytes_(other.bytes_)
+{
+    other.bytes_ = 0;
+}
+
+TrackedMemory& TrackedMemory::operator=(const TrackedMemory& other)
+{
+    if (this != &other)
+    {
+        Resize(other.bytes());
+    }
+    return *this;
+}
+
+TrackedMemory& TrackedMemory::operator=(TrackedMemory&& other) noexcept
+{
+    if (this != &other)
+    {
+        Resize(0);
+        account_ = std::move(other.account_);
+        category_ = other.category_;
+        bytes_ = other.bytes_;
+        other.bytes_ = 0;
+    }
+    return *this;
+}
+
+TrackedMemory::~TrackedMemory()
+{
+    Resize(0);
+}
+
+void TrackedMemory::Resize(size_t bytes)
+{
+    const int64_t new_bytes = int64_t(bytes);
+    if (new_bytes == bytes_)
+    {
+        return;
+    }
+    if (bytes_ == 0)
+    {
+        const MemoryScope::State& scope = MemoryScope::Current();
+        account_ = scope.account != nullptr ? scope.account->shared_from_this() : MemoryAccount::Process();
+        category_ = scope.account != nullptr ? scope.category : MemoryCategory::kActivations;
+    }
+
+    if (new_bytes > bytes_)
+    {
+        account_->Allocate(category_, new_bytes - bytes_);
+    }
+    else
+    {
+        account_->Release(category_, bytes_ - new_bytes);
+    }
+    bytes_ = new_bytes;
+    if (bytes_ == 0)
+    {
+        account_.reset();
+    }
+}
+
+void TrackedMemory::set_category(MemoryCategory category)
+{
+    if (bytes_ == 0 || category == category_)
+    {
+        return;
+    }
+    account_->Release(category_, bytes_);
+    account_->Allocate(category, bytes_);
+    category_ = category;
+}
+
+size_t TrackedMemory::bytes() const
+{
+    return size_t(bytes_);
+}
+
+static std::string FormatBytes(int64_t bytes)
+{
+    std::ostringstream bytes_str;
+    bytes_str << std::fixed << std::setprecision(2) << double(bytes) / (1024. * 1024.) << " MiB";
+    return bytes_str.str();
+}
+
+static std::string FormatUsage(const MemoryUsage& usage)
+{
+    return FormatBytes(usage.current_bytes) + " (peak " + FormatBytes(usage.peak_bytes) + ")";
+}
+
+void MemoryReportLogging(const MemoryReport& report)
+{
+    std::ostringstream total_str;
+    total_str << "Memory total: " << FormatUsage(report.total);
+    for (uint32_t i = 0; i < kMemoryCategoryCount; ++i)
+    {
+        total_str << "\t" << MemoryCategoryName(MemoryCategory(i)) << ": " << FormatUsage(report.categories.at(i));
+    }
+    total_str << "\tscratch arenas: " << FormatBytes(report.scratch_arena_bytes);
+    LOG(INFO) << total_str.str();
+
+    for (const LayerMemoryReport& layer : report.layers)
+    {
+        if (layer.total.peak_bytes == 0)
+        {
+            continue;
+        }
+        std::ostringstream layer_str;
+        layer_str << "Layer name: " << layer.name << "\t"
+                  << "layer type: " << layer.type << "\t"
+                  << "memory: " << FormatUsage(layer.total);
+        for (uint32_t i = 0; i < kMemoryCategoryCount; ++i)
+        {
+            if (layer.categories.at(i).peak_bytes > 0)
+            {
+                layer_str << "\t" << MemoryCategoryName(MemoryCategory(i)) << ": "
+                          << FormatUsage(layer.categories.at(i));
+            }
+        }
+        LOG(INFO) << layer_str.str();
+    }
+}
+}  // namespace utils
+}  // namespace black_scholes
@@ -0,0 +1,143 @@
+
+#include "utils/memory/scratch_arena.hpp"
+#include <glog/logging.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+namespace black_scholes
+{
+namespace utils
+{
+static std::atomic<size_t> reserved_scratch_bytes{0};
+static std::atomic<size_t> total_scratch_capacity{0};
+
+static size_t AlignScratchSize(size_t bytes)
+{
+    return (bytes + ScratchArena::kAlignment - 1) / ScratchArena::kAlignment * ScratchArena::kAlignment;
+}
+
+static void* AllocateScratchBlock(size_t bytes)
+{
+    void* block = std::aligned_alloc(ScratchArena::kAlignment, AlignScratchSize(std::max(bytes, size_t(1))));
+    CHECK(block != nullptr) << "Failed to allocate " << bytes << " bytes of scratch memory";
+    return block;
+}
+
+ScratchArena& ScratchArena::Local()
+{
+    static thread_local ScratchArena arena;
+    return arena;
+}
+
+void ScratchArena::Reserve(size_t bytes)
+{
+    bytes = AlignScratchSize(bytes);
+    size_t reserved = reserved_scratch_bytes.load(std::memory_order_relaxed);
+    while (bytes > reserved && !reserved_scratch_bytes.compare_exchange_weak(reserved, bytes))
+    {
+    }
+}
+
+size_t ScratchArena::reserved_bytes()
+{
+    return reserved_scratch_bytes.load(std::memory_order_relaxed);
+}
+
+size_t ScratchArena::total_capacity()
+{
+    return total_scratch_capacity.load(std::memory_order_relaxed);
+}
+
+ScratchArena::ScratchArena()
+{
+    // the blocks of one frame are few, keep their bookkeeping off the heap after the first use
+    overflow_blocks_.reserve(16);
+}
+
+ScratchArena::~ScratchArena()
+{
+    CHECK_EQ(frame_depth_, 0);
+    std::free(buffer_);
+    total_scratch_capacity.fetch_sub(capacity_, std::memory_order_relaxed);
+}
+
+void ScratchArena::Prepare()
+{
+    if (frame_depth_ != 0)
+    {
+        return;
+    }
+    const size_t required = std::max(reserved_bytes(), AlignScratchSize(high_water_));
+    if (required <= capacity_)
+    {
+        return;
+    }
+    std::free(buffer_);
+    buffer_ = static_cast<char*>(AllocateScratchBlock(required));
+    total_scratch_capacity.fetch_add(required - capacity_, std::memory_order_relaxed);
+    capacity_ = required;
+    high_water_ = 0;
+}
+
+size_t ScratchArena::capacity() const
+{
+    return this->capacity_;
+}
+
+void* ScratchArena::Allocate(size_t bytes)
+{
+    CHECK_GT(frame_depth_, 0) << "Scratch memory must be taken through a ScratchFrame";
+    bytes = AlignScratchSize(bytes);
+    high_water_ = std::max(high_water_, offset_ + overflow_bytes_ + bytes);
+    if (offset_ + bytes <= capacity_)
+    {
+        void* workspace = buffer_ + offset_;
+        offset_ += bytes;
+        return workspace;
+    }
+    // undeclared or grown scratch, served once and absorbed by the next Prepare
+    void* block = AllocateScratchBlock(bytes);
+    overflow_blocks_.push_back(block);
+    overflow_bytes_ += bytes;
+    return block;
+}
+
+ScratchFrame::ScratchFrame() : arena_(ScratchArena::Local())
+{
+    arena_.Prepare();
+    arena_.frame_depth_ += 1;
+    offset_ = arena_.offset_;
+    overflow_count_ = arena_.overflow_blocks_.size();
+    overflow_bytes_ = arena_.overflow_bytes_;
+    account_ = MemoryScope::Current().account;
+}
+
+ScratchFrame::~ScratchFrame()
+{
+    while (arena_.overflow_blocks_.size() > overflow_count_)
+    {
+        std::free(arena_.overflow_blocks_.back());
+        arena_.overflow_blocks_.pop_back();
+    }
+    arena_.offset_ = offset_;
+    arena_.overflow_bytes_ = overflow_bytes_;
+    arena_.frame_depth_ -= 1;
+    if (account_ != nullptr)
+    {
+        account_->Release(MemoryCategory::kScratch, charged_bytes_);
+    }
+}
+
+void* ScratchFrame::AllocateBytes(size_t bytes)
+{
+    void* workspace = arena_.Allocate(bytes);
+    if (account_ != nullptr)
+    {
+        account_->Allocate(MemoryCategory::kScratch, int64_t(bytes));
+        charged_bytes_ += int64_t(bytes);
+    }
+    return workspace;
+}
+}  // namespace utils
+}  // namespace black_scholes
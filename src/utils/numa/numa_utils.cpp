@@ -0,0 +1,180 @@
+
+#include "utils/numa/numa_utils.hpp"
+#include <glog/logging.h>
+#include <omp.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace black_scholes
+{
+namespace utils
+{
+// mempolicy constants from <linux/mempolicy.h>, kept local to avoid a libnuma dependency
+static constexpr int kMpolBind = 2;
+static constexpr unsigned kMpolMfMove = 1u << 1;
+
+static std::vector<uint32_t> ParseCpuList(const std::string& cpu_list)
+{
+    // format: "0-15,32-47"
+    std::vector<uint32_t> cpus;
+    std::stringstream list_stream(cpu_list);
+    std::string range;
+    while (std::getline(list_stream, range, ','))
+    {
+        if (range.empty() || range == "\n")
+        {
+            continue;
+        }
+        const size_t dash_pos = range.find('-');
+        if (dash_pos == std::string::npos)
+        {
+            cpus.push_back(std::stoul(range));
+        }
+        else
+        {
+            const uint32_t first = std::stoul(range.substr(0, dash_pos));
+            const uint32_t last = std::stoul(range.substr(dash_pos + 1));
+            for (uint32_t cpu = first; cpu <= last; ++cpu)
+            {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+
+NumaTopology::NumaTopology()
+{
+    for (uint32_t node = 0;; ++node)
+    {
+        std::ifstream cpu_list_file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!cpu_list_file.is_open())
+        {
+            break;
+        }
+        std::string cpu_list;
+        std::getline(cpu_list_file, cpu_list);
+        node_cpus_.push_back(ParseCpuList(cpu_list));
+    }
+
+    if (node_cpus_.empty())
+    {
+        std::vector<uint32_t> cpus;
+        const long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+        for (long cpu = 0; cpu < cpu_count; ++cpu)
+        {
+            cpus.push_back(uint32_t(cpu));
+        }
+        node_cpus_.push_back(cpus);
+    }
+}
+
+const NumaTopology& NumaTopology::Instance()
+{
+    static NumaTopology topology;
+    return topology;
+}
+
+uint32_t NumaTopology::node_count() const
+{
+    return node_cpus_.size();
+}
+
+const std::vector<uint32_t>& NumaTopology::node_cpus(uint32_t node) const
+{
+    CHECK_LT(node, node_cpus_.size()) << "NUMA node " << node << " does not exist";
+    return node_cpus_.at(node);
+}
+
+bool BindCurrentThreadToNode(int32_t node)
+{
+    const NumaTopology& topology = NumaTopology::Instance();
+    if (node < 0 || uint32_t(node) >= topology.node_count())
+    {
+        LOG(ERROR) << "Can not bind the thread to the NUMA node: " << node;
+        return false;
+    }
+
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (uint32_t cpu : topology.node_cpus(node))
+    {
+        CPU_SET(cpu, &mask);
+    }
+    return sched_setaffinity(0, sizeof(mask), &mask) == 0;
+}
+
+bool BindCurrentThreadToCpu(uint32_t cpu)
+{
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(cpu, &mask);
+    return sched_setaffinity(0, sizeof(mask), &mask) == 0;
+}
+
+void BindOpenMPThreadsToNode(int32_t node)
+{
+    const NumaTopology& topology = NumaTopology::Instance();
+    if (node < 0 || uint32_t(node) >= topology.node_count())
+    {
+        LOG(ERROR) << "Can not bind the OpenMP threads to the NUMA node: " << node;
+        return;
+    }
+
+    const std::vector<uint32_t>& cpus = topology.node_cpus(node);
+    CHECK(!cpus.empty()) << "The NUMA node " << node << " has no cpu";
+    omp_set_num_threads(int(cpus.size()));
+#pragma omp parallel
+    {
+        const uint32_t thread_index = omp_get_thread_num();
+        BindCurrentThreadToCpu(cpus.at(thread_index % cpus.size()));
+    }
+}
+
+bool MoveMemoryToNode(void* ptr, size_t size, int32_t node)
+{
+    if (ptr == nullptr || size == 0 || node < 0 || node >= 64)
+    {
+        return false;
+    }
+
+    const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+    const uintptr_t begin = (reinterpret_cast<uintptr_t>(ptr) + page_size - 1) & ~(page_size - 1);
+    const uintptr_t end = (reinterpret_cast<uintptr_t>(ptr) + size) & ~(page_size - 1);
+    if (end <= begin)
+    {
+        // smaller than a page, it lives wherever its neighbours live
+        return false;
+    }
+
+    unsigned long node_mask = 1ul << node;
+    const long status = syscall(SYS_mbind, reinterpret_cast<void*>(begin), end - begin, kMpolBind, &node_mask,
+                                sizeof(node_mask) * 8, kMpolMfMove);
+    return status == 0;
+}
+
+ScopedNodeAffinity::ScopedNodeAffinity(int32_t node)
+{
+    CPU_ZERO(&previous_mask_);
+    if (node < 0)
+    {
+        return;
+    }
+    if (sched_getaffinity(0, sizeof(previous_mask_), &previous_mask_) == 0)
+    {
+        restore_ = BindCurrentThreadToNode(node);
+    }
+}
+
+ScopedNodeAffinity::~ScopedNodeAffinity()
+{
+    if (restore_)
+    {
+        sched_setaffinity(0, sizeof(previous_mask_), &previous_mask_);
+    }
+}
+}  // namespace utils
+}  // namespace black_scholes
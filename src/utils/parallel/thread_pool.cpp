@@ -0,0 +1,193 @@
+
+#include "utils/parallel/thread_pool.hpp"
+#include <glog/logging.h>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "utils/numa/numa_utils.hpp"
+
+namespace black_scholes
+{
+namespace utils
+{
+static thread_local ThreadPool* current_thread_pool = nullptr;
+static thread_local bool inside_pool_task = false;
+
+static inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+ThreadPool::ThreadPool(uint32_t num_threads, uint32_t spin_time_us, int32_t numa_node)
+    : spin_time_us_(spin_time_us), numa_node_(numa_node)
+{
+    CHECK_GE(num_threads, 1) << "The thread pool needs at least one thread";
+    workers_.reserve(num_threads - 1);
+    for (uint32_t i = 1; i < num_threads; ++i)
+    {
+        workers_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stop_.store(true);
+        generation_.fetch_add(1);
+    }
+    wake_cond_.notify_all();
+    for (std::thread& worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+uint32_t ThreadPool::num_threads() const
+{
+    return workers_.size() + 1;
+}
+
+void ThreadPool::RunTasks()
+{
+    const bool was_inside = inside_pool_task;
+    inside_pool_task = true;
+    for (uint32_t task = next_task_.fetch_add(1); task < task_count_; task = next_task_.fetch_add(1))
+    {
+        (*task_)(task);
+    }
+    inside_pool_task = was_inside;
+}
+
+void ThreadPool::Run(uint32_t task_count, const std::function<void(uint32_t)>& task)
+{
+    if (task_count == 0)
+    {
+        return;
+    }
+    if (task_count == 1 || workers_.empty() || inside_pool_task)
+    {
+        for (uint32_t i = 0; i < task_count; ++i)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    task_ = &task;
+    task_count_ = task_count;
+    next_task_.store(0);
+    pending_workers_.store(workers_.size());
+    generation_.fetch_add(1);
+    if (sleeping_workers_.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        wake_cond_.notify_all();
+    }
+
+    RunTasks();
+    while (pending_workers_.load(std::memory_order_acquire) != 0)
+    {
+        CpuRelax();
+    }
+    task_ = nullptr;
+}
+
+void ThreadPool::Broadcast(const std::function<void(uint32_t)>& func)
+{
+    CHECK(!inside_pool_task) << "A broadcast cannot be started from inside a pool task";
+    if (workers_.empty())
+    {
+        func(0);
+        return;
+    }
+
+    task_ = &func;
+    broadcast_ = true;
+    pending_workers_.store(workers_.size());
+    generation_.fetch_add(1);
+    if (sleeping_workers_.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        wake_cond_.notify_all();
+    }
+
+    inside_pool_task = true;
+    func(0);
+    inside_pool_task = false;
+    while (pending_workers_.load(std::memory_order_acquire) != 0)
+    {
+        CpuRelax();
+    }
+    broadcast_ = false;
+    task_ = nullptr;
+}
+
+void ThreadPool::WorkerLoop(uint32_t worker_index)
+{
+    if (numa_node_ >= 0)
+    {
+        const std::vector<uint32_t>& cpus = NumaTopology::Instance().node_cpus(numa_node_);
+        BindCurrentThreadToCpu(cpus.at(worker_index % cpus.size()));
+    }
+
+    // no loop can start before the constructor returns, a worker scheduled late must still see the first one
+    uint64_t seen_generation = 0;
+    while (true)
+    {
+        // spin for the configured budget first, the next layer usually starts within it
+        const auto spin_deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(spin_time_us_);
+        uint32_t spin_count = 0;
+        while (generation_.load(std::memory_order_acquire) == seen_generation)
+        {
+            CpuRelax();
+            if ((++spin_count & 255) == 0 && std::chrono::steady_clock::now() >= spin_deadline)
+            {
+                std::unique_lock<std::mutex> lock(wake_mutex_);
+                sleeping_workers_.fetch_add(1);
+                wake_cond_.wait(lock, [this, seen_generation] { return generation_.load() != seen_generation; });
+                sleeping_workers_.fetch_sub(1);
+                break;
+            }
+        }
+
+        seen_generation = generation_.load();
+        if (stop_.load())
+        {
+            return;
+        }
+        if (broadcast_)
+        {
+            inside_pool_task = true;
+            (*task_)(worker_index);
+            inside_pool_task = false;
+        }
+        else
+        {
+            RunTasks();
+        }
+        pending_workers_.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+ThreadPool* ThreadPool::Current()
+{
+    return current_thread_pool;
+}
+
+ThreadPool::Scope::Scope(ThreadPool* thread_pool) : previous_pool_(current_thread_pool)
+{
+    current_thread_pool = thread_pool;
+}
+
+ThreadPool::Scope::~Scope()
+{
+    current_thread_pool = previous_pool_;
+}
+}  // namespace utils
+}  // namespace black_scholes
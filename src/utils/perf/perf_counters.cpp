@@ -0,0 +1,225 @@
+
+#include "utils/perf/perf_counters.hpp"
+#include <dirent.h>
+#include <glog/logging.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#include <fstream>
+
+namespace black_scholes
+{
+namespace utils
+{
+const char* PerfEventName(PerfEvent event)
+{
+    switch (event)
+    {
+        case PerfEvent::kCycles:
+            return "cycles";
+        case PerfEvent::kInstructions:
+            return "instructions";
+        case PerfEvent::kL1DMisses:
+            return "L1D misses";
+        case PerfEvent::kLLCMisses:
+            return "LLC misses";
+        case PerfEvent::kVectorInstructions:
+            return "vector instructions";
+        default:
+            return "unknown";
+    }
+}
+
+PerfCounterValues& PerfCounterValues::operator+=(const PerfCounterValues& other)
+{
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        values[i] += other.values[i];
+        available[i] = available[i] || other.available[i];
+    }
+    return *this;
+}
+
+PerfCounterValues PerfCounterValues::operator-(const PerfCounterValues& other) const
+{
+    PerfCounterValues delta;
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        delta.values[i] = values[i] >= other.values[i] ? values[i] - other.values[i] : 0;
+        delta.available[i] = available[i] && other.available[i];
+    }
+    return delta;
+}
+
+static bool IsIntelCpu()
+{
+    std::ifstream cpu_info("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpu_info, line))
+    {
+        if (line.rfind("vendor_id", 0) == 0)
+        {
+            return line.find("GenuineIntel") != std::string::npos;
+        }
+    }
+    return false;
+}
+
+static bool GetEventAttr(PerfEvent event, perf_event_attr& attr)
+{
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    switch (event)
+    {
+        case PerfEvent::kCycles:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            return true;
+        case PerfEvent::kInstructions:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            return true;
+        case PerfEvent::kL1DMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            return true;
+        case PerfEvent::kLLCMisses:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            return true;
+        case PerfEvent::kVectorInstructions:
+        {
+            static const bool is_intel = IsIntelCpu();
+            if (!is_intel)
+            {
+                return false;
+            }
+            // FP_ARITH_INST_RETIRED (0xC7): 128b, 256b and 512b packed single precision
+            attr.type = PERF_TYPE_RAW;
+            attr.config = (0xA8 << 8) | 0xC7;
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+static int PerfEventOpen(perf_event_attr* attr, pid_t tid, int group_fd)
+{
+    return int(syscall(SYS_perf_event_open, attr, tid, -1, group_fd, 0));
+}
+
+PerfCounterSet::PerfCounterSet()
+{
+    DIR* task_dir = opendir("/proc/self/task");
+    if (task_dir == nullptr)
+    {
+        LOG(ERROR) << "Can not list the threads of the process";
+        return;
+    }
+    while (dirent* entry = readdir(task_dir))
+    {
+        if (entry->d_name[0] == '.')
+        {
+            continue;
+        }
+        OpenThread(pid_t(std::stoi(entry->d_name)));
+    }
+    closedir(task_dir);
+    LOG_IF(WARNING, !valid()) << "Can not open the hardware performance counters, check "
+                                 "/proc/sys/kernel/perf_event_paranoid";
+}
+
+void PerfCounterSet::OpenThread(pid_t tid)
+{
+    ThreadCounters counters;
+    counters.tid = tid;
+    counters.fds.fill(-1);
+    counters.group_index.fill(-1);
+
+    for (size_t i = 0; i < size_t(PerfEvent::kEventCount); ++i)
+    {
+        perf_event_attr attr;
+        if (!GetEventAttr(PerfEvent(i), attr))
+        {
+            continue;
+        }
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.disabled = counters.leader_fd == -1 ? 1 : 0;
+        const int fd = PerfEventOpen(&attr, tid, counters.leader_fd);
+        if (fd < 0)
+        {
+            continue;
+        }
+        if (counters.leader_fd == -1)
+        {
+            counters.leader_fd = fd;
+        }
+        counters.fds[i] = fd;
+        counters.group_index[i] = int32_t(counters.group_size);
+        counters.group_size += 1;
+    }
+
+    if (counters.leader_fd == -1)
+    {
+        return;
+    }
+    ioctl(counters.leader_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(counters.leader_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    threads_.push_back(counters);
+}
+
+PerfCounterSet::~PerfCounterSet()
+{
+    for (const ThreadCounters& counters : threads_)
+    {
+        for (int fd : counters.fds)
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+        }
+    }
+}
+
+bool PerfCounterSet::valid() const
+{
+    return !threads_.empty();
+}
+
+PerfCounterValues PerfCounterSet::Read() const
+{
+    PerfCounterValues total;
+    // layout of a group read: nr, time_enabled, time_running, values[nr]
+    std::vector<uint64_t> buffer(3 + size_t(PerfEvent::kEventCount));
+    for (const ThreadCounters& counters : threads_)
+    {
+        const ssize_t read_size = read(counters.leader_fd, buffer.data(), buffer.size() * sizeof(uint64_t));
+        if (read_size < ssize_t(3 * sizeof(uint64_t)))
+        {
+            continue;
+        }
+        const uint64_t time_enabled = buffer[1];
+        const uint64_t time_running = buffer[2];
+        const double scale = time_running > 0 ? double(time_enabled) / double(time_running) : 0.;
+        for (size_t i = 0; i < size_t(PerfEvent::kEventCount); ++i)
+        {
+            const int32_t group_index = counters.group_index[i];
+            if (group_index < 0 || uint64_t(group_index) >= buffer[0])
+            {
+                continue;
+            }
+            total.values[i] += uint64_t(double(buffer[3 + group_index]) * scale);
+            total.available[i] = true;
+        }
+    }
+    return total;
+}
+}  // namespace utils
+}  // namespace black_scholes
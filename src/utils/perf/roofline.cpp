@@ -0,0 +1,287 @@
+
+#include "utils/perf/roofline.hpp"
+#include <glog/logging.h>
+#include <omp.h>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "utils/cpu/cpu_features.hpp"
+#include "utils/time/time_logging.hpp"
+
+namespace black_scholes
+{
+namespace utils
+{
+static double ElapsedSeconds(Time::time_point start_time)
+{
+    return std::chrono::duration<double>(Time::now() - start_time).count();
+}
+
+/// Iterations of the peak loops, each iteration runs one FMA per accumulator lane
+constexpr uint32_t kPeakIterations = 1 << 20;
+constexpr float kPeakScale = 0.999999f;
+constexpr float kPeakShift = 1e-7f;
+
+/**
+ * @brief Loop of independent multiply-add chains of one thread
+ *
+ * @return The sum of the accumulators, it keeps the chains alive
+ */
+using PeakLoop = float (*)(float seed);
+
+/// 8 chains of 16 lanes, vectorized by the compiler for the baseline ISA
+constexpr uint32_t kGenericPeakFlops = 2 * 8 * 16;
+
+static float GenericPeakLoop(float seed)
+{
+    constexpr uint32_t kChains = 8;
+    constexpr uint32_t kLanes = 16;
+    float acc[kChains][kLanes];
+    for (uint32_t c = 0; c < kChains; ++c)
+    {
+        for (uint32_t l = 0; l < kLanes; ++l)
+        {
+            acc[c][l] = float(c + l) + seed;
+        }
+    }
+    for (uint32_t i = 0; i < kPeakIterations; ++i)
+    {
+        for (uint32_t c = 0; c < kChains; ++c)
+        {
+#pragma omp simd
+            for (uint32_t l = 0; l < kLanes; ++l)
+            {
+                acc[c][l] = acc[c][l] * kPeakScale + kPeakShift;
+            }
+        }
+    }
+    float sum = 0.f;
+    for (uint32_t c = 0; c < kChains; ++c)
+    {
+        for (uint32_t l = 0; l < kLanes; ++l)
+        {
+            sum += acc[c][l];
+        }
+    }
+    return sum;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/// 10 chains cover the FMA latency times the two FMA ports of the AVX2 cores
+constexpr uint32_t kAvx2PeakFlops = 2 * 10 * 8;
+
+__attribute__((target("avx2,fma"))) static float Avx2PeakLoop(float seed)
+{
+    const __m256 scale = _mm256_set1_ps(kPeakScale);
+    const __m256 shift = _mm256_set1_ps(kPeakShift);
+    __m256 acc0 = _mm256_set1_ps(seed + 0.f), acc1 = _mm256_set1_ps(seed + 1.f);
+    __m256 acc2 = _mm256_set1_ps(seed + 2.f), acc3 = _mm256_set1_ps(seed + 3.f);
+    __m256 acc4 = _mm256_set1_ps(seed + 4.f), acc5 = _mm256_set1_ps(seed + 5.f);
+    __m256 acc6 = _mm256_set1_ps(seed + 6.f), acc7 = _mm256_set1_ps(seed + 7.f);
+    __m256 acc8 = _mm256_set1_ps(seed + 8.f), acc9 = _mm256_set1_ps(seed + 9.f);
+    for (uint32_t i = 0; i < kPeakIterations; ++i)
+    {
+        acc0 = _mm256_fmadd_ps(acc0, scale, shift);
+        acc1 = _mm256_fmadd_ps(acc1, scale, shift);
+        acc2 = _mm256_fmadd_ps(acc2, scale, shift);
+        acc3 = _mm256_fmadd_ps(acc3, scale, shift);
+        acc4 = _mm256_fmadd_ps(acc4, scale, shift);
+        acc5 = _mm256_fmadd_ps(acc5, scale, shift);
+        acc6 = _mm256_fmadd_ps(acc6, scale, shift);
+        acc7 = _mm256_fmadd_ps(acc7, scale, shift);
+        acc8 = _mm256_fmadd_ps(acc8, scale, shift);
+        acc9 = _mm256_fmadd_ps(acc9, scale, shift);
+    }
+    const __m256 sum = _mm256_add_ps(
+        _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3)),
+                      _mm256_add_ps(_mm256_add_ps(acc4, acc5), _mm256_add_ps(acc6, acc7))),
+        _mm256_add_ps(acc8, acc9));
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, sum);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + lanes[4] + lanes[5] + lanes[6] + lanes[7];
+}
+
+/// 12 chains cover the FMA latency times the two 512-bit FMA ports
+constexpr uint32_t kAvx512PeakFlops = 2 * 12 * 16;
+
+__attribute__((target("avx512f"))) static float Avx512PeakLoop(float seed)
+{
+    const __m512 scale = _mm512_set1_ps(kPeakScale);
+    const __m512 shift = _mm512_set1_ps(kPeakShift);
+    __m512 acc0 = _mm512_set1_ps(seed + 0.f), acc1 = _mm512_set1_ps(seed + 1.f);
+    __m512 acc2 = _mm512_set1_ps(seed + 2.f), acc3 = _mm512_set1_ps(seed + 3.f);
+    __m512 acc4 = _mm512_set1_ps(seed + 4.f), acc5 = _mm512_set1_ps(seed + 5.f);
+    __m512 acc6 = _mm512_set1_ps(seed + 6.f), acc7 = _mm512_set1_ps(seed + 7.f);
+    __m512 acc8 = _mm512_set1_ps(seed + 8.f), acc9 = _mm512_set1_ps(seed + 9.f);
+    __m512 acc10 = _mm512_set1_ps(seed + 10.f), acc11 = _mm512_set1_ps(seed + 11.f);
+    for (uint32_t i = 0; i < kPeakIterations; ++i)
+    {
+        acc0 = _mm512_fmadd_ps(acc0, scale, shift);
+        acc1 = _mm512_fmadd_ps(acc1, scale, shift);
+        acc2 = _mm512_fmadd_ps(acc2, scale, shift);
+        acc3 = _mm512_fmadd_ps(acc3, scale, shift);
+        acc4 = _mm512_fmadd_ps(acc4, scale, shift);
+        acc5 = _mm512_fmadd_ps(acc5, scale, shift);
+        acc6 = _mm512_fmadd_ps(acc6, scale, shift);
+        acc7 = _mm512_fmadd_ps(acc7, scale, shift);
+        acc8 = _mm512_fmadd_ps(acc8, scale, shift);
+        acc9 = _mm512_fmadd_ps(acc9, scale, shift);
+        acc10 = _mm512_fmadd_ps(acc10, scale, shift);
+        acc11 = _mm512_fmadd_ps(acc11, scale, shift);
+    }
+    const __m512 sum = _mm512_add_ps(
+        _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(acc0, acc1), _mm512_add_ps(acc2, acc3)),
+                      _mm512_add_ps(_mm512_add_ps(acc4, acc5), _mm512_add_ps(acc6, acc7))),
+        _mm512_add_ps(_mm512_add_ps(acc8, acc9), _mm512_add_ps(acc10, acc11)));
+    return _mm512_reduce_add_ps(sum);
+}
+#endif
+
+/**
+ * @brief Picks the widest FMA loop of the running CPU
+ *
+ * @param flops_per_iteration Receives the flops of one iteration of the loop
+ */
+static PeakLoop SelectPeakLoop(uint32_t& flops_per_iteration)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    const CpuFeatures& features = GetCpuFeatures();
+    if (features.avx512f)
+    {
+        flops_per_iteration = kAvx512PeakFlops;
+        return Avx512PeakLoop;
+    }
+    if (features.avx2 && features.fma)
+    {
+        flops_per_iteration = kAvx2PeakFlops;
+        return Avx2PeakLoop;
+    }
+#endif
+    flops_per_iteration = kGenericPeakFlops;
+    return GenericPeakLoop;
+}
+
+static double MeasurePeakGflops()
+{
+    uint32_t flops_per_iteration = 0;
+    const PeakLoop peak_loop = SelectPeakLoop(flops_per_iteration);
+    double best_seconds = 0.;
+    int32_t thread_count = 1;
+    float sink = 0.f;
+    for (uint32_t repeat = 0; repeat < 3; ++repeat)
+    {
+        const auto start_time = Time::now();
+#pragma omp parallel reduction(+ : sink)
+        {
+            sink += peak_loop(float(omp_get_thread_num()));
+#pragma omp single
+            thread_count = omp_get_num_threads();
+        }
+        const double seconds = ElapsedSeconds(start_time);
+        best_seconds = repeat == 0 ? seconds : std::min(best_seconds, seconds);
+    }
+    // keeps the chains alive
+    LOG_IF(INFO, sink == 0.f) << "Peak measurement sink: " << sink;
+    const double flops = double(flops_per_iteration) * double(kPeakIterations) * thread_count;
+    return flops / best_seconds * 1e-9;
+}
+
+static double MeasurePeakBandwidth()
+{
+    // three 32MB arrays are far beyond the last level cache of common CPUs
+    const size_t size = size_t(8) << 20;
+    std::unique_ptr<float[]> a(new float[size]);
+    std::unique_ptr<float[]> b(new float[size]);
+    std::unique_ptr<float[]> c(new float[size]);
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < size; ++i)
+    {
+        a[i] = 0.f;
+        b[i] = 1.f;
+        c[i] = 2.f;
+    }
+
+    double best_seconds = 0.;
+    for (uint32_t repeat = 0; repeat < 5; ++repeat)
+    {
+        const auto start_time = Time::now();
+#pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < size; ++i)
+        {
+            a[i] = b[i] + 3.f * c[i];
+        }
+        const double seconds = ElapsedSeconds(start_time);
+        best_seconds = repeat == 0 ? seconds : std::min(best_seconds, seconds);
+    }
+    return 3. * sizeof(float) * double(size) / best_seconds * 1e-9;
+}
+
+const MachinePeak& MeasuredMachinePeak()
+{
+    static const MachinePeak machine_peak = [] {
+        MachinePeak peak;
+        peak.gflops = MeasurePeakGflops();
+        peak.gbytes_per_second = MeasurePeakBandwidth();
+        return peak;
+    }();
+    return machine_peak;
+}
+
+void RooflineLogging(const std::map<std::string, LayerCost>& layer_costs)
+{
+    const MachinePeak& peak = MeasuredMachinePeak();
+    // arithmetic intensity above which a layer can become compute bound
+    const double ridge_intensity = peak.gflops / peak.gbytes_per_second;
+
+    std::ostringstream peak_str;
+    peak_str << std::fixed << std::setprecision(1) << "Machine peak: " << peak.gflops << " GFLOP/s\t"
+             << peak.gbytes_per_second << " GB/s\t"
+             << "ridge: " << ridge_intensity << " FLOP/B";
+    LOG(INFO) << peak_str.str();
+
+    auto layer_time_states = LayerTimeStatesSingleton::SingletonInstance();
+    CHECK(layer_time_states != nullptr);
+    for (const auto& [layer_name, layer_cost] : layer_costs)
+    {
+        const auto layer_state_iter = layer_time_states->find(layer_name);
+        if (layer_state_iter == layer_time_states->end() || layer_cost.bytes <= 0.)
+        {
+            continue;
+        }
+        const auto& layer_state = layer_state_iter->second;
+        CHECK(layer_state != nullptr);
+        int64_t duration_ns = 0;
+        {
+            std::lock_guard<std::mutex> lock(layer_state->time_mutex_);
+            duration_ns = layer_state->duration_ns_;
+        }
+        if (duration_ns <= 0)
+        {
+            continue;
+        }
+
+        const double gflops = layer_cost.flops / double(duration_ns);
+        const double gbytes_per_second = layer_cost.bytes / double(duration_ns);
+        const double intensity = layer_cost.flops / layer_cost.bytes;
+        // the attainable rate of the roofline at this intensity
+        const double attainable_gflops = std::min(peak.gflops, intensity * peak.gbytes_per_second);
+
+        std::ostringstream layer_str;
+        layer_str << std::fixed << std::setprecision(2) << "Layer name: " << layer_name << "\t"
+                  << "layer type: " << layer_state->layer_type_ << "\t" << gflops << " GFLOP/s ("
+                  << 100. * gflops / peak.gflops << "% peak)\t" << gbytes_per_second << " GB/s ("
+                  << 100. * gbytes_per_second / peak.gbytes_per_second << "% peak)\t"
+                  << "intensity: " << intensity << " FLOP/B\t"
+                  << (intensity < ridge_intensity ? "memory" : "compute") << " bound\t"
+                  << "roofline: " << (attainable_gflops > 0. ? 100. * gflops / attainable_gflops : 0.) << "%";
+        LOG(INFO) << layer_str.str();
+    }
+}
+}  // namespace utils
+}  // namespace black_scholes
@@ -0,0 +1,168 @@
+
+#include "utils/time/latency_histogram.hpp"
+#include <glog/logging.h>
+#include <algorithm>
+#include <utility>
+
+namespace black_scholes
+{
+namespace utils
+{
+void LatencyHistogram::MergeInto(std::vector<uint64_t>& counts, uint64_t& total_count, uint64_t& total_sum_ns,
+                                 uint64_t& min_ns, uint64_t& max_ns) const
+{
+    CHECK_EQ(counts.size(), kBucketCount);
+    for (uint32_t bucket = 0; bucket < kBucketCount; ++bucket)
+    {
+        counts[bucket] += counts_[bucket].load(std::memory_order_relaxed);
+    }
+    total_count += total_count_.load(std::memory_order_relaxed);
+    total_sum_ns += total_sum_ns_.load(std::memory_order_relaxed);
+    min_ns = std::min(min_ns, min_ns_.load(std::memory_order_relaxed));
+    max_ns = std::max(max_ns, max_ns_.load(std::memory_order_relaxed));
+}
+
+void LatencyHistogram::Reset()
+{
+    for (auto& count : counts_)
+    {
+        count.store(0, std::memory_order_relaxed);
+    }
+    total_count_.store(0, std::memory_order_relaxed);
+    total_sum_ns_.store(0, std::memory_order_relaxed);
+    min_ns_.store(UINT64_MAX, std::memory_order_relaxed);
+    max_ns_.store(0, std::memory_order_relaxed);
+}
+
+static std::atomic<uint64_t> next_recorder_id{1};
+
+struct LocalShardEntry
+{
+    uint64_t recorder_id = 0;
+    LatencyRecorder::Shard* shard = nullptr;
+};
+
+// recorders used by this thread, ids are never reused so stale entries do not match
+static thread_local std::vector<LocalShardEntry> local_shards;
+
+LatencyRecorder::LatencyRecorder(std::vector<std::string> metric_names)
+    : recorder_id_(next_recorder_id.fetch_add(1)), metric_names_(std::move(metric_names))
+{
+}
+
+LatencyRecorder::Shard& LatencyRecorder::LocalShard()
+{
+    for (const LocalShardEntry& entry : local_shards)
+    {
+        if (entry.recorder_id == recorder_id_)
+        {
+            return *entry.shard;
+        }
+    }
+
+    Shard* shard = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(shards_mutex_);
+        const std::thread::id thread_id = std::this_thread::get_id();
+        for (const auto& [shard_thread_id, thread_shard] : shards_)
+        {
+            if (shard_thread_id == thread_id)
+            {
+                shard = thread_shard.get();
+                break;
+            }
+        }
+        if (shard == nullptr)
+        {
+            shards_.emplace_back(thread_id, std::make_unique<Shard>(metric_names_.size()));
+            shard = shards_.back().second.get();
+        }
+    }
+    // drop the entries of recorders that are probably gone instead of growing forever
+    if (local_shards.size() >= 16)
+    {
+        local_shards.clear();
+    }
+    local_shards.push_back({recorder_id_, shard});
+    return *shard;
+}
+
+LatencySnapshot LatencyRecorder::Snapshot(uint32_t metric) const
+{
+    CHECK_LT(metric, metric_names_.size());
+    std::vector<uint64_t> counts(LatencyHistogram::kBucketCount);
+    uint64_t total_count = 0;
+    uint64_t total_sum_ns = 0;
+    uint64_t min_ns = UINT64_MAX;
+    uint64_t max_ns = 0;
+    {
+        std::lock_guard<std::mutex> lock(shards_mutex_);
+        for (const auto& [thread_id, shard] : shards_)
+        {
+            shard->histograms.at(metric).MergeInto(counts, total_count, total_sum_ns, min_ns, max_ns);
+        }
+    }
+
+    LatencySnapshot snapshot;
+    snapshot.name = metric_names_.at(metric);
+    // the buckets are read one by one while recording goes on, trust their sum over total_count
+    uint64_t bucket_total = 0;
+    for (uint64_t count : counts)
+    {
+        bucket_total += count;
+    }
+    snapshot.count = bucket_total;
+    if (bucket_total == 0)
+    {
+        return snapshot;
+    }
+    snapshot.min_ns = min_ns;
+    snapshot.max_ns = max_ns;
+    snapshot.mean_ns = total_count > 0 ? double(total_sum_ns) / double(total_count) : 0.;
+
+    const std::pair<double, uint64_t*> percentiles[] = {
+        {0.5, &snapshot.p50_ns}, {0.9, &snapshot.p90_ns}, {0.99, &snapshot.p99_ns}, {0.999, &snapshot.p999_ns}};
+    uint64_t accumulated = 0;
+    uint32_t bucket = 0;
+    for (const auto& [percentile, value_ns] : percentiles)
+    {
+        const uint64_t rank = std::max(uint64_t(1), uint64_t(percentile * double(bucket_total) + 0.5));
+        while (bucket < LatencyHistogram::kBucketCount && accumulated + counts[bucket] < rank)
+        {
+            accumulated += counts[bucket];
+            bucket += 1;
+        }
+        *value_ns = LatencyHistogram::BucketLowerBound(std::min(bucket, LatencyHistogram::kBucketCount - 1));
+    }
+    return snapshot;
+}
+
+std::vector<LatencySnapshot> LatencyRecorder::SnapshotAll() const
+{
+    std::vector<LatencySnapshot> snapshots;
+    snapshots.reserve(metric_names_.size());
+    for (uint32_t metric = 0; metric < metric_names_.size(); ++metric)
+    {
+        snapshots.push_back(Snapshot(metric));
+    }
+    return snapshots;
+}
+
+void LatencyRecorder::Reset()
+{
+    std::lock_guard<std::mutex> lock(shards_mutex_);
+    for (const auto& [thread_id, shard] : shards_)
+    {
+        for (LatencyHistogram& histogram : shard->histograms)
+        {
+            histogram.Reset();
+        }
+    }
+}
+
+const std::vector<std::string>& LatencyRecorder::metric_names() const
+{
+    return metric_names_;
+}
+}  // namespace utils
+}  // namespace black_scholes
@@ -1,5 +1,7 @@
 
 #include "utils/time/time_logging.hpp"
+#include <iomanip>
+#include <sstream>
 #include <utility>
 #include "layer/abstract/layer_factory.hpp"
 
@@ -26,16 +28,25 @@ std::mutex LayerTimeStatesSingleton::mutex_;
 
 PtrLayerTimeStatesCollector LayerTimeStatesSingleton::time_states_collector_;
 
-LayerTimeLogging::LayerTimeLogging(std::string layer_name, std::string layer_type)
+LayerTimeLogging::LayerTimeLogging(std::string layer_name, std::string layer_type,
+                                   const PerfCounterSet* perf_counters)
     : layer_name_(std::move(layer_name)),
       layer_type_(std::move(layer_type)),
-      start_time_(Time::now()) {
+      start_time_(Time::now()),
+      perf_counters_(perf_counters) {
   auto layer_time_states = LayerTimeStatesSingleton::SingletonInstance();
   layer_time_states->insert(
       {layer_name_, std::make_shared<LayerTimeState>(0l, layer_name_, layer_type_)});
+  if (perf_counters_ != nullptr) {
+    start_counters_ = perf_counters_->Read();
+  }
 }
 
 LayerTimeLogging::~LayerTimeLogging() {
+  PerfCounterValues counters_delta;
+  if (perf_counters_ != nullptr) {
+    counters_delta = perf_counters_->Read() - start_counters_;
+  }
   auto layer_time_states = LayerTimeStatesSingleton::SingletonInstance();
   const auto layer_state_iter = layer_time_states->find(layer_name_);
   if (layer_state_iter != layer_time_states->end()) {
@@ -47,28 +58,73 @@ LayerTimeLogging::~LayerTimeLogging() {
     const auto duration =
         std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time_).count();
     layer_state->duration_time_ += duration;
+    layer_state->duration_ns_ +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time_).count();
+    layer_state->perf_counters_ += counters_delta;
   } else {
     LOG(ERROR) << "Can not find the layer: " << layer_name_ << " in the time logging.";
   }
 }
 
+static std::string FormatPerfCounters(const PerfCounterValues& counters) {
+  if (!counters.has(PerfEvent::kCycles)) {
+    return "";
+  }
+  std::ostringstream counters_str;
+  counters_str << std::fixed << std::setprecision(2);
+  const double cycles = double(counters.value(PerfEvent::kCycles));
+  const double instructions = double(counters.value(PerfEvent::kInstructions));
+  counters_str << "\tcycles: " << counters.value(PerfEvent::kCycles);
+  if (counters.has(PerfEvent::kInstructions)) {
+    counters_str << "\tIPC: " << (cycles > 0 ? instructions / cycles : 0.);
+  }
+  // cache misses are reported per thousand instructions
+  for (PerfEvent event : {PerfEvent::kL1DMisses, PerfEvent::kLLCMisses}) {
+    if (counters.has(event) && instructions > 0) {
+      counters_str << "\t" << PerfEventName(event)
+                   << " MPKI: " << double(counters.value(event)) * 1000. / instructions;
+    }
+  }
+  if (counters.has(PerfEvent::kVectorInstructions)) {
+    counters_str << "\t" << PerfEventName(PerfEvent::kVectorInstructions) << ": "
+                 << counters.value(PerfEvent::kVectorInstructions);
+  }
+  return counters_str.str();
+}
+
 void LayerTimeLogging::SummaryLogging() {
   auto layer_time_states = LayerTimeStatesSingleton::SingletonInstance();
   CHECK(layer_time_states != nullptr);
   LayerTimeStatesCollector layer_time_states_collector = *layer_time_states.get();
 
   long total_time_costs = 0;
+  std::map<std::string, std::pair<long, PerfCounterValues>> layer_type_states;
   for (const auto& [layer_name, layer_time_state] : layer_time_states_collector) {
     CHECK(layer_time_state != nullptr);
 
     std::lock_guard<std::mutex> lock(layer_time_state->time_mutex_);
     const auto time_cost = layer_time_state->duration_time_;
     total_time_costs += time_cost;
-    if (layer_time_state->duration_time_ != 0) {
+    auto& layer_type_state = layer_type_states[layer_time_state->layer_type_];
+    layer_type_state.first += time_cost;
+    layer_type_state.second += layer_time_state->perf_counters_;
+
+    const bool has_counters = layer_time_state->perf_counters_.has(PerfEvent::kCycles);
+    if (layer_time_state->duration_time_ != 0 || has_counters) {
       LOG(INFO) << "Layer name: " << layer_name << "\t"
                 << "layer type: " << layer_time_state->layer_type_ << "\t"
-                << "time cost: " << time_cost << "ms";
+                << "time cost: " << time_cost << "ms"
+                << FormatPerfCounters(layer_time_state->perf_counters_);
+    }
+  }
+  for (const auto& [layer_type, layer_type_state] : layer_type_states) {
+    if (layer_type_state.first != 0 || layer_type_state.second.has(PerfEvent::kCycles)) {
+      LOG(INFO) << "Layer type: " << layer_type << "\t"
+                << "time cost: " << layer_type_state.first << "ms"
+                << FormatPerfCounters(layer_type_state.second);
     }
   }
   LOG(INFO) << "Total time: " << total_time_costs << "ms";
-} } } 
+}
+}  // namespace utils
+}  // namespace black_scholes
@@ -0,0 +1,196 @@
+
+#include "utils/time/trace_profiler.hpp"
+#include <glog/logging.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <utility>
+
+namespace black_scholes
+{
+namespace utils
+{
+static int64_t SteadyNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static thread_local std::string current_trace_name;
+
+struct LocalTraceBuffer
+{
+    uint64_t session = 0;
+    std::shared_ptr<ThreadTraceBuffer> buffer;
+};
+
+static thread_local LocalTraceBuffer local_trace_buffer;
+
+TraceProfiler& TraceProfiler::Instance()
+{
+    static TraceProfiler profiler;
+    return profiler;
+}
+
+void TraceProfiler::Start()
+{
+    std::lock_guard<std::mutex> lock(buffers_mutex_);
+    buffers_.clear();
+    session_start_ns_ = SteadyNowNs();
+    session_.fetch_add(1);
+    enabled_.store(true);
+}
+
+void TraceProfiler::Stop()
+{
+    enabled_.store(false);
+}
+
+bool TraceProfiler::enabled() const
+{
+    return enabled_.load(std::memory_order_relaxed);
+}
+
+uint64_t TraceProfiler::NowNs() const
+{
+    return uint64_t(SteadyNowNs() - session_start_ns_);
+}
+
+ThreadTraceBuffer* TraceProfiler::LocalBuffer()
+{
+    const uint64_t session = session_.load(std::memory_order_acquire);
+    if (local_trace_buffer.session != session || local_trace_buffer.buffer == nullptr)
+    {
+        auto buffer = std::make_shared<ThreadTraceBuffer>();
+        buffer->events.reserve(1024);
+        std::lock_guard<std::mutex> lock(buffers_mutex_);
+        buffer->thread_index = buffers_.size();
+        buffers_.push_back(buffer);
+        local_trace_buffer.session = session;
+        local_trace_buffer.buffer = buffer;
+    }
+    return local_trace_buffer.buffer.get();
+}
+
+void TraceProfiler::Record(TraceEvent event)
+{
+    if (!enabled())
+    {
+        return;
+    }
+    LocalBuffer()->events.push_back(std::move(event));
+}
+
+std::vector<std::shared_ptr<ThreadTraceBuffer>> TraceProfiler::buffers() const
+{
+    std::lock_guard<std::mutex> lock(buffers_mutex_);
+    return buffers_;
+}
+
+static std::string JsonEscape(const std::string& str)
+{
+    std::string escaped;
+    escaped.reserve(str.size());
+    for (char c : str)
+    {
+        switch (c)
+        {
+            case '"':
+                escaped += "\\\"";
+                break;
+            case '\\':
+                escaped += "\\\\";
+                break;
+            case '\n':
+                escaped += "\\n";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char buffer[8];
+                    snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                    escaped += buffer;
+                }
+                else
+                {
+                    escaped += c;
+                }
+        }
+    }
+    return escaped;
+}
+
+bool TraceProfiler::ExportChromeTrace(const std::string& path) const
+{
+    std::ofstream trace_file(path);
+    if (!trace_file.is_open())
+    {
+        LOG(ERROR) << "Can not open the trace file: " << path;
+        return false;
+    }
+
+    trace_file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first_event = true;
+    char time_buffer[64];
+    for (const auto& buffer : buffers())
+    {
+        for (const TraceEvent& event : buffer->events)
+        {
+            if (!first_event)
+            {
+                trace_file << ",";
+            }
+            first_event = false;
+            // trace_event timestamps are microseconds, keep the ns precision as decimals
+            snprintf(time_buffer, sizeof(time_buffer), "\"ts\":%.3f,\"dur\":%.3f", double(event.start_ns) / 1e3,
+                     double(event.end_ns - event.start_ns) / 1e3);
+            trace_file << "\n{\"name\":\"" << JsonEscape(event.name) << "\",\"cat\":\"" << JsonEscape(event.category)
+                       << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->thread_index << "," << time_buffer
+                       << ",\"args\":{\"inputs\":\"" << JsonEscape(event.input_shapes) << "\",\"outputs\":\""
+                       << JsonEscape(event.output_shapes) << "\"}}";
+        }
+    }
+    trace_file << "\n]}\n";
+    return trace_file.good();
+}
+
+TraceScope::TraceScope(const std::string& name, const std::string& category)
+    : enabled_(TraceProfiler::Instance().enabled())
+{
+    if (enabled_)
+    {
+        event_.name = name;
+        event_.category = category;
+        parent_name_ = current_trace_name;
+        current_trace_name = event_.name;
+        event_.start_ns = TraceProfiler::Instance().NowNs();
+    }
+}
+
+TraceScope::~TraceScope()
+{
+    if (enabled_)
+    {
+        TraceProfiler& profiler = TraceProfiler::Instance();
+        event_.end_ns = profiler.NowNs();
+        current_trace_name = std::move(parent_name_);
+        profiler.Record(std::move(event_));
+    }
+}
+
+void TraceScope::set_shapes(std::string input_shapes, std::string output_shapes)
+{
+    if (enabled_)
+    {
+        event_.input_shapes = std::move(input_shapes);
+        event_.output_shapes = std::move(output_shapes);
+    }
+}
+
+const std::string& CurrentTraceName()
+{
+    return current_trace_name;
+}
+}  // namespace utils
+}  // namespace black_scholes
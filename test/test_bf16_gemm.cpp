@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+#include "utils/math/bf16_gemm.hpp"
+
+using namespace black_scholes::utils;
+
+namespace
+{
+/**
+ * @brief Runs every test on one bf16 kernel, the emulated one runs on any x86 CPU
+ */
+class Bf16GemmTest : public ::testing::TestWithParam<Bf16Kernel>
+{
+   protected:
+    void SetUp() override
+    {
+        if (GetParam() != Bf16Kernel::kEmulated && SelectBf16Kernel() != GetParam())
+        {
+            GTEST_SKIP() << "The CPU has no " << Bf16KernelName(GetParam()) << " kernel";
+        }
+    }
+};
+}  // namespace
+
+TEST_P(Bf16GemmTest, MatchesReference)
+{
+    std::mt19937 generator(5);
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+    for (uint32_t rows : {1u, 3u, 4u, 5u, 9u})
+    {
+        for (uint32_t depth : {1u, 31u, 32u, 33u, 100u})
+        {
+            std::vector<float> weights(size_t(rows) * depth);
+            for (float& weight : weights)
+            {
+                weight = distribution(generator);
+            }
+            const Bf16PackedMatrix packed = PackBf16Matrix(weights.data(), rows, depth, GetParam());
+            ASSERT_EQ(packed.padded_depth, Bf16PaddedDepth(depth));
+            for (uint32_t r = 0; r < rows; ++r)
+            {
+                for (uint32_t k = 0; k < packed.padded_depth; ++k)
+                {
+                    const uint16_t expected = k < depth ? FloatToBf16(weights.at(size_t(r) * depth + k)) : 0;
+                    ASSERT_EQ(packed.data.at(size_t(r) * packed.padded_depth + k), expected);
+                }
+            }
+
+            std::vector<float> bias(rows);
+            for (float& value : bias)
+            {
+                value = distribution(generator);
+            }
+            for (uint32_t columns : {1u, 2u, 3u, 17u, 64u, 130u})
+            {
+                // the padding of the activations is finite, the zero weights cancel it
+                std::vector<uint16_t> activations(size_t(columns) * packed.padded_depth);
+                for (uint16_t& activation : activations)
+                {
+                    activation = FloatToBf16(distribution(generator));
+                }
+
+                for (bool use_bias : {false, true})
+                {
+                    const size_t output_stride = columns + 1;
+                    std::vector<float> output(rows * output_stride, -1000.f);
+                    Bf16Gemm(packed, activations.data(), columns, use_bias ? bias.data() : nullptr, output.data(),
+                             output_stride);
+                    for (uint32_t r = 0; r < rows; ++r)
+                    {
+                        for (uint32_t c = 0; c < columns; ++c)
+                        {
+                            double expected = use_bias ? bias.at(r) : 0.;
+                            double magnitude = std::fabs(expected);
+                            for (uint32_t k = 0; k < packed.padded_depth; ++k)
+                            {
+                                const double product =
+                                    double(Bf16ToFloat(packed.data.at(size_t(r) * packed.padded_depth + k))) *
+                                    Bf16ToFloat(activations.at(size_t(c) * packed.padded_depth + k));
+                                expected += product;
+                                magnitude += std::fabs(product);
+                            }
+                            ASSERT_NEAR(output.at(r * output_stride + c), expected, 1e-5 * magnitude + 1e-6)
+                                << "rows " << rows << " depth " << depth << " columns " << columns << " at " << r
+                                << "," << c << " bias " << use_bias;
+                        }
+                        ASSERT_EQ(output.at(r * output_stride + columns), -1000.f);
+                    }
+                }
+            }
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Bf16Kernels, Bf16GemmTest,
+                         ::testing::Values(Bf16Kernel::kEmulated, Bf16Kernel::kAvx512Bf16),
+                         [](const ::testing::TestParamInfo<Bf16Kernel>& info) {
+                             return std::string(Bf16KernelName(info.param));
+                         });
+
+TEST(Bf16ConversionTest, RoundsToNearestEven)
+{
+    // 1 + 2^-8 is halfway between two bf16 values, the even one is 1
+    EXPECT_EQ(FloatToBf16(1.f + std::ldexp(1.f, -8)), FloatToBf16(1.f));
+    // 1 + 3 * 2^-8 is halfway as well, the even one is 1 + 2^-6
+    EXPECT_EQ(Bf16ToFloat(FloatToBf16(1.f + 3.f * std::ldexp(1.f, -8))), 1.f + std::ldexp(1.f, -6));
+    EXPECT_EQ(Bf16ToFloat(FloatToBf16(-2.5f)), -2.5f);
+    EXPECT_TRUE(std::isinf(Bf16ToFloat(FloatToBf16(std::numeric_limits<float>::infinity()))));
+    EXPECT_TRUE(std::isnan(Bf16ToFloat(FloatToBf16(std::numeric_limits<float>::quiet_NaN()))));
+}
@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "utils/cpu/cpu_features.hpp"
+#include "utils/math/direct_conv.hpp"
+
+using namespace black_scholes::utils;
+
+namespace
+{
+/**
+ * @brief Runs every test on one direct convolution micro-kernel, the wider features are hidden
+ */
+class DirectConvTest : public ::testing::TestWithParam<DirectConvKernel>
+{
+   protected:
+    void SetUp() override
+    {
+        CpuFeatures features;
+        if (GetParam() != DirectConvKernel::kGeneric)
+        {
+            features.avx2 = true;
+            features.fma = true;
+        }
+        if (GetParam() == DirectConvKernel::kAvx512)
+        {
+            features.avx512f = true;
+        }
+        LimitCpuFeatures(features);
+        if (SelectDirectConvKernel() != GetParam())
+        {
+            GTEST_SKIP() << "The CPU has no " << DirectConvKernelName(GetParam()) << " kernel";
+        }
+    }
+
+    void TearDown() override
+    {
+        ResetCpuFeatures();
+    }
+};
+
+struct ConvShape
+{
+    uint32_t output_channels;
+    uint32_t channels;
+    uint32_t input_h;
+    uint32_t input_w;
+};
+
+/// channels off the blocks of 8 and output columns past the runs of 8, 24 and 32 rows
+const std::vector<ConvShape> kConvShapes = {
+    {1, 1, 3, 3}, {5, 3, 7, 5}, {8, 2, 17, 9}, {13, 4, 71, 6}, {16, 3, 66, 3}, {21, 5, 50, 11}};
+}  // namespace
+
+TEST_P(DirectConvTest, MatchesReference)
+{
+    std::mt19937 generator(13);
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+    for (uint32_t kernel_size : {3u, 1u})
+    {
+        const uint32_t taps = kernel_size * kernel_size;
+        for (const ConvShape& shape : kConvShapes)
+        {
+            std::vector<float> weights(size_t(shape.output_channels) * shape.channels * taps);
+            for (float& weight : weights)
+            {
+                weight = distribution(generator);
+            }
+            const DirectConvWeights packed =
+                PackDirectConvWeights(weights.data(), shape.output_channels, shape.channels, kernel_size);
+            std::vector<float> input(size_t(shape.channels) * shape.input_h * shape.input_w);
+            for (float& value : input)
+            {
+                value = distribution(generator);
+            }
+            std::vector<float> bias(shape.output_channels);
+            for (float& value : bias)
+            {
+                value = distribution(generator);
+            }
+
+            for (uint32_t padding : {0u, 1u})
+            {
+                if (shape.input_h + 2 * padding < kernel_size || shape.input_w + 2 * padding < kernel_size)
+                {
+                    continue;
+                }
+                const uint32_t output_h = (shape.input_h + 2 * padding - kernel_size) / 2 + 1;
+                const uint32_t output_w = (shape.input_w + 2 * padding - kernel_size) / 2 + 1;
+                const size_t output_hw = size_t(output_h) * output_w;
+                for (bool use_bias : {false, true})
+                {
+                    // one guard value past the last output channel
+                    std::vector<float> output(shape.output_channels * output_hw + 1, -1000.f);
+                    DirectConvStride2(packed, input.data(), shape.input_h, shape.input_w, padding, padding,
+                                      use_bias ? bias.data() : nullptr, output.data(), output_h, output_w);
+                    for (uint32_t o = 0; o < shape.output_channels; ++o)
+                    {
+                        for (uint32_t w = 0; w < output_w; ++w)
+                        {
+                            for (uint32_t r = 0; r < output_h; ++r)
+                            {
+                                double expected = use_bias ? bias.at(o) : 0.;
+                                double magnitude = std::fabs(expected);
+                                for (uint32_t ic = 0; ic < shape.channels; ++ic)
+                                {
+                                    for (uint32_t kw = 0; kw < kernel_size; ++kw)
+                                    {
+                                        for (uint32_t kh = 0; kh < kernel_size; ++kh)
+                                        {
+                                            const int32_t ih = int32_t(2 * r + kh) - int32_t(padding);
+                                            const int32_t iw = int32_t(2 * w + kw) - int32_t(padding);
+                                            if (ih < 0 || iw < 0 || ih >= int32_t(shape.input_h) ||
+                                                iw >= int32_t(shape.input_w))
+                                            {
+                                                continue;
+                                            }
+                                            const double product =
+                                                double(weights.at((size_t(o) * shape.channels + ic) * taps +
+                                                                  kw * kernel_size + kh)) *
+                                                input.at((size_t(ic) * shape.input_w + iw) * shape.input_h + ih);
+                                            expected += product;
+                                            magnitude += std::fabs(product);
+                                        }
+                                    }
+                                }
+                                ASSERT_NEAR(output.at(o * output_hw + size_t(w) * output_h + r), expected,
+                                            1e-5 * magnitude + 1e-6)
+                                    << "kernel " << kernel_size << " channels " << shape.output_channels << "x"
+                                    << shape.channels << " input " << shape.input_h << "x" << shape.input_w
+                                    << " padding " << padding << " bias " << use_bias << " at " << o << "," << r
+                                    << "," << w;
+                            }
+                        }
+                    }
+                    ASSERT_EQ(output.back(), -1000.f) << "The convolution wrote past the last channel";
+                }
+            }
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(DirectConvKernels, DirectConvTest,
+                         ::testing::Values(DirectConvKernel::kGeneric, DirectConvKernel::kAvx2,
+                                           DirectConvKernel::kAvx512),
+                         [](const ::testing::TestParamInfo<DirectConvKernel>& info) {
+                             return std::string(DirectConvKernelName(info.param));
+                         });
+
+TEST(DirectConvShapeTest, SupportsStride2Downsampling)
+{
+    EXPECT_TRUE(SupportsDirectConv(3, 3, 2, 2, 1, 1));
+    EXPECT_TRUE(SupportsDirectConv(1, 1, 2, 2, 1, 1));
+    EXPECT_FALSE(SupportsDirectConv(3, 3, 1, 1, 1, 1));
+    EXPECT_FALSE(SupportsDirectConv(3, 3, 2, 2, 2, 2));
+    EXPECT_FALSE(SupportsDirectConv(5, 5, 2, 2, 1, 1));
+    EXPECT_FALSE(SupportsDirectConv(3, 1, 2, 2, 1, 1));
+}
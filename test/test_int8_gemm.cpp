@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "utils/cpu/cpu_features.hpp"
+#include "utils/math/int8_gemm.hpp"
+
+using namespace black_scholes::utils;
+
+namespace
+{
+bool CpuHasInt8Kernel(Int8Kernel kernel)
+{
+    const CpuFeatures& features = GetCpuFeatures();
+    switch (kernel)
+    {
+        case Int8Kernel::kAvx2:
+            return features.avx2;
+        case Int8Kernel::kAvxVnni:
+            return features.avx_vnni;
+        case Int8Kernel::kAvx512Vnni:
+            return features.avx512vnni && features.avx512bw;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Runs every test on one int8 kernel
+ */
+class Int8GemmTest : public ::testing::TestWithParam<Int8Kernel>
+{
+   protected:
+    void SetUp() override
+    {
+        if (!CpuHasInt8Kernel(GetParam()))
+        {
+            GTEST_SKIP() << "The CPU has no " << Int8KernelName(GetParam()) << " kernel";
+        }
+    }
+};
+}  // namespace
+
+TEST_P(Int8GemmTest, MatchesReference)
+{
+    std::mt19937 generator(11);
+    std::uniform_int_distribution<int32_t> full_levels(-127, 127);
+    std::uniform_int_distribution<int32_t> small_levels(-63, 63);
+    std::uniform_int_distribution<int32_t> activation_levels(0, 255);
+    std::uniform_real_distribution<float> reals(0.01f, 0.1f);
+
+    for (uint32_t rows : {1u, 3u, 4u, 5u, 13u})
+    {
+        for (uint32_t depth : {1u, 4u, 33u, 100u, 300u})
+        {
+            // the odd rows stay within 6 bits, the others need the full range
+            std::vector<int8_t> weights(size_t(rows) * depth);
+            std::vector<float> weight_scales(rows);
+            for (uint32_t r = 0; r < rows; ++r)
+            {
+                for (uint32_t k = 0; k < depth; ++k)
+                {
+                    const int32_t level = r % 2 ? small_levels(generator) : full_levels(generator);
+                    weights.at(size_t(r) * depth + k) = int8_t(level);
+                }
+                weights.at(size_t(r) * depth) = int8_t(r % 2 ? 63 : -127);
+                weight_scales.at(r) = reals(generator);
+            }
+            const Int8PackedMatrix packed =
+                PackInt8Matrix(weights.data(), weight_scales.data(), rows, depth, GetParam());
+            ASSERT_EQ(packed.padded_depth, Int8PaddedDepth(depth));
+
+            // the packed levels times their scales still describe the weights
+            for (uint32_t r = 0; r < rows; ++r)
+            {
+                for (uint32_t k = 0; k < packed.padded_depth; ++k)
+                {
+                    const int32_t level = packed.data.at(size_t(r) * packed.padded_depth + k);
+                    if (k >= depth)
+                    {
+                        ASSERT_EQ(level, 0) << "The padding of row " << r << " is not zero";
+                        continue;
+                    }
+                    ASSERT_LE(std::abs(level), GetParam() == Int8Kernel::kAvx2 && r % 2 == 0 ? 64 : 127);
+                    const float weight = weights.at(size_t(r) * depth + k) * weight_scales.at(r);
+                    // half a packed level, the scale doubles with the halved levels
+                    ASSERT_NEAR(level * packed.scales.at(r), weight, packed.scales.at(r) * 0.5f + 1e-6f);
+                }
+            }
+
+            for (uint32_t columns : {1u, 2u, 3u, 64u, 65u, 130u})
+            {
+                std::vector<uint8_t> activations(size_t(columns) * packed.padded_depth);
+                for (uint8_t& activation : activations)
+                {
+                    activation = uint8_t(activation_levels(generator));
+                }
+                std::vector<float> epilogue_scales(rows);
+                std::vector<float> bias(rows);
+                for (uint32_t r = 0; r < rows; ++r)
+                {
+                    epilogue_scales.at(r) = packed.scales.at(r) * reals(generator);
+                    bias.at(r) = reals(generator) * 10.f - 0.5f;
+                }
+
+                for (bool requantize : {false, true})
+                {
+                    for (bool use_bias : {false, true})
+                    {
+                        Int8Epilogue epilogue;
+                        epilogue.scales = epilogue_scales.data();
+                        epilogue.bias = use_bias ? bias.data() : nullptr;
+                        epilogue.requantize = requantize;
+                        const size_t output_stride = columns + 3;
+                        std::vector<float> output(rows * output_stride, -1000.f);
+                        Int8GemmRequantize(packed, activations.data(), columns, epilogue, output.data(),
+                                           output_stride);
+
+                        for (uint32_t r = 0; r < rows; ++r)
+                        {
+                            for (uint32_t c = 0; c < columns; ++c)
+                            {
+                                int32_t accumulator = 0;
+                                for (uint32_t k = 0; k < packed.padded_depth; ++k)
+                                {
+                                    accumulator += int32_t(packed.data.at(size_t(r) * packed.padded_depth + k)) *
+                                                   (int32_t(activations.at(size_t(c) * packed.padded_depth + k)) -
+                                                    kInt8ActivationOffset);
+                                }
+                                float expected = float(accumulator) * epilogue_scales.at(r);
+                                expected += use_bias ? bias.at(r) : 0.f;
+                                if (requantize)
+                                {
+                                    expected = std::min(std::max(std::nearbyint(expected), -127.f), 127.f);
+                                }
+                                ASSERT_FLOAT_EQ(output.at(r * output_stride + c), expected)
+                                    << "rows " << rows << " depth " << depth << " columns " << columns << " at "
+                                    << r << "," << c << " requantize " << requantize << " bias " << use_bias;
+                            }
+                            for (size_t c = columns; c < output_stride; ++c)
+                            {
+                                ASSERT_EQ(output.at(r * output_stride + c), -1000.f);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(Int8GemmQuantizeTest, QuantizeActivationRoundsAndClamps)
+{
+    EXPECT_EQ(QuantizeActivation(0.f, 1.f), kInt8ActivationOffset);
+    EXPECT_EQ(QuantizeActivation(2.5f, 1.f), kInt8ActivationOffset + 2);
+    EXPECT_EQ(QuantizeActivation(-3.5f, 1.f), kInt8ActivationOffset - 4);
+    EXPECT_EQ(QuantizeActivation(1000.f, 1.f), kInt8ActivationOffset + 127);
+    EXPECT_EQ(QuantizeActivation(-1000.f, 1.f), kInt8ActivationOffset - 127);
+}
+
+INSTANTIATE_TEST_SUITE_P(Int8Kernels, Int8GemmTest,
+                         ::testing::Values(Int8Kernel::kAvx2, Int8Kernel::kAvxVnni, Int8Kernel::kAvx512Vnni),
+                         [](const ::testing::TestParamInfo<Int8Kernel>& info) {
+                             return std::string(Int8KernelName(info.param));
+                         });
@@ -0,0 +1,281 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "utils/cpu/cpu_features.hpp"
+#include "utils/math/gemm_backend.hpp"
+#include "utils/math/half.hpp"
+#include "utils/math/sgemm.hpp"
+
+using namespace black_scholes::utils;
+
+namespace
+{
+/// Marks the elements of C outside the m x n result, the GEMM must leave them alone
+constexpr float kGuardValue = -12345.f;
+
+std::vector<float> RandomValues(size_t count, std::mt19937& generator)
+{
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+    std::vector<float> values(count);
+    for (float& value : values)
+    {
+        value = distribution(generator);
+    }
+    return values;
+}
+
+/**
+ * @brief Scalar C = epilogue(op(A) * op(B)) accumulated in double
+ *
+ * @param magnitude Receives sum |a| * |b| of every element, the scale of its rounding error
+ */
+void ReferenceSgemm(bool transpose_a, bool transpose_b, uint32_t m, uint32_t n, uint32_t k, const float* a,
+                    size_t lda, const float* b, size_t ldb, const SgemmEpilogue& epilogue, std::vector<float>& c,
+                    std::vector<float>& magnitude)
+{
+    c.assign(size_t(m) * n, 0.f);
+    magnitude.assign(size_t(m) * n, 0.f);
+    for (uint32_t i = 0; i < m; ++i)
+    {
+        for (uint32_t j = 0; j < n; ++j)
+        {
+            double sum = epilogue.bias != nullptr ? epilogue.bias[i] : 0.;
+            double abs_sum = std::fabs(sum);
+            for (uint32_t p = 0; p < k; ++p)
+            {
+                const double a_value = transpose_a ? a[size_t(p) * lda + i] : a[size_t(i) * lda + p];
+                const double b_value = transpose_b ? b[size_t(j) * ldb + p] : b[size_t(p) * ldb + j];
+                sum += a_value * b_value;
+                abs_sum += std::fabs(a_value * b_value);
+            }
+            if (epilogue.activation == GemmActivation::kRelu)
+            {
+                sum = std::max(sum, 0.);
+            }
+            else if (epilogue.activation == GemmActivation::kRelu6)
+            {
+                sum = std::min(std::max(sum, 0.), 6.);
+            }
+            c.at(size_t(i) * n + j) = float(sum);
+            magnitude.at(size_t(i) * n + j) = float(abs_sum);
+        }
+    }
+}
+
+struct GemmShape
+{
+    uint32_t m;
+    uint32_t n;
+    uint32_t k;
+};
+
+/// odd sizes around the micro-kernel tiles and past the depth block of 256
+const std::vector<GemmShape> kGemmShapes = {{1, 1, 1},   {5, 7, 3},    {6, 16, 17},  {13, 33, 64},
+                                           {25, 130, 257}, {12, 32, 300}, {37, 5, 513}};
+
+const std::vector<GemmActivation> kActivations = {GemmActivation::kNone, GemmActivation::kRelu,
+                                                  GemmActivation::kRelu6};
+
+/**
+ * @brief Runs a GEMM on every shape, transpose combination and epilogue and compares it with the reference
+ *
+ * @param half_a Rounds A to half precision and passes it as such
+ */
+template <typename Gemm>
+void CheckGemm(const Gemm& gemm, bool half_a)
+{
+    std::mt19937 generator(7);
+    for (const GemmShape& shape : kGemmShapes)
+    {
+        for (uint32_t combination = 0; combination < 4; ++combination)
+        {
+            const bool transpose_a = combination & 1u;
+            const bool transpose_b = combination & 2u;
+            // leading dimensions a few elements past the stored rows
+            const size_t lda = (transpose_a ? shape.m : shape.k) + 3;
+            const size_t ldb = (transpose_b ? shape.k : shape.n) + 5;
+            const size_t ldc = shape.n + 2;
+            std::vector<float> a = RandomValues((transpose_a ? shape.k : shape.m) * lda, generator);
+            const std::vector<float> b = RandomValues((transpose_b ? shape.n : shape.k) * ldb, generator);
+            const std::vector<float> bias = RandomValues(shape.m, generator);
+            std::vector<uint16_t> a_half(a.size());
+            if (half_a)
+            {
+                // the reference multiplies the values A holds once rounded
+                FloatToHalf(a.data(), a_half.data(), a.size());
+                HalfToFloat(a_half.data(), a.data(), a.size());
+            }
+
+            for (GemmActivation activation : kActivations)
+            {
+                for (bool use_bias : {false, true})
+                {
+                    SgemmEpilogue epilogue;
+                    epilogue.bias = use_bias ? bias.data() : nullptr;
+                    epilogue.activation = activation;
+                    std::vector<float> c(size_t(shape.m) * ldc, kGuardValue);
+                    gemm(transpose_a, transpose_b, shape.m, shape.n, shape.k, a.data(), a_half.data(), lda, b.data(),
+                         ldb, c.data(), ldc, epilogue);
+
+                    std::vector<float> expected;
+                    std::vector<float> magnitude;
+                    ReferenceSgemm(transpose_a, transpose_b, shape.m, shape.n, shape.k, a.data(), lda, b.data(), ldb,
+                                   epilogue, expected, magnitude);
+                    for (uint32_t i = 0; i < shape.m; ++i)
+                    {
+                        for (uint32_t j = 0; j < shape.n; ++j)
+                        {
+                            const size_t index = size_t(i) * shape.n + j;
+                            ASSERT_NEAR(c.at(i * ldc + j), expected.at(index), 1e-5f * magnitude.at(index) + 1e-6f)
+                                << "m " << shape.m << " n " << shape.n << " k " << shape.k << " transpose "
+                                << transpose_a << transpose_b << " activation " << int32_t(activation) << " bias "
+                                << use_bias << " at " << i << "," << j;
+                        }
+                        for (size_t j = shape.n; j < ldc; ++j)
+                        {
+                            ASSERT_EQ(c.at(i * ldc + j), kGuardValue) << "The GEMM wrote past row " << i;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Runs every test on one SGEMM micro-kernel, the wider features are hidden
+ */
+class SgemmKernelTest : public ::testing::TestWithParam<SgemmKernel>
+{
+   protected:
+    void SetUp() override
+    {
+        CpuFeatures features;
+        if (GetParam() != SgemmKernel::kGeneric)
+        {
+            features.avx2 = true;
+            features.fma = true;
+            features.f16c = true;
+        }
+        if (GetParam() == SgemmKernel::kAvx512)
+        {
+            features.avx512f = true;
+        }
+        LimitCpuFeatures(features);
+        if (SelectSgemmKernel() != GetParam())
+        {
+            GTEST_SKIP() << "The CPU has no " << SgemmKernelName(GetParam()) << " kernel";
+        }
+    }
+
+    void TearDown() override
+    {
+        ResetCpuFeatures();
+    }
+};
+}  // namespace
+
+TEST_P(SgemmKernelTest, MatchesReference)
+{
+    CheckGemm(
+        [](bool transpose_a, bool transpose_b, uint32_t m, uint32_t n, uint32_t k, const float* a, const uint16_t*,
+           size_t lda, const float* b, size_t ldb, float* c, size_t ldc, const SgemmEpilogue& epilogue) {
+            Sgemm(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc, epilogue);
+        },
+        false);
+}
+
+TEST_P(SgemmKernelTest, HalfAMatchesReference)
+{
+    CheckGemm(
+        [](bool transpose_a, bool transpose_b, uint32_t m, uint32_t n, uint32_t k, const float*, const uint16_t* a,
+           size_t lda, const float* b, size_t ldb, float* c, size_t ldc, const SgemmEpilogue& epilogue) {
+            SgemmHalfA(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc, epilogue);
+        },
+        true);
+}
+
+INSTANTIATE_TEST_SUITE_P(SgemmKernels, SgemmKernelTest,
+                         ::testing::Values(SgemmKernel::kGeneric, SgemmKernel::kAvx2, SgemmKernel::kAvx512),
+                         [](const ::testing::TestParamInfo<SgemmKernel>& info) {
+                             return std::string(SgemmKernelName(info.param));
+                         });
+
+/**
+ * @brief Runs every test on one GEMM backend
+ */
+class GemmBackendTest : public ::testing::TestWithParam<GemmBackendType>
+{
+   protected:
+    void SetUp() override
+    {
+        SetGemmBackend(GetParam());
+    }
+
+    void TearDown() override
+    {
+        SetGemmBackend(GemmBackendType::kPacked);
+    }
+};
+
+TEST_P(GemmBackendTest, MatchesReference)
+{
+    CheckGemm(
+        [](bool transpose_a, bool transpose_b, uint32_t m, uint32_t n, uint32_t k, const float* a, const uint16_t*,
+           size_t lda, const float* b, size_t ldb, float* c, size_t ldc, const SgemmEpilogue& epilogue) {
+            GetGemmBackend().Sgemm(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc, epilogue);
+        },
+        false);
+}
+
+TEST_P(GemmBackendTest, HalfAMatchesReference)
+{
+    CheckGemm(
+        [](bool transpose_a, bool transpose_b, uint32_t m, uint32_t n, uint32_t k, const float*, const uint16_t* a,
+           size_t lda, const float* b, size_t ldb, float* c, size_t ldc, const SgemmEpilogue& epilogue) {
+            GetGemmBackend().SgemmHalfA(transpose_a, transpose_b, m, n, k, a, lda, b, ldb, c, ldc, epilogue);
+        },
+        true);
+}
+
+INSTANTIATE_TEST_SUITE_P(GemmBackends, GemmBackendTest,
+                         ::testing::Values(GemmBackendType::kPacked, GemmBackendType::kBlas),
+                         [](const ::testing::TestParamInfo<GemmBackendType>& info) {
+                             return std::string(GemmBackendName(info.param));
+                         });
+
+TEST(HalfConversionTest, F16CMatchesSoftware)
+{
+    std::vector<uint16_t> halves(1u << 16);
+    for (uint32_t i = 0; i < halves.size(); ++i)
+    {
+        halves.at(i) = uint16_t(i);
+    }
+    std::vector<float> software(halves.size());
+    std::vector<float> f16c(halves.size());
+    CpuFeatures no_f16c;
+    LimitCpuFeatures(no_f16c);
+    HalfToFloat(halves.data(), software.data(), halves.size());
+    ResetCpuFeatures();
+    if (!GetCpuFeatures().f16c)
+    {
+        GTEST_SKIP() << "The CPU has no F16C instructions";
+    }
+    HalfToFloat(halves.data(), f16c.data(), halves.size());
+
+    std::vector<uint16_t> round_trip(halves.size());
+    FloatToHalf(f16c.data(), round_trip.data(), f16c.size());
+    for (uint32_t i = 0; i < halves.size(); ++i)
+    {
+        if (std::isnan(f16c.at(i)))
+        {
+            ASSERT_TRUE(std::isnan(software.at(i))) << "half " << i;
+            continue;
+        }
+        ASSERT_EQ(f16c.at(i), software.at(i)) << "half " << i;
+        ASSERT_EQ(round_trip.at(i), halves.at(i)) << "half " << i;
+    }
+}
@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "utils/cpu/cpu_features.hpp"
+#include "utils/math/sparse_gemm.hpp"
+
+using namespace black_scholes::utils;
+
+namespace
+{
+/**
+ * @brief Weights about 70% zeros whose rows share their zeros in groups of group_rows
+ *
+ * With group_rows 2 the next pair takes the complement of the zeros, so
+ * blocks of 4 rows store every column and blocks of 2 rows are the cheapest.
+ */
+std::vector<float> SparseWeights(uint32_t rows, uint32_t depth, uint32_t group_rows, std::mt19937& generator)
+{
+    std::bernoulli_distribution nonzero(0.3);
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+    std::vector<float> weights(size_t(rows) * depth, 0.f);
+    std::vector<bool> mask(depth);
+    for (uint32_t row = 0; row < rows; ++row)
+    {
+        if (row % group_rows == 0)
+        {
+            for (uint32_t k = 0; k < depth; ++k)
+            {
+                mask.at(k) = group_rows == 2 && row % 4 == 2 ? !mask.at(k) : nonzero(generator);
+            }
+        }
+        for (uint32_t k = 0; k < depth; ++k)
+        {
+            if (mask.at(k))
+            {
+                weights.at(size_t(row) * depth + k) = distribution(generator);
+            }
+        }
+    }
+    return weights;
+}
+
+/**
+ * @brief Runs every test on the generic or the AVX2 tiles
+ */
+class SparseGemmTest : public ::testing::TestWithParam<bool>
+{
+   protected:
+    void SetUp() override
+    {
+        CpuFeatures features;
+        features.avx2 = GetParam();
+        features.fma = GetParam();
+        LimitCpuFeatures(features);
+        if (GetParam() && !GetCpuFeatures().avx2)
+        {
+            GTEST_SKIP() << "The CPU has no AVX2 instructions";
+        }
+    }
+
+    void TearDown() override
+    {
+        ResetCpuFeatures();
+    }
+};
+}  // namespace
+
+TEST_P(SparseGemmTest, MatchesReference)
+{
+    std::mt19937 generator(3);
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+    for (uint32_t group_rows : {1u, 2u, 4u})
+    {
+        for (uint32_t rows : {1u, 5u, 13u, 32u})
+        {
+            for (uint32_t depth : {1u, 9u, 37u, 200u})
+            {
+                const std::vector<float> weights = SparseWeights(rows, depth, group_rows, generator);
+                const BlockedCsrMatrix packed = PackBlockedCsr(weights.data(), rows, depth);
+                if (rows >= 13 && depth >= 37)
+                {
+                    ASSERT_EQ(packed.block_rows, group_rows) << "rows " << rows << " depth " << depth;
+                }
+                ASSERT_EQ(packed.block_offsets.size(), (rows + packed.block_rows - 1) / packed.block_rows + 1);
+                ASSERT_EQ(packed.values.size(), size_t(packed.columns.size()) * packed.block_rows);
+
+                std::vector<float> bias(rows);
+                for (float& value : bias)
+                {
+                    value = distribution(generator);
+                }
+                for (uint32_t columns : {1u, 15u, 16u, 17u, 40u})
+                {
+                    std::vector<float> activations(size_t(depth) * columns);
+                    for (float& activation : activations)
+                    {
+                        activation = distribution(generator);
+                    }
+
+                    for (bool use_bias : {false, true})
+                    {
+                        const size_t output_stride = columns + 2;
+                        std::vector<float> output(rows * output_stride, -1000.f);
+                        SparseGemm(packed, activations.data(), columns, use_bias ? bias.data() : nullptr,
+                                   output.data(), output_stride);
+                        for (uint32_t r = 0; r < rows; ++r)
+                        {
+                            for (uint32_t c = 0; c < columns; ++c)
+                            {
+                                double expected = use_bias ? bias.at(r) : 0.;
+                                double magnitude = std::fabs(expected);
+                                for (uint32_t k = 0; k < depth; ++k)
+                                {
+                                    const double product = double(weights.at(size_t(r) * depth + k)) *
+                                                           activations.at(size_t(k) * columns + c);
+                                    expected += product;
+                                    magnitude += std::fabs(product);
+                                }
+                                ASSERT_NEAR(output.at(r * output_stride + c), expected, 1e-5 * magnitude + 1e-6)
+                                    << "group " << group_rows << " rows " << rows << " depth " << depth
+                                    << " columns " << columns << " at " << r << "," << c << " bias " << use_bias;
+                            }
+                            for (size_t c = columns; c < output_stride; ++c)
+                            {
+                                ASSERT_EQ(output.at(r * output_stride + c), -1000.f);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(SparseTiles, SparseGemmTest, ::testing::Values(false, true),
+                         [](const ::testing::TestParamInfo<bool>& info) {
+                             return std::string(info.param ? "avx2" : "generic");
+                         });
+
+TEST(SparseGemmPackTest, WeightSparsityCountsZeros)
+{
+    const std::vector<float> weights = {0.f, 1.f, -0.f, 2.f, 0.f, 0.f, 3.f, 0.f};
+    EXPECT_FLOAT_EQ(WeightSparsity(weights.data(), weights.size()), 5.f / 8.f);
+
+    const BlockedCsrMatrix packed = PackBlockedCsr(weights.data(), 2, 4);
+    size_t nonzeros = 0;
+    for (float value : packed.values)
+    {
+        nonzeros += value != 0.f;
+    }
+    EXPECT_EQ(nonzeros, 3u);
+}
@@ -0,0 +1,282 @@
+
+#include <glog/logging.h>
+#include <omp.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "runtime/runtime_ir.hpp"
+#include "utils/math/direct_conv.hpp"
+#include "utils/math/gemm_backend.hpp"
+
+using namespace black_scholes;
+
+namespace
+{
+struct BenchmarkOptions
+{
+    std::string param_path;
+    std::string bin_path;
+    /// batch size, the model's own batch when zero
+    uint32_t batch_size = 0;
+    /// thread count, the OpenMP default when zero
+    uint32_t num_threads = 0;
+    bool spinning_workers = false;
+    utils::GemmBackendType gemm_backend = utils::GemmBackendType::kPacked;
+    /// stride-2 3x3 and 1x1 convolutions on the direct kernels instead of im2col
+    bool direct_conv = true;
+    uint32_t iterations = 100;
+    uint32_t warmup = 10;
+    uint32_t top_layers = 20;
+    std::string json_path;
+};
+
+void PrintUsage(const char* program)
+{
+    std::cout << "Usage: " << program << " --param=<model.param> --bin=<model.bin> [options]\n"
+              << "  --batch=N          batch size, defaults to the model's batch\n"
+              << "  --threads=N        number of threads, defaults to all cores\n"
+              << "  --spin             run the layers on spinning pool workers\n"
+              << "  --gemm=packed|blas GEMM of the convolutions, in-tree or the linked BLAS (packed)\n"
+              << "  --direct=on|off    direct kernels for the stride-2 3x3 and 1x1 convolutions (on)\n"
+              << "  --iterations=N     number of measured inferences (100)\n"
+              << "  --warmup=N         number of inferences before measuring (10)\n"
+              << "  --top=N            number of layers in the breakdown, 0 for all (20)\n"
+              << "  --json=<path>      also write the report as JSON\n"
+              << "The channels and spatial size of the inputs are fixed when the model is exported,\n"
+              << "export it again to benchmark another input size.\n";
+}
+
+bool ParseUint(const std::string& value, uint32_t& result)
+{
+    char* end = nullptr;
+    const unsigned long parsed = std::strtoul(value.c_str(), &end, 10);
+    if (value.empty() || end == nullptr || *end != '\0')
+    {
+        return false;
+    }
+    result = uint32_t(parsed);
+    return true;
+}
+
+bool ParseOptions(int argc, char* argv[], BenchmarkOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const size_t equal_pos = arg.find('=');
+        const std::string key = arg.substr(0, equal_pos);
+        const std::string value = equal_pos == std::string::npos ? "" : arg.substr(equal_pos + 1);
+
+        bool valid = true;
+        if (key == "--param")
+            options.param_path = value;
+        else if (key == "--bin")
+            options.bin_path = value;
+        else if (key == "--batch")
+            valid = ParseUint(value, options.batch_size);
+        else if (key == "--threads")
+            valid = ParseUint(value, options.num_threads);
+        else if (key == "--spin")
+            options.spinning_workers = true;
+        else if (key == "--gemm")
+            valid = utils::ParseGemmBackend(value, options.gemm_backend);
+        else if (key == "--direct")
+        {
+            valid = value == "on" || value == "off";
+            options.direct_conv = value == "on";
+        }
+        else if (key == "--iterations")
+            valid = ParseUint(value, options.iterations) && options.iterations > 0;
+        else if (key == "--warmup")
+            valid = ParseUint(value, options.warmup);
+        else if (key == "--top")
+            valid = ParseUint(value, options.top_layers);
+        else if (key == "--json")
+            options.json_path = value;
+        else
+            valid = false;
+
+        if (!valid)
+        {
+            std::cerr << "Invalid argument: " << arg << "\n";
+            return false;
+        }
+    }
+    return !options.param_path.empty() && !options.bin_path.empty();
+}
+
+double ElapsedMs(std::chrono::steady_clock::time_point start_time)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+std::string JsonEscape(const std::string& str)
+{
+    std::string escaped;
+    for (char c : str)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+void WriteSnapshotJson(std::ostream& out, const utils::LatencySnapshot& snapshot)
+{
+    out << "{\"name\":\"" << JsonEscape(snapshot.name) << "\",\"count\":" << snapshot.count
+        << ",\"mean_ms\":" << snapshot.mean_ns * 1e-6 << ",\"min_ms\":" << snapshot.min_ns * 1e-6
+        << ",\"max_ms\":" << snapshot.max_ns * 1e-6 << ",\"p50_ms\":" << snapshot.p50_ns * 1e-6
+        << ",\"p90_ms\":" << snapshot.p90_ns * 1e-6 << ",\"p99_ms\":" << snapshot.p99_ns * 1e-6
+        << ",\"p999_ms\":" << snapshot.p999_ns * 1e-6 << "}";
+}
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_logtostderr = true;
+
+    BenchmarkOptions options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    if (options.num_threads > 0)
+    {
+        omp_set_num_threads(int(options.num_threads));
+    }
+    utils::SetGemmBackend(options.gemm_backend);
+    utils::SetDirectConvEnabled(options.direct_conv);
+
+    const auto load_start = std::chrono::steady_clock::now();
+    RuntimeGraph graph(options.param_path, options.bin_path);
+    if (options.spinning_workers)
+    {
+        utils::WorkerConfig worker_config;
+        worker_config.mode = utils::WorkerMode::kSpinning;
+        worker_config.num_threads = options.num_threads;
+        graph.set_worker_config(worker_config);
+    }
+    // the operand shapes take the batch before Build allocates the outputs
+    graph.set_batch_size(options.batch_size);
+    graph.Build();
+    const double load_ms = ElapsedMs(load_start);
+
+    uint32_t batch_size = options.batch_size;
+    for (const std::string& input_name : graph.input_names())
+    {
+        const std::vector<int32_t> model_shape = graph.input_shape(input_name);
+        CHECK_EQ(model_shape.size(), 4) << "Only 4-d inputs are supported, input: " << input_name;
+        if (batch_size == 0)
+        {
+            batch_size = uint32_t(model_shape.at(0));
+        }
+        CHECK_EQ(int32_t(batch_size), model_shape.at(0)) << "The batch of " << input_name << " was not changed";
+        const std::vector<uint32_t> shape = {uint32_t(model_shape.at(1)), uint32_t(model_shape.at(2)),
+                                             uint32_t(model_shape.at(3))};
+        std::vector<sftensor> inputs(batch_size);
+        for (sftensor& input : inputs)
+        {
+            input = std::make_shared<Tensor<float>>(shape.at(0), shape.at(1), shape.at(2));
+            input->Rand();
+        }
+        graph.set_inputs(input_name, inputs);
+    }
+
+    const auto first_start = std::chrono::steady_clock::now();
+    graph.Forward();
+    const double first_inference_ms = ElapsedMs(first_start);
+    for (uint32_t i = 1; i < options.warmup; ++i)
+    {
+        graph.Forward();
+    }
+    graph.ResetLatencyHistograms();
+
+    const auto run_start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < options.iterations; ++i)
+    {
+        graph.Forward();
+    }
+    const double run_ms = ElapsedMs(run_start);
+    const double throughput = double(options.iterations) * batch_size / (run_ms * 1e-3);
+
+    std::vector<utils::LatencySnapshot> snapshots = graph.latency_snapshot();
+    CHECK(!snapshots.empty() && snapshots.front().name == "forward");
+    const utils::LatencySnapshot forward = snapshots.front();
+    std::vector<utils::LatencySnapshot> layers(snapshots.begin() + 1, snapshots.end());
+    std::sort(layers.begin(), layers.end(), [](const utils::LatencySnapshot& a, const utils::LatencySnapshot& b) {
+        return a.mean_ns > b.mean_ns;
+    });
+    if (options.top_layers > 0 && layers.size() > options.top_layers)
+    {
+        layers.resize(options.top_layers);
+    }
+
+    printf("Model: %s\n", options.param_path.c_str());
+    printf("Threads: %d%s, batch: %u, iterations: %u, warmup: %u, gemm: %s, direct: %s\n",
+           options.num_threads > 0 ? int(options.num_threads) : omp_get_max_threads(),
+           options.spinning_workers ? " (spinning)" : "", batch_size, options.iterations, options.warmup,
+           utils::GemmBackendName(options.gemm_backend), options.direct_conv ? "on" : "off");
+    printf("Load + build time: %.3f ms\n", load_ms);
+    printf("First inference:   %.3f ms\n", first_inference_ms);
+    printf("Latency mean: %.3f ms  min: %.3f  p50: %.3f  p90: %.3f  p99: %.3f  max: %.3f ms\n",
+           forward.mean_ns * 1e-6, forward.min_ns * 1e-6, forward.p50_ns * 1e-6, forward.p90_ns * 1e-6,
+           forward.p99_ns * 1e-6, forward.max_ns * 1e-6);
+    printf("Throughput: %.2f images/s\n", throughput);
+    const utils::MemoryReport memory_report = graph.memory_report();
+    printf("Memory peak: %.2f MiB", memory_report.total.peak_bytes / (1024. * 1024.));
+    for (uint32_t i = 0; i < utils::kMemoryCategoryCount; ++i)
+    {
+        printf("  %s: %.2f", utils::MemoryCategoryName(utils::MemoryCategory(i)),
+               memory_report.categories.at(i).peak_bytes / (1024. * 1024.));
+    }
+    printf(" MiB\n\n");
+    printf("%-40s %12s %12s %12s %8s\n", "Layer", "mean(ms)", "p50(ms)", "p99(ms)", "share");
+    for (const utils::LatencySnapshot& layer : layers)
+    {
+        printf("%-40s %12.4f %12.4f %12.4f %7.2f%%\n", layer.name.c_str(), layer.mean_ns * 1e-6,
+               layer.p50_ns * 1e-6, layer.p99_ns * 1e-6,
+               forward.mean_ns > 0. ? 100. * layer.mean_ns / forward.mean_ns : 0.);
+    }
+
+    if (!options.json_path.empty())
+    {
+        std::ofstream json_file(options.json_path);
+        if (!json_file.is_open())
+        {
+            LOG(ERROR) << "Can not open the json file: " << options.json_path;
+            return 1;
+        }
+        json_file << "{\"model\":\"" << JsonEscape(options.param_path) << "\",\"batch\":" << batch_size
+                  << ",\"iterations\":" << options.iterations << ",\"warmup\":" << options.warmup
+                  << ",\"load_ms\":" << load_ms << ",\"first_inference_ms\":" << first_inference_ms
+                  << ",\"throughput\":" << throughput << ",\"memory_peak_bytes\":{\"total\":"
+                  << memory_report.total.peak_bytes;
+        for (uint32_t i = 0; i < utils::kMemoryCategoryCount; ++i)
+        {
+            json_file << ",\"" << utils::MemoryCategoryName(utils::MemoryCategory(i))
+                      << "\":" << memory_report.categories.at(i).peak_bytes;
+        }
+        json_file << "},\"latency\":";
+        WriteSnapshotJson(json_file, forward);
+        json_file << ",\"layers\":[";
+        for (size_t i = 0; i < layers.size(); ++i)
+        {
+            json_file << (i == 0 ? "\n" : ",\n");
+            WriteSnapshotJson(json_file, layers.at(i));
+        }
+        json_file << "\n]}\n";
+    }
+    return 0;
+}
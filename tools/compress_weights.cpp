@@ -0,0 +1,205 @@
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "runtime/pnnx/ir.h"
+#include "utils/math/weight_quantization.hpp"
+
+using namespace black_scholes;
+
+namespace
+{
+struct CompressOptions
+{
+    std::string param_path;
+    std::string bin_path;
+    std::string output_param_path;
+    std::string output_bin_path;
+    /// 8 for per-channel int8, 4 for group-wise int4
+    uint32_t bits = 8;
+    /// values sharing one int4 scale along a weight row
+    uint32_t group_size = 64;
+    /// weights with fewer values stay float
+    uint32_t min_elements = 1024;
+};
+
+void PrintUsage(const char* program)
+{
+    std::cout << "Usage: " << program
+              << " --param=<model.param> --bin=<model.bin> --out-param=<out.param> --out-bin=<out.bin> [options]\n"
+              << "  --bits=8|4         per output channel int8, or int4 with one scale per group (8)\n"
+              << "  --group=N          int4 values sharing a scale along a weight row (64)\n"
+              << "  --min-elements=N   weights smaller than this stay float (1024)\n";
+}
+
+bool ParseUint(const std::string& value, uint32_t& result)
+{
+    char* end = nullptr;
+    const unsigned long parsed = std::strtoul(value.c_str(), &end, 10);
+    if (value.empty() || end == nullptr || *end != '\0')
+    {
+        return false;
+    }
+    result = uint32_t(parsed);
+    return true;
+}
+
+bool ParseOptions(int argc, char* argv[], CompressOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const size_t equal_pos = arg.find('=');
+        const std::string key = arg.substr(0, equal_pos);
+        const std::string value = equal_pos == std::string::npos ? "" : arg.substr(equal_pos + 1);
+
+        bool valid = true;
+        if (key == "--param")
+            options.param_path = value;
+        else if (key == "--bin")
+            options.bin_path = value;
+        else if (key == "--out-param")
+            options.output_param_path = value;
+        else if (key == "--out-bin")
+            options.output_bin_path = value;
+        else if (key == "--bits")
+            valid = ParseUint(value, options.bits) && (options.bits == 8 || options.bits == 4);
+        else if (key == "--group")
+            valid = ParseUint(value, options.group_size) && options.group_size > 0;
+        else if (key == "--min-elements")
+            valid = ParseUint(value, options.min_elements);
+        else
+            valid = false;
+
+        if (!valid)
+        {
+            std::cerr << "Invalid argument: " << arg << "\n";
+            return false;
+        }
+    }
+    return !options.param_path.empty() && !options.bin_path.empty() && !options.output_param_path.empty() &&
+           !options.output_bin_path.empty();
+}
+
+int32_t GroupsParameter(const pnnx::Operator* op)
+{
+    auto groups_iter = op->params.find("groups");
+    if (groups_iter == op->params.end() || groups_iter->second.type != 2)
+    {
+        return 1;
+    }
+    return std::max(groups_iter->second.i, 1);
+}
+
+/**
+ * @brief Replaces the float weight of a convolution with int8 levels and per output channel scales
+ *
+ * The layout is the one BaseConvolutionLayer reads: an i8 "weight" and an f32 "weight_scales".
+ */
+void CompressInt8(pnnx::Operator* op)
+{
+    pnnx::Attribute& weight = op->attrs.at("weight");
+    const std::vector<float> weights = weight.get_float32_data();
+    std::vector<int8_t> levels;
+    std::vector<float> scales;
+    utils::QuantizeConvWeightsInt8(weights, weight.shape, op->type == "nn.ConvTranspose2d", GroupsParameter(op),
+                                   levels, scales);
+
+    weight.type = 7;
+    weight.data.assign(reinterpret_cast<const char*>(levels.data()),
+                       reinterpret_cast<const char*>(levels.data()) + levels.size());
+    op->attrs["weight_scales"] = pnnx::Attribute({int(scales.size())}, scales);
+}
+
+/**
+ * @brief Replaces the float weight of an operator with packed int4 levels and per group scales
+ *
+ * The runtime graph dequantizes them while it loads the model, see weight_bits and weight_group_size.
+ */
+void CompressInt4(pnnx::Operator* op, uint32_t group_size)
+{
+    pnnx::Attribute& weight = op->attrs.at("weight");
+    const std::vector<float> weights = weight.get_float32_data();
+    const size_t row_len = weights.size() / weight.shape.front();
+    std::vector<uint8_t> packed;
+    std::vector<float> scales;
+    utils::QuantizeWeightsInt4(weights, row_len, group_size, packed, scales);
+
+    op->params["weight_bits"] = pnnx::Parameter(4);
+    op->params["weight_group_size"] = pnnx::Parameter(int(group_size));
+    op->params["weight_shape"] = pnnx::Parameter(weight.shape);
+    weight.type = 8;
+    weight.shape = {int(packed.size())};
+    weight.data.assign(reinterpret_cast<const char*>(packed.data()),
+                       reinterpret_cast<const char*>(packed.data()) + packed.size());
+    op->attrs["weight_scales"] = pnnx::Attribute({int(scales.size())}, scales);
+}
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_logtostderr = true;
+
+    CompressOptions options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    pnnx::Graph graph;
+    if (graph.load(options.param_path, options.bin_path) != 0)
+    {
+        LOG(ERROR) << "Can not load the model " << options.param_path << " " << options.bin_path;
+        return 1;
+    }
+
+    size_t float_bytes = 0;
+    size_t compressed_bytes = 0;
+    uint32_t compressed_count = 0;
+    for (pnnx::Operator* op : graph.ops)
+    {
+        if (op->type != "nn.Conv2d" && op->type != "nn.ConvTranspose2d")
+        {
+            continue;
+        }
+        auto weight_iter = op->attrs.find("weight");
+        if (weight_iter == op->attrs.end() || weight_iter->second.shape.size() != 4)
+        {
+            continue;
+        }
+        const pnnx::Attribute& weight = weight_iter->second;
+        if ((weight.type != 1 && weight.type != 3) || uint32_t(weight.elemcount()) < options.min_elements)
+        {
+            continue;
+        }
+
+        const size_t original_bytes = weight.data.size();
+        if (options.bits == 8)
+        {
+            CompressInt8(op);
+        }
+        else
+        {
+            CompressInt4(op, options.group_size);
+        }
+        const size_t new_bytes = op->attrs.at("weight").data.size() + op->attrs.at("weight_scales").data.size();
+        float_bytes += original_bytes;
+        compressed_bytes += new_bytes;
+        compressed_count += 1;
+        LOG(INFO) << op->name << ": " << original_bytes << " -> " << new_bytes << " bytes";
+    }
+
+    if (graph.save(options.output_param_path, options.output_bin_path) != 0)
+    {
+        LOG(ERROR) << "Can not save the model " << options.output_param_path << " " << options.output_bin_path;
+        return 1;
+    }
+    LOG(INFO) << "Compressed " << compressed_count << " weights to int" << options.bits << ": " << float_bytes
+              << " -> " << compressed_bytes << " bytes";
+    return 0;
+}